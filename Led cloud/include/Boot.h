@@ -0,0 +1,56 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Boot phases, in the order they are reported
+ *
+ * The first group runs in sequence during setup(). WiFi, clock and the first
+ * weather reading complete in the background after the scheduler has started.
+ */
+enum BootPhase : uint8_t {
+    BOOT_SETUP,           // setup() from start to the scheduler taking over
+    BOOT_SCENE,           // NeoPixel strip showing its last scene
+    BOOT_FILESYSTEM,
+    BOOT_SETTINGS,
+    BOOT_WEATHER_SERVICE,
+    BOOT_WEB_SERVER,
+    BOOT_WIFI,            // Background: station associated and got an address
+    BOOT_CLOCK,           // Background: first SNTP sync
+    BOOT_FIRST_WEATHER,   // Background: first reading from the weather API
+    BOOT_PHASE_COUNT
+};
+
+/**
+ * @class BootTimeline
+ * @brief Records when each boot phase started and finished (micros() since reset)
+ *
+ * The free heap at the end of each phase shows what the phases cost; compare
+ * it with the steady-state heap gauges on /metrics.
+ */
+class BootTimeline {
+public:
+    struct Phase {
+        uint32_t startUs;
+        uint32_t endUs;
+        uint32_t freeHeap;   // Free heap when the phase finished
+        bool started;
+        bool finished;
+    };
+
+    static void start(BootPhase phase);
+
+    /**
+     * @brief Mark a phase finished; later calls for the same phase are ignored
+     */
+    static void finish(BootPhase phase);
+
+    static const Phase& get(uint8_t phase) { return phases[phase]; }
+    static const char* getName(uint8_t phase);
+
+private:
+    static Phase phases[BOOT_PHASE_COUNT];
+};
+
+#endif // BOOT_H
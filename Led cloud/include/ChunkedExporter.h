@@ -0,0 +1,49 @@
+#ifndef CHUNKED_EXPORTER_H
+#define CHUNKED_EXPORTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class ChunkedExporter
+ * @brief Base of the documents streamed through chunked HTTP responses
+ *
+ * A subclass formats its document one piece at a time into pending;
+ * fill() hands that text out in whatever sizes the response asks for and
+ * requests the next piece once the last one is used up. fill() returns 0
+ * once formatNext() has reported the end and all formatted text is out.
+ */
+class ChunkedExporter {
+public:
+    virtual ~ChunkedExporter() {}
+    size_t fill(uint8_t* out, size_t maxLen);
+
+protected:
+    static const size_t PENDING_SIZE = 192;
+
+    ChunkedExporter() : pendingLength(0), pendingOffset(0), done(false) {}
+
+    /**
+     * @brief Format the next piece of the document into pending and set pendingLength
+     *
+     * pendingLength is 0 on entry; a piece may be empty.
+     * @return false once the document is complete (nothing was formatted)
+     */
+    virtual bool formatNext() = 0;
+
+    /**
+     * @brief Set pendingLength from an snprintf() result, which counts text that did not fit
+     */
+    void setPendingLength(int length) {
+        pendingLength = length < 0 ? 0 : ((size_t)length < PENDING_SIZE ? length : PENDING_SIZE - 1);
+    }
+
+    char pending[PENDING_SIZE];  // Formatted text not yet handed out
+    size_t pendingLength;
+
+private:
+    size_t pendingOffset;
+    bool done;
+};
+
+#endif // CHUNKED_EXPORTER_H
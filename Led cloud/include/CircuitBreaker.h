@@ -0,0 +1,131 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <stdint.h>
+
+/**
+ * @class CircuitBreaker
+ * @brief Exponential backoff with jitter and a closed/open/half-open breaker
+ *
+ * Each failure pushes the next allowed attempt out by an exponentially growing,
+ * jittered delay. After failureThreshold consecutive failures the breaker opens
+ * and rejects everything until its cooldown expires; it then lets a single
+ * probe through (half-open). A successful probe closes it again, a failed one
+ * reopens it with a doubled cooldown.
+ *
+ * The class only does arithmetic on caller-supplied timestamps and random
+ * values, so it has no dependency on the Arduino core.
+ */
+class CircuitBreaker {
+public:
+    enum State : uint8_t {
+        CLOSED = 0,     // Normal operation, backoff only after individual failures
+        OPEN = 1,       // Too many consecutive failures, all attempts rejected
+        HALF_OPEN = 2   // Cooldown expired, one probe attempt allowed
+    };
+
+    CircuitBreaker(uint8_t failureThreshold, uint32_t baseBackoffMs,
+                   uint32_t maxBackoffMs, uint32_t openCooldownMs)
+        : threshold(failureThreshold), baseBackoff(baseBackoffMs), maxBackoff(maxBackoffMs),
+          baseCooldown(openCooldownMs), state(CLOSED), consecutiveFailures(0),
+          totalFailures(0), openCount(0), cooldown(openCooldownMs), lastChangeMs(0), waitMs(0) {}
+
+    /**
+     * @brief Whether an attempt may be made now; moves OPEN to HALF_OPEN once the cooldown expires
+     */
+    bool allowRequest(uint32_t nowMs) {
+        if (nowMs - lastChangeMs < waitMs) {
+            return false;
+        }
+        if (state == OPEN) {
+            state = HALF_OPEN;
+        }
+        return true;
+    }
+
+    void recordSuccess(uint32_t nowMs) {
+        state = CLOSED;
+        consecutiveFailures = 0;
+        cooldown = baseCooldown;
+        lastChangeMs = nowMs;
+        waitMs = 0;
+    }
+
+    /**
+     * @param nowMs Time of the failure
+     * @param randomValue Any uniformly distributed value, used for jitter
+     */
+    void recordFailure(uint32_t nowMs, uint32_t randomValue) {
+        totalFailures++;
+        if (consecutiveFailures < UINT16_MAX) {
+            consecutiveFailures++;
+        }
+        lastChangeMs = nowMs;
+
+        if (state == HALF_OPEN) {
+            // Failed probe: reopen and wait twice as long before the next one
+            cooldown = cooldown > maxCooldown() / 2 ? maxCooldown() : cooldown * 2;
+            open(randomValue);
+        } else if (consecutiveFailures >= threshold) {
+            open(randomValue);
+        } else {
+            // "Equal jitter": half the backoff is fixed, the other half random
+            uint32_t backoff = baseBackoff;
+            for (uint16_t i = 1; i < consecutiveFailures && backoff < maxBackoff; i++) {
+                backoff *= 2;
+            }
+            if (backoff > maxBackoff) {
+                backoff = maxBackoff;
+            }
+            waitMs = withJitter(backoff, randomValue);
+        }
+    }
+
+    State getState() const { return state; }
+    uint16_t getConsecutiveFailures() const { return consecutiveFailures; }
+    uint32_t getTotalFailures() const { return totalFailures; }
+    uint32_t getOpenCount() const { return openCount; }
+
+    uint32_t getRetryInMs(uint32_t nowMs) const {
+        uint32_t elapsed = nowMs - lastChangeMs;
+        return elapsed < waitMs ? waitMs - elapsed : 0;
+    }
+
+    static const char* stateName(State s) {
+        switch (s) {
+            case CLOSED: return "closed";
+            case OPEN: return "open";
+            case HALF_OPEN: return "half-open";
+        }
+        return "unknown";
+    }
+
+private:
+    uint8_t threshold;
+    uint32_t baseBackoff;
+    uint32_t maxBackoff;
+    uint32_t baseCooldown;
+
+    State state;
+    uint16_t consecutiveFailures;
+    uint32_t totalFailures;
+    uint32_t openCount;
+    uint32_t cooldown;       // Current open-state cooldown (doubles on failed probes)
+    uint32_t lastChangeMs;   // Time of the last recorded outcome
+    uint32_t waitMs;         // Delay after lastChangeMs before the next attempt
+
+    uint32_t maxCooldown() const { return baseCooldown * 16; }
+
+    static uint32_t withJitter(uint32_t delay, uint32_t randomValue) {
+        uint32_t half = delay / 2;
+        return half + randomValue % (half + 1);
+    }
+
+    void open(uint32_t randomValue) {
+        state = OPEN;
+        openCount++;
+        waitMs = withJitter(cooldown, randomValue);
+    }
+};
+
+#endif // CIRCUIT_BREAKER_H
@@ -0,0 +1,117 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @struct SyncBeacon
+ * @brief Leader time announcement, sent over UDP multicast
+ *
+ * Encoded little-endian into SyncBeacon::SIZE bytes, independent of struct
+ * layout, so nodes built with different compilers interoperate.
+ */
+struct SyncBeacon {
+    static const size_t SIZE = 28;
+
+    uint32_t nodeId;      // Sender; the lowest id on the network leads
+    uint32_t sequence;
+    uint64_t networkUs;   // Sender's network time when the packet was sent
+    uint32_t epochMs;     // Network time (ms, wrapping) at which animation time is zero
+
+    size_t encode(uint8_t* out) const;
+    bool decode(const uint8_t* data, size_t length);
+};
+
+/**
+ * @class ClockSync
+ * @brief Leader/follower clock synchronisation for a shared animation timeline
+ *
+ * Every node keeps a model of network time: local time plus an offset that
+ * changes at an estimated drift rate. The node with the lowest id is the
+ * leader and broadcasts its network time; followers compare each beacon with
+ * what their model predicted and correct offset and drift with a small PI
+ * loop. Corrections are larger when a beacon arrives "early" (less network
+ * delay than usual), which biases the estimate toward the minimum delay.
+ *
+ * If the leader goes quiet for SYNC_LEADER_TIMEOUT, the lowest-id follower
+ * takes over with its current model, so network time continues smoothly.
+ *
+ * Only arithmetic on caller-supplied 64-bit microsecond timestamps; the
+ * transport is up to the caller, so several instances can run on one host.
+ */
+class ClockSync {
+public:
+    explicit ClockSync(uint32_t nodeId);
+
+    /**
+     * @brief Network time for a local timestamp
+     */
+    uint64_t networkTimeUs(uint64_t localUs) const;
+
+    /**
+     * @brief Milliseconds on the shared animation timeline (wraps after ~49 days)
+     */
+    uint32_t animationTimeMs(uint64_t localUs) const;
+
+    /**
+     * @brief Move the animation epoch so that animation time is elapsedMs now
+     *
+     * Used to resume after a soft reset; followers adopt the leader's epoch.
+     */
+    void setAnimationElapsed(uint32_t elapsedMs, uint64_t localUs);
+
+    /**
+     * @brief Check whether a beacon is due
+     * @param beacon Filled in when the function returns true
+     */
+    bool poll(uint64_t localUs, SyncBeacon& beacon);
+
+    /**
+     * @brief Process a received beacon
+     * @param localUs Local time at reception, taken as early as possible
+     */
+    void onBeacon(const SyncBeacon& beacon, uint64_t localUs);
+
+    bool isLeader() const { return leaderId == nodeId; }
+    bool isSynced() const { return synced; }
+    uint32_t getNodeId() const { return nodeId; }
+    uint32_t getLeaderId() const { return leaderId; }
+    int64_t getOffsetUs(uint64_t localUs) const { return modelOffset(localUs); }
+    float getDriftPpm() const { return (float)(drift * 1e6); }
+
+    // Sync error: difference between a beacon and the model's prediction
+    uint32_t getLastErrorUs() const { return lastErrorUs; }
+    uint32_t getMeanErrorUs() const { return meanErrorScaled / 8; }
+    uint32_t getMaxErrorUs() const { return windowMaxErrorUs > maxErrorUs ? windowMaxErrorUs : maxErrorUs; }
+    uint32_t getBeaconsSent() const { return beaconsSent; }
+    uint32_t getBeaconsReceived() const { return beaconsReceived; }
+
+private:
+    uint32_t nodeId;
+    uint32_t leaderId;
+    bool synced;                // A follower has applied at least one beacon from the current leader
+    uint64_t lastBeaconUs;      // Local time of the last beacon from the leader (or sent as leader)
+    uint32_t sequence;
+
+    // Model: network = local + anchorOffset + drift * (local - anchorUs)
+    uint64_t anchorUs;
+    int64_t anchorOffset;
+    double drift;
+    uint32_t epochMs;
+
+    uint32_t lastErrorUs;
+    uint32_t meanErrorScaled;   // Moving average times 8, 1/8 weight per beacon
+    uint32_t maxErrorUs;        // Largest error in the current window
+    uint32_t windowMaxErrorUs;  // Largest error in the previous window
+    uint8_t windowCount;
+    uint32_t beaconsSent;
+    uint32_t beaconsReceived;
+
+    int64_t modelOffset(uint64_t localUs) const;
+    void recordError(int64_t residual);
+    void resetError();
+};
+
+#endif // CLOCK_SYNC_H
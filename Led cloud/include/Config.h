@@ -12,18 +12,122 @@
 // LED Configuration
 #define DEFAULT_BRIGHTNESS 100      // Default LED brightness (0-255)
 #define LED_PIN LED_BUILTIN         // Default LED pin
+#define NEOPIXEL_COUNT 60           // Pixels on the NeoPixel strip
+#define NEOPIXEL_ORDER OrderGRB     // Colour order on the wire: OrderRGB, OrderGRB, OrderRGBW or OrderGRBW
+#define WARM_STATE_INTERVAL 1000    // How often a running animation checkpoints to RTC memory (ms)
+#define NEOPIXEL_OUTPUT_INTERVAL 16 // Strip refresh while animating (ms, ~60 fps); slow patterns are blended between keyframes
+
+// Render quality governor (frame overruns step render quality down, clean running steps it back up)
+#define QUALITY_FRAME_BUDGET (NEOPIXEL_COUNT * 30 + 6000)  // Update + send time per output frame: the strip's wire time (30 us per pixel) plus 6 ms (us)
+#define QUALITY_WINDOW 32           // Output frames per decision (about half a second)
+#define QUALITY_DOWN_OVERRUNS 8     // Overrunning frames in one window that drop a level
+#define QUALITY_RECOVER_MARGIN 2000 // A window counts toward recovery if every frame finished at least this far inside the budget (us)
+#define QUALITY_RECOVER_WINDOWS 8   // Clean windows in a row before a level is restored; doubles after a relapse, up to 8x
+#define QUALITY_HISTORY 8           // Level changes kept for /neopixel/quality
+
+// Frame cache (chase, fade and color wipe repeat exactly; one cycle is rendered, then replayed).
+// Takes about FRAME_CACHE_BYTES + 2 * FRAME_CACHE_FRAMES of heap, only while one of them runs
+#define FRAME_CACHE_BYTES 3072      // Encoded frames of one cycle, 6 bytes per changed run of pixels at RGB; longer cycles are partly cached
+#define FRAME_CACHE_FRAMES 384      // Frames per cached cycle (color wipe is 6 passes over the strip, 360 at 60 pixels)
+#define FRAME_CACHE_FILL_AHEAD 4    // Frames one update renders into the cache to catch up; a bigger jump is only rendered
 
 // Server Configuration
 #define WEB_SERVER_PORT 80          // Web server port
 
 // Weather Configuration
 #define WEATHER_API_KEY "7f29f73f56a4c0e81cbdd4900b8886bb"  // OpenWeatherMap API key
+#define WEATHER_API_BASE_URL "http://api.openweathermap.org/data/2.5"  // API base URL (plain http; point at a stand-in server for testing)
 #define LATITUDE 9.953397           // Default latitude 
 #define LONGITUDE 76.353383         // Default longitude 
 #define WEATHER_UPDATE_INTERVAL 1200000  // Weather update frequency (20 minutes in ms)
+#define WEATHER_PARSE_BUFFER_LIMIT 1024  // Max heap the filtered weather parse may use (bytes)
+#define WEATHER_CACHE_TTL 600000    // Cached weather is served without an API call while younger than this (10 minutes)
+#define WEATHER_POLL_INTERVAL 10000 // How often the weather task checks whether a fetch or retry is due
+#define WEATHER_HTTP_TIMEOUT 5000   // Connect/read timeout for weather requests (ms)
+#define WEATHER_PROBE_TIMEOUT 1500  // TCP connect timeout for the half-open reprobe (ms)
+#define WEATHER_FAILURE_THRESHOLD 5 // Consecutive failures before the circuit breaker opens
+#define WEATHER_BACKOFF_BASE 30000  // First retry delay after a failure (ms, doubles per failure)
+#define WEATHER_BACKOFF_MAX 600000  // Longest retry delay while the breaker is closed (ms)
+#define WEATHER_BREAKER_COOLDOWN 300000  // Time the breaker stays open before a reprobe (ms, doubles per failed probe)
+#define FORECAST_UPDATE_INTERVAL 10800000  // 5-day/3-hour forecast refresh (3 hours in ms)
+#define FORECAST_CAPACITY 48        // Forecast slots kept in RAM (40 ahead + 1 day of history, 8 bytes each)
+
+// Time Configuration
+#define NTP_SERVER "pool.ntp.org"   // Primary NTP server (used to age cached data across reboots)
+#define NTP_SERVER_FALLBACK "time.google.com"
+
+// Settings persistence (/settings.bin)
+#define SETTINGS_WRITE_DELAY 2000   // Write settings once changes have been quiet this long (ms)
+#define SETTINGS_WRITE_MAX_DELAY 10000  // ...or at the latest this long after the first change (ms)
+#define SETTINGS_CHECK_INTERVAL 500 // How often pending settings changes are checked (ms)
+
+// LED presets (/presets.bin)
+#define PRESET_SLOTS 16             // Slots in the preset file (208 bytes each at 60 pixels)
+#define PRESET_NAME_MAX 16          // Longest preset name, including the terminator
+
+// Pixel programs (PixelVM, /neopixel/program)
+#define VM_MAX_PROGRAM 256          // Bytecode bytes per program
+#define VM_STACK_DEPTH 16           // Values on the evaluation stack
+#define VM_REGISTERS 8              // Variables a program can store and load
+#define VM_FRAME_BUDGET 20000       // Instructions per frame across all pixels
+
+// Firmware updates over HTTP (/ota)
+#define OTA_SECTOR_SIZE 4096        // Flash erase unit; also the inflate window, so images are packed with a 4 KB window
+#define OTA_STALL_TIMEOUT 30000     // An upload that sends nothing for this long is dropped; the next one resumes (ms)
+#define OTA_RESTART_DELAY 1000      // Time for the final response to go out before rebooting into the new image (ms)
+#define OTA_CHECK_INTERVAL 50       // Ota task period: erases one sector per run for a prepared upload, checks stalls and the restart (ms)
+#define OTA_VERIFY_CHUNK 16384      // Image bytes the Ota task reads back and checks per run once an upload is complete
+#define OTA_TOKEN ""                // Shared secret POST /ota must send in X-OTA-Token; updates are refused while it is empty
+
+// Animation clock sync between nodes (UDP multicast)
+#define SYNC_MULTICAST_GROUP "239.255.76.67"
+#define SYNC_PORT 4767
+#define SYNC_BEACON_INTERVAL 1000   // Leader beacon period (ms)
+#define SYNC_LEADER_TIMEOUT 3500    // Silence after which another node takes over (ms)
+#define SYNC_STEP_THRESHOLD 50000   // Errors above this step the clock instead of slewing (us)
+#define SYNC_ERROR_WINDOW 32        // Beacons per max-error window
+#define SYNC_POLL_INTERVAL 2        // How often received beacons are read; adds up to this much delay noise (ms)
 
 // System Configuration
-#define WIFI_CHECK_INTERVAL 5000    // WiFi connection check interval (5 seconds)
+#define WIFI_CHECK_INTERVAL 250     // WiFi state machine interval; also services the portal's DNS (ms)
+#define WIFI_CONNECT_TIMEOUT 20000  // Time allowed for one connection attempt (ms)
+#define WIFI_BACKOFF_BASE 2000      // Wait after the first failed attempt, doubled per failure (ms)
+#define WIFI_BACKOFF_MAX 60000      // Longest wait between attempts (ms)
+#define WIFI_PORTAL_AFTER_FAILURES 5 // Failed attempts in a row before the configuration portal opens (0 = never)
+#define WIFI_RETRY_COOLDOWN 120000  // Wait between attempts while the portal is open, doubles up to 16x (ms)
 #define HEAP_CHECK_INTERVAL 30000   // Memory check interval (30 seconds)
 
+// Logging (override the level with build flag -D LOG_LEVEL=n; 0 none, 1 error, 2 warn, 3 info, 4 debug)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 3                 // Calls above this level are compiled out
+#endif
+#ifndef LOG_BENCHMARK
+#define LOG_BENCHMARK 0             // 1 = time LOG_INFO against String + Serial.println at boot
+#endif
+#define LOG_BUFFER_SIZE 2048        // Log ring buffer in RAM (power of two), also served on /logs
+#define LOG_LINE_MAX 128            // Longest formatted log line; longer messages are truncated
+#define LOG_DRAIN_INTERVAL 10       // How often buffered log text is moved to the UART (ms)
+
+// Metrics
+#define METRICS_MAX 80              // Registered metric series (/metrics); one per route, gauge, counter or histogram
+
+// System history (/system-history; 8 bytes per sample)
+#define HISTORY_FINE_INTERVAL 60000 // Fine sample period (1 minute)
+#define HISTORY_FINE_CAPACITY 120   // Fine samples kept (2 hours)
+#define HISTORY_COARSE_FACTOR 15    // Fine samples folded into each coarse sample (15 minutes)
+#define HISTORY_COARSE_CAPACITY 192 // Coarse samples kept (2 days)
+
+// Tracing (enable with build flag -D LEDCLOUD_TRACE=1; compiled out entirely otherwise)
+#ifndef LEDCLOUD_TRACE
+#define LEDCLOUD_TRACE 0
+#endif
+#define TRACE_CAPACITY 256          // Trace records kept in RAM (8 bytes each, power of two)
+#define TRACE_CYCLE_SHIFT 6         // Durations stored in units of 64 CPU cycles (0.8 us at 80 MHz, max ~13 s)
+
+// RTC user memory layout (4-byte blocks, survives soft resets)
+#define RTC_USER_MEMORY_SIZE 512    // Bytes of RTC user memory on the ESP8266
+#define RTC_EBOOT_BLOCKS 32         // Blocks 0..31 (the first 128 bytes) hold the bootloader command (eboot_command); OTA writes it, nothing else may
+#define RTC_LED_STATE_BLOCK 32      // NeoPixel warm state (49 blocks at 60 pixels, 32..80), above the eboot command
+#define RTC_WEATHER_CACHE_BLOCK 81  // Weather cache record (13 blocks, 81..93), above the LED state
+
 #endif // CONFIG_H
\ No newline at end of file
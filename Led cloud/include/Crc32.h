@@ -0,0 +1,44 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Standard CRC-32 (the gzip and zlib polynomial, reflected 0xEDB88320)
+ * computed a nibble at a time: 64 bytes of table instead of 1 KB. It gives
+ * the same values as the core's crc32(), but has no Arduino dependencies,
+ * so code that uses it also runs on the host.
+ */
+
+// Half-byte table for the reflected polynomial
+const uint32_t CRC32_NIBBLE_TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/**
+ * @brief Feed one byte into a CRC register (start at 0xFFFFFFFF, invert at the end)
+ */
+inline uint32_t crc32NibbleByte(uint32_t crc, uint8_t value)
+{
+    crc ^= value;
+    crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+    return (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+}
+
+/**
+ * @brief CRC-32 of data; pass the previous result as crc to continue over the next piece
+ */
+inline uint32_t crc32Nibble(const void* data, size_t length, uint32_t crc = 0)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = crc32NibbleByte(crc, bytes[i]);
+    }
+    return ~crc;
+}
+
+#endif // CRC32_H
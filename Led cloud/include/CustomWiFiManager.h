@@ -2,43 +2,102 @@
 #define CUSTOM_WIFI_MANAGER_H
 
 #include <Arduino.h>
+#include <functional>
 #include <ESP8266WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <ESPAsyncWiFiManager.h> // Use the async WiFi manager
-#include <Ticker.h>
 #include <DNSServer.h>
 #include <ESP8266mDNS.h>
+#include "CircuitBreaker.h"
+#include "Metrics.h"
+#include "RequestTracker.h"
 
 /**
  * @class CustomWiFiManager
  * @brief A wrapper class for the Async WiFiManager library that provides additional functionality
  * 
  * This class handles WiFi connection management, including automatic reconnection,
- * access point configuration, and mDNS setup for easy device discovery
+ * access point configuration, and mDNS setup for easy device discovery.
+ *
+ * Reconnecting never blocks: loop() runs a small state machine that starts an
+ * attempt, gives it WIFI_CONNECT_TIMEOUT, and waits out a jittered exponential
+ * backoff after each failure. After WIFI_PORTAL_AFTER_FAILURES consecutive
+ * failures the configuration portal opens in modeless mode, next to the
+ * station that keeps retrying, and it closes again once the station connects.
+ *
+ * The portal borrows the application's AsyncWebServer rather than running a
+ * second one on the same port. Its AsyncWiFiManager and DNSServer only exist
+ * while AP mode is up; closing the portal frees them and hands the server
+ * back through the portal-closed callback, which re-registers the routes.
+ * Both swaps reset the server, so each waits until no request is in flight.
  */
 class CustomWiFiManager {
+public:
+    enum LinkState : uint8_t {
+        LINK_CONNECTING = 0,   // Attempt in progress
+        LINK_CONNECTED = 1,
+        LINK_WAITING = 2       // Backing off before the next attempt
+    };
+
 private:
     String hostname;         // Device hostname for mDNS and AP mode
-    AsyncWebServer* server;  // Pointer to the AsyncWebServer instance
-    DNSServer dns;           // DNS server for captive portal
-    AsyncWiFiManager* wifiManager; // Pointer to the async WiFiManager instance
-    Ticker wifiTicker;       // Timer for periodic WiFi connection checks
+    AsyncWebServer* server;  // Shared application server, lent to the portal
+    DNSServer* dns;          // DNS server for captive portal, only while it is open
+    AsyncWiFiManager* wifiManager; // Portal, only while it is open
+    std::function<void()> portalClosedCallback;
     bool shouldRun;          // Flag to track if the WiFi task is running
+    
+    LinkState state;
+    CircuitBreaker backoff;  // Paces attempts; opening it is the cue for the portal
+    bool portalActive;
+    bool portalClosing;      // Connected, but the portal waits for in-flight requests before it closes
+    bool servicesStarted;    // mDNS is up for the current connection
+    unsigned long attemptStart; // millis() when the current attempt began
+    unsigned long downSince; // millis() when the link was lost, 0 before the first connection
+    
+    // Set from WiFi events (SYS context), handled in loop()
+    WiFiEventHandler gotIpHandler;
+    WiFiEventHandler disconnectedHandler;
+    volatile bool linkLost;
+    volatile uint8_t disconnectReason;
+    
+    Counter disconnects;     // Station links lost
+    Counter reconnects;      // Connections restored after the link was lost
+    Counter reconnectFailures; // Connection attempts that timed out
+    Counter portalStarts;
+    Gauge linkStateGauge;
+    Histogram downtimeSeconds; // Time from losing the link to getting an address again
+    
     void checkWiFiConnection();
+    void startAttempt(unsigned long now);
+    void onConnected(unsigned long now);
+    void startPortal();
+    void stopPortal();
+    void startServices();
+    void setState(LinkState newState);
 
 public:
-    CustomWiFiManager(const char* deviceName = "LEDcloud", AsyncWebServer* asyncServer = nullptr);
+    CustomWiFiManager(const char* deviceName, AsyncWebServer* sharedServer);
     ~CustomWiFiManager();
     void startTask();
     void stopTask();
-    bool begin();
+    void loop();             // Reconnect state machine, run by the Protocol scheduler
+    void begin();            // Start connecting with saved credentials without blocking
     void reset();
     bool isConnected();
     String getIP();
     String getHostname();
+    LinkState getState() const { return state; }
+    bool isPortalActive() const { return portalActive; }
+    
+    /**
+     * @brief Called after the portal released the shared server; re-register the application's routes here
+     */
+    void setPortalClosedCallback(std::function<void()> callback) { portalClosedCallback = callback; }
+    static const char* stateName(LinkState s);
     
     // New method for setting up client IP logging
     void setupClientIPLogging(AsyncWebServer* server);
 };
 
-#endif // CUSTOM_WIFI_MANAGER_H
\ No newline at end of file
+#endif // CUSTOM_WIFI_MANAGER_H
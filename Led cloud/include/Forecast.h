@@ -0,0 +1,101 @@
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "WeatherCondition.h"
+
+/**
+ * @struct ForecastSample
+ * @brief One packed 3-hour forecast slot (8 bytes)
+ */
+struct ForecastSample {
+    uint32_t epoch;            // Forecast time (UTC seconds)
+    int16_t temperatureCenti;  // Temperature in 1/100 °C
+    uint8_t humidity;          // Relative humidity in percent
+    uint8_t condition;         // WeatherCondition code
+};
+static_assert(sizeof(ForecastSample) == 8, "ForecastSample must stay packed into 8 bytes");
+
+/**
+ * @class ForecastBuffer
+ * @brief Fixed-size ring buffer of forecast samples ordered by time
+ *
+ * Samples are inserted in ascending time order. A sample for a slot that is
+ * already held replaces it (newer forecasts refine older ones); a later slot is
+ * appended and, once the buffer is full, overwrites the oldest sample. Nothing
+ * is allocated after construction.
+ */
+template <size_t Capacity>
+class ForecastBuffer {
+private:
+    ForecastSample samples[Capacity];
+    uint8_t head;    // Index of the oldest sample
+    uint8_t count;   // Number of valid samples
+
+    static_assert(Capacity > 0 && Capacity < 256, "Capacity must fit the uint8_t indices");
+
+    size_t physical(size_t logicalIndex) const { return (head + logicalIndex) % Capacity; }
+
+public:
+    ForecastBuffer() : head(0), count(0) {}
+
+    /**
+     * @brief Insert or refresh a sample
+     * @return false if the sample falls before or between held slots
+     */
+    bool upsert(const ForecastSample& sample) {
+        if (count > 0 && sample.epoch <= samples[physical(count - 1)].epoch) {
+            // Refresh a held slot; forecasts arrive in order, so search from the newest end
+            for (size_t i = count; i-- > 0;) {
+                ForecastSample& existing = samples[physical(i)];
+                if (existing.epoch == sample.epoch) {
+                    existing = sample;
+                    return true;
+                }
+                if (existing.epoch < sample.epoch) {
+                    break;
+                }
+            }
+            // Falls between held slots or before the oldest one
+            return false;
+        }
+
+        if (count < Capacity) {
+            samples[physical(count)] = sample;
+            count++;
+        } else {
+            samples[head] = sample;
+            head = (head + 1) % Capacity;
+        }
+        return true;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    /**
+     * @brief Sample by age order, 0 = oldest
+     */
+    const ForecastSample& at(size_t index) const { return samples[physical(index)]; }
+
+    /**
+     * @brief The first sample at or after the given time, or nullptr
+     */
+    const ForecastSample* findAtOrAfter(uint32_t epoch) const {
+        for (size_t i = 0; i < count; i++) {
+            const ForecastSample& sample = samples[physical(i)];
+            if (sample.epoch >= epoch) {
+                return &sample;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif // FORECAST_H
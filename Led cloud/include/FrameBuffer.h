@@ -0,0 +1,224 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "Config.h"
+
+/**
+ * @struct ColorOrder
+ * @brief Byte offsets of each channel within one pixel as the strip expects it on the wire
+ *
+ * W < 0 means an RGB strip. NEO_TYPE packs the offsets the way
+ * Adafruit_NeoPixel's neoPixelType does, so the strip object and the
+ * frame buffer are configured from the same type.
+ */
+template <uint8_t R, uint8_t G, uint8_t B, int8_t W = -1>
+struct ColorOrder {
+    static const uint8_t CHANNELS = W < 0 ? 3 : 4;
+    static const uint8_t RED = R;
+    static const uint8_t GREEN = G;
+    static const uint8_t BLUE = B;
+    static const uint8_t WHITE = W < 0 ? R : W;
+    static const uint8_t NEO_TYPE = (WHITE << 6) | (R << 4) | (G << 2) | B;
+};
+
+typedef ColorOrder<0, 1, 2> OrderRGB;
+typedef ColorOrder<1, 0, 2> OrderGRB;
+typedef ColorOrder<0, 1, 2, 3> OrderRGBW;
+typedef ColorOrder<1, 0, 2, 3> OrderGRBW;
+
+/**
+ * @class FrameBuffer
+ * @brief Pixel buffer of a fixed size, stored in the strip's wire order
+ *
+ * Pixel count, colour order and channel count are template parameters, so
+ * every channel offset is a constant and the kernels' loops have fixed trip
+ * counts the compiler can unroll. Colours enter and leave as packed
+ * 0xWWRRGGBB values (Adafruit_NeoPixel::Color()); the bytes in between are
+ * exactly what the strip sends, so output is a plain copy with brightness
+ * applied on the way (writeScaled()).
+ */
+template <size_t Count, typename Order>
+class FrameBuffer {
+public:
+    static const size_t PIXELS = Count;
+    static const size_t CHANNELS = Order::CHANNELS;
+    static const size_t BYTES = Count * Order::CHANNELS;
+    static const uint8_t ORDER_TYPE = Order::NEO_TYPE;  // For the Adafruit_NeoPixel constructor
+
+    FrameBuffer() { clear(); }
+
+    void clear() { memset(bytes, 0, BYTES); }
+
+    void set(size_t i, uint8_t r, uint8_t g, uint8_t b) {
+        uint8_t* p = &bytes[i * CHANNELS];
+        p[Order::RED] = r;
+        p[Order::GREEN] = g;
+        p[Order::BLUE] = b;
+        if (CHANNELS == 4) {
+            p[Order::WHITE] = 0;
+        }
+    }
+
+    void setColor(size_t i, uint32_t color) {
+        uint8_t* p = &bytes[i * CHANNELS];
+        p[Order::RED] = (uint8_t)(color >> 16);
+        p[Order::GREEN] = (uint8_t)(color >> 8);
+        p[Order::BLUE] = (uint8_t)color;
+        if (CHANNELS == 4) {
+            p[Order::WHITE] = (uint8_t)(color >> 24);
+        }
+    }
+
+    uint32_t get(size_t i) const {
+        const uint8_t* p = &bytes[i * CHANNELS];
+        uint32_t color = ((uint32_t)p[Order::RED] << 16) | ((uint32_t)p[Order::GREEN] << 8) | p[Order::BLUE];
+        if (CHANNELS == 4) {
+            color |= (uint32_t)p[Order::WHITE] << 24;
+        }
+        return color;
+    }
+
+    void fill(uint32_t color) {
+        for (size_t i = 0; i < Count; i++) {
+            setColor(i, color);
+        }
+    }
+
+    /**
+     * @brief Load Count RGB triples
+     */
+    void load(const uint8_t (*rgb)[3]) {
+        for (size_t i = 0; i < Count; i++) {
+            set(i, rgb[i][0], rgb[i][1], rgb[i][2]);
+        }
+    }
+
+    /**
+     * @brief Multiply every channel by numerator/256
+     */
+    void fade(uint16_t numerator) {
+        for (size_t k = 0; k < BYTES; k++) {
+            bytes[k] = (uint8_t)((bytes[k] * numerator) >> 8);
+        }
+    }
+
+    /**
+     * @brief Move every pixel one place toward the end; pixel 0 keeps its colour
+     */
+    void shiftUp() { memmove(&bytes[CHANNELS], &bytes[0], BYTES - CHANNELS); }
+
+    /**
+     * @brief Copy to the strip's output buffer, scaled by brightness (0-255)
+     */
+    void writeScaled(uint8_t* out, uint8_t brightness) const {
+        if (brightness == 255) {
+            memcpy(out, bytes, BYTES);
+            return;
+        }
+        // The output never overlaps the buffer; saying so lets the compiler unroll and vectorise
+        uint16_t scale = brightness + 1;
+        const uint8_t* __restrict in = bytes;
+        uint8_t* __restrict to = out;
+        for (size_t k = 0; k < BYTES; k++) {
+            to[k] = (uint8_t)((in[k] * scale) >> 8);
+        }
+    }
+
+    /**
+     * @brief Copy the frame weight/256 of the way from `from` to this one, scaled by brightness
+     *
+     * Output frames between two keyframes of a slow pattern. Blending and
+     * brightness share one pass over the bytes; weight 256 is this frame.
+     */
+    void writeBlended(uint8_t* out, const FrameBuffer& from, uint16_t weight, uint8_t brightness) const {
+        uint16_t scale = brightness + 1;
+        const uint8_t* __restrict a = from.bytes;
+        const uint8_t* __restrict b = bytes;
+        uint8_t* __restrict to = out;
+        for (size_t k = 0; k < BYTES; k++) {
+            uint8_t mixed = (uint8_t)(a[k] + (((b[k] - a[k]) * (int)weight) >> 8));
+            to[k] = (uint8_t)((mixed * scale) >> 8);
+        }
+    }
+
+    uint8_t* data() { return bytes; }
+    const uint8_t* data() const { return bytes; }
+
+private:
+    uint8_t bytes[BYTES];
+};
+
+/**
+ * @class GenericFrameBuffer
+ * @brief The same buffer with size and channel offsets chosen at run time
+ *
+ * The layout Adafruit_NeoPixel uses for any strip type. It is the baseline
+ * for the host benchmark (scripts/framebuffer_bench.cpp) that measures what
+ * compile-time specialisation buys.
+ */
+class GenericFrameBuffer {
+public:
+    GenericFrameBuffer(size_t count, uint8_t neoType)
+        : pixels(count), red((neoType >> 4) & 3), green((neoType >> 2) & 3), blue(neoType & 3),
+          white((neoType >> 6) & 3), channels(white == red ? 3 : 4), bytes(new uint8_t[count * channels]()) {}
+    ~GenericFrameBuffer() { delete[] bytes; }
+    GenericFrameBuffer(const GenericFrameBuffer&) = delete;
+    void operator=(const GenericFrameBuffer&) = delete;
+
+    void setColor(size_t i, uint32_t color) {
+        uint8_t* p = &bytes[i * channels];
+        p[red] = (uint8_t)(color >> 16);
+        p[green] = (uint8_t)(color >> 8);
+        p[blue] = (uint8_t)color;
+        if (channels == 4) {
+            p[white] = (uint8_t)(color >> 24);
+        }
+    }
+
+    uint32_t get(size_t i) const {
+        const uint8_t* p = &bytes[i * channels];
+        uint32_t color = ((uint32_t)p[red] << 16) | ((uint32_t)p[green] << 8) | p[blue];
+        if (channels == 4) {
+            color |= (uint32_t)p[white] << 24;
+        }
+        return color;
+    }
+
+    void fill(uint32_t color) {
+        for (size_t i = 0; i < pixels; i++) {
+            setColor(i, color);
+        }
+    }
+
+    void load(const uint8_t (*rgb)[3]) {
+        for (size_t i = 0; i < pixels; i++) {
+            setColor(i, ((uint32_t)rgb[i][0] << 16) | ((uint32_t)rgb[i][1] << 8) | rgb[i][2]);
+        }
+    }
+
+    void fade(uint16_t numerator) {
+        for (size_t k = 0; k < pixels * channels; k++) {
+            bytes[k] = (uint8_t)((bytes[k] * numerator) >> 8);
+        }
+    }
+
+    void writeScaled(uint8_t* out, uint8_t brightness) const {
+        uint16_t scale = brightness + 1;
+        for (size_t k = 0; k < pixels * channels; k++) {
+            out[k] = (uint8_t)((bytes[k] * scale) >> 8);
+        }
+    }
+
+    size_t size() const { return pixels; }
+
+private:
+    size_t pixels;
+    uint8_t red, green, blue, white;
+    uint8_t channels;
+    uint8_t* bytes;
+};
+
+#endif // FRAME_BUFFER_H
@@ -0,0 +1,179 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "Config.h"
+
+/**
+ * @class FrameCache
+ * @brief One cycle of a periodic pattern, delta-encoded, replayed instead of rendered
+ *
+ * A pattern whose frames repeat every `period` frames is rendered once per
+ * cycle frame. Each frame is stored as the runs of pixels that changed
+ * since the previous frame: a start pixel, a length and the one colour
+ * they all share. That is how chase (a few moving pixels), color wipe
+ * (one new pixel) and fade (the whole strip in one colour) change, so a
+ * frame costs a few bytes and replaying it touches only those pixels.
+ *
+ * Frames are stored in the order they are first shown, from wherever in
+ * the cycle the pattern started (the origin). The first one is encoded
+ * against black, so any cached frame can be rebuilt from a cleared buffer
+ * by replaying the ones before it. The space is bounded (Bytes, Frames).
+ * When a cycle does not fit, the frames stored so far are still replayed
+ * and the rest are rendered every time.
+ *
+ * Header-only because it is specialised on the frame buffer type; no
+ * Arduino dependencies, so scripts/frame_cache_bench.cpp runs it on the host.
+ */
+template <typename Buffer, size_t Bytes, size_t Frames>
+class FrameCache {
+public:
+    static const size_t RUN_BYTES = 3 + Buffer::CHANNELS;  // Start pixel (2), length, colour
+
+    FrameCache() { reset(); }
+
+    /**
+     * @brief Drop every stored frame; the pattern or its parameters changed
+     */
+    void reset() {
+        period = 0;
+        origin = 0;
+        count = 0;
+        full = false;
+        position = -1;
+        offsets[0] = 0;
+    }
+
+    /**
+     * @brief Forget which frame the pixels show; something else drew on them
+     */
+    void lose() { position = -1; }
+
+    /**
+     * @brief Bring pixels to frame `index` of a cycle of `period` frames
+     *
+     * Cached frames are replayed from the ones pixels already show. Frames
+     * not cached yet are rendered with render(frame) and stored, at most
+     * FRAME_CACHE_FILL_AHEAD of them per call. Further ahead than that, or
+     * once the cache is full, the frame is only rendered.
+     *
+     * @param scratch Holds the previous frame while a new one is encoded
+     * @return true if the frame was replayed without rendering anything
+     */
+    template <typename Render>
+    bool seek(uint32_t index, uint32_t cyclePeriod, Buffer& pixels, Buffer& scratch, Render render) {
+        if (cyclePeriod != period) {
+            reset();
+            period = cyclePeriod;
+        }
+        if (count == 0) {
+            origin = index % period;
+        }
+        uint32_t target = (index % period + period - origin) % period;
+        if (target < count) {
+            replay(target, pixels);
+            return true;
+        }
+
+        if (!full && target - count < FRAME_CACHE_FILL_AHEAD) {
+            if (count > 0) {
+                replay(count - 1, pixels);
+            } else {
+                pixels.clear();
+                position = -1;
+            }
+            while (!full && count <= target) {
+                scratch = pixels;
+                render(origin + count);
+                if (append(scratch, pixels)) {
+                    position = count - 1;
+                } else {
+                    full = true;
+                    position = -1;
+                }
+            }
+            if (position == (int32_t)target) {
+                return false;
+            }
+        }
+
+        render(index);
+        position = -1;
+        return false;
+    }
+
+    uint32_t getPeriod() const { return period; }
+    size_t getFrames() const { return count; }      // Cycle frames stored
+    size_t getBytes() const { return offsets[count]; }  // Encoded size of those frames
+    bool isComplete() const { return period > 0 && count == period; }
+    bool isFull() const { return full; }            // The cycle did not fit
+
+private:
+    uint32_t period;
+    uint32_t origin;     // Cycle frame stored first
+    uint32_t count;
+    bool full;
+    int32_t position;    // Stored frame the pixels show, -1 if unknown
+    uint16_t offsets[Frames + 1];  // Frame i is pool[offsets[i]] up to pool[offsets[i + 1]]
+    uint8_t pool[Bytes];
+
+    // Cycles longer than Frames are only partly cached, so the offsets never pass Bytes
+    static_assert(Bytes <= UINT16_MAX, "FrameCache offsets are 16-bit");
+
+    bool append(const Buffer& previous, const Buffer& frame) {
+        if (count >= Frames) {
+            return false;
+        }
+        const uint8_t* before = previous.data();
+        const uint8_t* after = frame.data();
+        size_t at = offsets[count];
+        for (size_t i = 0; i < Buffer::PIXELS;) {
+            const uint8_t* color = &after[i * Buffer::CHANNELS];
+            if (memcmp(&before[i * Buffer::CHANNELS], color, Buffer::CHANNELS) == 0) {
+                i++;
+                continue;
+            }
+            // Extend over the following pixels that also changed, to the same colour
+            size_t run = 1;
+            while (i + run < Buffer::PIXELS && run < 255 &&
+                   memcmp(&before[(i + run) * Buffer::CHANNELS], &after[(i + run) * Buffer::CHANNELS],
+                          Buffer::CHANNELS) != 0 &&
+                   memcmp(&after[(i + run) * Buffer::CHANNELS], color, Buffer::CHANNELS) == 0) {
+                run++;
+            }
+            if (at + RUN_BYTES > Bytes) {
+                return false;
+            }
+            pool[at] = (uint8_t)i;
+            pool[at + 1] = (uint8_t)(i >> 8);
+            pool[at + 2] = (uint8_t)run;
+            memcpy(&pool[at + 3], color, Buffer::CHANNELS);
+            at += RUN_BYTES;
+            i += run;
+        }
+        offsets[++count] = (uint16_t)at;
+        return true;
+    }
+
+    // Replay forward from the frame shown, or from black if target is behind it
+    void replay(uint32_t target, Buffer& pixels) {
+        if (position < 0 || (uint32_t)position > target) {
+            pixels.clear();
+            position = -1;
+        }
+        uint8_t* bytes = pixels.data();
+        for (uint32_t frame = position + 1; frame <= target; frame++) {
+            for (size_t at = offsets[frame]; at < offsets[frame + 1]; at += RUN_BYTES) {
+                size_t start = pool[at] | (pool[at + 1] << 8);
+                for (size_t k = 0; k < pool[at + 2]; k++) {
+                    memcpy(&bytes[(start + k) * Buffer::CHANNELS], &pool[at + 3], Buffer::CHANNELS);
+                }
+            }
+        }
+        position = target;
+    }
+};
+
+#endif // FRAME_CACHE_H
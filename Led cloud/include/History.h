@@ -0,0 +1,138 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+#include "ChunkedExporter.h"
+
+/**
+ * @struct HistorySample
+ * @brief One interval of system health (8 bytes)
+ */
+struct HistorySample {
+    uint16_t freeHeap;       // Lowest free heap in the interval (bytes)
+    uint16_t maxBlock;       // Smallest largest-free-block in the interval (bytes)
+    uint8_t fragmentation;   // Highest heap fragmentation in the interval (%)
+    int8_t rssi;             // WiFi signal (dBm), 0 while disconnected
+    uint16_t frameTimeUs;    // Mean NeoPixel frame time (us, saturates at 65535)
+};
+
+static_assert(sizeof(HistorySample) == 8, "HistorySample must stay packed into 8 bytes");
+
+/**
+ * @class HistoryRing
+ * @brief Fixed-capacity ring of samples; the oldest is overwritten when full
+ */
+template <size_t Capacity>
+class HistoryRing {
+public:
+    HistoryRing() : head(0), count(0) {}
+
+    void push(const HistorySample& sample) {
+        samples[head] = sample;
+        head = (head + 1) % Capacity;
+        if (count < Capacity) {
+            count++;
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return Capacity; }
+    size_t oldestSlot() const { return (head + Capacity - count) % Capacity; }
+
+    /**
+     * @brief Sample by age order; index 0 is the oldest
+     */
+    const HistorySample& at(size_t index) const {
+        return samples[(oldestSlot() + index) % Capacity];
+    }
+
+    /**
+     * @brief Sample by storage slot, for readers that hold on to a position across pushes
+     */
+    const HistorySample& slot(size_t index) const { return samples[index % Capacity]; }
+
+private:
+    HistorySample samples[Capacity];
+    size_t head;   // Next slot to write
+    size_t count;
+};
+
+/**
+ * @class SystemHistory
+ * @brief Two-level downsampled history of system health
+ *
+ * Fine samples are recorded directly. Every HISTORY_COARSE_FACTOR fine
+ * samples are folded into one coarse sample that keeps the worst case of
+ * each value (lowest heap and max block, highest fragmentation) and the mean
+ * RSSI and frame time.
+ */
+class SystemHistory {
+public:
+    typedef HistoryRing<HISTORY_FINE_CAPACITY> FineRing;
+    typedef HistoryRing<HISTORY_COARSE_CAPACITY> CoarseRing;
+
+    SystemHistory();
+
+    /**
+     * @brief Record one fine sample
+     * @param sample Values for the interval that just ended
+     * @param nowMs Current time, used to report the age of the newest sample
+     */
+    void record(const HistorySample& sample, uint32_t nowMs);
+
+    const FineRing& getFine() const { return fine; }
+    const CoarseRing& getCoarse() const { return coarse; }
+    uint32_t getLastRecordMs() const { return lastRecordMs; }
+
+    static uint16_t saturate16(uint32_t value) { return value > 0xFFFF ? 0xFFFF : (uint16_t)value; }
+
+private:
+    FineRing fine;
+    CoarseRing coarse;
+    uint32_t lastRecordMs;
+
+    // Coarse sample being accumulated
+    uint8_t pending;
+    uint16_t pendingHeapMin;
+    uint16_t pendingBlockMin;
+    uint8_t pendingFragMax;
+    int16_t pendingRssiSum;
+    uint8_t pendingRssiCount;  // Connected samples only
+    uint32_t pendingFrameSum;
+};
+
+/**
+ * @class HistoryExporter
+ * @brief Streams both history levels as column-oriented JSON
+ *
+ * Output is {"newestAgeS":N,"fine":{...},"coarse":{...}} where each level has
+ * intervalS, capacity and one array per field, oldest first.
+ *
+ * The slots to export are fixed when the exporter is created. A record()
+ * between chunks moves the rings on, but every column still covers the same
+ * slots, so the five arrays keep the same length and order. A full ring
+ * reuses its oldest slot, so that one sample may mix old and new values.
+ */
+class HistoryExporter : public ChunkedExporter {
+public:
+    HistoryExporter(const SystemHistory& source, uint32_t nowMs);
+
+private:
+    const SystemHistory& history;
+    uint32_t nowMs;
+    size_t levelStart[2];  // Oldest slot of each level when the export began
+    size_t levelCount[2];  // Samples in each level then
+    uint8_t level;     // 0 = fine, 1 = coarse, 2 = closing brace, 3 = done
+    uint8_t column;    // Field being written; COLUMN_COUNT = level header
+    size_t index;      // Next sample in the current column
+
+    static const uint8_t COLUMN_COUNT = 5;
+
+    bool formatNext() override;
+    size_t levelSize() const;
+    const HistorySample& levelSample(size_t i) const;
+};
+
+#endif // HISTORY_H
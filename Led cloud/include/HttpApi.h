@@ -0,0 +1,121 @@
+#ifndef HTTP_API_H
+#define HTTP_API_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+#include "Config.h"
+
+/**
+ * @class ApiRequest
+ * @brief What a route handler reads from an HTTP request
+ *
+ * WebServer adapts AsyncWebServerRequest to this; on the host any request
+ * object will do, so the handlers can be driven without a network stack.
+ */
+class ApiRequest {
+public:
+    virtual ~ApiRequest() {}
+    virtual const char* getParam(const char* name) const = 0;   // Query parameter, or nullptr
+    virtual const char* getHeader(const char* name) const = 0;  // Request header, or nullptr
+    virtual const char* getContentType() const = 0;
+    virtual const uint8_t* getBody() const = 0;
+    virtual size_t getBodyLength() const = 0;
+};
+
+/**
+ * @class ApiResponse
+ * @brief Where a route handler writes its reply: begin(), the body, end()
+ *
+ * Headers may be added any time before end(). The body is written through
+ * write(), so ArduinoJson can serialize straight into the response.
+ */
+class ApiResponse {
+public:
+    virtual ~ApiResponse() {}
+    virtual void begin(int code, const char* contentType) = 0;
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    virtual void addHeader(const char* name, const char* value) = 0;
+    virtual void end() = 0;
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+};
+
+/**
+ * @brief Device readings for /system-info
+ */
+struct SystemInfo {
+    uint32_t freeHeap;
+    uint8_t heapFragmentation;  // Percent
+    int wifiSignal;             // RSSI in dBm
+    bool ledState;
+    int brightness;
+    uint32_t uptime;            // Seconds
+};
+
+/**
+ * @class ApiDevice
+ * @brief The device state the dashboard routes read and change
+ */
+class ApiDevice {
+public:
+    virtual ~ApiDevice() {}
+    virtual SystemInfo getSystemInfo() = 0;
+    virtual bool getWeather(JsonDocument& doc) = 0;     // false if there is no weather service
+    virtual int getPixelBrightness() = 0;
+    virtual int getPattern() = 0;
+    virtual uint32_t getPixelColor(int index) = 0;
+    virtual void setAllPixels(int r, int g, int b) = 0;
+    virtual void setPixel(int index, int r, int g, int b) = 0;
+    virtual void setPattern(int pattern) = 0;
+    virtual void setPixelBrightness(int brightness) = 0;
+};
+
+/**
+ * @class DashboardApi
+ * @brief Handlers for the routes the dashboard and group controllers poll and post to
+ *
+ * They only see ApiRequest, ApiResponse and ApiDevice, so scripts/http_loadgen.cpp
+ * runs exactly this code on the host. Counting and tracing stay with the
+ * route bindings in WebServer.
+ */
+class DashboardApi {
+public:
+    explicit DashboardApi(ApiDevice& device) : device(device) {}
+
+    void systemInfo(ApiRequest& request, ApiResponse& response);          // GET /system-info
+    void weather(ApiRequest& request, ApiResponse& response);             // GET /weather
+    void pixelStatus(ApiRequest& request, ApiResponse& response);         // GET /neopixel/status
+    void setAllPixels(ApiRequest& request, ApiResponse& response);        // POST /neopixel/setAll
+    void setPixel(ApiRequest& request, ApiResponse& response);            // POST /neopixel/setPixel
+    void setPattern(ApiRequest& request, ApiResponse& response);          // POST /neopixel/setPattern
+    void setPixelBrightness(ApiRequest& request, ApiResponse& response);  // POST /neopixel/setBrightness
+
+private:
+    ApiDevice& device;
+};
+
+/**
+ * @brief Send doc as JSON, or as MessagePack if the request accepts it
+ *
+ * X-Serialize-Us reports how long serializing took, so both formats can be
+ * compared per route.
+ */
+void sendDocument(ApiRequest& request, ApiResponse& response, int code, const JsonDocument& doc);
+
+/**
+ * @brief Send a fixed JSON reply (status or error), converted if the request wants MessagePack
+ */
+void sendReply(ApiRequest& request, ApiResponse& response, int code, const char* json);
+
+/**
+ * @brief Parse the body as JSON, or as MessagePack with Content-Type: application/msgpack
+ */
+DeserializationError parseBody(ApiRequest& request, JsonDocument& doc);
+
+/**
+ * @brief Microsecond clock for X-Serialize-Us (micros() on the device)
+ */
+uint32_t apiClockUs();
+
+#endif // HTTP_API_H
@@ -0,0 +1,163 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stdlib.h>
+
+/**
+ * @class BoundedAllocator
+ * @brief ArduinoJson allocator that refuses to grow past a fixed byte limit
+ *
+ * Every block carries a small size header so outstanding and peak usage can be
+ * tracked. Once the limit is reached allocations fail and deserialization
+ * stops with DeserializationError::NoMemory instead of exhausting the heap.
+ */
+class BoundedAllocator : public ArduinoJson::Allocator {
+private:
+    size_t limit;      // Maximum bytes that may be outstanding at once
+    size_t current;    // Bytes currently allocated (payload only)
+    size_t peak;       // Highest value of current since the last reset
+
+    static size_t* header(void* ptr) { return static_cast<size_t*>(ptr) - 1; }
+
+public:
+    explicit BoundedAllocator(size_t limitBytes) : limit(limitBytes), current(0), peak(0) {}
+
+    void* allocate(size_t size) override {
+        if (current + size > limit) {
+            return nullptr;
+        }
+        size_t* block = static_cast<size_t*>(malloc(size + sizeof(size_t)));
+        if (!block) {
+            return nullptr;
+        }
+        *block = size;
+        current += size;
+        if (current > peak) {
+            peak = current;
+        }
+        return block + 1;
+    }
+
+    void deallocate(void* ptr) override {
+        if (!ptr) {
+            return;
+        }
+        size_t* block = header(ptr);
+        current -= *block;
+        free(block);
+    }
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        if (!ptr) {
+            return allocate(newSize);
+        }
+        size_t* block = header(ptr);
+        size_t oldSize = *block;
+        if (newSize > oldSize && current + (newSize - oldSize) > limit) {
+            return nullptr;
+        }
+        size_t* resized = static_cast<size_t*>(realloc(block, newSize + sizeof(size_t)));
+        if (!resized) {
+            return nullptr;
+        }
+        *resized = newSize;
+        current = current - oldSize + newSize;
+        if (current > peak) {
+            peak = current;
+        }
+        return resized + 1;
+    }
+
+    size_t getPeak() const { return peak; }
+    size_t getLimit() const { return limit; }
+    void resetPeak() { peak = current; }
+};
+
+/**
+ * @class BufferedStreamReader
+ * @brief Small fixed-size read buffer in front of an Arduino Stream
+ *
+ * ArduinoJson pulls input one character at a time; this reader refills a
+ * stack-sized buffer from whatever the stream has available so the network
+ * client is not called per byte. It never holds more than N bytes of payload.
+ */
+template <size_t N = 64>
+class BufferedStreamReader {
+private:
+    Stream& stream;
+    char buffer[N];
+    size_t length;
+    size_t position;
+    size_t total;      // Bytes consumed from the stream so far
+
+    bool refill() {
+        int available = stream.available();
+        size_t wanted = available > 0 ? min((size_t)available, N) : 1;
+        // readBytes() blocks up to the stream timeout when nothing is available yet
+        length = stream.readBytes(buffer, wanted);
+        position = 0;
+        total += length;
+        return length > 0;
+    }
+
+public:
+    explicit BufferedStreamReader(Stream& source) : stream(source), length(0), position(0), total(0) {}
+
+    int read() {
+        if (position >= length && !refill()) {
+            return -1;
+        }
+        return static_cast<unsigned char>(buffer[position++]);
+    }
+
+    size_t readBytes(char* dest, size_t count) {
+        size_t copied = 0;
+        while (copied < count) {
+            if (position >= length && !refill()) {
+                break;
+            }
+            size_t chunk = min(count - copied, length - position);
+            memcpy(dest + copied, buffer + position, chunk);
+            position += chunk;
+            copied += chunk;
+        }
+        return copied;
+    }
+
+    /**
+     * @brief Skip input up to and including the given marker
+     * @return true if the marker was found before the stream ended
+     */
+    bool find(const char* marker) {
+        size_t matched = 0;
+        size_t markerLength = strlen(marker);
+        int c;
+        while ((c = read()) >= 0) {
+            if (c == marker[matched]) {
+                if (++matched == markerLength) {
+                    return true;
+                }
+            } else {
+                matched = (c == marker[0]) ? 1 : 0;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Read the next non-whitespace character, or -1 at end of stream
+     */
+    int readNonSpace() {
+        int c;
+        do {
+            c = read();
+        } while (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+        return c;
+    }
+
+    size_t getBytesRead() const { return total; }
+};
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,96 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+// Log levels; LOG_LEVEL in Config.h selects the most verbose level compiled in
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/**
+ * @class Log
+ * @brief Leveled printf-style logging into a fixed RAM ring buffer
+ *
+ * Each call formats one line on the stack and copies it into the ring; nothing
+ * is allocated and nothing waits on the UART. drain() moves buffered text to
+ * Serial only as far as the UART FIFO has room and is run as a scheduler task.
+ * If Serial falls a full ring behind, the oldest unsent bytes are dropped and
+ * counted. The ring also keeps the most recent output for the /logs endpoint.
+ *
+ * Format strings are kept in flash (PSTR) by the LOG_* macros. Calls below
+ * LOG_LEVEL compile to nothing, arguments included. Not for use from ISRs.
+ */
+class Log {
+public:
+    static void write(uint8_t level, PGM_P format, ...);
+
+    /**
+     * @brief Send buffered text to Serial without blocking
+     */
+    static void drain();
+
+    /**
+     * @brief Send all buffered text to Serial, blocking until done
+     */
+    static void flush();
+
+    /**
+     * @brief Copy the most recent complete lines, oldest first
+     * @return Number of bytes copied
+     */
+    static size_t copyRecent(char* out, size_t maxLen);
+
+    static size_t getBufferedLength();
+    static uint32_t getLineCount() { return lines; }
+    static uint32_t getDroppedBytes() { return droppedBytes; }
+    static uint32_t getAverageCycles() { return lines ? (uint32_t)(totalCycles / lines) : 0; }
+
+#if LOG_BENCHMARK
+    /**
+     * @brief Times the old String + Serial.println pattern against LOG_INFO and prints the result
+     */
+    static void runBenchmark();
+#endif
+
+private:
+    static char buffer[LOG_BUFFER_SIZE];
+    static uint32_t head;          // Bytes written since boot; the ring index is head % size
+    static uint32_t serialTail;    // Bytes handed to Serial so far
+    static uint32_t lines;
+    static uint32_t droppedBytes;  // Bytes overwritten before Serial could send them
+    static uint64_t totalCycles;   // CPU cycles spent in write(), for the per-call average
+
+    static void append(const char* text, size_t length);
+
+    static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of two");
+};
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) Log::write(LOG_LEVEL_ERROR, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...) Log::write(LOG_LEVEL_WARN, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) Log::write(LOG_LEVEL_INFO, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) Log::write(LOG_LEVEL_DEBUG, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) do { } while (0)
+#endif
+
+#endif // LOG_H
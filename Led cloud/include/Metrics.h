@@ -0,0 +1,151 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+#include "ChunkedExporter.h"
+
+/**
+ * @class Counter
+ * @brief Monotonic event count
+ */
+class Counter {
+public:
+    Counter() : value(0) {}
+    void inc(uint32_t amount = 1) { value += amount; }
+    uint32_t get() const { return value; }
+
+private:
+    uint32_t value;
+};
+
+/**
+ * @class Gauge
+ * @brief Point-in-time value; setMin()/setMax() keep a low or high water mark
+ */
+class Gauge {
+public:
+    explicit Gauge(int32_t initial = 0) : value(initial) {}
+    void set(int32_t v) { value = v; }
+    void setMin(int32_t v) { if (v < value) value = v; }
+    void setMax(int32_t v) { if (v > value) value = v; }
+    int32_t get() const { return value; }
+
+private:
+    int32_t value;
+};
+
+/**
+ * @class Histogram
+ * @brief Distribution over a small set of fixed upper bounds
+ *
+ * observe() is a short linear scan over at most MAX_BUCKETS bounds. Counts
+ * are per bucket; the exporter makes them cumulative as Prometheus expects.
+ */
+class Histogram {
+public:
+    static const uint8_t MAX_BUCKETS = 8;
+
+    /**
+     * @param upperBounds Ascending bucket upper bounds (inclusive); must outlive the histogram
+     * @param count Number of bounds, at most MAX_BUCKETS
+     */
+    Histogram(const uint32_t* upperBounds, uint8_t count)
+        : bounds(upperBounds), bucketCount(count > MAX_BUCKETS ? MAX_BUCKETS : count), sum(0), total(0) {
+        for (uint8_t i = 0; i <= MAX_BUCKETS; i++) {
+            counts[i] = 0;
+        }
+    }
+
+    void observe(uint32_t v) {
+        uint8_t i = 0;
+        while (i < bucketCount && v > bounds[i]) {
+            i++;
+        }
+        counts[i]++;  // counts[bucketCount] is the +Inf bucket
+        sum += v;
+        total++;
+    }
+
+    uint8_t getBucketCount() const { return bucketCount; }
+    uint32_t getBound(uint8_t i) const { return bounds[i]; }
+    uint32_t getBucket(uint8_t i) const { return counts[i]; }
+    uint64_t getSum() const { return sum; }
+    uint32_t getCount() const { return total; }
+
+private:
+    const uint32_t* bounds;
+    uint8_t bucketCount;
+    uint32_t counts[MAX_BUCKETS + 1];
+    uint64_t sum;
+    uint32_t total;
+};
+
+/**
+ * @class Metrics
+ * @brief Fixed-size registry of counters, gauges and histograms
+ *
+ * Metric objects live with the component that updates them, so hot paths
+ * touch only their own fields; the registry just remembers where they are.
+ * Entries sharing a name (one per label value) are kept next to each other
+ * whatever order they are added in, so they are exported as one group under
+ * a single HELP/TYPE header. Register everything before the first export.
+ * Names, help texts and label strings must be string literals or otherwise
+ * outlive the registry.
+ */
+class Metrics {
+public:
+    enum Type : uint8_t {
+        TYPE_COUNTER,
+        TYPE_GAUGE,
+        TYPE_HISTOGRAM
+    };
+
+    struct Entry {
+        const char* name;
+        const char* help;
+        const char* labelName;   // Optional single label, e.g. "route"
+        const char* labelValue;
+        Type type;
+        const void* metric;
+    };
+
+    static bool add(const char* name, const char* help, const Counter& counter,
+                    const char* labelName = nullptr, const char* labelValue = nullptr);
+    static bool add(const char* name, const char* help, const Gauge& gauge,
+                    const char* labelName = nullptr, const char* labelValue = nullptr);
+    static bool add(const char* name, const char* help, const Histogram& histogram,
+                    const char* labelName = nullptr, const char* labelValue = nullptr);
+
+    static size_t getCount() { return count; }
+    static const Entry& get(size_t index) { return entries[index]; }
+
+private:
+    static Entry entries[METRICS_MAX];
+    static size_t count;
+
+    static bool addEntry(const char* name, const char* help, Type type, const void* metric,
+                         const char* labelName, const char* labelValue);
+};
+
+/**
+ * @class MetricsExporter
+ * @brief Streams the registry in the Prometheus text exposition format
+ *
+ * One line (or HELP/TYPE header pair) per piece. Values are read as they
+ * are formatted.
+ */
+class MetricsExporter : public ChunkedExporter {
+public:
+    MetricsExporter();
+
+private:
+    size_t entryIndex;
+    uint8_t line;           // Line within the current entry; 0 is the HELP/TYPE header
+
+    bool formatNext() override;
+    size_t formatSample(const Metrics::Entry& entry, const char* suffix, const char* le, const char* value);
+};
+
+#endif // METRICS_H
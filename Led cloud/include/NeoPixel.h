@@ -1,6 +1,25 @@
 #pragma once
 #include <Adafruit_NeoPixel.h>
 #include <Arduino.h>
+#include "Config.h"
+#include "WeatherCondition.h"
+#include "WarmState.h"
+#include "PixelVM.h"
+#include "Metrics.h"
+#include "FrameBuffer.h"
+#include "QualityGovernor.h"
+#include "FrameCache.h"
+
+// Strip pixels in the strip's own byte order (see FrameBuffer.h)
+typedef FrameBuffer<NEOPIXEL_COUNT, NEOPIXEL_ORDER> PixelBuffer;
+
+// Adafruit_NeoPixel without a pixel buffer of its own: send() clocks out bytes the caller owns
+class StripOutput : public Adafruit_NeoPixel {
+public:
+    StripOutput(uint16_t count, int16_t pin, neoPixelType type);
+    ~StripOutput() { pixels = nullptr; }  // Never ours to free
+    void send(uint8_t* bytes);            // count pixels, already in wire order
+};
 
 // Define your pattern types here
 enum PatternType {
@@ -12,7 +31,9 @@ enum PatternType {
     PATTERN_TWINKLE = 5,  // New animation: random twinkling
     PATTERN_FIRE = 6,     // Fire effect simulation
     PATTERN_RAIN = 7,     // Blue rain effect
-    PATTERN_COLOR_WIPE = 8 // Color wipe animation
+    PATTERN_COLOR_WIPE = 8, // Color wipe animation
+    PATTERN_WEATHER = 9,  // Scene follows the current weather condition
+    PATTERN_PROGRAM = 10  // Uploaded PixelVM program
 };
 
 class NeoPixel {
@@ -23,20 +44,73 @@ public:
     void updatePixelColor(int idx, int r, int g, int b);
     void setBrightness(int b);
     void setPattern(PatternType pattern);
+    void setPixels(const uint8_t (*rgb)[3], int count);  // Load saved colors and show them once
+    void setScene(PatternType pattern, int b, const uint8_t (*rgb)[3]);  // Pattern, brightness and all colors in one show
+    void setWeatherCondition(uint8_t condition);
+    const char* setProgram(const uint8_t* data, size_t length);  // Verify, run and keep a PixelVM program; nullptr or the error
+    const PixelVM& getProgram() const { return vm; }
+    uint32_t getProgramCrc();  // crc32 of the program the Program pattern runs, 0 if there is none
+    uint32_t getProgramPixelsPerSecond() const { return programPixelsPerSecond.get(); }
+    uint32_t getProgramBudgetExhausted() const { return programBudgetExhausted.get(); }
     void show();
     void update();    // Method to update animations
+    void reportFrame(uint32_t costUs, bool late);  // Feed one output frame's cost to the quality governor
+    const QualityGovernor& getQuality() const { return quality; }
     bool isAnimationActive(); // Method to check if an animation is currently running
     uint32_t rgbToColor(int r, int g, int b);
-    String getStatusJson();
+    PatternType getPattern() const { return currentPattern; }
+    int getBrightness() const { return brightness; }
+    uint32_t getPixelColor(int idx) const { return pixels.get(idx); }
+    bool isWarmStart() const { return warmStart; }  // Scene was resumed from RTC memory
 
 private:
     NeoPixel();
     static NeoPixel* instance;
-    Adafruit_NeoPixel strip;
+    StripOutput strip;
     int brightness;
     PatternType currentPattern;
-    uint32_t pixelColors[60]; // Updated to support 60 LEDs
-    unsigned long lastUpdate;  // Timestamp of last animation update
+    PixelBuffer pixels;        // The only copy of the colors: full brightness, wire order
+    unsigned long lastUpdate;  // Time the current keyframe was due
+    uint32_t frame;            // Animation frame from the shared clock, at the pattern's own keyframe rate
+    unsigned long lastTwinkle; // Timestamp of the last new twinkle
+    
+    // Keyframe interpolation: slow patterns render at their own rate and output blends the last two frames
+    PixelBuffer keyframe;      // Previous keyframe; pixels holds the next one
+    uint16_t blend;            // Output position from keyframe to pixels, /256 (BLEND_NONE shows pixels as is)
+    Counter keyframesRendered;
+    Counter framesBlended;
+    
+    // Render quality, stepped down when frames overrun their budget
+    QualityGovernor quality;
+    unsigned long lastOutput;  // Last output tick that did any work
+    Gauge qualityLevel;
+    Counter qualityStepsDown;
+    Counter qualityStepsUp;
+    
+    // Periodic patterns (chase, fade, color wipe) render one cycle into the cache and replay it.
+    // The cache is only on the heap while one of them runs.
+    typedef FrameCache<PixelBuffer, FRAME_CACHE_BYTES, FRAME_CACHE_FRAMES> PatternFrameCache;
+    PatternFrameCache* frameCache;
+    Counter frameCacheHits;
+    Counter frameCacheMisses;
+    Gauge frameCacheBytes;
+    
+    // Warm state (survives soft resets in RTC memory)
+    WarmStateStore warmState;
+    bool warmStart;
+    unsigned long lastCheckpoint;
+    
+    // Weather-reactive pattern state
+    uint8_t weatherCondition;    // Latest condition pushed by the weather service
+    uint8_t renderedCondition;   // Condition the base scene was rendered for
+    PixelBuffer weatherBase;     // Base scene, only re-rendered when the condition changes
+    
+    // User pixel program
+    PixelVM vm;
+    bool programFileChecked;     // The saved program is loaded on first use, after LittleFS is up
+    uint32_t programCrc;         // crc32 of the loaded program's bytes, 0 if none
+    Gauge programPixelsPerSecond;
+    Counter programBudgetExhausted;
     
     // Animation update methods
     void updateChasePattern();
@@ -45,4 +119,12 @@ private:
     void updateFirePattern();
     void updateRainPattern();
     void updateColorWipePattern();
+    void updateWeatherPattern();
+    void updateProgramPattern();
+    void loadProgramFile();
+    void updatePeriodicPattern(uint16_t periodFrames);
+    void releaseFrameCache();
+    void renderWeatherBase();
+    bool restoreWarmState();
+    void saveWarmState();
 };
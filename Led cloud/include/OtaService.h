@@ -0,0 +1,152 @@
+#ifndef OTA_SERVICE_H
+#define OTA_SERVICE_H
+
+#include <Arduino.h>
+#include "OtaUpdate.h"
+#include "Metrics.h"
+
+struct eboot_command;
+
+/**
+ * @class OtaService
+ * @brief Firmware updates over HTTP that survive dropped connections and reboots
+ *
+ * An update takes two requests, both carrying OTA_TOKEN. POST /ota/prepare
+ * names the image; loop() then erases the flash it will go to, a sector per
+ * run, and GET /ota reports "ready" when that is done. POST /ota streams the
+ * image packed by scripts/ota_pack.py through OtaImageWriter into the free
+ * flash between the sketch and the filesystem. Every commit point is saved
+ * to /ota.state along with the image's size and the packed file's CRC, so
+ * a later upload of the same file starts from there; any other file starts
+ * from the beginning.
+ *
+ * Once the whole image is on flash, loop() reads it back a slice per run
+ * and checks it against its CRC and the header checks of the core's
+ * Updater. Only then is the bootloader told to copy it over the sketch,
+ * and loop() restarts the device after flushing pending settings and the
+ * log. The command lives in RTC memory, so nothing else writes there from
+ * then on (the LED warm state and weather cache stop saving), and it is
+ * read back before the restart. Erasing and reading back the whole area
+ * take seconds, so both stay in loop() and out of the web server's
+ * callbacks, which only program sectors that are already erased.
+ *
+ * The writer and its 4 KB window are only allocated while an upload runs.
+ */
+class OtaService {
+public:
+    static OtaService* getInstance();
+
+    /**
+     * @brief Whether token is OTA_TOKEN (never, while OTA_TOKEN is empty)
+     */
+    static bool isAuthorized(const char* token);
+
+    /**
+     * @brief Compressed offset an upload of this image has to start at (0 unless one was interrupted)
+     * @param packedCrc CRC-32 of the packed file, as sent by ota_pack.py
+     */
+    uint32_t getResumeOffset(uint32_t imageSize, uint32_t packedCrc);
+
+    /**
+     * @brief Have loop() erase the flash an upload of this image writes to, from its resume point on
+     * @param imageCrc CRC-32 of the inflated image, checked against flash before it is applied
+     * @return nullptr, or why the upload was refused
+     */
+    const char* prepare(uint32_t imageSize, uint32_t packedCrc, uint32_t imageCrc);
+
+    /**
+     * @brief Start receiving the image prepare() got ready, at offset, which must be getResumeOffset()
+     * @param owner Identifies the upload; write() only accepts data from the same owner
+     * @return nullptr, or why the upload was refused
+     */
+    const char* begin(const void* owner, uint32_t offset, uint32_t imageSize, uint32_t packedCrc, uint32_t imageCrc);
+
+    /**
+     * @brief Next piece of the packed image
+     * @return nullptr, or why the upload failed (it can be resumed)
+     */
+    const char* write(const void* owner, const uint8_t* data, size_t length);
+
+    /**
+     * @brief The owner's connection closed; stop its upload if it was not complete
+     */
+    void release(const void* owner);
+
+    /**
+     * @brief Erase for a prepared upload, check a received image, drop stalled uploads and restart
+     *        once an update is applied; run every OTA_CHECK_INTERVAL
+     */
+    void loop();
+
+    const char* getStateName() const;
+    bool isReceiving() const { return writer != nullptr; }
+    bool isReceivingFrom(const void* uploader) const { return writer != nullptr && uploader == owner; }
+    bool isImageReceived() const { return phase == PHASE_VERIFYING || phase == PHASE_RESTARTING; }
+    bool isRestartPending() const { return phase == PHASE_RESTARTING; }
+    uint32_t getImageSize() const { return record.imageSize; }
+    uint32_t getCommittedInput() const { return record.committedInput; }
+    uint32_t getReceived() const { return writer ? writer->getInputOffset() : record.committedInput; }
+    uint32_t getWritten() const { return writer ? writer->getOutputOffset() : record.committedOutput; }
+    const char* getLastError() const { return lastError; }
+
+private:
+    OtaService();
+    OtaService(const OtaService&) = delete;
+    void operator=(const OtaService&) = delete;
+
+    /**
+     * @brief Progress saved at each commit point
+     */
+    struct ResumeRecord {
+        uint32_t magic;
+        uint32_t imageSize;
+        uint32_t packedCrc;         // Identifies the upload to resume
+        uint32_t imageCrc;          // What the inflated image must read back as
+        uint32_t startAddress;      // Flash address of the update area
+        uint32_t committedInput;
+        uint32_t committedOutput;
+        uint32_t crc;               // crc32 over all preceding fields
+    };
+
+    enum Phase : uint8_t {
+        PHASE_IDLE,
+        PHASE_ERASING,      // prepare() was accepted; loop() erases the sectors the upload writes
+        PHASE_READY,        // Erased, waiting for POST /ota
+        PHASE_RECEIVING,
+        PHASE_VERIFYING,    // The image is on flash; loop() reads it back
+        PHASE_RESTARTING    // The bootloader command is written
+    };
+
+    static OtaService* instance;
+    static const char* STATE_FILE;
+
+    ResumeRecord record;
+    bool recordLoaded;
+    Phase phase;
+    uint32_t eraseNext;         // Image offset of the next sector to erase
+    uint32_t eraseEnd;
+    uint32_t verifyOffset;      // Image bytes read back so far
+    uint32_t verifyCrc;
+    OtaImageWriter* writer;
+    const void* owner;
+    unsigned long lastDataTime;
+    unsigned long completedTime;
+    const char* lastError;
+
+    Counter received;
+    Counter sectorsWritten;
+    Counter resumes;
+    Counter failures;
+
+    void loadRecord();
+    void saveRecord();
+    void bootCommand(eboot_command& command) const;
+    bool isBootCommandStored() const;
+    bool storeBootCommand();
+    const char* verifyNext();
+    void finish();
+    void abort(const char* error);
+    static uint32_t updateArea(uint32_t imageSize);
+};
+
+#endif // OTA_SERVICE_H
@@ -0,0 +1,199 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @class FlashRegion
+ * @brief Sector-erasable memory that receives a firmware image
+ *
+ * Offsets are relative to the start of the update area. On the device this
+ * is the free flash between the running sketch and the filesystem; on the
+ * host any buffer can stand in for it.
+ */
+class FlashRegion {
+public:
+    virtual ~FlashRegion() {}
+    virtual bool eraseSector(uint32_t offset) = 0;
+    virtual bool write(uint32_t offset, const uint8_t* data, size_t size) = 0;
+};
+
+/**
+ * @class GzipInflater
+ * @brief Streaming gzip decoder with a fixed window of one flash sector
+ *
+ * Input may be split at any byte: inflate() consumes what it can and keeps
+ * its place, so it can be fed straight from network chunks. Output goes into
+ * an OTA_SECTOR_SIZE ring that is both the deflate history window and the
+ * staging buffer for the next flash sector; inflate() returns WINDOW_FULL
+ * each time the ring holds a complete sector.
+ *
+ * Back-references may reach at most OTA_SECTOR_SIZE bytes, so images must be
+ * compressed with a 4 KB window (zlib wbits 12; scripts/ota_pack.py does
+ * this). Each gzip member's CRC-32 and length are checked when it ends.
+ *
+ * Huffman codes are decoded a bit at a time against canonical code counts,
+ * which needs about 1 KB of tables instead of lookup tables.
+ */
+class GzipInflater {
+public:
+    enum Result : uint8_t {
+        NEED_INPUT,     // All input consumed
+        WINDOW_FULL,    // The window holds a full sector; call windowFlushed() before continuing
+        MEMBER_END,     // A gzip member ended and checked out; the next byte starts a new one
+        FAILED          // Corrupt or unsupported stream; see getError()
+    };
+
+    GzipInflater();
+
+    /**
+     * @brief Expect the start of a gzip member; the window position is kept
+     */
+    void reset();
+
+    /**
+     * @brief Forget the window too (the output starts a new sector)
+     */
+    void resetWindow();
+
+    /**
+     * @brief Decode from input
+     * @param consumed Set to the input bytes used
+     */
+    Result inflate(const uint8_t* input, size_t length, size_t& consumed);
+
+    /**
+     * @brief The window contents were written out; new output starts at its beginning again
+     */
+    void windowFlushed() { windowFill = 0; }
+
+    uint8_t* getWindow() { return window; }
+    size_t getWindowFill() const { return windowFill; }
+    uint32_t getMemberOutput() const { return memberOutput; }
+    bool isAtMemberStart() const { return state == STATE_HEADER && headerCount == 0; }
+    const char* getError() const { return error; }
+
+private:
+    enum State : uint8_t {
+        STATE_HEADER,
+        STATE_EXTRA_LENGTH,
+        STATE_SKIP,             // FEXTRA payload or the header CRC
+        STATE_NAME,
+        STATE_COMMENT,
+        STATE_BLOCK_HEADER,
+        STATE_STORED_LENGTH,
+        STATE_STORED,
+        STATE_TABLE_COUNTS,
+        STATE_CODE_LENGTH_CODES,
+        STATE_CODE_LENGTHS,
+        STATE_CODE_LENGTH_REPEAT,
+        STATE_CODES,
+        STATE_LENGTH_EXTRA,
+        STATE_DISTANCE,
+        STATE_DISTANCE_EXTRA,
+        STATE_COPY,
+        STATE_TRAILER,
+        STATE_FAILED
+    };
+
+    alignas(4) uint8_t window[OTA_SECTOR_SIZE];
+    size_t windowFill;          // Bytes of the current sector in the window, also the next ring position
+
+    // Input of the current inflate() call
+    const uint8_t* in;
+    const uint8_t* inEnd;
+
+    uint32_t bitBuffer;         // Unconsumed bits, least significant first
+    uint8_t bitCount;
+
+    State state;
+    const char* error;
+    uint8_t header[10];         // Fixed gzip header, then stored-block lengths and the trailer
+    uint8_t headerCount;
+    uint8_t flags;              // gzip FLG
+    uint16_t skip;              // Bytes left to skip or copy (header fields, stored blocks)
+    bool finalBlock;
+
+    // Huffman tables: code counts per length and symbols in canonical order
+    uint16_t lengthCount[16];
+    uint16_t lengthSymbol[288];
+    uint16_t distanceCount[16];
+    uint16_t distanceSymbol[30];   // Also holds the code-length code while a dynamic header is read
+    uint8_t codeLengths[288 + 32];
+    uint16_t literalCodes;         // HLIT + 257
+    uint16_t distanceCodes;        // HDIST + 1
+    uint8_t codeLengthCodes;       // HCLEN + 4
+    uint16_t lengthIndex;          // Next code length to read
+    uint16_t pendingSymbol;        // Symbol waiting for its extra bits
+
+    uint16_t copyLength;
+    uint16_t copyDistance;
+
+    uint32_t crc;
+    uint32_t memberOutput;
+
+    bool fail(const char* message);
+    bool needBits(uint8_t count);
+    uint32_t takeBits(uint8_t count);
+    int decode(const uint16_t* count, const uint16_t* symbol);
+    static int buildTable(uint16_t* count, uint16_t* symbol, const uint8_t* lengths, int n);
+    void buildFixedTables();
+    bool buildDynamicTables();
+    void put(uint8_t value);
+    void alignToByte();
+};
+
+/**
+ * @class OtaImageWriter
+ * @brief Inflates a gzip firmware image into a FlashRegion, one erased sector at a time
+ *
+ * An image may be several gzip members back to back (still a valid gzip
+ * file). Where a member ends on a sector boundary the whole upload up to
+ * that point is on flash, and the writer records a commit point: the input
+ * and output offsets a later upload can resume from with begin().
+ */
+class OtaImageWriter {
+public:
+    explicit OtaImageWriter(FlashRegion& region);
+
+    /**
+     * @brief Start, or resume at a commit point
+     * @param imageSize Size of the inflated image in bytes
+     * @param magic Required first byte of the image
+     * @return nullptr, or why the upload cannot start
+     */
+    const char* begin(uint32_t imageSize, uint8_t magic, uint32_t inputOffset = 0, uint32_t outputOffset = 0);
+
+    /**
+     * @brief Feed the next piece of compressed input
+     * @return nullptr, or why the upload failed; begin() again to retry from the last commit point
+     */
+    const char* write(const uint8_t* data, size_t length);
+
+    bool isComplete() const { return complete; }
+    uint32_t getImageSize() const { return imageSize; }
+    uint32_t getInputOffset() const { return inputOffset; }
+    uint32_t getOutputOffset() const { return sectorOffset + inflater.getWindowFill(); }
+    uint32_t getCommittedInput() const { return committedInput; }
+    uint32_t getCommittedOutput() const { return committedOutput; }
+    uint32_t getSectorsWritten() const { return sectorsWritten; }
+
+private:
+    FlashRegion& region;
+    GzipInflater inflater;
+    uint32_t imageSize;
+    uint8_t magic;
+    uint32_t inputOffset;       // Compressed bytes consumed
+    uint32_t sectorOffset;      // Image offset of the sector in the window
+    uint32_t committedInput;
+    uint32_t committedOutput;
+    uint32_t sectorsWritten;
+    bool complete;
+    const char* error;
+
+    const char* flushSector(size_t used);
+};
+
+#endif // OTA_UPDATE_H
@@ -0,0 +1,94 @@
+#ifndef PIXEL_VM_H
+#define PIXEL_VM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @brief PixelVM instructions
+ *
+ * Values are Q16.16 fixed point. Inputs and most intrinsics work in the
+ * 0..1 range: a program leaves red, green and blue (0..1 each) on the
+ * stack, and PALETTE pushes all three at once. Results that do not fit
+ * wrap around, so no program can reach undefined arithmetic.
+ */
+enum PixelOp : uint8_t {
+    OP_PUSH = 0,      // imm32: push a constant
+    OP_INDEX,         // Pixel index
+    OP_POS,           // Pixel position along the strip, 0..1
+    OP_TIME,          // Animation time in seconds (wraps every 32768 s)
+    OP_COUNT,         // Number of pixels
+    OP_LOAD,          // imm8: push register
+    OP_STORE,         // imm8: pop into register
+    OP_DUP,
+    OP_SWAP,
+    OP_POP,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,           // Division by zero gives 0
+    OP_MOD,           // Modulo by 0 or -1 gives 0
+    OP_NEG,
+    OP_ABS,
+    OP_MIN,
+    OP_MAX,
+    OP_FRAC,
+    OP_FLOOR,
+    OP_CLAMP,         // Clamp to 0..1
+    OP_LT,            // a b -> 1 if a < b, else 0
+    OP_SELECT,        // c a b -> a if c > 0, else b
+    OP_SIN,           // Argument in turns (1.0 = full circle), result -1..1
+    OP_NOISE,         // Smooth 1D value noise, 0..1
+    OP_PALETTE,       // imm8 palette; t -> r g b
+    OP_COUNT_OF_OPS
+};
+
+/**
+ * @class PixelVM
+ * @brief Stack machine that computes one pixel colour per run from a small program
+ *
+ * Programs are straight-line bytecode (no jumps), checked once by load():
+ * every opcode and operand must be valid, the stack can neither underflow
+ * nor exceed VM_STACK_DEPTH, and exactly three values remain at the end.
+ * Every pixel therefore costs the same number of instructions, and
+ * render() stops once a frame's instruction budget is spent, leaving the
+ * remaining pixels as they were.
+ *
+ * No Arduino dependencies, so the same code runs in host benchmarks.
+ */
+class PixelVM {
+public:
+    static const uint32_t MAGIC = 0x31565850;  // "PXV1", first four bytes of a program file
+    static const uint8_t PALETTE_COUNT = 4;    // 0 rainbow, 1 fire, 2 ocean, 3 forest
+
+    PixelVM();
+
+    /**
+     * @brief Verify and load a program file (magic followed by bytecode)
+     * @return nullptr on success, otherwise why the program was rejected
+     */
+    const char* load(const uint8_t* data, size_t length);
+
+    void unload() { codeLength = 0; }
+    bool isLoaded() const { return codeLength > 0; }
+    size_t getCodeLength() const { return codeLength; }
+    uint16_t getInstructionCount() const { return instructionCount; }
+
+    /**
+     * @brief Render a frame
+     * @param rgb Output, count entries
+     * @param budget Instructions allowed for the whole frame
+     * @return Pixels rendered; fewer than count if the budget ran out
+     */
+    int render(uint32_t timeMs, uint8_t (*rgb)[3], int count, uint32_t budget);
+
+private:
+    uint8_t code[VM_MAX_PROGRAM];
+    size_t codeLength;
+    uint16_t instructionCount;   // Instructions per pixel
+
+    void run(int32_t index, int32_t pos, int32_t time, int32_t count, uint8_t* rgb) const;
+};
+
+#endif // PIXEL_VM_H
@@ -0,0 +1,89 @@
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Metrics.h"
+
+/**
+ * @struct PresetRecord
+ * @brief One saved look: pattern, brightness and every pixel's colour
+ *
+ * Stored as-is in a fixed-size slot of /presets.bin. A Program preset also
+ * records which pixel program it was saved with; the program itself lives
+ * in its own file, so recall refuses the preset once that has changed.
+ */
+struct PresetRecord {
+    uint8_t used;                       // 0 for an empty slot
+    uint8_t pattern;                    // PatternType
+    uint8_t brightness;
+    uint8_t reserved;
+    char name[PRESET_NAME_MAX];         // NUL-terminated
+    uint32_t programCrc;                // NeoPixel::getProgramCrc() when saved (Program pattern), else 0
+    uint32_t crc;                       // crc32 over the pixels
+    uint8_t pixels[NEOPIXEL_COUNT][3];  // RGB
+};
+
+/**
+ * @class PresetStore
+ * @brief Named LED presets in an indexed slot file
+ *
+ * /presets.bin is a short header followed by PRESET_SLOTS fixed-size
+ * records, so slot n lives at a known offset. The names are read into RAM
+ * once; after that, recalling a preset is a name lookup in RAM plus one
+ * seek and one read of its slot, with no JSON anywhere on the path. Saving
+ * rewrites only the affected slot.
+ */
+class PresetStore {
+public:
+    static constexpr int INVALID_SLOT = -1;
+
+    static PresetStore* getInstance();
+
+    /**
+     * @brief Capture the strip's current scene into a slot
+     * @param slot Slot to use, or INVALID_SLOT for the slot already holding name (else the first free one)
+     * @return The slot written, or INVALID_SLOT on failure
+     */
+    int save(const char* name, int slot = INVALID_SLOT);
+
+    /**
+     * @brief Show a saved preset on the strip
+     * @return nullptr, or why it was not shown (empty, unreadable or corrupt slot, or a Program
+     *         preset whose pixel program has since been replaced)
+     */
+    const char* recall(int slot);
+
+    /**
+     * @brief Slot holding a preset with this name, or INVALID_SLOT
+     */
+    int find(const char* name);
+
+    bool isUsed(int slot);
+    const char* getName(int slot);
+    uint32_t getLastRecallUs() const { return lastRecallUs; }
+
+private:
+    PresetStore();
+    PresetStore(const PresetStore&) = delete;
+    void operator=(const PresetStore&) = delete;
+
+    static PresetStore* instance;
+    static const char* PRESET_FILE;
+
+    // In-RAM index of the slot file, filled on first use
+    char names[PRESET_SLOTS][PRESET_NAME_MAX];
+    bool used[PRESET_SLOTS];
+    bool indexed;
+    uint32_t lastRecallUs;
+
+    Counter saves;
+    Counter recalls;
+    Counter failures;
+    Histogram recallTimeUs;    // Slot read plus strip update
+
+    void loadIndex();
+    bool createFile();
+};
+
+#endif // PRESET_H
@@ -2,27 +2,24 @@
 #define PROTOCOL_H
 
 #include <Arduino.h>
-#include <vector>
 #include <functional>
-#include <Ticker.h>
 #include "CustomWiFiManager.h"
 #include "Weather.h"
 #include "WebServer.h"
 #include "Config.h"
 #include "NeoPixel.h"
+#include "Scheduler.h"
+#include "Metrics.h"
+#include "History.h"
 
 /**
- * @struct TaskConfig
- * @brief Configuration structure for scheduled tasks
- * 
- * Defines all properties needed to manage periodic tasks including
- * name, timing, and the function to execute
+ * @brief Task priorities; when several tasks are due the higher one runs first
  */
-struct TaskConfig {
-    const char* name;                  // Friendly name for the task
-    Ticker ticker;                     // Timer that schedules task execution
-    std::function<void(void)> callback; // Function to call when task runs
-    uint32_t interval_ms;              // Interval between executions in milliseconds
+enum TaskPriority : uint8_t {
+    PRIORITY_LOW = 0,       // Diagnostics
+    PRIORITY_NORMAL = 1,    // Background services
+    PRIORITY_HIGH = 2,      // Connectivity
+    PRIORITY_REALTIME = 3   // Frame output
 };
 
 /**
@@ -35,7 +32,7 @@ struct TaskConfig {
 class Protocol {
 private:
     static Protocol* instance;         // Singleton instance pointer
-    std::vector<TaskConfig> tasks;     // Container for all registered tasks
+    Scheduler scheduler;               // Cooperative scheduler for all periodic tasks
     
     // System components
     CustomWiFiManager* wifiManager;    // WiFi manager 
@@ -47,6 +44,34 @@ private:
     bool* ledState;                    // LED state reference
     int* brightness;                   // LED brightness reference
     
+    // System metrics (served on /metrics)
+    Gauge heapFree;                    // Free heap at the last sample
+    Gauge heapFreeMin;                 // Lowest free heap seen since boot
+    Gauge heapMaxBlock;                // Largest free block at the last sample
+    Gauge heapMaxBlockMin;             // Smallest largest-free-block seen since boot
+    Gauge heapFragmentation;           // Fragmentation percentage at the last sample
+    Gauge uptimeSeconds;
+    Histogram renderTimeUs;            // NeoPixel update + show time per frame
+    
+    // Downsampled health history (served on /system-history)
+    SystemHistory history;
+    uint32_t windowHeapMin;            // Lowest free heap since the last history sample
+    uint32_t windowMaxBlockMin;        // Smallest max block since the last history sample
+    uint8_t windowFragMax;             // Highest fragmentation since the last history sample
+    uint64_t renderSumMark;            // renderTimeUs sum and count at the last history sample
+    uint32_t renderCountMark;
+    uint32_t lastFrameStart;           // micros() at the start of the previous NeoPixel tick
+    
+    /**
+     * @brief Register the system metrics with the Metrics registry
+     */
+    void registerMetrics();
+    
+    /**
+     * @brief Sample heap state and update the high-water-mark gauges
+     */
+    void sampleHeap();
+    
     /**
      * @brief Private constructor to enforce Singleton pattern
      */
@@ -90,9 +115,15 @@ public:
      * @param name Friendly identifier for the task
      * @param taskFunction Function to execute when the task runs
      * @param interval_ms Time between executions in milliseconds
+     * @param priority Order among tasks that are due at the same time
      */
     void createTask(const char* name, std::function<void(void)> taskFunction, 
-                   uint32_t interval_ms);
+                   uint32_t interval_ms, uint8_t priority = PRIORITY_NORMAL);
+    
+    /**
+     * @brief Runs due tasks; call from loop()
+     */
+    void loop();
                    
     /**
      * @brief Task function to update weather information
@@ -109,6 +140,11 @@ public:
      */
     void neoPixelTask();
     
+    /**
+     * @brief Task function to record one system history sample
+     */
+    void historyTask();
+    
     /**
      * @brief Gets the WiFi manager instance
      * @return Pointer to the CustomWiFiManager
@@ -126,6 +162,12 @@ public:
      * @return Pointer to the Weather service
      */
     Weather* getWeatherService() { return weatherService; }
+    
+    /**
+     * @brief Gets the task scheduler
+     * @return Pointer to the Scheduler
+     */
+    Scheduler* getScheduler() { return &scheduler; }
 };
 
 #endif // PROTOCOL_H
\ No newline at end of file
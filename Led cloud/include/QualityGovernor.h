@@ -0,0 +1,110 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @brief Render quality levels, from full detail down; each level keeps the savings of the ones above it
+ */
+enum QualityLevel : uint8_t {
+    QUALITY_FULL = 0,            // Native render rates, blended output every NEOPIXEL_OUTPUT_INTERVAL
+    QUALITY_SLOW_KEYFRAMES = 1,  // Keyframed patterns (fire, programs) render at half their rate
+    QUALITY_NO_BLEND = 2,        // Keyframed patterns only send their keyframes, nothing blended in between
+    QUALITY_HALF_PIXELS = 3,     // Fire and programs compute every other pixel and repeat it
+    QUALITY_HALF_OUTPUT = 4,     // The strip is refreshed on every second output tick
+    QUALITY_LEVELS = 5
+};
+
+/**
+ * @brief Short name of a quality level, for logs and JSON output
+ */
+inline const char* qualityLevelName(uint8_t level) {
+    switch (level) {
+        case QUALITY_FULL: return "full";
+        case QUALITY_SLOW_KEYFRAMES: return "slow-keyframes";
+        case QUALITY_NO_BLEND: return "no-blend";
+        case QUALITY_HALF_PIXELS: return "half-pixels";
+        case QUALITY_HALF_OUTPUT: return "half-output";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @struct QualityTransition
+ * @brief One level change and the window of frames that caused it
+ */
+struct QualityTransition {
+    uint32_t timeMs;
+    uint8_t from;
+    uint8_t to;
+    uint8_t overruns;      // Overrunning frames in the deciding window
+    uint32_t peakCostUs;   // Most expensive frame in that window
+};
+
+/**
+ * @class QualityGovernor
+ * @brief Steps render quality down under sustained frame overruns and back up with hysteresis
+ *
+ * Frames are judged in windows of QUALITY_WINDOW. A frame overruns when its
+ * update and send took longer than the budget, or when it started so late
+ * that the previous output tick was lost. A window with QUALITY_DOWN_OVERRUNS
+ * or more drops one level, so a single slow frame changes nothing.
+ *
+ * Going back up takes QUALITY_RECOVER_WINDOWS windows in a row in which no
+ * frame overran and every frame finished QUALITY_RECOVER_MARGIN inside the
+ * budget. That margin is the room the restored work needs. If a restored level drops again before it has held for that
+ * long, the number of windows needed doubles, up to 8x. This stops the
+ * governor flapping between two levels under a load that sits right at the
+ * edge. Each level that holds for the full time halves it again.
+ *
+ * Only arithmetic on caller-supplied costs and times, so a load profile can
+ * be replayed on the host (scripts/quality_sim.cpp).
+ */
+class QualityGovernor {
+public:
+    explicit QualityGovernor(uint32_t budgetUs);
+
+    /**
+     * @brief Account for one output frame
+     * @param costUs Time the frame's update and send took
+     * @param late The frame started after the next one was already due
+     * @return true if the frame closed a window that changed the level
+     */
+    bool observe(uint32_t costUs, bool late, uint32_t nowMs);
+
+    uint8_t getLevel() const { return level; }
+    uint32_t getBudgetUs() const { return budgetUs; }
+    uint32_t getStepsDown() const { return stepsDown; }
+    uint32_t getStepsUp() const { return stepsUp; }
+    uint16_t getRecoverWindows() const { return recoverWindows; }  // Clean windows the next step up needs
+
+    // Most recent changes, oldest first; at most QUALITY_HISTORY are kept
+    size_t getTransitionCount() const { return transitionCount; }
+    const QualityTransition& getTransition(size_t index) const;
+
+private:
+    uint32_t budgetUs;
+    uint8_t level;
+
+    // Current window
+    uint8_t windowFrames;
+    uint8_t windowOverruns;
+    uint32_t windowPeakUs;
+
+    uint16_t cleanWindows;       // Clean windows in a row at this level
+    uint16_t recoverWindows;     // Clean windows needed before stepping up
+    uint16_t windowsAtLevel;     // Windows since the last change
+    bool steppedUp;              // The last change restored a level
+    uint32_t stepsDown;
+    uint32_t stepsUp;
+
+    QualityTransition transitions[QUALITY_HISTORY];
+    uint8_t transitionHead;      // Slot the next transition goes in
+    uint8_t transitionCount;
+
+    void change(uint8_t to, uint32_t nowMs, uint8_t overruns, uint32_t peakUs);
+};
+
+#endif // QUALITY_GOVERNOR_H
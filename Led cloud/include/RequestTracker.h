@@ -0,0 +1,47 @@
+#ifndef REQUEST_TRACKER_H
+#define REQUEST_TRACKER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <ESPAsyncWebServer.h>
+
+/**
+ * @class RequestTracker
+ * @brief Counts the requests the shared AsyncWebServer is still working on
+ *
+ * A request keeps a pointer to the handler that claimed it until its
+ * connection closes, so AsyncWebServer::reset() is only safe while
+ * getActive() is 0. Add one tracker ahead of every other handler after each
+ * reset. It never claims a request; it counts it in canHandle() and uncounts
+ * it when the connection closes.
+ *
+ * A request has a single disconnect callback, so a route that needs its own
+ * must set it through onDisconnect() below, which keeps the count right.
+ * Server callbacks and loop() run in the same context, so the count cannot
+ * change while loop() code reads it.
+ */
+class RequestTracker : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest* request) override {
+        active++;
+        request->onDisconnect([]() { active--; });
+        return false;
+    }
+
+    /**
+     * @brief Run callback when the request's connection closes
+     */
+    static void onDisconnect(AsyncWebServerRequest* request, std::function<void()> callback) {
+        request->onDisconnect([callback]() {
+            active--;
+            callback();
+        });
+    }
+
+    static uint16_t getActive() { return active; }
+
+private:
+    static uint16_t active;
+};
+
+#endif // REQUEST_TRACKER_H
@@ -0,0 +1,104 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+/**
+ * @class Scheduler
+ * @brief Cooperative deadline scheduler driven from loop()
+ *
+ * Periodic tasks are kept in a min-heap ordered by their next deadline. Each
+ * call to runPending() runs every task whose deadline has passed, highest
+ * priority first, and records run count, runtime, start jitter, overruns and
+ * missed deadlines per task. Work therefore runs in the loop context instead
+ * of the SYS context that Ticker callbacks use.
+ *
+ * Time comes from an injected microsecond clock, so the scheduler has no
+ * dependency on the Arduino core and can be driven by a virtual clock.
+ */
+class Scheduler {
+public:
+    typedef uint32_t (*ClockFunction)();  // Free-running microsecond counter (wraps at 2^32)
+
+    static const uint8_t MAX_TASKS = 12;
+    static const int INVALID_TASK = -1;
+
+    /**
+     * @struct Task
+     * @brief A registered task and its timing statistics
+     */
+    struct Task {
+        const char* name;                   // Friendly name for the task
+        std::function<void(void)> callback; // Function to call when task runs
+        uint32_t intervalUs;                // Period between deadlines
+        uint8_t priority;                   // Higher runs first when several tasks are due
+        uint64_t deadline;                  // Next deadline on the scheduler's 64-bit timeline
+
+        uint32_t runCount;
+        uint64_t totalRuntimeUs;
+        uint32_t maxRuntimeUs;
+        uint32_t lastJitterUs;              // Start delay after the deadline on the last run
+        uint32_t maxJitterUs;
+        uint32_t missedDeadlines;           // Periods skipped because the task ran too late
+        uint32_t overruns;                  // Runs that took longer than the task's own interval
+    };
+
+    explicit Scheduler(ClockFunction clockUs);
+
+    /**
+     * @brief Register a periodic task
+     * @return Task id, or INVALID_TASK if the table is full
+     */
+    int addTask(const char* name, std::function<void(void)> callback,
+                uint32_t intervalMs, uint8_t priority);
+
+    /**
+     * @brief Arm all registered tasks; the first run of each is one interval from now
+     */
+    void start();
+
+    /**
+     * @brief Remove all tasks
+     */
+    void clear();
+
+    /**
+     * @brief Run every task whose deadline has passed
+     * @return Number of tasks run
+     */
+    size_t runPending();
+
+    /**
+     * @brief Milliseconds until the earliest deadline (0 if one is already due)
+     */
+    uint32_t getMsUntilNext();
+
+    size_t getTaskCount() const { return taskCount; }
+    const Task& getTask(size_t index) const { return tasks[index]; }
+    bool isStarted() const { return started; }
+
+    static uint32_t getAverageRuntimeUs(const Task& task) {
+        return task.runCount ? (uint32_t)(task.totalRuntimeUs / task.runCount) : 0;
+    }
+
+private:
+    ClockFunction clock;
+    uint32_t lastClock;       // Last raw clock reading, to extend it to 64 bits
+    uint64_t elapsed;         // Monotonic 64-bit time in microseconds
+
+    Task tasks[MAX_TASKS];
+    uint8_t taskCount;
+    uint8_t heap[MAX_TASKS];  // Task indices, min-heap on deadline
+    uint8_t heapSize;
+    bool started;
+
+    uint64_t now();
+    void run(uint8_t index);
+    bool earlier(uint8_t a, uint8_t b) const;
+    void heapPush(uint8_t index);
+    uint8_t heapPop();
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,101 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Metrics.h"
+
+/**
+ * @struct SettingsData
+ * @brief Every persisted setting, stored as one binary record
+ *
+ * New fields must be appended: records written by older firmware are shorter
+ * and their missing tail keeps the defaults.
+ */
+struct SettingsData {
+    // Weather (valid once weatherSaved is set)
+    char apiKey[40];                  // OpenWeatherMap keys are 32 characters
+    char apiBaseUrl[96];
+    float latitude;
+    float longitude;
+    uint8_t weatherSaved;             // 1 once the user (or the migration) stored weather settings
+
+    // Built-in LED
+    uint8_t ledOn;
+    uint8_t ledBrightness;
+
+    // NeoPixel strip
+    uint8_t pattern;                  // PatternType
+    uint8_t pixelBrightness;
+    uint8_t pixels[NEOPIXEL_COUNT][3];  // RGB, restored for static patterns
+    uint8_t reserved[3];
+};
+
+/**
+ * @class SettingsStore
+ * @brief Versioned binary settings file with CRC, atomic replace and write-behind
+ *
+ * The record is read in a single file read the first time it is needed, so
+ * boot does no JSON parsing. Changes only mark the record dirty; loop()
+ * writes it once the changes have been quiet for SETTINGS_WRITE_DELAY (or
+ * SETTINGS_WRITE_MAX_DELAY after the first change), so a burst of UI
+ * updates costs one flash write. Writes go to a temporary file that is then
+ * renamed over the old one, and records identical to the last one written
+ * are not written again.
+ */
+class SettingsStore {
+public:
+    static SettingsStore* getInstance();
+
+    /**
+     * @brief Current settings (loaded on first use)
+     */
+    const SettingsData& get();
+
+    /**
+     * @brief Settings for modification; the store is marked dirty
+     */
+    SettingsData& edit();
+
+    /**
+     * @brief Write pending changes once they have settled; run periodically
+     */
+    void loop();
+
+    /**
+     * @brief Write pending changes now (e.g. before a restart)
+     * @return false if a write was needed and failed
+     */
+    bool flush();
+
+    bool isDirty() const { return dirty; }
+
+private:
+    SettingsStore();
+    SettingsStore(const SettingsStore&) = delete;
+    void operator=(const SettingsStore&) = delete;
+
+    static SettingsStore* instance;
+    static const char* SETTINGS_FILE;
+    static const char* TEMP_FILE;
+    static const char* LEGACY_WEATHER_FILE;
+
+    SettingsData data;
+    bool loaded;
+    bool dirty;
+    unsigned long firstChangeTime;   // millis() of the first change since the last write
+    unsigned long lastChangeTime;    // millis() of the most recent change
+    uint32_t writtenCrc;             // CRC of the record on flash, to skip identical writes
+
+    Counter writes;
+    Counter skippedWrites;
+    Counter writeFailures;
+
+    void load();
+    void applyDefaults();
+    bool readFile();
+    bool migrateLegacy();
+    bool write();
+};
+
+#endif // SETTINGS_H
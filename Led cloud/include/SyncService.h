@@ -0,0 +1,77 @@
+#ifndef SYNC_SERVICE_H
+#define SYNC_SERVICE_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include "ClockSync.h"
+#include "Metrics.h"
+
+/**
+ * @class SyncService
+ * @brief Runs ClockSync over UDP multicast so nodes share one animation timeline
+ *
+ * All protocol logic lives in ClockSync; this class only supplies a 64-bit
+ * microsecond clock, moves beacons through SYNC_MULTICAST_GROUP:SYNC_PORT and
+ * exports the achieved sync error. Without WiFi (or without other nodes) it
+ * keeps running on the local clock, so patterns still animate.
+ *
+ * Received beacons are read by loop(), so the poll period adds up to
+ * SYNC_POLL_INTERVAL of delay noise; ClockSync favours the earliest arrivals,
+ * which keeps the resulting offset bias to about one poll period.
+ */
+class SyncService {
+public:
+    static SyncService* getInstance();
+
+    /**
+     * @brief Send a due beacon and process received ones; run every SYNC_POLL_INTERVAL
+     */
+    void loop();
+
+    /**
+     * @brief Milliseconds on the shared animation timeline
+     */
+    uint32_t animationTimeMs();
+
+    /**
+     * @brief Resume the timeline at elapsedMs (after a soft reset)
+     */
+    void setAnimationElapsed(uint32_t elapsedMs);
+
+    /**
+     * @brief Local clock extended to 64 bits; valid while called at least every ~71 minutes
+     */
+    uint64_t localUs();
+
+    const ClockSync& getClock() const { return clock; }
+    bool isJoined() const { return joined; }
+
+private:
+    SyncService();
+    SyncService(const SyncService&) = delete;
+    void operator=(const SyncService&) = delete;
+
+    static SyncService* instance;
+
+    ClockSync clock;
+    WiFiUDP udp;
+    IPAddress group;
+    IPAddress joinedAddress;   // Station address the group was joined on
+    bool joined;
+    uint32_t lastMicros;
+    uint64_t elapsedUs;
+
+    Counter beaconsSent;
+    Counter beaconsReceived;
+    Counter invalidPackets;
+    Gauge leader;              // 1 while this node leads
+    Gauge errorMeanUs;
+    Gauge errorMaxUs;
+
+    void join();
+    void receive();
+    void updateMetrics();
+};
+
+#endif // SYNC_SERVICE_H
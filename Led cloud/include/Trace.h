@@ -0,0 +1,147 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "TraceTimeline.h"
+#include "ChunkedExporter.h"
+
+/**
+ * @brief Identifiers of traced code regions
+ *
+ * Names and Chrome trace tracks for each id live in Trace.cpp; keep both in sync.
+ */
+enum TraceId : uint8_t {
+    // Rendering
+    TRACE_NEOPIXEL_UPDATE = 0,
+    TRACE_NEOPIXEL_SHOW,
+    // HTTP routes
+    TRACE_HTTP_ROOT,
+    TRACE_HTTP_HEALTH,
+    TRACE_HTTP_LED_ON,
+    TRACE_HTTP_LED_OFF,
+    TRACE_HTTP_BRIGHTNESS,
+    TRACE_HTTP_SYSTEM_INFO,
+    TRACE_HTTP_TASKS,
+    TRACE_HTTP_BOOT,
+    TRACE_HTTP_TRACE,
+    TRACE_HTTP_LOGS,
+    TRACE_HTTP_METRICS,
+    TRACE_HTTP_SYSTEM_HISTORY,
+    TRACE_HTTP_WEATHER,
+    TRACE_HTTP_WEATHER_FORECAST,
+    TRACE_HTTP_WEATHER_SETTINGS_GET,
+    TRACE_HTTP_WEATHER_SETTINGS_POST,
+    TRACE_HTTP_NEOPIXEL_SET_ALL,
+    TRACE_HTTP_NEOPIXEL_SET_PIXEL,
+    TRACE_HTTP_NEOPIXEL_SET_PATTERN,
+    TRACE_HTTP_NEOPIXEL_SET_BRIGHTNESS,
+    TRACE_HTTP_NEOPIXEL_STATUS,
+    TRACE_HTTP_SYNC,
+    TRACE_HTTP_PRESETS,
+    TRACE_HTTP_PRESETS_SAVE,
+    TRACE_HTTP_PRESETS_RECALL,
+    TRACE_HTTP_PROGRAM_GET,
+    TRACE_HTTP_PROGRAM_POST,
+    TRACE_HTTP_QUALITY,
+    TRACE_HTTP_OTA_GET,
+    TRACE_HTTP_OTA_POST,
+    TRACE_HTTP_OTA_PREPARE,
+    // Protocol tasks
+    TRACE_TASK_WEATHER,
+    TRACE_TASK_MONITOR,
+    TRACE_TASK_NEOPIXEL,
+    TRACE_TASK_WIFI,
+    TRACE_TASK_HISTORY,
+    TRACE_TASK_SETTINGS,
+    TRACE_TASK_OTA,
+    // Services
+    TRACE_WEATHER_FETCH,
+    TRACE_WEATHER_FORECAST,
+    TRACE_SYNC_BEACON,
+    TRACE_ID_COUNT
+};
+
+#if LEDCLOUD_TRACE
+
+/**
+ * @class Trace
+ * @brief Fixed RAM ring buffer of trace records
+ *
+ * Recording is two cycle counter reads, a shift and a store into a
+ * power-of-two ring. Only the most recent
+ * TRACE_CAPACITY records are kept.
+ */
+class Trace {
+public:
+    static inline void record(uint8_t id, uint32_t startCycles, uint32_t endCycles) {
+        buffer[head & (TRACE_CAPACITY - 1)] = TraceRecord::make(id, startCycles, endCycles);
+        head++;
+    }
+
+    /**
+     * @brief Copy the buffered records, oldest first
+     * @return Number of records copied
+     */
+    static size_t snapshot(TraceRecord* out, size_t maxRecords);
+
+    static uint32_t getTotalRecorded() { return head; }
+    static const char* getName(uint8_t id);
+    static uint8_t getTrack(uint8_t id);
+
+private:
+    static TraceRecord buffer[TRACE_CAPACITY];
+    static uint32_t head;  // Records written since boot; the ring index is head % capacity
+
+    static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "TRACE_CAPACITY must be a power of two");
+};
+
+/**
+ * @class TraceScope
+ * @brief Records the enclosing scope's duration when it is left
+ */
+class TraceScope {
+public:
+    explicit TraceScope(uint8_t traceId) : id(traceId), start(ESP.getCycleCount()) {}
+    ~TraceScope() { Trace::record(id, start, ESP.getCycleCount()); }
+
+private:
+    uint8_t id;
+    uint32_t start;
+};
+
+/**
+ * @class TraceExporter
+ * @brief Streams a snapshot of the trace buffer as Chrome trace_event JSON
+ *
+ * One event per piece. Load the output in chrome://tracing or
+ * https://ui.perfetto.dev.
+ */
+class TraceExporter : public ChunkedExporter {
+public:
+    TraceExporter();
+    ~TraceExporter();
+
+private:
+    TraceRecord* records;
+    size_t count;
+    size_t next;            // Next record to format
+    uint8_t stage;          // 0 = header, 1 = events, 2 = footer, 3 = done
+    uint64_t originCycles;  // Earliest unwrapped start, emitted as ts 0
+    TraceTimeline timeline;
+    uint32_t cyclesPerUs;
+
+    bool formatNext() override;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(id) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(id)
+
+#else
+
+#define TRACE_SCOPE(id) do { } while (0)
+
+#endif // LEDCLOUD_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,70 @@
+#ifndef TRACE_TIMELINE_H
+#define TRACE_TIMELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @struct TraceRecord
+ * @brief One completed region (8 bytes)
+ */
+struct TraceRecord {
+    uint32_t startCycles;  // ESP.getCycleCount() at region entry
+    uint32_t packed;       // Duration in (cycles >> TRACE_CYCLE_SHIFT) in the upper 24 bits, TraceId in the low 8
+
+    static inline TraceRecord make(uint8_t id, uint32_t startCycles, uint32_t endCycles) {
+        uint32_t duration = (endCycles - startCycles) >> TRACE_CYCLE_SHIFT;
+        if (duration > 0xFFFFFF) {
+            duration = 0xFFFFFF;
+        }
+        TraceRecord record;
+        record.startCycles = startCycles;
+        record.packed = (duration << 8) | id;
+        return record;
+    }
+
+    uint8_t getId() const { return packed & 0xFF; }
+    uint32_t getDurationCycles() const { return (packed >> 8) << TRACE_CYCLE_SHIFT; }
+};
+
+/**
+ * @class TraceTimeline
+ * @brief Extends the 32-bit start times of trace records onto a 64-bit timeline
+ *
+ * Records are stored in order of completion, so a scope that encloses others
+ * is stored after them but started before them. Its start is behind the
+ * previous record's by at most its own duration; any larger step back is the
+ * cycle counter wrapping. Starts are exact, unlike durations, which are
+ * truncated to 2^TRACE_CYCLE_SHIFT cycles. place() must be called for the
+ * records in stored order.
+ */
+class TraceTimeline {
+public:
+    void reset() {
+        started = false;
+    }
+
+    uint64_t place(const TraceRecord& record) {
+        if (!started) {
+            startCycles = (uint64_t)1 << 32;  // Headroom so earlier starts stay positive
+            started = true;
+        } else {
+            uint32_t back = lastRawStart - record.startCycles;
+            if (back <= record.getDurationCycles() + (1u << TRACE_CYCLE_SHIFT)) {
+                startCycles -= back;
+            } else {
+                startCycles += (uint32_t)(record.startCycles - lastRawStart);
+            }
+        }
+        lastRawStart = record.startCycles;
+        return startCycles;
+    }
+
+private:
+    bool started = false;
+    uint64_t startCycles = 0;  // Unwrapped start of the previous record
+    uint32_t lastRawStart = 0;
+};
+
+#endif // TRACE_TIMELINE_H
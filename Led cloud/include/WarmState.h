@@ -0,0 +1,83 @@
+#ifndef WARM_STATE_H
+#define WARM_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Config.h"
+
+/**
+ * @struct PatternPhase
+ * @brief Position of the running animations, so they resume where they stopped
+ *
+ * Animations are a function of the shared animation time, so that is all
+ * there is to keep.
+ */
+struct PatternPhase {
+    uint32_t elapsedMs;   // Animation time when the record was saved
+};
+
+/**
+ * @struct WarmStateRecord
+ * @brief LED scene kept in RTC user memory across soft resets
+ */
+struct WarmStateRecord {
+    uint32_t magic;
+    uint8_t pattern;                    // PatternType
+    uint8_t brightness;
+    uint8_t weatherCondition;           // WeatherCondition code for the weather scene
+    uint8_t reserved;
+    PatternPhase phase;
+    uint8_t pixels[NEOPIXEL_COUNT][3];  // RGB snapshot
+    uint32_t checksum;                  // crc32 over all preceding bytes
+};
+
+static_assert(sizeof(WarmStateRecord) % 4 == 0, "RTC user memory is accessed in 4-byte blocks");
+static_assert(RTC_LED_STATE_BLOCK >= RTC_EBOOT_BLOCKS,
+              "LED warm state would overlap the bootloader command in RTC user memory");
+static_assert(RTC_LED_STATE_BLOCK * 4 + sizeof(WarmStateRecord) <= RTC_USER_MEMORY_SIZE,
+              "LED warm state does not fit in RTC user memory");
+
+/**
+ * @class RtcRegion
+ * @brief Block-addressed memory that survives soft resets
+ *
+ * On the device this is ESP8266 RTC user memory; on the host any buffer can
+ * stand in for it.
+ */
+class RtcRegion {
+public:
+    virtual ~RtcRegion() {}
+    virtual bool read(uint32_t block, void* data, size_t size) = 0;
+    virtual bool write(uint32_t block, const void* data, size_t size) = 0;
+};
+
+/**
+ * @class WarmStateStore
+ * @brief Saves and validates the LED warm state in an RtcRegion
+ *
+ * After power-on the region holds garbage, which fails the magic or checksum
+ * test, so load() only succeeds after a watchdog, exception or soft reset.
+ */
+class WarmStateStore {
+public:
+    WarmStateStore(RtcRegion& region, uint32_t block);
+
+    /**
+     * @brief Read the record
+     * @return false if the region holds no valid record
+     */
+    bool load(WarmStateRecord& record);
+
+    /**
+     * @brief Stamp the record with magic and checksum and write it
+     */
+    bool save(WarmStateRecord& record);
+
+    static uint32_t checksum(const void* data, size_t length);
+
+private:
+    RtcRegion& region;
+    uint32_t block;
+};
+
+#endif // WARM_STATE_H
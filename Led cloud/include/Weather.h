@@ -9,6 +9,9 @@
 #include <Ticker.h>
 #include <LittleFS.h>
 #include "Config.h" // Include the configuration file
+#include "CircuitBreaker.h"
+#include "Forecast.h"
+#include "Metrics.h"
 
 class Weather {
 private:
@@ -22,29 +25,73 @@ private:
     String apiKey;
     float latitude;
     float longitude;
+    String apiBaseUrl;
     
     // Weather data
     float temperature;
     int humidity;    // Added humidity field
     String weatherDescription;
     String weatherIcon;
+    uint8_t condition;   // WeatherCondition code of the current reading
+    
+    // 5-day/3-hour forecast in packed samples
+    ForecastBuffer<FORECAST_CAPACITY> forecast;
+    unsigned long lastForecastTime;
+    bool hasForecast;
     
     // Update tracking
-    unsigned long lastUpdateTime;
+    volatile bool updateRequested;  // Set by the ticker, consumed by poll()
+    unsigned long lastUpdateTime;   // millis() reference of the current reading
+    uint32_t lastUpdateEpoch;       // Wall-clock time of the current reading (0 if unknown)
+    bool hasData;                   // True once a reading was fetched or restored from cache
     bool shouldRun;
     
     // Ticker for scheduling updates
     Ticker weatherTicker;
     
-    // Settings file path
-    static const char* SETTINGS_FILE;
+    // Cache file path
+    static const char* CACHE_FILE;
+    
+    // Cache statistics
+    Counter cacheHits;           // Fetches answered from the cache without an API call
+    Counter cacheMisses;         // Fetches that had to go to the network
     
     // Rate limiting
     static unsigned long lastApiCallTime;
     static const unsigned long MIN_API_CALL_INTERVAL; // Minimum time between API calls
     
     // API call counter
-    static unsigned long apiCallCount;
+    static Counter apiCallCount;
+    Counter apiFailures;         // Failed calls and probes, as seen by the breaker
+    
+    // Backoff and circuit breaker for failing API calls
+    CircuitBreaker breaker;
+    
+    // Record a failed API call with the breaker
+    void recordFailure(const char* reason);
+    
+    // Cheap TCP connect check against the API host, used before a half-open retry
+    bool probeEndpoint();
+    
+    // Memory usage of the most recent response parse
+    size_t lastParsePeakBytes;   // Peak bytes held by the filtered JSON document
+    size_t lastResponseBytes;    // Bytes read from the response stream
+    uint32_t lastFetchHeapUsed;  // Free heap consumed while the request was in flight
+    
+    // Restore the last reading from RTC memory or LittleFS
+    bool restoreCache();
+    
+    // Persist the current reading to RTC memory and LittleFS
+    void storeCache();
+    
+    // Drop the cached reading (e.g. after a location change)
+    void invalidateCache();
+    
+    // Age of the current reading in milliseconds
+    unsigned long getDataAgeMs() const;
+    
+    // True while the current reading is younger than WEATHER_CACHE_TTL
+    bool isCacheFresh() const;
 
 public:
     // API call limit management - using interval from Config.h
@@ -66,14 +113,14 @@ public:
     // Initialize with saved settings or defaults
     bool beginWithSavedSettings();
     
-    // Save settings to file system
-    bool saveSettings(const String& apiKey, float latitude, float longitude);
+    // Save settings to the settings store
+    bool saveSettings(const String& apiKey, float latitude, float longitude, const String& baseUrl);
     
-    // Load settings from file system
-    bool loadSettings(String& apiKey, float& latitude, float& longitude);
+    // Load settings from the settings store
+    bool loadSettings(String& apiKey, float& latitude, float& longitude, String& baseUrl);
     
     // Update weather data with new settings
-    bool updateSettings(const String& apiKey, float latitude, float longitude);
+    bool updateSettings(const String& apiKey, float latitude, float longitude, const String& baseUrl);
     
     // Start the weather update task
     void startTask();
@@ -81,14 +128,23 @@ public:
     // Stop the weather update task
     void stopTask();
     
-    // Fetch weather data from API
-    void fetchWeatherData();
+    // Fetch weather data from API, or serve the cache while it is fresh unless forced
+    void fetchWeatherData(bool force = false);
+    
+    // Fetch when the reading is due for an update and the breaker allows it
+    void poll();
+    
+    // Fetch the 5-day/3-hour forecast into the ring buffer
+    void fetchForecast();
     
-    // Get weather data as JSON string
-    String toJson() const;
+    // Fill doc with the forecast samples
+    void getForecast(JsonDocument& doc) const;
     
-    // Get settings as JSON string
-    String getSettingsJson() const;
+    // Fill doc with the current weather data
+    void getWeather(JsonDocument& doc) const;
+    
+    // Fill doc with the settings (API key masked)
+    void getSettings(JsonDocument& doc) const;
     
     // Manual trigger to update weather immediately
     void updateNow();
@@ -98,15 +154,29 @@ public:
     int getHumidity() const { return humidity; }    // Added getter for humidity
     String getDescription() const { return weatherDescription; }
     String getIcon() const { return weatherIcon; }
+    uint8_t getCondition() const { return condition; }
+    const ForecastBuffer<FORECAST_CAPACITY>& getForecast() const { return forecast; }
     String getLastUpdateTime() const;
     
     // Getters for settings
     String getApiKey() const { return apiKey; }
     float getLatitude() const { return latitude; }
     float getLongitude() const { return longitude; }
+    String getApiBaseUrl() const { return apiBaseUrl; }
     
     // Get API call count
-    static unsigned long getApiCallCount() { return apiCallCount; }
+    static unsigned long getApiCallCount() { return apiCallCount.get(); }
+    
+    // Getters for parse memory statistics
+    size_t getLastParsePeakBytes() const { return lastParsePeakBytes; }
+    uint32_t getLastFetchHeapUsed() const { return lastFetchHeapUsed; }
+    
+    // Getters for cache statistics
+    unsigned long getCacheHits() const { return cacheHits.get(); }
+    unsigned long getCacheMisses() const { return cacheMisses.get(); }
+    
+    // Get the circuit breaker state
+    const CircuitBreaker& getBreaker() const { return breaker; }
 };
 
 #endif // WEATHER_H
\ No newline at end of file
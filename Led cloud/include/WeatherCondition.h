@@ -0,0 +1,53 @@
+#ifndef WEATHER_CONDITION_H
+#define WEATHER_CONDITION_H
+
+#include <stdint.h>
+
+/**
+ * @brief Compact weather condition code shared by the weather service and LED patterns
+ *
+ * Collapses the OpenWeatherMap condition ids (https://openweathermap.org/weather-conditions)
+ * into one byte so readings and forecast samples don't need description/icon strings.
+ */
+enum WeatherCondition : uint8_t {
+    WEATHER_UNKNOWN = 0,
+    WEATHER_CLEAR = 1,
+    WEATHER_CLOUDS = 2,
+    WEATHER_DRIZZLE = 3,
+    WEATHER_RAIN = 4,
+    WEATHER_THUNDERSTORM = 5,
+    WEATHER_SNOW = 6,
+    WEATHER_MIST = 7     // Mist, fog, haze, dust and other 7xx atmosphere codes
+};
+
+/**
+ * @brief Map an OpenWeatherMap condition id to a WeatherCondition
+ */
+inline WeatherCondition weatherConditionFromId(int id) {
+    if (id >= 200 && id < 300) return WEATHER_THUNDERSTORM;
+    if (id >= 300 && id < 400) return WEATHER_DRIZZLE;
+    if (id >= 500 && id < 600) return WEATHER_RAIN;
+    if (id >= 600 && id < 700) return WEATHER_SNOW;
+    if (id >= 700 && id < 800) return WEATHER_MIST;
+    if (id == 800) return WEATHER_CLEAR;
+    if (id > 800 && id < 900) return WEATHER_CLOUDS;
+    return WEATHER_UNKNOWN;
+}
+
+/**
+ * @brief Short lowercase name of a condition, for JSON output
+ */
+inline const char* weatherConditionName(uint8_t condition) {
+    switch (condition) {
+        case WEATHER_CLEAR: return "clear";
+        case WEATHER_CLOUDS: return "clouds";
+        case WEATHER_DRIZZLE: return "drizzle";
+        case WEATHER_RAIN: return "rain";
+        case WEATHER_THUNDERSTORM: return "thunderstorm";
+        case WEATHER_SNOW: return "snow";
+        case WEATHER_MIST: return "mist";
+        default: return "unknown";
+    }
+}
+
+#endif // WEATHER_CONDITION_H
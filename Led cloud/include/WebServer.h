@@ -9,6 +9,10 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "Weather.h"
+#include "Scheduler.h"
+#include "Metrics.h"
+#include "History.h"
+#include "HttpApi.h"
 
 /**
  * @class WebServer
@@ -16,8 +20,10 @@
  * 
  * This class encapsulates all web server functionality including
  * setting up routes, handling API requests, and serving static files.
+ * The dashboard routes are handled by DashboardApi, with WebServer as
+ * the ApiDevice behind them.
  */
-class WebServer {
+class WebServer : public ApiDevice {
 private:
     AsyncWebServer server;
     
@@ -29,11 +35,26 @@ private:
     // Weather instance
     Weather* weatherService;
     
+    // Task scheduler (for /tasks statistics)
+    const Scheduler* scheduler;
+    
+    // System health history (for /system-history)
+    const SystemHistory* systemHistory;
+    
+    // Handlers for the routes the dashboard polls and posts to
+    DashboardApi dashboard;
+    
+    // Per-route request counters (for /metrics)
+    static const uint8_t MAX_ROUTES = 32;
+    Counter routeRequests[MAX_ROUTES + 1];
+    uint8_t routeCount;
+    bool routesCounted;     // Counters already registered with Metrics
+    
     /**
-     * @brief Initialize the LittleFS file system
-     * @return true if successful, false otherwise
+     * @brief Register a request counter for a route
+     * @return Counter to increment from the route's handler
      */
-    bool initFileSystem();
+    Counter* countRoute(const char* handler);
     
     /**
      * @brief Handle requests that were not found (404 error)
@@ -79,6 +100,18 @@ public:
      */
     void setupRoutes();
     
+    /**
+     * @brief Register the routes again after the server was lent out (e.g. to the WiFi portal)
+     *
+     * Call only while RequestTracker::getActive() is 0.
+     */
+    void restoreRoutes();
+    
+    /**
+     * @brief The application's server, shared with the WiFi configuration portal
+     */
+    AsyncWebServer* getServer() { return &server; }
+    
     /**
      * @brief Update the physical LED based on current state and brightness
      */
@@ -97,6 +130,29 @@ public:
      * @param weather Pointer to the Weather instance
      */
     void setWeatherService(Weather* weather);
+    
+    /**
+     * @brief Set the scheduler whose task statistics are served on /tasks
+     * @param taskScheduler Pointer to the Scheduler
+     */
+    void setScheduler(const Scheduler* taskScheduler);
+    
+    /**
+     * @brief Set the system history served on /system-history
+     * @param history Pointer to the SystemHistory
+     */
+    void setSystemHistory(const SystemHistory* history);
+    
+    // ApiDevice: what DashboardApi reads and changes
+    SystemInfo getSystemInfo() override;
+    bool getWeather(JsonDocument& doc) override;
+    int getPixelBrightness() override;
+    int getPattern() override;
+    uint32_t getPixelColor(int index) override;
+    void setAllPixels(int r, int g, int b) override;
+    void setPixel(int index, int r, int g, int b) override;
+    void setPattern(int pattern) override;
+    void setPixelBrightness(int value) override;
 };
 
 #endif // WEBSERVER_H
\ No newline at end of file
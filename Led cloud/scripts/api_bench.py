@@ -0,0 +1,122 @@
+"""Compare JSON and MessagePack responses of the device's API.
+
+Every JSON endpoint answers in MessagePack when the request carries
+Accept: application/msgpack. This fetches a few endpoints in both formats
+and reports, per route and format, the body size, the round trip time and
+the device's own serialization time (the X-Serialize-Us header). The
+MessagePack bodies are decoded and checked to have the same fields as the
+JSON ones.
+
+    python scripts/api_bench.py http://ledcloud.local
+    python scripts/api_bench.py http://ledcloud.local -n 50 /sync /tasks
+"""
+import argparse
+import json
+import statistics
+import struct
+import time
+import urllib.request
+
+ROUTES = ["/neopixel/status", "/weather", "/system-info"]
+FORMATS = [("json", "application/json"), ("msgpack", "application/msgpack")]
+
+
+def unpack(data, pos=0):
+    """Decode one MessagePack value at pos; returns (value, next position)."""
+    b = data[pos]
+    pos += 1
+    if b <= 0x7F:
+        return b, pos
+    if b >= 0xE0:
+        return b - 0x100, pos
+    if 0x80 <= b <= 0x8F:
+        return unpack_map(data, pos, b & 0x0F)
+    if 0x90 <= b <= 0x9F:
+        return unpack_array(data, pos, b & 0x0F)
+    if 0xA0 <= b <= 0xBF:
+        return data[pos:pos + (b & 0x1F)].decode(), pos + (b & 0x1F)
+    fixed = {0xC0: None, 0xC2: False, 0xC3: True}
+    if b in fixed:
+        return fixed[b], pos
+    scalars = {0xCA: ">f", 0xCB: ">d", 0xCC: ">B", 0xCD: ">H", 0xCE: ">I", 0xCF: ">Q",
+               0xD0: ">b", 0xD1: ">h", 0xD2: ">i", 0xD3: ">q"}
+    if b in scalars:
+        size = struct.calcsize(scalars[b])
+        return struct.unpack_from(scalars[b], data, pos)[0], pos + size
+    lengths = {0xD9: ">B", 0xDA: ">H", 0xDB: ">I", 0xDC: ">H", 0xDD: ">I", 0xDE: ">H", 0xDF: ">I"}
+    if b in lengths:
+        n = struct.unpack_from(lengths[b], data, pos)[0]
+        pos += struct.calcsize(lengths[b])
+        if b <= 0xDB:
+            return data[pos:pos + n].decode(), pos + n
+        return (unpack_array if b <= 0xDD else unpack_map)(data, pos, n)
+    raise ValueError(f"unsupported MessagePack type 0x{b:02x} at byte {pos - 1}")
+
+
+def unpack_array(data, pos, n):
+    items = []
+    for _ in range(n):
+        item, pos = unpack(data, pos)
+        items.append(item)
+    return items, pos
+
+
+def unpack_map(data, pos, n):
+    items = {}
+    for _ in range(n):
+        key, pos = unpack(data, pos)
+        items[key], pos = unpack(data, pos)
+    return items, pos
+
+
+def fetch(url, accept):
+    request = urllib.request.Request(url, headers={"Accept": accept})
+    started = time.perf_counter()
+    with urllib.request.urlopen(request, timeout=10) as response:
+        body = response.read()
+        elapsed = (time.perf_counter() - started) * 1000
+        serialize = response.headers.get("X-Serialize-Us")
+        return body, response.headers.get("Content-Type", ""), elapsed, int(serialize) if serialize else None
+
+
+def shape(value):
+    """Field names and nesting, without the values (which change between requests)."""
+    if isinstance(value, dict):
+        return {key: shape(item) for key, item in value.items()}
+    if isinstance(value, list):
+        return [shape(value[0])] if value else []
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", help="device base URL, e.g. http://ledcloud.local")
+    parser.add_argument("routes", nargs="*", default=ROUTES, help=f"routes to compare (default {' '.join(ROUTES)})")
+    parser.add_argument("-n", type=int, default=20, help="requests per route and format")
+    args = parser.parse_args()
+    base = args.url.rstrip("/")
+
+    print(f"{'route':<20} {'format':<8} {'bytes':>6} {'p50 ms':>8} {'p90 ms':>8} {'serialize us':>13}")
+    for route in args.routes:
+        decoded = {}
+        for name, accept in FORMATS:
+            sizes, times, serialize = [], [], []
+            for _ in range(args.n):
+                body, content_type, elapsed, serialize_us = fetch(base + route, accept)
+                if not content_type.startswith(accept):
+                    raise SystemExit(f"{route}: asked for {accept}, got {content_type}")
+                sizes.append(len(body))
+                times.append(elapsed)
+                if serialize_us is not None:
+                    serialize.append(serialize_us)
+            decoded[name] = json.loads(body) if name == "json" else unpack(body)[0]
+            times.sort()
+            print(f"{route:<20} {name:<8} {statistics.median(sizes):>6.0f} {statistics.median(times):>8.1f} "
+                  f"{times[int(len(times) * 0.9) - 1]:>8.1f} "
+                  f"{statistics.median(serialize) if serialize else float('nan'):>13.0f}")
+        if shape(decoded["json"]) != shape(decoded["msgpack"]):
+            raise SystemExit(f"{route}: MessagePack and JSON responses have different fields")
+
+
+if __name__ == "__main__":
+    main()
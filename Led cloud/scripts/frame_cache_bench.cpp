@@ -0,0 +1,176 @@
+// Host benchmark for the frame cache: plays chase, fade and color wipe the way
+// NeoPixel::update() does, once rendering every frame and once through
+// FrameCache. Reports ns per frame for the pattern's part of the frame:
+// rendering it, and replaying it once the cycle is cached. Then the hit rate
+// over the given number of cycles from an empty cache (the first cycle is
+// all misses), and the frames and bytes the cycle takes in the cache. The
+// dim pass every output frame pays on top is printed for scale.
+//
+// Every replayed frame is also compared with a fresh render, in order and
+// again with every third frame skipped and the position lost every 50 frames
+// (output ticks that fall behind, writes from the web API). Any difference
+// is reported and the benchmark exits 1.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/frame_cache_bench.cpp -o frame_cache_bench
+//     ./frame_cache_bench [cycles]
+
+#include "FrameBuffer.h"
+#include "FrameCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const uint8_t BRIGHTNESS = 100;   // DEFAULT_BRIGHTNESS; dimmed output goes through a stack copy
+const uint32_t FADE_FRAMES = 5120 / NEOPIXEL_OUTPUT_INTERVAL;
+
+volatile uint8_t sink;
+int failures = 0;
+
+uint32_t color(uint8_t r, uint8_t g, uint8_t b)
+{
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+// The periodic pattern kernels from NeoPixel.cpp, drawing frame f
+template <typename Buffer>
+struct Patterns {
+    Buffer& pixels;
+
+    explicit Patterns(Buffer& pixels) : pixels(pixels) {}
+
+    void chase(uint32_t f) {
+        pixels.clear();
+        int chasePosition = f % Buffer::PIXELS;
+        for (int i = 0; i < 3; i++) {
+            pixels.set((chasePosition + i) % Buffer::PIXELS, 0, 0, 255 - (i * 60));
+        }
+    }
+
+    void fade(uint32_t f) {
+        int phase = f % FADE_FRAMES;
+        int value = (phase <= (int)FADE_FRAMES / 2 ? phase : FADE_FRAMES - phase) * 510 / FADE_FRAMES;
+        pixels.fill(color(value, 0, value));
+    }
+
+    void wipe(uint32_t f) {
+        static const uint32_t wipeColors[] = {color(255, 0, 0),   color(0, 255, 0),   color(0, 0, 255),
+                                              color(255, 255, 0), color(0, 255, 255), color(255, 0, 255)};
+        size_t wipePosition = f % Buffer::PIXELS;
+        uint32_t c = wipeColors[(f / Buffer::PIXELS) % 6];
+        for (size_t i = 0; i < Buffer::PIXELS; i++) {
+            pixels.setColor(i, i <= wipePosition ? c : 0);
+        }
+    }
+};
+
+// Best of three runs
+template <typename Frame>
+double nsPerFrame(uint32_t frames, Frame frame)
+{
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t f = 0; f < frames; f++) {
+            frame(f);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+        best = run == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+template <size_t Count>
+void run(uint32_t cycles)
+{
+    typedef FrameBuffer<Count, OrderGRB> Buffer;
+    typedef FrameCache<Buffer, FRAME_CACHE_BYTES, FRAME_CACHE_FRAMES> Cache;
+    std::unique_ptr<Buffer> pixelsBuffer(new Buffer()), scratchBuffer(new Buffer()), checkBuffer(new Buffer());
+    Buffer& pixels = *pixelsBuffer;
+    Buffer& scratch = *scratchBuffer;
+    Patterns<Buffer> patterns(pixels);
+    Patterns<Buffer> reference(*checkBuffer);
+    std::unique_ptr<Cache> cache(new Cache());
+    std::vector<uint8_t> out(Buffer::BYTES);
+
+    typedef void (Patterns<Buffer>::*Render)(uint32_t);
+    struct Row {
+        const char* name;
+        Render render;
+        uint32_t period;
+    } rows[] = {
+        {"chase", &Patterns<Buffer>::chase, Count},
+        {"fade", &Patterns<Buffer>::fade, FADE_FRAMES},
+        {"color wipe", &Patterns<Buffer>::wipe, Count * 6},
+    };
+
+    printf("%zu pixels, cache %d bytes + %d frames, %zu bytes of RAM (ns per frame over %u cycles)\n", Count,
+           FRAME_CACHE_BYTES, FRAME_CACHE_FRAMES, sizeof(Cache), (unsigned)cycles);
+    printf("  %-11s %7s %10s %10s %7s %9s %7s %7s\n", "pattern", "period", "render", "replay", "saved", "hit rate",
+           "frames", "bytes");
+    for (const Row& row : rows) {
+        uint32_t frames = row.period * cycles;
+        // Starts a third of the way into the cycle, as when the pattern is picked mid-animation
+        uint32_t first = row.period / 3;
+        double rendered = nsPerFrame(frames, [&](uint32_t f) {
+            (patterns.*row.render)(first + f);
+            sink = pixels.data()[0];
+        });
+
+        // From empty, counting hits; after that the cache holds what fits and replays it
+        cache->reset();
+        uint32_t hits = 0;
+        for (uint32_t f = 0; f < frames; f++) {
+            hits += cache->seek(first + f, row.period, pixels, scratch,
+                                [&](uint32_t frame) { (patterns.*row.render)(frame); });
+        }
+        double cached = nsPerFrame(frames, [&](uint32_t f) {
+            cache->seek(first + f, row.period, pixels, scratch, [&](uint32_t frame) { (patterns.*row.render)(frame); });
+            sink = pixels.data()[0];
+        });
+        printf("  %-11s %7u %10.0f %10.0f %6.0f%% %8.1f%% %7zu %7zu\n", row.name, (unsigned)row.period, rendered,
+               cached, 100 * (1 - cached / rendered), 100.0 * hits / frames, cache->getFrames(), cache->getBytes());
+
+        // Replayed frames must be exactly what the pattern renders
+        uint32_t mismatches = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            cache->reset();
+            for (uint32_t f = 0; f < frames; f++) {
+                if (pass == 1 && f % 3 == 2) {
+                    continue;
+                }
+                if (pass == 1 && f % 50 == 0) {
+                    pixels.fill(color(1, 2, 3));
+                    cache->lose();
+                }
+                cache->seek(first + f, row.period, pixels, scratch,
+                            [&](uint32_t frame) { (patterns.*row.render)(frame); });
+                (reference.*row.render)(first + f);
+                mismatches += memcmp(pixels.data(), checkBuffer->data(), Buffer::BYTES) != 0;
+            }
+        }
+        if (mismatches) {
+            printf("  %-11s FAIL: %u replayed frames differ from the pattern\n", row.name, (unsigned)mismatches);
+            failures++;
+        }
+    }
+    double dim = nsPerFrame(Count * cycles, [&](uint32_t) {
+        pixels.writeScaled(out.data(), BRIGHTNESS);
+        sink = out[0];
+    });
+    printf("  dim pass into the output copy: %.0f ns per frame\n", dim);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t cycles = argc > 1 ? atoi(argv[1]) : 3;
+    run<NEOPIXEL_COUNT>(cycles);
+    run<600>(cycles);
+    return failures ? 1 : 0;
+}
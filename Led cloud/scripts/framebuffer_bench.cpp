@@ -0,0 +1,168 @@
+// Host benchmark for FrameBuffer: the same per-frame kernels on the
+// compile-time specialised buffer, on GenericFrameBuffer (size and colour
+// order chosen at run time), and on the previous layout (a uint32_t colour
+// array copied pixel by pixel into the strip with Adafruit_NeoPixel's
+// setPixelColor() logic). Reports ns per frame for the configured strip and
+// a ten times longer one, and the RAM each layout keeps per strip.
+//
+// The firmware sends FrameBuffer's bytes to the strip directly at full
+// brightness and through a stack copy when dimmed ("show" rows); the old
+// layout copied every pixel with setPixelColor() on every frame either way.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/framebuffer_bench.cpp -o framebuffer_bench
+//     ./framebuffer_bench [frames]
+
+#include "FrameBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+volatile uint8_t sink;
+
+// Previous layout: packed colours plus the strip's own byte buffer, written
+// through setPixelColor() with brightness applied per pixel
+class LegacyStrip {
+public:
+    LegacyStrip(size_t count, uint8_t neoType, uint8_t brightness)
+        : colors(count), out(count * 3), rOffset((neoType >> 4) & 3), gOffset((neoType >> 2) & 3),
+          bOffset(neoType & 3), brightness((uint8_t)(brightness + 1)) {}
+
+    // Lives in Adafruit_NeoPixel.cpp, so it is a real call per pixel on the device
+    __attribute__((noinline)) void setPixelColor(size_t n, uint32_t c) {
+        uint8_t r = (uint8_t)(c >> 16), g = (uint8_t)(c >> 8), b = (uint8_t)c;
+        if (brightness) {
+            r = (r * brightness) >> 8;
+            g = (g * brightness) >> 8;
+            b = (b * brightness) >> 8;
+        }
+        uint8_t* p = &out[n * 3];
+        p[rOffset] = r;
+        p[gOffset] = g;
+        p[bOffset] = b;
+    }
+
+    void fill(uint32_t color) {
+        for (size_t i = 0; i < colors.size(); i++) {
+            colors[i] = color;
+        }
+    }
+
+    void load(const uint8_t (*rgb)[3]) {
+        for (size_t i = 0; i < colors.size(); i++) {
+            colors[i] = ((uint32_t)rgb[i][0] << 16) | ((uint32_t)rgb[i][1] << 8) | rgb[i][2];
+        }
+    }
+
+    // The twinkle decay as it was written: unpack, scale by 95/100, repack
+    void fade() {
+        for (size_t i = 0; i < colors.size(); i++) {
+            uint8_t r = (colors[i] >> 16) & 0xFF, g = (colors[i] >> 8) & 0xFF, b = colors[i] & 0xFF;
+            r = (r * 95) / 100;
+            g = (g * 95) / 100;
+            b = (b * 95) / 100;
+            colors[i] = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+        }
+    }
+
+    void show() {
+        for (size_t i = 0; i < colors.size(); i++) {
+            setPixelColor(i, colors[i]);
+        }
+        sink = out[0];
+    }
+
+private:
+    std::vector<uint32_t> colors;
+    std::vector<uint8_t> out;
+    uint8_t rOffset, gOffset, bOffset;
+    uint8_t brightness;    // Stored plus one, as Adafruit_NeoPixel does; 0 means full
+};
+
+// Best of five runs, to keep scheduler noise out of figures this small
+template <typename Kernel>
+double nsPerFrame(int frames, Kernel kernel)
+{
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            kernel(f);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+        best = run == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+template <size_t Count>
+void run(int frames)
+{
+    const uint8_t brightness = 50;
+    std::vector<uint8_t> rgbBytes(Count * 3);
+    for (size_t k = 0; k < rgbBytes.size(); k++) {
+        rgbBytes[k] = (uint8_t)(k * 37);
+    }
+    const uint8_t (*rgb)[3] = reinterpret_cast<const uint8_t (*)[3]>(rgbBytes.data());
+    std::vector<uint8_t> out(Count * 3);
+
+    std::unique_ptr<FrameBuffer<Count, OrderGRB>> fixedBuffer(new FrameBuffer<Count, OrderGRB>());
+    FrameBuffer<Count, OrderGRB>& fixed = *fixedBuffer;
+    GenericFrameBuffer generic(Count, OrderGRB::NEO_TYPE);
+    LegacyStrip legacy(Count, OrderGRB::NEO_TYPE, brightness);
+    LegacyStrip legacyFull(Count, OrderGRB::NEO_TYPE, 255);
+
+    // Each row renders a frame with one kernel and sends it, as a pattern update does
+    struct Row {
+        const char* name;
+        double fixed, generic, legacy;
+    } rows[] = {
+        {"fill + show",
+         nsPerFrame(frames, [&](int f) { fixed.fill(f); fixed.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int f) { generic.fill(f); generic.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int f) { legacy.fill(f); legacy.show(); })},
+        {"load + show",
+         nsPerFrame(frames, [&](int) { fixed.load(rgb); fixed.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { generic.load(rgb); generic.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { legacy.load(rgb); legacy.show(); })},
+        {"fade + show",
+         nsPerFrame(frames, [&](int) { fixed.fade(243); fixed.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { generic.fade(243); generic.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { legacy.fade(); legacy.show(); })},
+        {"show dimmed",
+         nsPerFrame(frames, [&](int) { fixed.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { generic.writeScaled(out.data(), brightness); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { legacy.show(); })},
+        {"show full",
+         nsPerFrame(frames, [&](int) { sink = fixed.data()[0]; }),
+         nsPerFrame(frames, [&](int) { generic.writeScaled(out.data(), 255); sink = out[0]; }),
+         nsPerFrame(frames, [&](int) { legacyFull.show(); })},
+    };
+
+    printf("%zu pixels, GRB, %d frames (ns per frame)\n", Count, frames);
+    printf("  %-12s %10s %10s %10s %9s\n", "kernel", "template", "generic", "legacy", "speedup");
+    for (const Row& row : rows) {
+        if (row.fixed < 2) {
+            printf("  %-12s %10s %10.0f %10.0f %9s\n", row.name, "no copy", row.generic, row.legacy, "-");
+        } else {
+            printf("  %-12s %10.0f %10.0f %10.0f %8.1fx\n", row.name, row.fixed, row.generic, row.legacy,
+                   row.legacy / row.fixed);
+        }
+    }
+    printf("  RAM kept: template %zu bytes (plus %zu on the stack while a dimmed frame is sent),\n"
+           "            legacy %zu bytes (uint32_t colours + strip buffer)\n",
+           sizeof(fixed), sizeof(fixed), Count * sizeof(uint32_t) + Count * 3);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 100000;
+    run<NEOPIXEL_COUNT>(frames);
+    run<NEOPIXEL_COUNT * 10>(frames / 10);
+    return 0;
+}
@@ -0,0 +1,420 @@
+// Host load generator for the dashboard routes.
+//
+// Drives DashboardApi (src/HttpApi.cpp, the same handlers the device runs)
+// with replayed dashboard traffic and reports, per route and response
+// format, p50/p99 handler latency and heap allocations per request. The
+// device side is a stand-in with a real FrameBuffer for the strip.
+//
+// The traffic is a fixed-seed replay of a group of dashboards and
+// controllers:
+//   - each dashboard polls /neopixel/status every second, /system-info every
+//     5 s and /weather every minute; a quarter of them ask for MessagePack
+//   - every 30 s a controller updates the group: setPattern, setBrightness
+//     and setAll back to back, and every third update paints the strip
+//     pixel by pixel with setPixel
+//
+// The replay runs several times and each route reports its best p50 and p99,
+// which keeps scheduler noise out of the numbers. As a regression gate, save
+// a baseline once and compare later runs to it; the run fails if a route
+// makes more allocations per request than before, or its p99 grows by more
+// than the tolerance (and by at least a microsecond):
+//
+//     g++ -std=gnu++17 -O2 -Iinclude -I.pio/libdeps/esp12e/ArduinoJson/src scripts/http_loadgen.cpp src/HttpApi.cpp -o http_loadgen
+//     ./http_loadgen --save loadgen.baseline
+//     ./http_loadgen --baseline loadgen.baseline [--tolerance 0.25]
+//
+// Allocations are counted by wrapping malloc, which needs glibc (Linux).
+
+#include "HttpApi.h"
+#include "FrameBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+namespace {
+
+bool counting = false;
+size_t allocations = 0;
+size_t allocatedBytes = 0;
+
+void countAllocation(size_t size)
+{
+    if (counting) {
+        allocations++;
+        allocatedBytes += size;
+    }
+}
+
+} // namespace
+
+extern "C" void* malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+uint32_t apiClockUs()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+// Built before the handler runs, so none of its storage is counted
+class HostRequest : public ApiRequest {
+public:
+    HostRequest(const char* accept, const char* contentType, const std::string& body)
+        : accept(accept), contentType(contentType), body(body) {}
+
+    const char* getParam(const char*) const override { return nullptr; }
+    const char* getHeader(const char* name) const override { return strcmp(name, "Accept") == 0 ? accept : nullptr; }
+    const char* getContentType() const override { return contentType; }
+    const uint8_t* getBody() const override { return reinterpret_cast<const uint8_t*>(body.data()); }
+    size_t getBodyLength() const override { return body.size(); }
+
+private:
+    const char* accept;
+    const char* contentType;
+    std::string body;
+};
+
+// Fixed buffer, like the TCP send buffer the response goes into on the device
+class HostResponse : public ApiResponse {
+public:
+    HostResponse() : code(0), length(0), complete(false) {}
+
+    void begin(int status, const char*) override
+    {
+        code = status;
+        length = 0;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override
+    {
+        size_t n = std::min(size, sizeof(body) - length);
+        memcpy(body + length, data, n);
+        length += n;
+        return n;
+    }
+
+    void addHeader(const char*, const char*) override {}
+    void end() override { complete = true; }
+
+    int code;
+    uint8_t body[2048];
+    size_t length;
+    bool complete;
+};
+
+class HostDevice : public ApiDevice {
+public:
+    HostDevice() : brightness(128), pattern(0), uptime(0) { pixels.clear(); }
+
+    SystemInfo getSystemInfo() override
+    {
+        SystemInfo info;
+        info.freeHeap = 31234;
+        info.heapFragmentation = 12;
+        info.wifiSignal = -63;
+        info.ledState = true;
+        info.brightness = 128;
+        info.uptime = uptime++;
+        return info;
+    }
+
+    // Same fields as Weather::getWeather()
+    bool getWeather(JsonDocument& doc) override
+    {
+        doc["temperature"] = 12.34f;
+        doc["humidity"] = 81;
+        doc["description"] = "light rain";
+        doc["icon"] = "10d";
+        doc["condition"] = "rain";
+        doc["lastUpdate"] = "5 minutes ago";
+        doc["apiCallCount"] = 123;
+        doc["parsePeakBytes"] = 1234;
+        doc["responseBytes"] = 512;
+        doc["fetchHeapUsed"] = 2048;
+        doc["cacheHits"] = 3;
+        doc["cacheMisses"] = 1;
+        JsonObject breaker = doc["breaker"].to<JsonObject>();
+        breaker["state"] = "closed";
+        breaker["consecutiveFailures"] = 0;
+        breaker["totalFailures"] = 2;
+        breaker["openCount"] = 0;
+        breaker["retryInMs"] = 0;
+        return true;
+    }
+
+    int getPixelBrightness() override { return brightness; }
+    int getPattern() override { return pattern; }
+    uint32_t getPixelColor(int index) override { return pixels.get(index); }
+    void setAllPixels(int r, int g, int b) override { pixels.fill(((uint32_t)r << 16) | ((uint32_t)g << 8) | b); }
+
+    void setPixel(int index, int r, int g, int b) override
+    {
+        if (index >= 0 && index < NEOPIXEL_COUNT) {
+            pixels.set(index, r, g, b);
+        }
+    }
+
+    void setPattern(int value) override { pattern = value; }
+    void setPixelBrightness(int value) override { brightness = value; }
+
+private:
+    FrameBuffer<NEOPIXEL_COUNT, NEOPIXEL_ORDER> pixels;
+    int brightness;
+    int pattern;
+    uint32_t uptime;
+};
+
+typedef void (DashboardApi::*Handler)(ApiRequest&, ApiResponse&);
+
+struct Call {
+    double at;              // Seconds into the replay
+    std::string route;      // Report label
+    Handler handler;
+    bool msgPack;
+    std::string body;       // JSON body for POSTs
+};
+
+struct RouteStats {
+    std::vector<double> latencyUs;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t failures = 0;
+};
+
+// One route over all runs
+struct RouteResult {
+    size_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double allocations = 0;     // Per request; the same every run
+    double bytes = 0;
+    size_t failures = 0;
+};
+
+std::vector<Call> buildTraffic(int dashboards, int seconds, std::mt19937& random)
+{
+    std::vector<Call> calls;
+    for (int d = 0; d < dashboards; d++) {
+        bool msgPack = d % 4 == 3;
+        const char* suffix = msgPack ? " (msgpack)" : "";
+        double phase = (random() % 1000) / 1000.0;  // Dashboards are not in step
+        for (int t = 0; t < seconds; t++) {
+            calls.push_back({t + phase, std::string("GET /neopixel/status") + suffix, &DashboardApi::pixelStatus, msgPack, ""});
+            if (t % 5 == 0) {
+                calls.push_back({t + phase + 0.01, std::string("GET /system-info") + suffix, &DashboardApi::systemInfo, msgPack, ""});
+            }
+            if (t % 60 == 0) {
+                calls.push_back({t + phase + 0.02, std::string("GET /weather") + suffix, &DashboardApi::weather, msgPack, ""});
+            }
+        }
+    }
+
+    char body[96];
+    for (int t = 0, update = 0; t < seconds; t += 30, update++) {
+        snprintf(body, sizeof(body), "{\"pattern\":%u}", (unsigned)(random() % 8));
+        calls.push_back({t + 0.5, "POST /neopixel/setPattern", &DashboardApi::setPattern, false, body});
+        snprintf(body, sizeof(body), "{\"brightness\":%u}", (unsigned)(random() % 256));
+        calls.push_back({t + 0.501, "POST /neopixel/setBrightness", &DashboardApi::setPixelBrightness, false, body});
+        snprintf(body, sizeof(body), "{\"r\":%u,\"g\":%u,\"b\":%u}", (unsigned)(random() % 256),
+                 (unsigned)(random() % 256), (unsigned)(random() % 256));
+        calls.push_back({t + 0.502, "POST /neopixel/setAll", &DashboardApi::setAllPixels, false, body});
+        if (update % 3 == 0) {
+            for (int i = 0; i < NEOPIXEL_COUNT; i++) {
+                snprintf(body, sizeof(body), "{\"index\":%d,\"r\":%u,\"g\":%u,\"b\":%u}", i, (unsigned)(random() % 256),
+                         (unsigned)(random() % 256), (unsigned)(random() % 256));
+                calls.push_back({t + 0.6 + i * 0.001, "POST /neopixel/setPixel", &DashboardApi::setPixel, false, body});
+            }
+        }
+    }
+
+    std::stable_sort(calls.begin(), calls.end(), [](const Call& a, const Call& b) { return a.at < b.at; });
+    return calls;
+}
+
+double percentile(std::vector<double>& values, double p)
+{
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+struct Baseline {
+    double p50;
+    double p99;
+    double allocations;
+};
+
+std::map<std::string, Baseline> readBaseline(const char* path)
+{
+    std::map<std::string, Baseline> baseline;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(2);
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char* tab = strchr(line, '\t');
+        Baseline entry;
+        if (!tab || sscanf(tab + 1, "%lf %lf %lf", &entry.p50, &entry.p99, &entry.allocations) != 3) {
+            continue;
+        }
+        baseline[std::string(line, tab)] = entry;
+    }
+    fclose(file);
+    return baseline;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int dashboards = 8;
+    int seconds = 600;
+    int runs = 5;
+    double tolerance = 0.25;
+    const char* savePath = nullptr;
+    const char* baselinePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dashboards") == 0 && i + 1 < argc) {
+            dashboards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--dashboards n] [--seconds n] [--runs n] [--save file] [--baseline file] [--tolerance x]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937 random(2024);
+    std::vector<Call> calls = buildTraffic(dashboards, seconds, random);
+    HostDevice device;
+    DashboardApi api(device);
+    std::map<std::string, RouteResult> results;
+
+    for (int run = 0; run < runs; run++) {
+        std::map<std::string, RouteStats> stats;
+        for (const Call& call : calls) {
+            HostRequest request(call.msgPack ? "application/msgpack" : "application/json", "application/json", call.body);
+            HostResponse response;
+            RouteStats& route = stats[call.route];
+
+            allocations = 0;
+            allocatedBytes = 0;
+            counting = true;
+            auto start = std::chrono::steady_clock::now();
+            (api.*call.handler)(request, response);
+            auto end = std::chrono::steady_clock::now();
+            counting = false;
+
+            route.latencyUs.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            route.allocations += allocations;
+            route.bytes += allocatedBytes;
+            if (!response.complete || response.code != 200) {
+                route.failures++;
+            }
+        }
+
+        for (auto& entry : stats) {
+            RouteStats& route = entry.second;
+            RouteResult& result = results[entry.first];
+            double p50 = percentile(route.latencyUs, 0.50);
+            double p99 = percentile(route.latencyUs, 0.99);
+            result.p50 = run == 0 || p50 < result.p50 ? p50 : result.p50;
+            result.p99 = run == 0 || p99 < result.p99 ? p99 : result.p99;
+            result.count = route.latencyUs.size();
+            result.allocations = (double)route.allocations / result.count;
+            result.bytes = (double)route.bytes / result.count;
+            result.failures += route.failures;
+        }
+    }
+
+    std::map<std::string, Baseline> baseline;
+    if (baselinePath) {
+        baseline = readBaseline(baselinePath);
+    }
+    FILE* save = savePath ? fopen(savePath, "w") : nullptr;
+    if (savePath && !save) {
+        perror(savePath);
+        return 2;
+    }
+
+    printf("%zu requests from %d dashboards over %d s, best of %d runs\n", calls.size(), dashboards, seconds, runs);
+    printf("%-32s %7s %9s %9s %8s %9s\n", "route", "count", "p50 us", "p99 us", "allocs", "bytes");
+    bool regressed = false;
+    for (auto& entry : results) {
+        const RouteResult& route = entry.second;
+        printf("%-32s %7zu %9.2f %9.2f %8.1f %9.0f", entry.first.c_str(), route.count, route.p50, route.p99,
+               route.allocations, route.bytes);
+        if (route.failures) {
+            printf("  %zu failed", route.failures);
+            regressed = true;
+        }
+
+        auto previous = baseline.find(entry.first);
+        if (previous != baseline.end()) {
+            if (route.allocations > previous->second.allocations + 0.05) {
+                printf("  allocations up from %.1f", previous->second.allocations);
+                regressed = true;
+            }
+            if (route.p99 > previous->second.p99 * (1 + tolerance) && route.p99 - previous->second.p99 >= 1.0) {
+                printf("  p99 up from %.2f", previous->second.p99);
+                regressed = true;
+            }
+        }
+        printf("\n");
+        if (save) {
+            fprintf(save, "%s\t%.3f %.3f %.3f\n", entry.first.c_str(), route.p50, route.p99, route.allocations);
+        }
+    }
+    if (save) {
+        fclose(save);
+    }
+    if (regressed) {
+        fprintf(stderr, "regression against %s\n", baselinePath ? baselinePath : "expected 200 responses");
+        return 1;
+    }
+    return 0;
+}
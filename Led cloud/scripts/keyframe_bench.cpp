@@ -0,0 +1,195 @@
+// Host benchmark for keyframe interpolation: runs the smooth patterns the way
+// NeoPixel::update() does at NEOPIXEL_OUTPUT_INTERVAL, once rendering every
+// output frame and once rendering a keyframe every fourth frame and blending
+// the three in between (FrameBuffer::writeBlended()). Reports, per pattern,
+// ns per output frame either way and the share of render time saved. The
+// patterns where the blend costs more than rendering are the ones
+// patternTiming in NeoPixel.cpp renders every output frame.
+//
+// The program rows run two PixelVM programs built into the benchmark, a
+// moving rainbow and the ocean waves example from scripts/pixelvm_compile.py.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/keyframe_bench.cpp src/PixelVM.cpp -o keyframe_bench
+//     ./keyframe_bench [frames]
+
+#include "FrameBuffer.h"
+#include "PixelVM.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int KEYFRAME_EVERY = 4;     // Output frames per keyframe, as patternTiming has it
+const uint8_t BRIGHTNESS = 100;   // DEFAULT_BRIGHTNESS; dimmed output goes through a stack copy
+
+// palette(rainbow, pos - t * 0.2)
+const uint8_t RAINBOW_PROGRAM[] = {0x50, 0x58, 0x56, 0x31, 0x02, 0x03, 0x00, 0x33,
+                                   0x33, 0x00, 0x00, 0x0c, 0x0b, 0x1a, 0x00};
+
+// w = sin(pos * 2 - t * 0.25) * 0.5 + 0.5
+// palette(ocean, w + noise(i * 0.3 + t) * 0.2)
+const uint8_t WAVES_PROGRAM[] = {0x50, 0x58, 0x56, 0x31, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x0c,
+                                 0x03, 0x00, 0x00, 0x40, 0x00, 0x00, 0x0c, 0x0b, 0x18, 0x00, 0x00,
+                                 0x80, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x80, 0x00, 0x00, 0x0a, 0x06,
+                                 0x00, 0x05, 0x00, 0x01, 0x00, 0xcd, 0x4c, 0x00, 0x00, 0x0c, 0x03,
+                                 0x0a, 0x19, 0x00, 0x33, 0x33, 0x00, 0x00, 0x0c, 0x0a, 0x1a, 0x02};
+
+volatile uint8_t sink;
+
+// Arduino's random(lo, hi)
+long randomRange(long lo, long hi)
+{
+    return lo + rand() % (hi - lo);
+}
+
+// The pattern kernels from NeoPixel.cpp, drawing into the buffer for animation time t;
+// interval is the time since the previous render
+template <typename Buffer>
+struct Patterns {
+    Buffer& pixels;
+    PixelVM vm;
+    std::vector<uint8_t> rgbBytes;
+    uint32_t lastTwinkle = 0;
+
+    explicit Patterns(Buffer& pixels) : pixels(pixels), rgbBytes(Buffer::PIXELS * 3) {}
+
+    void fade(uint32_t t, uint32_t) {
+        const int frames = 5120 / NEOPIXEL_OUTPUT_INTERVAL;
+        int phase = t / NEOPIXEL_OUTPUT_INTERVAL % frames;
+        int value = (phase <= frames / 2 ? phase : frames - phase) * 510 / frames;
+        pixels.fill(((uint32_t)value << 16) | value);
+    }
+
+    // 95% per 50 ms, whatever the interval
+    void twinkle(uint32_t t, uint32_t interval) {
+        pixels.fade((uint16_t)lround(256 * pow(0.95, interval / 50.0)));
+        if (t - lastTwinkle > (uint32_t)randomRange(20, 150)) {
+            lastTwinkle = t;
+            int count = randomRange(1, 4);
+            for (int i = 0; i < count; i++) {
+                uint8_t level = randomRange(180, 255);
+                pixels.set(rand() % Buffer::PIXELS, level, level, level);
+            }
+        }
+    }
+
+    void fire(uint32_t, uint32_t) {
+        for (size_t i = 0; i < Buffer::PIXELS; i++) {
+            int flicker = randomRange(80, 150);
+            uint8_t r = flicker, g = flicker * 0.4, b = flicker * 0.1;
+            if (rand() % 100 < 30) {
+                r = std::min(255, r + (int)randomRange(30, 80));
+                g = std::min(255, g + (int)randomRange(20, 50));
+            }
+            pixels.set(i, r, g, b);
+        }
+    }
+
+    void program(uint32_t t, uint32_t) {
+        uint8_t (*rgb)[3] = reinterpret_cast<uint8_t (*)[3]>(rgbBytes.data());
+        int rendered = vm.render(t, rgb, Buffer::PIXELS, UINT32_MAX);
+        for (int i = 0; i < rendered; i++) {
+            pixels.set(i, rgb[i][0], rgb[i][1], rgb[i][2]);
+        }
+    }
+};
+
+// Best of three runs of the given number of output frames
+template <typename Frame>
+double nsPerFrame(int frames, Frame frame)
+{
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            frame(f);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+        best = run == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+template <size_t Count>
+void run(int frames)
+{
+    typedef FrameBuffer<Count, OrderGRB> Buffer;
+    std::unique_ptr<Buffer> pixelsBuffer(new Buffer()), keyframeBuffer(new Buffer());
+    Buffer& pixels = *pixelsBuffer;
+    Buffer& keyframe = *keyframeBuffer;
+    Patterns<Buffer> patterns(pixels);
+    std::vector<uint8_t> out(Buffer::BYTES);
+
+    typedef void (Patterns<Buffer>::*Render)(uint32_t, uint32_t);
+
+    // Every output frame: render, then dim into the stack copy and send
+    auto everyFrame = [&](Render render) {
+        return nsPerFrame(frames, [&](int f) {
+            (patterns.*render)(f * NEOPIXEL_OUTPUT_INTERVAL, NEOPIXEL_OUTPUT_INTERVAL);
+            pixels.writeScaled(out.data(), BRIGHTNESS);
+            sink = out[0];
+        });
+    };
+    // Keyframes: keep the last one, render the next, blend the output frames in between
+    auto keyframes = [&](Render render) {
+        return nsPerFrame(frames, [&](int f) {
+            int phase = f % KEYFRAME_EVERY;
+            if (phase == 0) {
+                keyframe = pixels;
+                (patterns.*render)(f * NEOPIXEL_OUTPUT_INTERVAL, KEYFRAME_EVERY * NEOPIXEL_OUTPUT_INTERVAL);
+            }
+            pixels.writeBlended(out.data(), keyframe, phase * 256 / KEYFRAME_EVERY, BRIGHTNESS);
+            sink = out[0];
+        });
+    };
+
+    struct Row {
+        const char* name;
+        Render render;
+        const uint8_t* program;
+        size_t programLength;
+    } rows[] = {
+        {"fade", &Patterns<Buffer>::fade, nullptr, 0},
+        {"twinkle", &Patterns<Buffer>::twinkle, nullptr, 0},
+        {"fire", &Patterns<Buffer>::fire, nullptr, 0},
+        {"program rainbow", &Patterns<Buffer>::program, RAINBOW_PROGRAM, sizeof(RAINBOW_PROGRAM)},
+        {"program waves", &Patterns<Buffer>::program, WAVES_PROGRAM, sizeof(WAVES_PROGRAM)},
+    };
+
+    printf("%zu pixels, output every %d ms, keyframe every %d ms (ns per output frame)\n", Count,
+           NEOPIXEL_OUTPUT_INTERVAL, KEYFRAME_EVERY * NEOPIXEL_OUTPUT_INTERVAL);
+    printf("  %-16s %12s %12s %8s\n", "pattern", "every frame", "keyframes", "saved");
+    for (const Row& row : rows) {
+        if (row.program && patterns.vm.load(row.program, row.programLength)) {
+            printf("  %-16s program rejected\n", row.name);
+            continue;
+        }
+        double full = everyFrame(row.render);
+        double keyed = keyframes(row.render);
+        printf("  %-16s %12.0f %12.0f %7.0f%%\n", row.name, full, keyed, 100 * (1 - keyed / full));
+    }
+    double blendOnly = nsPerFrame(frames, [&](int f) {
+        pixels.writeBlended(out.data(), keyframe, f & 0xFF, BRIGHTNESS);
+        sink = out[0];
+    });
+    double dimOnly = nsPerFrame(frames, [&](int) {
+        pixels.writeScaled(out.data(), BRIGHTNESS);
+        sink = out[0];
+    });
+    printf("  in-between frame: blend + dim %.0f ns, dim alone %.0f ns; keyframe RAM %zu bytes\n", blendOnly, dimOnly,
+           sizeof(keyframe));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    run<NEOPIXEL_COUNT>(frames);
+    run<600>(frames / 10);
+    return 0;
+}
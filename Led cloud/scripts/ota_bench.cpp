@@ -0,0 +1,160 @@
+// Host test and benchmark for the OTA decompressor and sector writer.
+//
+// Feeds a packed image (scripts/ota_pack.py) through OtaImageWriter into a
+// RAM stand-in for flash, in TCP-sized chunks, and reports throughput in
+// KB/s of compressed input and of image written. Then it replays the upload
+// with connections dropped at random points, resuming each time from the
+// last commit point with a fresh writer as the device would after a
+// reboot, and checks that the flash contents match the image byte for byte.
+//
+//     python scripts/ota_pack.py firmware.bin -o firmware.ota.gz
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/ota_bench.cpp src/OtaUpdate.cpp -o ota_bench
+//     ./ota_bench firmware.ota.gz firmware.bin [drops]
+
+#include "OtaUpdate.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// NOR flash: erase sets a sector to 0xFF, writes can only clear bits
+class RamFlash : public FlashRegion {
+public:
+    explicit RamFlash(size_t size) : bytes(size, 0), erases(0) {}
+
+    bool eraseSector(uint32_t offset) override {
+        if (offset % OTA_SECTOR_SIZE || offset + OTA_SECTOR_SIZE > bytes.size()) {
+            return false;
+        }
+        memset(&bytes[offset], 0xFF, OTA_SECTOR_SIZE);
+        erases++;
+        return true;
+    }
+
+    bool write(uint32_t offset, const uint8_t* data, size_t size) override {
+        if (offset + size > bytes.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            bytes[offset + i] &= data[i];
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> bytes;
+    uint32_t erases;
+};
+
+std::vector<uint8_t> readFile(const char* path)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return data;
+}
+
+bool matches(const RamFlash& flash, const std::vector<uint8_t>& image)
+{
+    return memcmp(flash.bytes.data(), image.data(), image.size()) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s image.ota.gz image.bin [drops]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> packed = readFile(argv[1]);
+    std::vector<uint8_t> image = readFile(argv[2]);
+    int drops = argc > 3 ? atoi(argv[3]) : 20;
+    const size_t CHUNK = 1460;  // One TCP segment, the size AsyncWebServer hands body data over in
+    const size_t flashSize = (image.size() + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    uint8_t magic = image[0];
+
+    // Throughput: whole uploads, best of several runs
+    double best = 0;
+    int runs = 0;
+    RamFlash flash(flashSize);
+    OtaImageWriter* writer = new OtaImageWriter(flash);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    do {
+        writer->begin(image.size(), magic);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < packed.size(); offset += CHUNK) {
+            size_t length = packed.size() - offset < CHUNK ? packed.size() - offset : CHUNK;
+            const char* error = writer->write(&packed[offset], length);
+            if (error) {
+                fprintf(stderr, "failed at input byte %u: %s\n", (unsigned)writer->getInputOffset(), error);
+                return 1;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = runs == 0 || seconds < best ? seconds : best;
+        runs++;
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    if (!writer->isComplete() || !matches(flash, image)) {
+        fprintf(stderr, "flash contents do not match the image\n");
+        return 1;
+    }
+    printf("%zu bytes packed -> %zu bytes image (%.0f%%), %u sectors, RAM %zu bytes for the writer\n",
+           packed.size(), image.size(), 100.0 * packed.size() / image.size(), (unsigned)writer->getSectorsWritten(),
+           sizeof(OtaImageWriter));
+    printf("best of %d runs: %.1f ms, %.0f KB/s compressed in, %.0f KB/s written\n", runs, best * 1000,
+           packed.size() / 1024.0 / best, image.size() / 1024.0 / best);
+    delete writer;
+
+    // Interrupted uploads: drop the connection at random points, resume from the last commit
+    std::mt19937 random(12345);
+    RamFlash resumed(flashSize);
+    memset(resumed.bytes.data(), 0x5A, resumed.bytes.size());  // Stale contents from some earlier upload
+    uint32_t committedInput = 0;
+    uint32_t committedOutput = 0;
+    uint32_t sent = 0;
+    int attempts = 0;
+    bool complete = false;
+    while (!complete) {
+        OtaImageWriter session(resumed);  // Fresh state each time, as after a reboot
+        if (const char* error = session.begin(image.size(), magic, committedInput, committedOutput)) {
+            fprintf(stderr, "resume rejected: %s\n", error);
+            return 1;
+        }
+        size_t stop = attempts < drops ? committedInput + random() % (packed.size() - committedInput + 1) : packed.size();
+        for (size_t offset = committedInput; offset < stop;) {
+            size_t length = 1 + random() % CHUNK;
+            length = stop - offset < length ? stop - offset : length;
+            if (const char* error = session.write(&packed[offset], length)) {
+                fprintf(stderr, "failed at input byte %u: %s\n", (unsigned)session.getInputOffset(), error);
+                return 1;
+            }
+            offset += length;
+            sent += length;
+        }
+        committedInput = session.getCommittedInput();
+        committedOutput = session.getCommittedOutput();
+        complete = session.isComplete();
+        attempts++;
+    }
+    if (!matches(resumed, image)) {
+        fprintf(stderr, "resumed flash contents do not match the image\n");
+        return 1;
+    }
+    printf("%d uploads with %d dropped connections: image intact, %u bytes sent (%.0f%% of the packed size)\n",
+           attempts, attempts - 1, (unsigned)sent, 100.0 * sent / packed.size());
+    return 0;
+}
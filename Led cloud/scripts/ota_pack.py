@@ -0,0 +1,134 @@
+"""Pack a firmware image for the /ota endpoint, and optionally upload it.
+
+The image is cut into segments (a multiple of the 4 KB flash sector) and
+each one is compressed as its own gzip member with a 4 KB window. The
+result is an ordinary gzip file (gunzip gives back the image) that the
+device inflates with one sector of RAM, writing a flash sector at a time.
+Every segment boundary is a point an interrupted upload resumes from.
+
+    python scripts/ota_pack.py .pio/build/esp12e/firmware.bin -o firmware.ota.gz
+    python scripts/ota_pack.py .pio/build/esp12e/firmware.bin --upload http://cloudled.local --token SECRET
+
+The upload first has the device prepare for the image (POST /ota/prepare),
+which answers where the last upload of the same image got to and erases
+the flash from there on. Once GET /ota reports "ready" it sends the rest,
+and on a dropped connection waits and does the same again. The device only
+accepts uploads that carry its OTA_TOKEN (--token, or the
+LEDCLOUD_OTA_TOKEN environment variable). Along with the packed file's CRC,
+which identifies the upload to resume, it gets the CRC of the image itself;
+once the image is in, the device reads it back and checks it against that
+before restarting, and the script waits to hear how that went.
+"""
+import argparse
+import json
+import os
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+SECTOR_SIZE = 4096
+WINDOW_BITS = 12        # 4 KB window, the device's OTA_SECTOR_SIZE
+
+
+def pack(image, segment):
+    packed = bytearray()
+    for start in range(0, len(image), segment):
+        compressor = zlib.compressobj(9, zlib.DEFLATED, 16 + WINDOW_BITS, 9)
+        packed += compressor.compress(image[start:start + segment]) + compressor.flush()
+    return bytes(packed)
+
+
+def request(url, data=None, timeout=30, token=None):
+    headers = {"Content-Type": "application/octet-stream"} if data is not None else {}
+    if token:
+        headers["X-OTA-Token"] = token
+    req = urllib.request.Request(url, data=data, headers=headers, method="POST" if data is not None else "GET")
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as response:
+            return response.status, json.loads(response.read().decode())
+    except urllib.error.HTTPError as error:
+        return error.code, json.loads(error.read().decode() or "{}")
+
+
+def wait_while(base, states, timeout=120):
+    """Poll GET /ota until the device leaves the given states; returns its status"""
+    deadline = time.time() + timeout
+    while True:
+        _, status = request(f"{base}/ota")
+        if status.get("state") not in states or time.time() > deadline:
+            return status
+        time.sleep(0.5)
+
+
+def upload(base, image, packed, token, retries):
+    query = f"size={len(image)}&crc={zlib.crc32(packed)}&imageCrc={zlib.crc32(image)}"
+    for attempt in range(retries + 1):
+        try:
+            code, prepared = request(f"{base}/ota/prepare?{query}", b"", token=token)
+            if code != 202:
+                sys.exit(f"upload refused ({code}): {prepared.get('error')}")
+            offset = prepared.get("resumeOffset", 0)
+            if offset:
+                print(f"resuming at {offset} of {len(packed)} bytes")
+            status = wait_while(base, ("erasing",))
+            if status.get("state") != "ready":
+                sys.exit(f"device did not get ready ({status.get('state')}): {status.get('lastError')}")
+            started = time.time()
+            code, result = request(f"{base}/ota?{query}&offset={offset}", packed[offset:], timeout=120, token=token)
+            if code != 200:
+                sys.exit(f"upload rejected ({code}): {result.get('error')}")
+            seconds = max(time.time() - started, 1e-3)
+            print(f"sent {len(packed) - offset} bytes in {seconds:.1f} s ({(len(packed) - offset) / 1024 / seconds:.1f} KB/s)")
+            if result.get("complete"):
+                print("image written, device is checking it")
+                break
+        except (urllib.error.URLError, ConnectionError, TimeoutError, OSError) as error:
+            print(f"upload interrupted ({error}), retrying ({attempt + 1}/{retries})")
+            time.sleep(3)
+    else:
+        sys.exit("giving up; run again to resume")
+
+    try:
+        status = wait_while(base, ("verifying",))
+    except (urllib.error.URLError, ConnectionError, TimeoutError, OSError):
+        print("device stopped answering; it is most likely restarting into the new image")
+        return
+    if status.get("state") != "restarting":
+        sys.exit(f"device rejected the image: {status.get('lastError')}")
+    print("image checked, device is restarting")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="firmware .bin")
+    parser.add_argument("-o", "--output", help="write the packed image here")
+    parser.add_argument("--segment", type=int, default=16384,
+                        help="bytes per gzip member and resume point, a multiple of 4096 (default 16384)")
+    parser.add_argument("--upload", metavar="URL", help="device base URL to upload to, e.g. http://cloudled.local")
+    parser.add_argument("--token", default=os.environ.get("LEDCLOUD_OTA_TOKEN"),
+                        help="the device's OTA_TOKEN (default: $LEDCLOUD_OTA_TOKEN)")
+    parser.add_argument("--retries", type=int, default=10, help="reconnect attempts before giving up")
+    args = parser.parse_args()
+
+    if args.segment <= 0 or args.segment % SECTOR_SIZE:
+        sys.exit(f"--segment must be a multiple of {SECTOR_SIZE}")
+    image = open(args.image, "rb").read()
+    if not image or image[0] != 0xE9:
+        sys.exit(f"{args.image} is not an ESP8266 firmware image")
+
+    packed = pack(image, args.segment)
+    print(f"{len(image)} bytes -> {len(packed)} bytes ({100 * len(packed) / len(image):.0f}%), "
+          f"{(len(image) + args.segment - 1) // args.segment} segments")
+    if args.output:
+        with open(args.output, "wb") as out:
+            out.write(packed)
+    if args.upload:
+        if not args.token:
+            sys.exit("--upload needs the device's OTA_TOKEN (--token or LEDCLOUD_OTA_TOKEN)")
+        upload(args.upload.rstrip("/"), image, packed, args.token, args.retries)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+// Host benchmark for the PixelVM interpreter: renders frames of a compiled
+// program and reports pixels per second. The device reports the same figure
+// for the running program on GET /neopixel/program.
+//
+//     python scripts/pixelvm_compile.py waves.pxs -o waves.pxv
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/pixelvm_bench.cpp src/PixelVM.cpp -o pixelvm_bench
+//     ./pixelvm_bench waves.pxv [pixels] [frames]
+
+#include "PixelVM.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s program.pxv [pixels] [frames]\n", argv[0]);
+        return 2;
+    }
+    int pixels = argc > 2 ? atoi(argv[2]) : NEOPIXEL_COUNT;
+    int frames = argc > 3 ? atoi(argv[3]) : 2000;
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    uint8_t program[4 + VM_MAX_PROGRAM + 1];
+    size_t length = fread(program, 1, sizeof(program), file);
+    fclose(file);
+
+    PixelVM vm;
+    const char* error = vm.load(program, length);
+    if (error)
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+
+    std::vector<uint8_t> frame(pixels * 3);
+    uint8_t (*rgb)[3] = reinterpret_cast<uint8_t (*)[3]>(frame.data());
+    uint64_t rendered = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        rendered += vm.render(f * 50, rgb, pixels, UINT32_MAX);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu bytes, %u instructions per pixel\n", vm.getCodeLength(), vm.getInstructionCount());
+    printf("%llu pixels in %.3f s: %.0f pixels/s, %.1f M instructions/s\n", (unsigned long long)rendered, seconds,
+           rendered / seconds, rendered * vm.getInstructionCount() / seconds / 1e6);
+    printf("frame budget of %u instructions covers %u pixels\n", VM_FRAME_BUDGET,
+           VM_FRAME_BUDGET / vm.getInstructionCount());
+    printf("last frame, first pixels:");
+    for (int i = 0; i < pixels && i < 4; i++)
+    {
+        printf(" #%02x%02x%02x", rgb[i][0], rgb[i][1], rgb[i][2]);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+"""Compiler for PixelVM pixel programs.
+
+A program is evaluated once per pixel and frame. It is a few assignments
+followed by one colour statement:
+
+    # Slow ocean waves
+    w = sin(pos * 2 - t * 0.25) * 0.5 + 0.5
+    palette(ocean, w + noise(i * 0.3 + t) * 0.2)
+
+Inputs:      i (pixel index), pos (0..1 along the strip), t (seconds), n (pixel count)
+Operators:   + - * / %  < >  unary -  parentheses
+Functions:   sin(x) cos(x) (x in turns: 1.0 = full circle), abs frac floor clamp noise,
+             min(a, b) max(a, b) select(c, a, b) (a if c > 0, else b)
+Colour:      rgb(r, g, b) with each channel 0..1, or palette(rainbow|fire|ocean|forest, x)
+             (the palette repeats every 1.0)
+
+Values are 16.16 fixed point, so stay within +-32767. Up to 8 variables.
+
+    python scripts/pixelvm_compile.py waves.pxs -o waves.pxv
+    python scripts/pixelvm_compile.py waves.pxs --upload http://ledcloud.local
+"""
+import argparse
+import re
+import struct
+import sys
+import urllib.request
+
+MAGIC = b"PXV1"
+MAX_PROGRAM = 256
+STACK_DEPTH = 16
+REGISTERS = 8
+
+# Must match enum PixelOp in include/PixelVM.h
+OPS = ["PUSH", "INDEX", "POS", "TIME", "COUNT", "LOAD", "STORE", "DUP", "SWAP", "POP",
+       "ADD", "SUB", "MUL", "DIV", "MOD", "NEG", "ABS", "MIN", "MAX", "FRAC", "FLOOR",
+       "CLAMP", "LT", "SELECT", "SIN", "NOISE", "PALETTE"]
+OP = {name: code for code, name in enumerate(OPS)}
+
+INPUTS = {"i": "INDEX", "pos": "POS", "t": "TIME", "n": "COUNT"}
+UNARY = {"abs": "ABS", "frac": "FRAC", "floor": "FLOOR", "clamp": "CLAMP", "noise": "NOISE", "sin": "SIN"}
+BINARY = {"min": "MIN", "max": "MAX"}
+PALETTES = {"rainbow": 0, "fire": 1, "ocean": 2, "forest": 3}
+
+TOKEN = re.compile(r"\s*(?:(\d+\.\d*|\.\d+|\d+)|([A-Za-z_]\w*)|(.))")
+
+
+class CompileError(Exception):
+    pass
+
+
+class Parser:
+    def __init__(self, text, variables, line):
+        self.tokens = []
+        for number, name, symbol in TOKEN.findall(text):
+            if number:
+                self.tokens.append(("num", float(number)))
+            elif name:
+                self.tokens.append(("name", name))
+            elif symbol.strip():
+                self.tokens.append(("sym", symbol))
+        self.pos = 0
+        self.variables = variables
+        self.line = line
+        self.code = bytearray()
+
+    def error(self, message):
+        raise CompileError(f"line {self.line}: {message}")
+
+    def peek(self):
+        return self.tokens[self.pos] if self.pos < len(self.tokens) else (None, None)
+
+    def take(self, kind=None, value=None):
+        token = self.peek()
+        if token[0] is None or (kind and token[0] != kind) or (value and token[1] != value):
+            self.error(f"expected {value or kind}, found {token[1]!r}")
+        self.pos += 1
+        return token
+
+    def emit(self, name, operand=b""):
+        self.code += bytes([OP[name]]) + operand
+
+    def done(self):
+        if self.pos != len(self.tokens):
+            self.error(f"unexpected {self.peek()[1]!r}")
+
+    # expr := sum (('<' | '>') sum)?
+    def expr(self):
+        self.sum()
+        kind, value = self.peek()
+        if kind == "sym" and value in "<>":
+            self.take()
+            if value == "<":
+                self.sum()
+            else:
+                # a > b is b < a: evaluate b, then swap it under a
+                self.sum()
+                self.emit("SWAP")
+            self.emit("LT")
+
+    def sum(self):
+        self.product()
+        while self.peek() in (("sym", "+"), ("sym", "-")):
+            symbol = self.take()[1]
+            self.product()
+            self.emit("ADD" if symbol == "+" else "SUB")
+
+    def product(self):
+        self.unary()
+        while self.peek() in (("sym", "*"), ("sym", "/"), ("sym", "%")):
+            symbol = self.take()[1]
+            self.unary()
+            self.emit({"*": "MUL", "/": "DIV", "%": "MOD"}[symbol])
+
+    def unary(self):
+        if self.peek() == ("sym", "-"):
+            self.take()
+            self.unary()
+            self.emit("NEG")
+        else:
+            self.atom()
+
+    def args(self, count):
+        self.take("sym", "(")
+        for k in range(count):
+            if k:
+                self.take("sym", ",")
+            self.expr()
+        self.take("sym", ")")
+
+    def atom(self):
+        kind, value = self.peek()
+        if kind == "num":
+            self.take()
+            if abs(value) >= 32768:
+                self.error(f"{value} is out of range")
+            self.emit("PUSH", struct.pack("<i", round(value * 65536)))
+        elif kind == "sym" and value == "(":
+            self.take()
+            self.expr()
+            self.take("sym", ")")
+        elif kind == "name":
+            self.take()
+            if value in INPUTS:
+                self.emit(INPUTS[value])
+            elif value in self.variables:
+                self.emit("LOAD", bytes([self.variables[value]]))
+            elif value in UNARY:
+                self.args(1)
+                self.emit(UNARY[value])
+            elif value == "cos":
+                self.args(1)
+                self.emit("PUSH", struct.pack("<i", 16384))  # Quarter turn
+                self.emit("ADD")
+                self.emit("SIN")
+            elif value in BINARY:
+                self.args(2)
+                self.emit(BINARY[value])
+            elif value == "select":
+                self.args(3)
+                self.emit("SELECT")
+            else:
+                self.error(f"unknown name {value!r}")
+        else:
+            self.error(f"unexpected {value!r}")
+
+
+def compile_source(source):
+    variables = {}
+    code = bytearray()
+    output = None
+    for number, raw in enumerate(source.splitlines(), 1):
+        line = raw.split("#", 1)[0].strip()
+        if not line:
+            continue
+        if output is not None:
+            raise CompileError(f"line {number}: nothing may follow the colour statement")
+
+        assignment = re.match(r"([A-Za-z_]\w*)\s*=(?!=)(.*)", line)
+        if assignment:
+            name, text = assignment.groups()
+            if name in INPUTS or name in UNARY or name in BINARY or name in ("cos", "select", "rgb", "palette"):
+                raise CompileError(f"line {number}: {name!r} is reserved")
+            if name not in variables:
+                if len(variables) == REGISTERS:
+                    raise CompileError(f"line {number}: more than {REGISTERS} variables")
+                variables[name] = len(variables)
+            parser = Parser(text, variables, number)
+            parser.expr()
+            parser.done()
+            parser.emit("STORE", bytes([variables[name]]))
+            code += parser.code
+            continue
+
+        parser = Parser(line, variables, number)
+        name = parser.take("name")[1]
+        if name == "rgb":
+            parser.args(3)
+        elif name == "palette":
+            parser.take("sym", "(")
+            palette = parser.take("name")[1]
+            if palette not in PALETTES:
+                parser.error(f"unknown palette {palette!r}")
+            parser.take("sym", ",")
+            parser.expr()
+            parser.take("sym", ")")
+            parser.emit("PALETTE", bytes([PALETTES[palette]]))
+        else:
+            parser.error("expected rgb(...) or palette(...)")
+        parser.done()
+        code += parser.code
+        output = name
+
+    if output is None:
+        raise CompileError("program has no rgb(...) or palette(...) statement")
+    if len(code) > MAX_PROGRAM:
+        raise CompileError(f"program is {len(code)} bytes, the limit is {MAX_PROGRAM}")
+    return MAGIC + bytes(code)
+
+
+def stack_depth(code):
+    """Deepest evaluation stack the program reaches, mirroring PixelVM::load()."""
+    effects = {"PUSH": (0, 1, 4), "LOAD": (0, 1, 1), "STORE": (1, 0, 1), "DUP": (1, 2, 0), "SWAP": (2, 2, 0),
+               "POP": (1, 0, 0), "SELECT": (3, 1, 0), "PALETTE": (1, 3, 1)}
+    depth = deepest = pc = instructions = 0
+    while pc < len(code):
+        name = OPS[code[pc]]
+        if name in effects:
+            pops, pushes, operand = effects[name]
+        elif name in ("INDEX", "POS", "TIME", "COUNT"):
+            pops, pushes, operand = 0, 1, 0
+        elif name in ("ADD", "SUB", "MUL", "DIV", "MOD", "MIN", "MAX", "LT"):
+            pops, pushes, operand = 2, 1, 0
+        else:
+            pops, pushes, operand = 1, 1, 0
+        depth += pushes - pops
+        deepest = max(deepest, depth)
+        pc += 1 + operand
+        instructions += 1
+    return deepest, instructions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="program source, or - for stdin")
+    parser.add_argument("-o", "--output", help="write the compiled program here")
+    parser.add_argument("--upload", metavar="URL", help="device base URL to upload to, e.g. http://ledcloud.local")
+    args = parser.parse_args()
+
+    source = sys.stdin.read() if args.source == "-" else open(args.source).read()
+    try:
+        program = compile_source(source)
+    except CompileError as error:
+        sys.exit(f"{args.source}: {error}")
+
+    depth, instructions = stack_depth(program[4:])
+    if depth > STACK_DEPTH:
+        sys.exit(f"{args.source}: needs a stack of {depth}, the VM has {STACK_DEPTH}")
+    print(f"{len(program) - 4} bytes, {instructions} instructions per pixel, stack depth {depth}")
+
+    if args.output:
+        with open(args.output, "wb") as out:
+            out.write(program)
+    if args.upload:
+        request = urllib.request.Request(args.upload.rstrip("/") + "/neopixel/program", data=program,
+                                         headers={"Content-Type": "application/octet-stream"}, method="POST")
+        with urllib.request.urlopen(request, timeout=10) as response:
+            print(response.read().decode())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,231 @@
+// Host simulation of the render quality governor: replays a load profile
+// through QualityGovernor at the NeoPixel task's 16 ms tick and checks that
+// it steps down under sustained overruns, holds steady at the edge, and
+// recovers once the load is gone.
+//
+// Frame cost comes from a model of NeoPixel::update() at each level:
+// keyframe render, blend or dim pass, and the time the strip takes to clock
+// out (30 us per pixel). Phases set the keyframe render time (a light or a
+// heavy pixel program) or add WiFi activity, which stretches frames and
+// blocks the loop so ticks start late. Prints the level and overrun rate per
+// second, the level changes, and PASS/FAIL per check; exits 1 if any check
+// fails. The budget follows the pixel count as QUALITY_FRAME_BUDGET does.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/quality_sim.cpp src/QualityGovernor.cpp -o quality_sim
+//     ./quality_sim [pixels] [-q]
+
+#include "QualityGovernor.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace {
+
+const uint32_t WIRE_US_PER_PIXEL = 30;   // WS2812 at 800 kHz, 24 bits
+const uint32_t KEYFRAME_MS = 4 * NEOPIXEL_OUTPUT_INTERVAL;
+
+/**
+ * @brief Load during one phase of the profile
+ */
+struct Phase {
+    const char* name;
+    uint32_t seconds;
+    uint32_t renderUs;           // Keyframe render time of the pattern
+    uint32_t wifiPercent;        // Share of ticks delayed by WiFi work
+    uint32_t wifiBlockMs;        // How long the loop is blocked when that happens
+    uint32_t wifiStretchPercent; // Extra frame time from interrupts while WiFi is busy
+    uint32_t burstSeconds;       // WiFi is only busy for this long...
+    uint32_t burstPeriod;        // ...out of every this many seconds (0: all the time)
+};
+
+const Phase PROFILE[] = {
+    {"calm", 20, 2500, 0, 0, 0, 0, 0},
+    {"heavy program", 30, 12000, 0, 0, 0, 0, 0},
+    {"recover", 60, 2500, 0, 0, 0, 0, 0},
+    {"wifi storm", 20, 2500, 30, 40, 40, 0, 0},
+    {"recover", 60, 2500, 0, 0, 0, 0, 0},
+    {"edge", 60, 6200, 2, 20, 0, 0, 0},
+    {"recover", 60, 2500, 0, 0, 0, 0, 0},
+    {"wifi bursts", 120, 2500, 30, 40, 40, 2, 7},
+    {"recover", 60, 2500, 0, 0, 0, 0, 0},
+};
+
+/**
+ * @brief What NeoPixel::update() does on one tick at a quality level, and what it costs
+ */
+class StripModel {
+public:
+    StripModel(uint32_t pixels, std::mt19937& random) : pixels(pixels), random(random), lastOutput(0), lastKeyframe(0) {}
+
+    uint32_t tick(uint32_t nowMs, uint8_t level, const Phase& phase) {
+        if (level >= QUALITY_HALF_OUTPUT && nowMs - lastOutput < NEOPIXEL_OUTPUT_INTERVAL * 3 / 2) {
+            return 20;
+        }
+        lastOutput = nowMs;
+
+        uint32_t keyframeMs = level >= QUALITY_SLOW_KEYFRAMES ? 2 * KEYFRAME_MS : KEYFRAME_MS;
+        bool blending = level < QUALITY_NO_BLEND;
+        uint32_t passUs = pixels * 3 * (blending ? 12 : 6) / 1000;   // Blend + dim, or dim alone
+        uint32_t sendUs = pixels * WIRE_US_PER_PIXEL;
+
+        if (nowMs - lastKeyframe < keyframeMs) {
+            return blending ? passUs + sendUs : 20;
+        }
+        lastKeyframe = nowMs;
+        uint32_t renderUs = phase.renderUs * (85 + random() % 31) / 100;  // Varies by 15% either way
+        if (level >= QUALITY_HALF_PIXELS) {
+            renderUs /= 2;
+        }
+        return renderUs + passUs + sendUs;
+    }
+
+private:
+    uint32_t pixels;
+    std::mt19937& random;
+    uint32_t lastOutput;
+    uint32_t lastKeyframe;
+};
+
+struct PhaseResult {
+    uint32_t frames;
+    uint32_t overruns;
+    uint32_t tailFrames;     // Last 5 s of the phase
+    uint32_t tailOverruns;
+    uint8_t startLevel;
+    uint8_t endLevel;
+    uint8_t lowestLevel;     // Highest level number reached
+    uint32_t changes;
+    uint32_t firstChangeMs;  // From the start of the phase, 0 if none
+    uint32_t lastChangeMs;
+};
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("  %s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t pixels = NEOPIXEL_COUNT;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else {
+            pixels = atoi(argv[i]);
+        }
+    }
+
+    uint32_t budgetUs = QUALITY_FRAME_BUDGET - NEOPIXEL_COUNT * WIRE_US_PER_PIXEL + pixels * WIRE_US_PER_PIXEL;
+    QualityGovernor governor(budgetUs);
+    std::mt19937 random(1);
+    StripModel strip(pixels, random);
+    const size_t phaseCount = sizeof(PROFILE) / sizeof(PROFILE[0]);
+    PhaseResult results[phaseCount];
+
+    printf("%u pixels, budget %u us per frame, tick %d ms\n", (unsigned)pixels, (unsigned)budgetUs,
+           NEOPIXEL_OUTPUT_INTERVAL);
+    uint32_t nowMs = 0;
+    size_t transitionsSeen = 0;
+    for (size_t p = 0; p < phaseCount; p++) {
+        const Phase& phase = PROFILE[p];
+        PhaseResult& result = results[p];
+        memset(&result, 0, sizeof(result));
+        result.startLevel = result.lowestLevel = governor.getLevel();
+        uint32_t phaseStart = nowMs;
+        uint32_t secondFrames = 0, secondOverruns = 0;
+        uint64_t secondCost = 0;
+        uint32_t nextSecond = nowMs + 1000;
+
+        while (nowMs - phaseStart < phase.seconds * 1000) {
+            // The tick is due every interval; WiFi work can hold the loop past the next one
+            bool late = false;
+            nowMs += NEOPIXEL_OUTPUT_INTERVAL;
+            bool busy = phase.burstPeriod == 0 || (nowMs - phaseStart) / 1000 % phase.burstPeriod < phase.burstSeconds;
+            bool wifi = busy && phase.wifiPercent > 0 && random() % 100 < phase.wifiPercent;
+            if (wifi && phase.wifiBlockMs >= NEOPIXEL_OUTPUT_INTERVAL) {
+                nowMs += phase.wifiBlockMs;
+                late = true;
+            }
+
+            uint32_t cost = strip.tick(nowMs, governor.getLevel(), phase);
+            if (wifi) {
+                cost += cost * phase.wifiStretchPercent / 100;
+            }
+            bool overrun = late || cost > budgetUs;
+            if (governor.observe(cost, late, nowMs)) {
+                result.changes++;
+                if (result.firstChangeMs == 0) {
+                    result.firstChangeMs = nowMs - phaseStart;
+                }
+                result.lastChangeMs = nowMs - phaseStart;
+            }
+
+            result.frames++;
+            result.overruns += overrun;
+            if (nowMs - phaseStart >= (phase.seconds - 5) * 1000) {
+                result.tailFrames++;
+                result.tailOverruns += overrun;
+            }
+            if (governor.getLevel() > result.lowestLevel) {
+                result.lowestLevel = governor.getLevel();
+            }
+            secondFrames++;
+            secondOverruns += overrun;
+            secondCost += cost;
+
+            if (nowMs >= nextSecond) {
+                if (!quiet) {
+                    printf("  %6.1f s  %-14s level %u %-15s overruns %3u%%  mean %5u us\n", nowMs / 1000.0,
+                           phase.name, governor.getLevel(), qualityLevelName(governor.getLevel()),
+                           secondOverruns * 100 / secondFrames, (unsigned)(secondCost / secondFrames));
+                }
+                secondFrames = secondOverruns = 0;
+                secondCost = 0;
+                nextSecond += 1000;
+            }
+        }
+        result.endLevel = governor.getLevel();
+
+        // Level changes in this phase, from the governor's own history
+        size_t total = governor.getStepsDown() + governor.getStepsUp();
+        size_t kept = governor.getTransitionCount();
+        for (size_t i = total - transitionsSeen > kept ? 0 : kept - (total - transitionsSeen); i < kept; i++) {
+            const QualityTransition& change = governor.getTransition(i);
+            printf("  %6.1f s  %-14s %s -> %s (%u overruns, slowest %u us)\n", change.timeMs / 1000.0, phase.name,
+                   qualityLevelName(change.from), qualityLevelName(change.to), (unsigned)change.overruns,
+                   (unsigned)change.peakCostUs);
+        }
+        transitionsSeen = total;
+    }
+
+    printf("\nchecks\n");
+    const PhaseResult& calm = results[0];
+    const PhaseResult& heavy = results[1];
+    const PhaseResult& storm = results[3];
+    const PhaseResult& edge = results[5];
+    const PhaseResult& bursts = results[7];
+    check(calm.changes == 0 && calm.endLevel == QUALITY_FULL, "calm load stays at full quality");
+    check(heavy.firstChangeMs > 0 && heavy.firstChangeMs <= 2000, "heavy program steps down within 2 s");
+    check(heavy.tailOverruns * 100 < heavy.tailFrames * QUALITY_DOWN_OVERRUNS * 100 / QUALITY_WINDOW,
+          "heavy program ends below the step-down overrun rate");
+    check(results[2].endLevel == QUALITY_FULL, "full quality restored after the heavy program");
+    check(storm.lowestLevel > QUALITY_FULL, "WiFi storm lowers quality");
+    check(results[4].endLevel == QUALITY_FULL, "full quality restored after the WiFi storm");
+    check(edge.changes <= 4, "load at the edge changes level at most 4 times in 60 s");
+    check(results[6].endLevel == QUALITY_FULL, "full quality restored after the edge load");
+    check(bursts.changes <= 8 && bursts.lastChangeMs < 60000,
+          "repeated WiFi bursts settle on one level within 60 s instead of flapping");
+    check(results[8].endLevel == QUALITY_FULL, "full quality restored at the end");
+    printf("%d check(s) failed; %u steps down, %u up\n", failures, (unsigned)governor.getStepsDown(),
+           (unsigned)governor.getStepsUp());
+    return failures ? 1 : 0;
+}
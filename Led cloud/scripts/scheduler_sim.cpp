@@ -0,0 +1,152 @@
+// Host test of the loop() scheduler under a virtual clock: the scheduler's
+// microsecond clock is a variable the test moves forward, and callbacks can
+// move it too to stand for their own runtime. Checks priority order among due
+// tasks, that the 32-bit clock wrapping does not disturb deadlines, and the
+// jitter, missed-deadline and overrun counts. Prints PASS/FAIL per check and
+// exits 1 if any check fails.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/scheduler_sim.cpp src/Scheduler.cpp -o scheduler_sim
+//     ./scheduler_sim
+
+#include "Scheduler.h"
+#include <cstdio>
+#include <string>
+
+namespace {
+
+uint32_t virtualUs = 0;
+
+uint32_t virtualClock()
+{
+    return virtualUs;
+}
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("  %s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Polls runPending() every stepUs for durationUs
+void runFor(Scheduler& scheduler, uint32_t durationUs, uint32_t stepUs)
+{
+    for (uint32_t t = 0; t < durationUs; t += stepUs) {
+        virtualUs += stepUs;
+        scheduler.runPending();
+    }
+}
+
+void priorities()
+{
+    printf("priority order\n");
+    virtualUs = 1000;
+    Scheduler scheduler(virtualClock);
+    std::string order;
+    scheduler.addTask("low", [&] { order += 'L'; }, 10, 1);
+    scheduler.addTask("high", [&] { order += 'H'; }, 10, 5);
+    scheduler.addTask("mid", [&] { order += 'M'; }, 10, 3);
+    scheduler.start();
+
+    virtualUs += 9999;
+    check(scheduler.runPending() == 0 && order.empty(), "nothing runs before the first deadline");
+    virtualUs += 1;
+    check(scheduler.runPending() == 3 && order == "HML", "tasks due together run highest priority first");
+
+    // Low priority due first, high priority due later; both overdue at the same poll
+    Scheduler late(virtualClock);
+    order.clear();
+    late.addTask("early low", [&] { order += 'L'; }, 10, 1);
+    late.addTask("late high", [&] { order += 'H'; }, 12, 5);
+    late.start();
+    virtualUs += 15000;
+    late.runPending();
+    check(order == "HL", "an overdue high priority task goes before an earlier low priority one");
+    check(late.getMsUntilNext() == 5, "next deadline is the earliest one left (the low priority task's second)");
+}
+
+void clockWrap()
+{
+    printf("32-bit clock wrap\n");
+    virtualUs = UINT32_MAX - 25000;  // Wraps 25 ms in
+    Scheduler scheduler(virtualClock);
+    uint32_t runs = 0;
+    int task = scheduler.addTask("tick", [&] { runs++; }, 10, 1);
+    scheduler.start();
+
+    runFor(scheduler, 100000, 1000);
+    const Scheduler::Task& tick = scheduler.getTask(task);
+    check(runs == 10, "10 ms task runs 10 times in 100 ms across the wrap");
+    check(tick.maxJitterUs == 0, "polled every millisecond, no run starts late");
+    check(tick.missedDeadlines == 0 && tick.overruns == 0, "no missed deadlines or overruns");
+
+    // A deadline just past the wrap, read from just before it
+    virtualUs = UINT32_MAX - 2500;
+    Scheduler edge(virtualClock);
+    edge.addTask("edge", [] {}, 5, 1);
+    edge.start();
+    virtualUs += 1000;
+    check(edge.getMsUntilNext() == 4, "time to a deadline on the far side of the wrap");
+    virtualUs += 4000;  // 1.5 ms past the wrap, 5 ms after start
+    check(edge.runPending() == 1, "deadline on the far side of the wrap fires on time");
+}
+
+void missedDeadlines()
+{
+    printf("missed deadlines\n");
+    virtualUs = 0;
+    Scheduler scheduler(virtualClock);
+    uint32_t runs = 0;
+    int task = scheduler.addTask("periodic", [&] { runs++; }, 10, 1);
+    scheduler.start();
+
+    // The loop is blocked from 0 to 35 ms: one late run, two periods skipped
+    virtualUs = 35000;
+    scheduler.runPending();
+    const Scheduler::Task& periodic = scheduler.getTask(task);
+    check(runs == 1, "an overdue task runs once, not once per missed period");
+    check(periodic.missedDeadlines == 2, "the two periods that passed meanwhile count as missed");
+    check(periodic.lastJitterUs == 25000, "jitter is measured from the first missed deadline");
+    check(scheduler.getMsUntilNext() == 5, "the next deadline stays on the original 10 ms grid");
+
+    virtualUs = 40000;
+    check(scheduler.runPending() == 1 && periodic.missedDeadlines == 2, "back on time, nothing more is missed");
+}
+
+void overruns()
+{
+    printf("overruns\n");
+    virtualUs = 0;
+    Scheduler scheduler(virtualClock);
+    int slow = scheduler.addTask("slow", [] { virtualUs += 12000; }, 10, 1);
+    int fast = scheduler.addTask("fast", [] { virtualUs += 3000; }, 10, 1);
+    scheduler.start();
+
+    runFor(scheduler, 100000, 1000);
+    const Scheduler::Task& slowTask = scheduler.getTask(slow);
+    const Scheduler::Task& fastTask = scheduler.getTask(fast);
+    check(slowTask.runCount > 0 && slowTask.overruns == slowTask.runCount,
+          "a task that takes 12 ms of a 10 ms interval overruns on every run");
+    check(slowTask.maxRuntimeUs == 12000 && Scheduler::getAverageRuntimeUs(slowTask) == 12000,
+          "runtime is measured on the task's own clock");
+    check(fastTask.overruns == 0, "a 3 ms task that only starts late does not count as overrunning");
+    check(fastTask.missedDeadlines > 0, "but it misses the deadlines the slow task took");
+    printf("  slow: %u runs, %u overruns, %u missed; fast: %u runs, %u missed, max jitter %u us\n",
+           (unsigned)slowTask.runCount, (unsigned)slowTask.overruns, (unsigned)slowTask.missedDeadlines,
+           (unsigned)fastTask.runCount, (unsigned)fastTask.missedDeadlines, (unsigned)fastTask.maxJitterUs);
+}
+
+} // namespace
+
+int main()
+{
+    priorities();
+    clockWrap();
+    missedDeadlines();
+    overruns();
+    printf("%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
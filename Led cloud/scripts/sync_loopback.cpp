@@ -0,0 +1,188 @@
+// Host-native clock sync check: several ClockSync nodes exchanging real UDP
+// multicast beacons over the loopback interface.
+//
+// Each node gets its own socket and a local clock with a random offset and a
+// crystal error of up to +-50 ppm. Once a second the tool prints every node's
+// role, its animation time relative to the leader's (exact, since all nodes
+// share this process's clock) and the sync error the node itself reports.
+// Halfway through, the first leader stops, to show the takeover.
+//
+//     g++ -std=gnu++17 -Iinclude scripts/sync_loopback.cpp src/ClockSync.cpp -o sync_loopback
+//     ./sync_loopback [nodes] [seconds]
+
+#include "ClockSync.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Node {
+    ClockSync clock;
+    int socket;
+    double rate;       // Local clock speed relative to the host clock
+    double offsetUs;
+    bool running;
+
+    Node(uint32_t id, double r, double o) : clock(id), socket(-1), rate(r), offsetUs(o), running(true) {}
+    uint64_t localUs(double hostUs) const { return (uint64_t)(offsetUs + hostUs * rate); }
+};
+
+double hostUs()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration<double, std::micro>(steady_clock::now() - start).count();
+}
+
+int openSocket()
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SYNC_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        perror("bind");
+        exit(1);
+    }
+
+    ip_mreq membership = {};
+    inet_pton(AF_INET, SYNC_MULTICAST_GROUP, &membership.imr_multiaddr);
+    inet_pton(AF_INET, "127.0.0.1", &membership.imr_interface);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+    {
+        perror("IP_ADD_MEMBERSHIP");
+        exit(1);
+    }
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &membership.imr_interface, sizeof(membership.imr_interface));
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    timeval timeout = {0, 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 3;
+    int seconds = argc > 2 ? atoi(argv[2]) : 60;
+
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_real_distribution<double> ppm(-50, 50);
+    std::uniform_real_distribution<double> offset(0, 1e9);
+    std::vector<Node> nodes;
+    for (int i = 0; i < count; i++)
+    {
+        nodes.emplace_back(100 + i, 1 + ppm(rng) * 1e-6, offset(rng));
+        nodes.back().socket = openSocket();
+    }
+
+    sockaddr_in group = {};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(SYNC_PORT);
+    inet_pton(AF_INET, SYNC_MULTICAST_GROUP, &group.sin_addr);
+
+    double nextReport = 1e6;
+    bool stopped = false;
+    while (hostUs() < seconds * 1e6)
+    {
+        for (Node& node : nodes)
+        {
+            if (!node.running)
+            {
+                continue;
+            }
+
+            uint8_t packet[64];
+            ssize_t length;
+            while ((length = recv(node.socket, packet, sizeof(packet), MSG_DONTWAIT)) > 0)
+            {
+                uint64_t arrivalUs = node.localUs(hostUs());
+                SyncBeacon beacon;
+                if (beacon.decode(packet, length))
+                {
+                    node.clock.onBeacon(beacon, arrivalUs);
+                }
+            }
+
+            SyncBeacon beacon;
+            if (node.clock.poll(node.localUs(hostUs()), beacon))
+            {
+                length = beacon.encode(packet);
+                sendto(node.socket, packet, length, 0, (sockaddr*)&group, sizeof(group));
+            }
+        }
+
+        double now = hostUs();
+        if (!stopped && now >= seconds * 1e6 / 2)
+        {
+            for (Node& node : nodes)
+            {
+                if (node.clock.isLeader())
+                {
+                    node.running = false;
+                    printf("node %u (leader) stops\n", node.clock.getNodeId());
+                }
+            }
+            stopped = true;
+        }
+
+        if (now >= nextReport)
+        {
+            nextReport += 1e6;
+            const Node* leader = nullptr;
+            for (const Node& node : nodes)
+            {
+                if (node.running && node.clock.isLeader())
+                {
+                    leader = &node;
+                }
+            }
+
+            printf("t=%3.0fs", now / 1e6);
+            for (const Node& node : nodes)
+            {
+                if (!node.running)
+                {
+                    printf(" | %u stopped", node.clock.getNodeId());
+                    continue;
+                }
+                double diffUs = leader ? (double)(int64_t)(node.clock.networkTimeUs(node.localUs(now)) -
+                                                           leader->clock.networkTimeUs(leader->localUs(now)))
+                                       : 0;
+                printf(" | %u %s anim %u ms, vs leader %+.0f us, error mean %u max %u us, drift %+.1f ppm",
+                       node.clock.getNodeId(), node.clock.isLeader() ? "L" : "F",
+                       node.clock.animationTimeMs(node.localUs(now)), diffUs, node.clock.getMeanErrorUs(),
+                       node.clock.getMaxErrorUs(), node.clock.getDriftPpm());
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    for (Node& node : nodes)
+    {
+        close(node.socket);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Host test of the trace timeline: builds trace records the way TraceScope
+// does, in order of completion, and checks where TraceTimeline places them.
+// Covers nested scopes (the outer one is stored after the inner one and
+// started before it), the 32-bit cycle counter wrapping inside and between
+// scopes, and long gaps between records. Prints PASS/FAIL per check and
+// exits 1 if any check fails.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/trace_timeline_check.cpp -o trace_timeline_check
+//     ./trace_timeline_check
+
+#include "TraceTimeline.h"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("  %s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+struct Placed {
+    int64_t start;  // Relative to the first record's true start
+    int64_t end;
+};
+
+/**
+ * @brief Places records as the exporter does and shifts them so that the
+ * first one starts at firstTrueStart
+ */
+std::vector<Placed> place(const std::vector<TraceRecord>& records, int64_t firstTrueStart)
+{
+    TraceTimeline timeline;
+    std::vector<Placed> placed;
+    int64_t base = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        int64_t start = (int64_t)timeline.place(records[i]);
+        if (i == 0) {
+            base = start - firstTrueStart;
+        }
+        placed.push_back({start - base, start - base + records[i].getDurationCycles()});
+    }
+    return placed;
+}
+
+// Cycle counter value at a true (64-bit) time, as ESP.getCycleCount() reads it
+uint32_t counter(uint64_t origin, int64_t t)
+{
+    return (uint32_t)(origin + t);
+}
+
+void checkNested(uint64_t origin, const char* label)
+{
+    printf("%s\n", label);
+
+    // outer [0, 10000) encloses inner [3000, 9990), then a sibling at 20000.
+    // The inner scope ends 10 cycles before the outer one, less than one
+    // duration unit, so truncation leaves the outer's stored end before it.
+    std::vector<TraceRecord> records = {
+        TraceRecord::make(1, counter(origin, 3000), counter(origin, 9990)),
+        TraceRecord::make(0, counter(origin, 0), counter(origin, 10000)),
+        TraceRecord::make(2, counter(origin, 20000), counter(origin, 20500)),
+    };
+    std::vector<Placed> placed = place(records, 3000);
+
+    check(placed[0].start == 3000, "inner scope starts where it started");
+    check(placed[1].start == 0, "outer scope starts before the inner one, not 2^32 cycles later");
+    check(placed[1].start <= placed[0].start && placed[0].start <= placed[1].end,
+          "inner scope starts inside the outer one");
+    check(placed[0].end <= placed[1].end + (1 << TRACE_CYCLE_SHIFT),
+          "inner scope ends within one duration unit of the outer one");
+    check(placed[2].start == 20000, "next scope keeps its time after the nesting");
+}
+
+void checkDeepNesting()
+{
+    printf("three levels ending in the same cycle\n");
+
+    // All three scopes end together; each stored end is short by its own
+    // truncation, and the stored starts step back twice
+    std::vector<TraceRecord> records = {
+        TraceRecord::make(2, 5000, 6000),
+        TraceRecord::make(1, 4000, 6000),
+        TraceRecord::make(0, 1000, 6000),
+        TraceRecord::make(3, 7000, 7100),
+    };
+    std::vector<Placed> placed = place(records, 5000);
+
+    check(placed[0].start == 5000 && placed[1].start == 4000 && placed[2].start == 1000,
+          "each enclosing scope starts before the one it encloses");
+    check(placed[3].start == 7000, "following scope is not shifted");
+}
+
+void checkGap()
+{
+    printf("long gap between records\n");
+
+    // 40 s at 80 MHz between two short scopes: the counter moves forward by
+    // far more than the next record's duration and must not be read as a step
+    // back
+    uint64_t gap = 40ULL * 80000000ULL;
+    std::vector<TraceRecord> records = {
+        TraceRecord::make(0, 100, 200),
+        TraceRecord::make(1, (uint32_t)(100 + gap), (uint32_t)(100 + gap + 500)),
+    };
+    std::vector<Placed> placed = place(records, 100);
+
+    check(placed[1].start == (int64_t)(100 + gap), "record 40 s later is placed 40 s later");
+}
+
+} // namespace
+
+int main()
+{
+    checkNested(1000000, "nested scopes");
+    checkNested(0xFFFFFFFFULL - 5000, "nested scopes, counter wraps inside the inner scope");
+    checkNested(0xFFFFFFFFULL - 1500, "nested scopes, counter wraps between the outer and inner start");
+    checkDeepNesting();
+    checkGap();
+
+    printf("%d check(s) failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
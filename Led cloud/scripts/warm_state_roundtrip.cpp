@@ -0,0 +1,151 @@
+// Host test of the LED warm state: saves records through WarmStateStore into
+// a buffer standing in for ESP8266 RTC user memory, and checks that they load
+// back unchanged and that power-on garbage, a wrong magic, flipped bytes and
+// a failing read are all refused. The record sits at RTC_LED_STATE_BLOCK as on
+// the device, and saving it must leave the other blocks alone, above all the
+// bootloader's eboot command in blocks 0..RTC_EBOOT_BLOCKS-1. Prints PASS/FAIL
+// per check and exits 1 if any check fails.
+//
+//     g++ -std=gnu++17 -O2 -Iinclude scripts/warm_state_roundtrip.cpp src/WarmState.cpp -o warm_state_roundtrip
+//     ./warm_state_roundtrip
+
+#include "WarmState.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief RTC user memory as a plain buffer, with the same 4-byte block addressing
+ */
+class BufferRtcRegion : public RtcRegion {
+public:
+    uint8_t bytes[RTC_USER_MEMORY_SIZE];
+    bool failReads = false;
+
+    BufferRtcRegion() { memset(bytes, 0, sizeof(bytes)); }
+
+    bool read(uint32_t block, void* data, size_t size) override {
+        if (failReads || !fits(block, size)) {
+            return false;
+        }
+        memcpy(data, &bytes[block * 4], size);
+        return true;
+    }
+
+    bool write(uint32_t block, const void* data, size_t size) override {
+        if (!fits(block, size)) {
+            return false;
+        }
+        memcpy(&bytes[block * 4], data, size);
+        return true;
+    }
+
+private:
+    static bool fits(uint32_t block, size_t size) { return size % 4 == 0 && block * 4 + size <= RTC_USER_MEMORY_SIZE; }
+};
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("  %s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+WarmStateRecord sampleRecord()
+{
+    WarmStateRecord record;
+    memset(&record, 0, sizeof(record));
+    record.pattern = 6;
+    record.brightness = 180;
+    record.weatherCondition = 3;
+    record.phase.elapsedMs = 123456789;
+    for (int i = 0; i < NEOPIXEL_COUNT; i++) {
+        record.pixels[i][0] = i * 3;
+        record.pixels[i][1] = 255 - i;
+        record.pixels[i][2] = i * 7;
+    }
+    return record;
+}
+
+bool sameScene(const WarmStateRecord& a, const WarmStateRecord& b)
+{
+    return a.pattern == b.pattern && a.brightness == b.brightness && a.weatherCondition == b.weatherCondition &&
+           a.phase.elapsedMs == b.phase.elapsedMs && memcmp(a.pixels, b.pixels, sizeof(a.pixels)) == 0;
+}
+
+} // namespace
+
+int main()
+{
+    const size_t offset = RTC_LED_STATE_BLOCK * 4;
+    printf("record %zu bytes at RTC block %d (bytes %zu..%zu), eboot command in bytes 0..%d\n",
+           sizeof(WarmStateRecord), RTC_LED_STATE_BLOCK, offset, offset + sizeof(WarmStateRecord) - 1,
+           RTC_EBOOT_BLOCKS * 4 - 1);
+
+    BufferRtcRegion rtc;
+    WarmStateStore store(rtc, RTC_LED_STATE_BLOCK);
+    WarmStateRecord loaded;
+
+    // Power-on: RTC memory holds noise
+    for (size_t i = 0; i < sizeof(rtc.bytes); i++) {
+        rtc.bytes[i] = (uint8_t)(i * 131 + 17);
+    }
+    check(!store.load(loaded), "garbage after power-on is refused");
+
+    uint8_t before[RTC_USER_MEMORY_SIZE];
+    memcpy(before, rtc.bytes, sizeof(before));
+    WarmStateRecord saved = sampleRecord();
+    check(store.save(saved), "record is saved");
+    check(memcmp(before, rtc.bytes, offset) == 0 &&
+              memcmp(before + offset + sizeof(saved), rtc.bytes + offset + sizeof(saved),
+                     sizeof(before) - offset - sizeof(saved)) == 0,
+          "saving touches no byte outside the record's blocks");
+    check(memcmp(before, rtc.bytes, RTC_EBOOT_BLOCKS * 4) == 0 && offset >= RTC_EBOOT_BLOCKS * 4,
+          "the eboot command's blocks are left alone");
+    check(store.load(loaded) && sameScene(saved, loaded), "saved record loads back unchanged");
+
+    // Every single flipped bit in the stored record must be caught
+    uint32_t missed = 0;
+    for (size_t i = 0; i < sizeof(WarmStateRecord); i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            rtc.bytes[offset + i] ^= 1 << bit;
+            missed += store.load(loaded);
+            rtc.bytes[offset + i] ^= 1 << bit;
+        }
+    }
+    check(missed == 0, "every single-bit corruption of the stored record is refused");
+    check(store.load(loaded), "the record loads again once the bytes are restored");
+
+    // A record with a valid checksum but another magic (an older layout, say)
+    WarmStateRecord other;
+    memcpy(&other, rtc.bytes + offset, sizeof(other));
+    other.magic ^= 0x01000000;
+    other.checksum = WarmStateStore::checksum(&other, offsetof(WarmStateRecord, checksum));
+    memcpy(rtc.bytes + offset, &other, sizeof(other));
+    check(!store.load(loaded), "a wrong magic is refused even with a matching checksum");
+
+    store.save(saved);
+    memset(rtc.bytes + offset + 12, 0, 3 * 10);
+    check(!store.load(loaded), "pixels cleared by something else are refused");
+
+    store.save(saved);
+    rtc.failReads = true;
+    check(!store.load(loaded), "a failed read is refused");
+    rtc.failReads = false;
+
+    // A second save over a valid one replaces it
+    saved.pattern = 9;
+    saved.phase.elapsedMs += 1000;
+    store.save(saved);
+    check(store.load(loaded) && sameScene(saved, loaded), "a newer record replaces the old one");
+
+    // The known CRC-32 check value
+    check(WarmStateStore::checksum("123456789", 9) == 0xCBF43926, "checksum is standard CRC-32");
+
+    printf("%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+"""Local stand-in for the OpenWeatherMap API.
+
+Point the device at it by POSTing {"baseUrl": "http://<host-ip>:8080"} (plus the
+usual apiKey/latitude/longitude) to /weather-settings, then pick a failure mode
+to exercise the backoff and circuit breaker:
+
+    python scripts/weather_standin.py --mode ok
+    python scripts/weather_standin.py --mode error --fail-first 6
+
+Modes:
+    ok        valid current-weather response
+    error     HTTP 503
+    hang      accept the request and never answer (client timeout)
+    reset     close the connection without a response
+    garbage   HTTP 200 with a body that is not JSON
+    oversized HTTP 200 with a valid but very large description field
+"""
+import argparse
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+SAMPLE = {
+    "coord": {"lon": 76.3534, "lat": 9.9534},
+    "weather": [{"id": 803, "main": "Clouds", "description": "broken clouds", "icon": "04d"}],
+    "base": "stations",
+    "main": {"temp": 29.4, "feels_like": 34.1, "temp_min": 29.4, "temp_max": 29.4,
+             "pressure": 1009, "humidity": 74, "sea_level": 1009, "grnd_level": 1008},
+    "visibility": 10000,
+    "wind": {"speed": 3.6, "deg": 260},
+    "clouds": {"all": 75},
+    "dt": 1718000000,
+    "sys": {"country": "IN", "sunrise": 1717979000, "sunset": 1718024600},
+    "timezone": 19800,
+    "id": 1273874,
+    "name": "Kochi",
+    "cod": 200,
+}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.0"
+
+    def do_GET(self):
+        server = self.server
+        server.request_count += 1
+        mode = server.mode
+        if server.fail_first and server.request_count > server.fail_first:
+            mode = "ok"
+        print(f"request #{server.request_count} {self.path} -> {mode}")
+
+        if mode == "hang":
+            time.sleep(3600)
+            return
+        if mode == "reset":
+            self.close_connection = True
+            self.connection.close()
+            return
+        if mode == "error":
+            self.send_error(503, "Service Unavailable")
+            return
+
+        if mode == "garbage":
+            body = b"<html>upstream proxy error</html>"
+        elif mode == "oversized":
+            payload = dict(SAMPLE)
+            payload["weather"] = [dict(SAMPLE["weather"][0], description="x" * 4096)]
+            body = json.dumps(payload).encode()
+        else:
+            body = json.dumps(SAMPLE).encode()
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--mode", default="ok",
+                        choices=["ok", "error", "hang", "reset", "garbage", "oversized"])
+    parser.add_argument("--fail-first", type=int, default=0,
+                        help="apply --mode to the first N requests only, then answer normally")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), Handler)
+    server.mode = args.mode
+    server.fail_first = args.fail_first
+    server.request_count = 0
+    print(f"Weather stand-in on port {args.port}, mode={args.mode}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
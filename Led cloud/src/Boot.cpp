@@ -0,0 +1,52 @@
+#include "Boot.h"
+
+BootTimeline::Phase BootTimeline::phases[BOOT_PHASE_COUNT];
+
+namespace {
+
+const char* const PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "setup",
+    "scene",
+    "filesystem",
+    "settings",
+    "weatherService",
+    "webServer",
+    "wifi",
+    "clock",
+    "firstWeather",
+};
+
+} // namespace
+
+void BootTimeline::start(BootPhase phase)
+{
+    Phase& entry = phases[phase];
+    if (!entry.started)
+    {
+        entry.startUs = micros();
+        entry.started = true;
+    }
+}
+
+void BootTimeline::finish(BootPhase phase)
+{
+    Phase& entry = phases[phase];
+    if (entry.finished)
+    {
+        return;
+    }
+    uint32_t now = micros();
+    if (!entry.started)
+    {
+        entry.startUs = now;
+        entry.started = true;
+    }
+    entry.endUs = now;
+    entry.freeHeap = ESP.getFreeHeap();
+    entry.finished = true;
+}
+
+const char* BootTimeline::getName(uint8_t phase)
+{
+    return phase < BOOT_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
@@ -0,0 +1,30 @@
+#include "ChunkedExporter.h"
+#include <string.h>
+
+size_t ChunkedExporter::fill(uint8_t* out, size_t maxLen)
+{
+    size_t written = 0;
+    while (written < maxLen)
+    {
+        if (pendingOffset >= pendingLength)
+        {
+            if (done)
+            {
+                break;
+            }
+            pendingOffset = 0;
+            pendingLength = 0;
+            done = !formatNext();
+            continue;
+        }
+        size_t chunk = pendingLength - pendingOffset;
+        if (chunk > maxLen - written)
+        {
+            chunk = maxLen - written;
+        }
+        memcpy(out + written, pending + pendingOffset, chunk);
+        pendingOffset += chunk;
+        written += chunk;
+    }
+    return written;
+}
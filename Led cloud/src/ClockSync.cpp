@@ -0,0 +1,203 @@
+#include "ClockSync.h"
+
+namespace {
+
+const uint32_t BEACON_MAGIC = 0x59534C43; // "CLSY"
+const uint8_t BEACON_VERSION = 1;
+const double MAX_DRIFT = 500e-6;          // Crystal tolerance is far below this
+
+void put32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+uint32_t get32(const uint8_t* data)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value |= (uint32_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+size_t SyncBeacon::encode(uint8_t* out) const
+{
+    put32(out, BEACON_MAGIC);
+    out[4] = BEACON_VERSION;
+    out[5] = out[6] = out[7] = 0;
+    put32(out + 8, nodeId);
+    put32(out + 12, sequence);
+    put32(out + 16, (uint32_t)networkUs);
+    put32(out + 20, (uint32_t)(networkUs >> 32));
+    put32(out + 24, epochMs);
+    return SIZE;
+}
+
+bool SyncBeacon::decode(const uint8_t* data, size_t length)
+{
+    if (length < SIZE || get32(data) != BEACON_MAGIC || data[4] != BEACON_VERSION)
+    {
+        return false;
+    }
+    nodeId = get32(data + 8);
+    sequence = get32(data + 12);
+    networkUs = get32(data + 16) | ((uint64_t)get32(data + 20) << 32);
+    epochMs = get32(data + 24);
+    return true;
+}
+
+ClockSync::ClockSync(uint32_t id)
+    : nodeId(id), leaderId(UINT32_MAX), synced(false), lastBeaconUs(0), sequence(0), anchorUs(0),
+      anchorOffset(0), drift(0), epochMs(0), lastErrorUs(0), meanErrorScaled(0), maxErrorUs(0),
+      windowMaxErrorUs(0), windowCount(0), beaconsSent(0), beaconsReceived(0)
+{
+}
+
+int64_t ClockSync::modelOffset(uint64_t localUs) const
+{
+    return anchorOffset + (int64_t)(drift * (double)(int64_t)(localUs - anchorUs));
+}
+
+uint64_t ClockSync::networkTimeUs(uint64_t localUs) const
+{
+    return localUs + modelOffset(localUs);
+}
+
+uint32_t ClockSync::animationTimeMs(uint64_t localUs) const
+{
+    return (uint32_t)(networkTimeUs(localUs) / 1000) - epochMs;
+}
+
+void ClockSync::setAnimationElapsed(uint32_t elapsedMs, uint64_t localUs)
+{
+    epochMs = (uint32_t)(networkTimeUs(localUs) / 1000) - elapsedMs;
+}
+
+bool ClockSync::poll(uint64_t localUs, SyncBeacon& beacon)
+{
+    if (lastBeaconUs == 0)
+    {
+        lastBeaconUs = localUs;  // Listen for a leader before claiming the role
+    }
+
+    // Take over when the leader went quiet, or once synced to a leader with a higher id;
+    // either way the current model carries on, so network time does not jump
+    if (!isLeader() && (localUs - lastBeaconUs > (uint64_t)SYNC_LEADER_TIMEOUT * 1000 ||
+                        (synced && nodeId < leaderId)))
+    {
+        leaderId = nodeId;
+        synced = false;
+        lastBeaconUs = 0;
+        resetError();
+    }
+
+    if (!isLeader() || (lastBeaconUs != 0 && localUs - lastBeaconUs < (uint64_t)SYNC_BEACON_INTERVAL * 1000))
+    {
+        return false;
+    }
+
+    beacon.nodeId = nodeId;
+    beacon.sequence = ++sequence;
+    beacon.networkUs = networkTimeUs(localUs);
+    beacon.epochMs = epochMs;
+    lastBeaconUs = localUs;
+    beaconsSent++;
+    return true;
+}
+
+void ClockSync::onBeacon(const SyncBeacon& beacon, uint64_t localUs)
+{
+    if (beacon.nodeId == nodeId)
+    {
+        return;  // Our own multicast looped back
+    }
+    beaconsReceived++;
+
+    // Follow the lowest id; a silent leader may be replaced by anyone
+    bool leaderSilent = localUs - lastBeaconUs > (uint64_t)SYNC_LEADER_TIMEOUT * 1000;
+    if (isLeader() ? beacon.nodeId > nodeId : beacon.nodeId > leaderId && !leaderSilent)
+    {
+        return;
+    }
+    if (beacon.nodeId != leaderId)
+    {
+        leaderId = beacon.nodeId;
+        synced = false;
+        resetError();
+    }
+
+    int64_t sample = (int64_t)(beacon.networkUs - localUs);
+    if (!synced)
+    {
+        // New leader: step to its time and start estimating drift afresh
+        anchorUs = localUs;
+        anchorOffset = sample;
+        drift = 0;
+        synced = true;
+    }
+    else
+    {
+        int64_t predicted = modelOffset(localUs);
+        int64_t residual = sample - predicted;
+        recordError(residual);
+
+        if (residual > SYNC_STEP_THRESHOLD || residual < -SYNC_STEP_THRESHOLD)
+        {
+            anchorOffset = sample;
+        }
+        else
+        {
+            // Network delay only ever makes a beacon look late, so early ones are trusted more
+            double gain = residual > 0 ? 0.5 : 0.03;
+            double elapsed = (double)(int64_t)(localUs - anchorUs);
+            anchorOffset = predicted + (int64_t)(residual * gain);
+            if (elapsed > 0)
+            {
+                drift += residual * gain * 0.1 / elapsed;
+                drift = drift > MAX_DRIFT ? MAX_DRIFT : (drift < -MAX_DRIFT ? -MAX_DRIFT : drift);
+            }
+        }
+        anchorUs = localUs;
+    }
+
+    epochMs = beacon.epochMs;
+    lastBeaconUs = localUs;
+}
+
+void ClockSync::recordError(int64_t residual)
+{
+    uint32_t error = (uint32_t)(residual < 0 ? -residual : residual);
+    lastErrorUs = error;
+    meanErrorScaled += error - meanErrorScaled / 8;
+    if (error > maxErrorUs)
+    {
+        maxErrorUs = error;
+    }
+    if (++windowCount >= SYNC_ERROR_WINDOW)
+    {
+        windowMaxErrorUs = maxErrorUs;
+        maxErrorUs = 0;
+        windowCount = 0;
+    }
+}
+
+/**
+ * @brief Clears the sync error statistics when the leader changes
+ *
+ * They describe how well this node tracked the previous leader; a new leader,
+ * or this node leading, starts from no error until beacons show otherwise.
+ */
+void ClockSync::resetError()
+{
+    lastErrorUs = 0;
+    meanErrorScaled = 0;
+    maxErrorUs = 0;
+    windowMaxErrorUs = 0;
+    windowCount = 0;
+}
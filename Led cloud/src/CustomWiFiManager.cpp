@@ -1,56 +1,245 @@
 #include "CustomWiFiManager.h"
+#include "Log.h"
+#include "Boot.h"
+#include "Config.h"
 
-CustomWiFiManager::CustomWiFiManager(const char *deviceName, AsyncWebServer* asyncServer)
-    : hostname(deviceName), server(asyncServer), shouldRun(false)
+// Downtime buckets (s): brief roams, AP reboots, longer outages
+static const uint32_t DOWNTIME_BOUNDS[] = {2, 5, 15, 60, 300, 900, 3600, 14400};
+
+CustomWiFiManager::CustomWiFiManager(const char *deviceName, AsyncWebServer* sharedServer)
+    : hostname(deviceName), server(sharedServer), dns(nullptr), wifiManager(nullptr), shouldRun(false),
+      state(LINK_WAITING),
+      backoff(WIFI_PORTAL_AFTER_FAILURES > 0 ? WIFI_PORTAL_AFTER_FAILURES : 255, WIFI_BACKOFF_BASE,
+              WIFI_BACKOFF_MAX, WIFI_RETRY_COOLDOWN),
+      portalActive(false), portalClosing(false), servicesStarted(false), attemptStart(0), downSince(0), linkLost(false),
+      disconnectReason(0), linkStateGauge(LINK_WAITING),
+      downtimeSeconds(DOWNTIME_BOUNDS, sizeof(DOWNTIME_BOUNDS) / sizeof(DOWNTIME_BOUNDS[0]))
+{
+    Metrics::add("ledcloud_wifi_disconnects_total", "WiFi station links lost", disconnects);
+    Metrics::add("ledcloud_wifi_reconnects_total", "WiFi connections restored after a drop", reconnects);
+    Metrics::add("ledcloud_wifi_reconnect_failures_total", "WiFi connection attempts that timed out", reconnectFailures);
+    Metrics::add("ledcloud_wifi_portal_starts_total", "Times the configuration portal was opened", portalStarts);
+    Metrics::add("ledcloud_wifi_link_state", "WiFi link state (0 connecting, 1 connected, 2 waiting)", linkStateGauge);
+    Metrics::add("ledcloud_wifi_downtime_seconds", "Time from losing the WiFi link to reconnecting", downtimeSeconds);
+}
+
+CustomWiFiManager::~CustomWiFiManager()
+{
+    delete wifiManager;
+    delete dns;
+    // Do not delete server, as it is managed elsewhere
+}
+
+void CustomWiFiManager::checkWiFiConnection()
+{
+    unsigned long now = millis();
+    
+    // The portal's DNS server and form handling run from here too
+    if (portalActive) {
+        wifiManager->loop();
+        if (portalClosing && isConnected()) {
+            stopPortal();
+        }
+    }
+    
+    if (isConnected()) {
+        if (state != LINK_CONNECTED) {
+            onConnected(now);
+        }
+        MDNS.update();
+        return;
+    }
+    
+    // A disconnect event ends the link, or fails the current attempt without waiting for its timeout
+    bool disconnected = linkLost;
+    linkLost = false;
+    
+    if (state == LINK_CONNECTED) {
+        // Lost the link: try again straight away, then back off
+        LOG_WARN("WiFi disconnected (reason %u), reconnecting", (unsigned)disconnectReason);
+        disconnects.inc();
+        downSince = now;
+        servicesStarted = false;
+        backoff.recordSuccess(now);
+        startAttempt(now);
+        return;
+    }
+    
+    if (state == LINK_CONNECTING) {
+        if (!disconnected && now - attemptStart < WIFI_CONNECT_TIMEOUT) {
+            return;
+        }
+        reconnectFailures.inc();
+        backoff.recordFailure(now, (uint32_t)random(0x7FFFFFFF));
+        if (WIFI_PORTAL_AFTER_FAILURES > 0 && backoff.getState() == CircuitBreaker::OPEN && !portalActive) {
+            startPortal();
+        }
+        LOG_WARN("WiFi connect attempt failed (reason %u, %u in a row), retrying in %u ms",
+                 (unsigned)disconnectReason, (unsigned)backoff.getConsecutiveFailures(), (unsigned)backoff.getRetryInMs(now));
+        setState(LINK_WAITING);
+        return;
+    }
+    
+    // Waiting; without saved credentials only the portal can help
+    if (WiFi.SSID().length() > 0 && backoff.allowRequest(now)) {
+        startAttempt(now);
+    }
+}
+
+void CustomWiFiManager::startAttempt(unsigned long now)
+{
+    WiFi.begin();
+    disconnectReason = 0;
+    attemptStart = now;
+    setState(LINK_CONNECTING);
+}
+
+void CustomWiFiManager::onConnected(unsigned long now)
+{
+    if (downSince != 0) {
+        downtimeSeconds.observe((now - downSince) / 1000);
+        reconnects.inc();
+        downSince = 0;
+    }
+    backoff.recordSuccess(now);
+    setState(LINK_CONNECTED);
+    
+    if (portalActive) {
+        stopPortal();
+    }
+    if (!servicesStarted) {
+        startServices();
+    }
+}
+
+void CustomWiFiManager::startPortal()
 {
-    wifiManager = nullptr;
     if (!server) {
-        // If no server provided, create one on port 80
-        server = new AsyncWebServer(80);
+        LOG_ERROR("No web server for the configuration portal");
+        return;
     }
-    wifiManager = new AsyncWiFiManager(server, &dns);
+    // The next failed attempt tries again
+    if (RequestTracker::getActive() > 0) {
+        LOG_WARN("Configuration portal waits for %u HTTP requests", (unsigned)RequestTracker::getActive());
+        return;
+    }
+    
+    uint32_t heapBefore = ESP.getFreeHeap();
+    LOG_WARN("Opening configuration portal \"%s\"", hostname.c_str());
+    portalStarts.inc();
+    
+    // The portal takes the whole server while it is open
+    server->reset();
+    server->addHandler(new RequestTracker());
+    dns = new DNSServer();
+    wifiManager = new AsyncWiFiManager(server, dns);
+    wifiManager->startConfigPortalModeless(hostname.c_str(), nullptr);
+    portalActive = true;
+    LOG_INFO("Portal uses %d bytes of heap", (int)heapBefore - (int)ESP.getFreeHeap());
 }
 
-CustomWiFiManager::~CustomWiFiManager()
+void CustomWiFiManager::stopPortal()
 {
-    if (wifiManager) {
-        delete wifiManager;
+    // Requests in flight point into the portal's handlers; checkWiFiConnection() retries
+    if (RequestTracker::getActive() > 0) {
+        if (!portalClosing) {
+            LOG_INFO("Configuration portal closes once %u HTTP requests finish", (unsigned)RequestTracker::getActive());
+        }
+        portalClosing = true;
+        return;
+    }
+    portalClosing = false;
+    
+    uint32_t heapBefore = ESP.getFreeHeap();
+    
+    dns->stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    
+    // Drop the portal's handlers before the object they point into
+    server->reset();
+    delete wifiManager;
+    wifiManager = nullptr;
+    delete dns;
+    dns = nullptr;
+    portalActive = false;
+    
+    if (portalClosedCallback) {
+        portalClosedCallback();
     }
-    // Do not delete server, as it may be managed elsewhere
+    LOG_INFO("Configuration portal closed, %d bytes of heap freed", (int)ESP.getFreeHeap() - (int)heapBefore);
 }
 
-void CustomWiFiManager::checkWiFiConnection()
+void CustomWiFiManager::setState(LinkState newState)
 {
-    if (!isConnected()) {
-        begin();
+    state = newState;
+    linkStateGauge.set(newState);
+}
+
+const char* CustomWiFiManager::stateName(LinkState s)
+{
+    switch (s) {
+        case LINK_CONNECTING: return "connecting";
+        case LINK_CONNECTED: return "connected";
+        case LINK_WAITING: return "waiting";
     }
-    MDNS.update();
+    return "unknown";
 }
 
 void CustomWiFiManager::startTask()
 {
-    if (!shouldRun) {
-        shouldRun = true;
-        wifiTicker.attach_ms(1000, [this]() { this->checkWiFiConnection(); });
-    }
+    shouldRun = true;
 }
 
 void CustomWiFiManager::stopTask()
+{
+    shouldRun = false;
+}
+
+void CustomWiFiManager::loop()
 {
     if (shouldRun) {
-        shouldRun = false;
-        wifiTicker.detach();
+        checkWiFiConnection();
     }
 }
 
-bool CustomWiFiManager::begin()
+/**
+ * @brief Starts associating with the saved network and returns immediately
+ *
+ * loop() picks the connection up once it is established. Without saved
+ * credentials there is nothing to try, so the portal opens right away.
+ */
+void CustomWiFiManager::begin()
 {
-    if (!wifiManager->autoConnect(hostname.c_str())) {
-        Serial.println("Failed to connect and hit timeout");
-        delay(3000);
-        return false;
+    BootTimeline::start(BOOT_WIFI);
+    gotIpHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP&) {
+        BootTimeline::finish(BOOT_WIFI);
+    });
+    disconnectedHandler = WiFi.onStationModeDisconnected([this](const WiFiEventStationModeDisconnected& event) {
+        // WiFi.begin() itself leaves the old association; that is not a failure
+        if (event.reason != WIFI_DISCONNECT_REASON_ASSOC_LEAVE) {
+            disconnectReason = event.reason;
+            linkLost = true;
+        }
+    });
+    
+    // Retries are paced by the state machine rather than the SDK
+    WiFi.setAutoReconnect(false);
+    WiFi.hostname(hostname.c_str());
+    WiFi.mode(WIFI_STA);
+
+    if (WiFi.SSID().length() == 0) {
+        LOG_INFO("No saved WiFi credentials");
+        startPortal();
+        return;
     }
 
+    startAttempt(millis());
+    LOG_INFO("Connecting to %s in the background", WiFi.SSID().c_str());
+}
+
+void CustomWiFiManager::startServices()
+{
     // Set hostname in WiFi config
     WiFi.hostname(hostname.c_str());
     
@@ -61,24 +250,20 @@ bool CustomWiFiManager::begin()
     if (MDNS.begin(hostname.c_str())) {
         // Add service advertising
         MDNS.addService("http", "tcp", 80);
-        Serial.print("mDNS responder started: http://");
-        Serial.print(hostname);
-        Serial.println(".local");
+        LOG_INFO("mDNS responder started: http://%s.local", hostname.c_str());
     } else {
-        Serial.println("Error setting up MDNS responder!");
+        LOG_ERROR("Error setting up MDNS responder!");
     }
 
-    Serial.println("WiFi connected");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
-    Serial.print("Hostname: ");
-    Serial.println(hostname);
-    return true;
+    LOG_INFO("WiFi connected, IP address: %s, hostname: %s",
+             WiFi.localIP().toString().c_str(), hostname.c_str());
+    servicesStarted = true;
 }
 
 void CustomWiFiManager::reset()
 {
-    wifiManager->resetSettings();
+    // Forget the saved credentials (what AsyncWiFiManager::resetSettings() does)
+    WiFi.disconnect(true);
     ESP.restart();
 }
 
@@ -104,7 +289,6 @@ void CustomWiFiManager::setupClientIPLogging(AsyncWebServer* server) {
     
     // Add default handler to log client IP
     server->onRequestBody([](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-        Serial.print("Request from IP: ");
-        Serial.println(request->client()->remoteIP().toString());
+        LOG_DEBUG("Request from IP: %s", request->client()->remoteIP().toString().c_str());
     });
 }
\ No newline at end of file
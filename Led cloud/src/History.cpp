@@ -0,0 +1,163 @@
+#include "History.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char* const COLUMN_NAMES[] = {"heap", "block", "frag", "rssi", "frameUs"};
+
+int columnValue(const HistorySample& sample, uint8_t column)
+{
+    switch (column) {
+        case 0: return sample.freeHeap;
+        case 1: return sample.maxBlock;
+        case 2: return sample.fragmentation;
+        case 3: return sample.rssi;
+        default: return sample.frameTimeUs;
+    }
+}
+
+} // namespace
+
+SystemHistory::SystemHistory()
+    : lastRecordMs(0), pending(0), pendingHeapMin(0xFFFF), pendingBlockMin(0xFFFF), pendingFragMax(0),
+      pendingRssiSum(0), pendingRssiCount(0), pendingFrameSum(0)
+{
+}
+
+void SystemHistory::record(const HistorySample& sample, uint32_t nowMs)
+{
+    fine.push(sample);
+    lastRecordMs = nowMs;
+
+    if (sample.freeHeap < pendingHeapMin)
+    {
+        pendingHeapMin = sample.freeHeap;
+    }
+    if (sample.maxBlock < pendingBlockMin)
+    {
+        pendingBlockMin = sample.maxBlock;
+    }
+    if (sample.fragmentation > pendingFragMax)
+    {
+        pendingFragMax = sample.fragmentation;
+    }
+    if (sample.rssi != 0)
+    {
+        pendingRssiSum += sample.rssi;
+        pendingRssiCount++;
+    }
+    pendingFrameSum += sample.frameTimeUs;
+
+    if (++pending < HISTORY_COARSE_FACTOR)
+    {
+        return;
+    }
+
+    HistorySample folded;
+    folded.freeHeap = pendingHeapMin;
+    folded.maxBlock = pendingBlockMin;
+    folded.fragmentation = pendingFragMax;
+    folded.rssi = pendingRssiCount ? (int8_t)(pendingRssiSum / pendingRssiCount) : 0;
+    folded.frameTimeUs = saturate16(pendingFrameSum / pending);
+    coarse.push(folded);
+
+    pending = 0;
+    pendingHeapMin = 0xFFFF;
+    pendingBlockMin = 0xFFFF;
+    pendingFragMax = 0;
+    pendingRssiSum = 0;
+    pendingRssiCount = 0;
+    pendingFrameSum = 0;
+}
+
+HistoryExporter::HistoryExporter(const SystemHistory& source, uint32_t now)
+    : history(source), nowMs(now), level(0), column(COLUMN_COUNT), index(0)
+{
+    levelStart[0] = history.getFine().oldestSlot();
+    levelCount[0] = history.getFine().size();
+    levelStart[1] = history.getCoarse().oldestSlot();
+    levelCount[1] = history.getCoarse().size();
+    uint32_t age = levelCount[0] ? (nowMs - history.getLastRecordMs()) / 1000 : 0;
+    setPendingLength(snprintf(pending, sizeof(pending), "{\"newestAgeS\":%u", (unsigned)age));
+}
+
+size_t HistoryExporter::levelSize() const
+{
+    return levelCount[level];
+}
+
+const HistorySample& HistoryExporter::levelSample(size_t i) const
+{
+    return level == 0 ? history.getFine().slot(levelStart[0] + i) : history.getCoarse().slot(levelStart[1] + i);
+}
+
+/**
+ * @brief Formats the next piece of the document into the pending buffer
+ *
+ * Samples are formatted several at a time to keep the number of calls low.
+ */
+bool HistoryExporter::formatNext()
+{
+    if (level == 3)
+    {
+        return false;
+    }
+    if (level == 2)
+    {
+        setPendingLength(snprintf(pending, sizeof(pending), "}"));
+        level = 3;
+        return true;
+    }
+
+    // Level header, then the first column
+    if (column == COLUMN_COUNT)
+    {
+        uint32_t intervalS = HISTORY_FINE_INTERVAL / 1000;
+        size_t capacity = history.getFine().capacity();
+        if (level == 1)
+        {
+            intervalS *= HISTORY_COARSE_FACTOR;
+            capacity = history.getCoarse().capacity();
+        }
+        pendingLength = snprintf(pending, sizeof(pending), ",\"%s\":{\"intervalS\":%u,\"capacity\":%u,\"%s\":[",
+                                 level == 0 ? "fine" : "coarse", (unsigned)intervalS, (unsigned)capacity,
+                                 COLUMN_NAMES[0]);
+        column = 0;
+        index = 0;
+        return true;
+    }
+
+    // Room is always left for the column's closing text
+    const size_t reserve = 24;
+    size_t count = levelSize();
+    while (index < count)
+    {
+        char value[12];
+        int length = snprintf(value, sizeof(value), "%s%d", index == 0 ? "" : ",",
+                              columnValue(levelSample(index), column));
+        if (pendingLength + length + reserve >= sizeof(pending))
+        {
+            return true;  // Buffer full; continue with this sample next time
+        }
+        memcpy(pending + pendingLength, value, length);
+        pendingLength += length;
+        index++;
+    }
+
+    // Column finished: close it and open the next one, or close the level
+    if (column + 1 < COLUMN_COUNT)
+    {
+        column++;
+        index = 0;
+        pendingLength += snprintf(pending + pendingLength, sizeof(pending) - pendingLength,
+                                  "],\"%s\":[", COLUMN_NAMES[column]);
+    }
+    else
+    {
+        column = COLUMN_COUNT;
+        level++;
+        pendingLength += snprintf(pending + pendingLength, sizeof(pending) - pendingLength, "]}");
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+#include "HttpApi.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char* const JSON_TYPE = "application/json";
+const char* const MSGPACK_TYPE = "application/msgpack";
+
+// The request asked for MessagePack (Accept: application/msgpack); JSON otherwise
+bool wantsMsgPack(ApiRequest& request)
+{
+    const char* accept = request.getHeader("Accept");
+    return accept && strstr(accept, MSGPACK_TYPE) != nullptr;
+}
+
+// Reply to a POST whose body could not be parsed
+void sendInvalidBody(ApiRequest& request, ApiResponse& response)
+{
+    sendReply(request, response, 400, "{\"error\":\"Invalid JSON\"}");
+}
+
+} // namespace
+
+void sendDocument(ApiRequest& request, ApiResponse& response, int code, const JsonDocument& doc)
+{
+    bool msgPack = wantsMsgPack(request);
+    uint32_t start = apiClockUs();
+    response.begin(code, msgPack ? MSGPACK_TYPE : JSON_TYPE);
+    if (msgPack)
+    {
+        serializeMsgPack(doc, response);
+    }
+    else
+    {
+        serializeJson(doc, response);
+    }
+    char elapsed[12];
+    snprintf(elapsed, sizeof(elapsed), "%u", (unsigned)(apiClockUs() - start));
+    response.addHeader("Vary", "Accept");
+    response.addHeader("X-Serialize-Us", elapsed);
+    response.end();
+}
+
+void sendReply(ApiRequest& request, ApiResponse& response, int code, const char* json)
+{
+    if (!wantsMsgPack(request))
+    {
+        response.begin(code, JSON_TYPE);
+        response.write(reinterpret_cast<const uint8_t*>(json), strlen(json));
+        response.end();
+        return;
+    }
+    JsonDocument doc;
+    deserializeJson(doc, json);
+    sendDocument(request, response, code, doc);
+}
+
+DeserializationError parseBody(ApiRequest& request, JsonDocument& doc)
+{
+    const char* type = request.getContentType();
+    if (type && strncmp(type, MSGPACK_TYPE, strlen(MSGPACK_TYPE)) == 0)
+    {
+        return deserializeMsgPack(doc, request.getBody(), request.getBodyLength());
+    }
+    return deserializeJson(doc, request.getBody(), request.getBodyLength());
+}
+
+void DashboardApi::systemInfo(ApiRequest& request, ApiResponse& response)
+{
+    SystemInfo info = device.getSystemInfo();
+    JsonDocument doc;
+    doc["freeHeap"] = info.freeHeap;
+    doc["heapFragmentation"] = info.heapFragmentation;
+    doc["wifiSignal"] = info.wifiSignal;
+    doc["ledState"] = info.ledState ? 1 : 0;
+    doc["brightness"] = info.brightness;
+    doc["uptime"] = info.uptime;
+    sendDocument(request, response, 200, doc);
+}
+
+void DashboardApi::weather(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    if (!device.getWeather(doc))
+    {
+        sendReply(request, response, 503, "{\"error\":\"Weather service not available\"}");
+        return;
+    }
+    sendDocument(request, response, 200, doc);
+}
+
+void DashboardApi::pixelStatus(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    doc["brightness"] = device.getPixelBrightness();
+    doc["pattern"] = device.getPattern();
+    JsonArray pixels = doc["pixels"].to<JsonArray>();
+    for (int i = 0; i < NEOPIXEL_COUNT; i++)
+    {
+        pixels.add(device.getPixelColor(i));
+    }
+    sendDocument(request, response, 200, doc);
+}
+
+// POST: {"r":int, "g":int, "b":int}
+void DashboardApi::setAllPixels(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    if (parseBody(request, doc))
+    {
+        sendInvalidBody(request, response);
+        return;
+    }
+    device.setAllPixels(doc["r"] | 0, doc["g"] | 0, doc["b"] | 0);
+    sendReply(request, response, 200, "{\"status\":\"ok\"}");
+}
+
+// POST: {"index":int, "r":int, "g":int, "b":int}
+void DashboardApi::setPixel(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    if (parseBody(request, doc))
+    {
+        sendInvalidBody(request, response);
+        return;
+    }
+    device.setPixel(doc["index"] | 0, doc["r"] | 0, doc["g"] | 0, doc["b"] | 0);
+    sendReply(request, response, 200, "{\"status\":\"ok\"}");
+}
+
+// POST: {"pattern":int}
+void DashboardApi::setPattern(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    if (parseBody(request, doc))
+    {
+        sendInvalidBody(request, response);
+        return;
+    }
+    device.setPattern(doc["pattern"] | 0);
+    sendReply(request, response, 200, "{\"status\":\"ok\"}");
+}
+
+// POST: {"brightness":int}
+void DashboardApi::setPixelBrightness(ApiRequest& request, ApiResponse& response)
+{
+    JsonDocument doc;
+    if (parseBody(request, doc))
+    {
+        sendInvalidBody(request, response);
+        return;
+    }
+    device.setPixelBrightness(doc["brightness"] | 0);
+    sendReply(request, response, 200, "{\"status\":\"ok\"}");
+}
@@ -0,0 +1,157 @@
+#include "Log.h"
+#include <stdarg.h>
+
+char Log::buffer[LOG_BUFFER_SIZE];
+uint32_t Log::head = 0;
+uint32_t Log::serialTail = 0;
+uint32_t Log::lines = 0;
+uint32_t Log::droppedBytes = 0;
+uint64_t Log::totalCycles = 0;
+
+namespace {
+const char LEVEL_CHARS[] = "-EWID";
+}
+
+void Log::write(uint8_t level, PGM_P format, ...)
+{
+    uint32_t startCycles = ESP.getCycleCount();
+
+    char line[LOG_LINE_MAX];
+    int prefix = snprintf(line, sizeof(line), "[%7lu] %c ", (unsigned long)millis(),
+                          LEVEL_CHARS[level <= LOG_LEVEL_DEBUG ? level : 0]);
+
+    // Leave room for the newline; overlong messages are truncated
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf_P(line + prefix, sizeof(line) - prefix - 1, format, args);
+    va_end(args);
+
+    size_t total = prefix + (length < 0 ? 0 : length);
+    if (total > sizeof(line) - 2)
+    {
+        total = sizeof(line) - 2;
+    }
+    line[total++] = '\n';
+
+    append(line, total);
+    lines++;
+    totalCycles += ESP.getCycleCount() - startCycles;
+}
+
+void Log::append(const char *text, size_t length)
+{
+    // Serial is a full ring behind: skip the bytes about to be overwritten
+    if (head + length - serialTail > LOG_BUFFER_SIZE)
+    {
+        uint32_t overwritten = head + length - serialTail - LOG_BUFFER_SIZE;
+        serialTail += overwritten;
+        droppedBytes += overwritten;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[(head + i) & (LOG_BUFFER_SIZE - 1)] = text[i];
+    }
+    head += length;
+}
+
+void Log::drain()
+{
+    // At most two writes: up to the end of the ring, then from its start
+    for (uint8_t pass = 0; pass < 2 && serialTail != head; pass++)
+    {
+        int room = Serial.availableForWrite();
+        if (room <= 0)
+        {
+            return;
+        }
+        size_t offset = serialTail & (LOG_BUFFER_SIZE - 1);
+        size_t chunk = head - serialTail;
+        if (chunk > LOG_BUFFER_SIZE - offset)
+        {
+            chunk = LOG_BUFFER_SIZE - offset;
+        }
+        if (chunk > (size_t)room)
+        {
+            chunk = room;
+        }
+        Serial.write(buffer + offset, chunk);
+        serialTail += chunk;
+    }
+}
+
+void Log::flush()
+{
+    while (serialTail != head)
+    {
+        size_t offset = serialTail & (LOG_BUFFER_SIZE - 1);
+        size_t chunk = head - serialTail;
+        if (chunk > LOG_BUFFER_SIZE - offset)
+        {
+            chunk = LOG_BUFFER_SIZE - offset;
+        }
+        Serial.write(buffer + offset, chunk);
+        serialTail += chunk;
+    }
+    Serial.flush();
+}
+
+size_t Log::getBufferedLength()
+{
+    return head < LOG_BUFFER_SIZE ? head : LOG_BUFFER_SIZE;
+}
+
+size_t Log::copyRecent(char *out, size_t maxLen)
+{
+    size_t available = getBufferedLength();
+    bool partial = head > LOG_BUFFER_SIZE;
+    if (available > maxLen)
+    {
+        available = maxLen;
+        partial = true;
+    }
+
+    uint32_t start = head - available;
+    size_t copied = 0;
+    for (size_t i = 0; i < available; i++)
+    {
+        char c = buffer[(start + i) & (LOG_BUFFER_SIZE - 1)];
+        // The oldest line may have been partly overwritten; start after its end
+        if (partial)
+        {
+            partial = c != '\n';
+            continue;
+        }
+        out[copied++] = c;
+    }
+    return copied;
+}
+
+#if LOG_BENCHMARK
+void Log::runBenchmark()
+{
+    const int iterations = 20;
+    flush();
+
+    // Previous pattern: heap-built String printed synchronously
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++)
+    {
+        Serial.println("Setting pixel " + String(i) + " to R=" + String(255) + ", G=" + String(128) + ", B=" + String(0));
+    }
+    uint32_t stringCycles = (ESP.getCycleCount() - start) / iterations;
+    Serial.flush();
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++)
+    {
+        LOG_INFO("Setting pixel %d to R=%d, G=%d, B=%d", i, 255, 128, 0);
+    }
+    uint32_t logCycles = (ESP.getCycleCount() - start) / iterations;
+    flush();
+
+    Serial.printf("Log benchmark: String + Serial.println %u cycles/call (%u us), LOG_INFO %u cycles/call (%u us)\n",
+                  (unsigned)stringCycles, (unsigned)(stringCycles / ESP.getCpuFreqMHz()),
+                  (unsigned)logCycles, (unsigned)(logCycles / ESP.getCpuFreqMHz()));
+}
+#endif
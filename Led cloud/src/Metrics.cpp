@@ -0,0 +1,195 @@
+#include "Metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+Metrics::Entry Metrics::entries[METRICS_MAX];
+size_t Metrics::count = 0;
+
+namespace {
+
+const char* const TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+// Decimal formatting for 64-bit sums without relying on %llu support in printf
+void formatUnsigned64(char* out, size_t size, uint64_t value)
+{
+    char digits[21];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + (char)(value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    size_t i = 0;
+    while (n > 0 && i + 1 < size) {
+        out[i++] = digits[--n];
+    }
+    out[i] = '\0';
+}
+
+} // namespace
+
+bool Metrics::addEntry(const char* name, const char* help, Type type, const void* metric,
+                       const char* labelName, const char* labelValue)
+{
+    if (count >= METRICS_MAX)
+    {
+        return false;
+    }
+
+    // Keep series of one metric together: a name seen before goes after its
+    // last series, so the exporter writes one HELP/TYPE header and one group
+    size_t position = count;
+    for (size_t i = count; i > 0; i--)
+    {
+        if (strcmp(entries[i - 1].name, name) == 0)
+        {
+            position = i;
+            break;
+        }
+    }
+    for (size_t i = count; i > position; i--)
+    {
+        entries[i] = entries[i - 1];
+    }
+    count++;
+
+    Entry& entry = entries[position];
+    entry.name = name;
+    entry.help = help;
+    entry.labelName = labelName;
+    entry.labelValue = labelValue;
+    entry.type = type;
+    entry.metric = metric;
+    return true;
+}
+
+bool Metrics::add(const char* name, const char* help, const Counter& counter,
+                  const char* labelName, const char* labelValue)
+{
+    return addEntry(name, help, TYPE_COUNTER, &counter, labelName, labelValue);
+}
+
+bool Metrics::add(const char* name, const char* help, const Gauge& gauge,
+                  const char* labelName, const char* labelValue)
+{
+    return addEntry(name, help, TYPE_GAUGE, &gauge, labelName, labelValue);
+}
+
+bool Metrics::add(const char* name, const char* help, const Histogram& histogram,
+                  const char* labelName, const char* labelValue)
+{
+    return addEntry(name, help, TYPE_HISTOGRAM, &histogram, labelName, labelValue);
+}
+
+MetricsExporter::MetricsExporter()
+    : entryIndex(0), line(0)
+{
+}
+
+/**
+ * @brief Formats "name_suffix{label="v",le="x"} value\n" into the pending buffer
+ * @return Number of bytes formatted
+ */
+size_t MetricsExporter::formatSample(const Metrics::Entry& entry, const char* suffix, const char* le, const char* value)
+{
+    char labels[64] = "";
+    if (entry.labelName && le)
+    {
+        snprintf(labels, sizeof(labels), "{%s=\"%s\",le=\"%s\"}", entry.labelName, entry.labelValue, le);
+    }
+    else if (entry.labelName)
+    {
+        snprintf(labels, sizeof(labels), "{%s=\"%s\"}", entry.labelName, entry.labelValue);
+    }
+    else if (le)
+    {
+        snprintf(labels, sizeof(labels), "{le=\"%s\"}", le);
+    }
+
+    setPendingLength(snprintf(pending, sizeof(pending), "%s%s%s %s\n", entry.name, suffix, labels, value));
+    return pendingLength;
+}
+
+/**
+ * @brief Formats the next line (or header pair) of the document into the pending buffer
+ */
+bool MetricsExporter::formatNext()
+{
+    if (entryIndex >= Metrics::getCount())
+    {
+        return false;
+    }
+
+    const Metrics::Entry& entry = Metrics::get(entryIndex);
+
+    if (line == 0)
+    {
+        line = 1;
+        // Labeled series of one metric are adjacent (see addEntry) and share the header of the first
+        if (entryIndex == 0 || strcmp(Metrics::get(entryIndex - 1).name, entry.name) != 0)
+        {
+            int length = snprintf(pending, sizeof(pending), "# HELP %s %s\n# TYPE %s %s\n",
+                                  entry.name, entry.help, entry.name, TYPE_NAMES[entry.type]);
+            setPendingLength(length);
+            return true;
+        }
+    }
+
+    char value[24];
+    if (entry.type == Metrics::TYPE_COUNTER)
+    {
+        snprintf(value, sizeof(value), "%u", (unsigned)static_cast<const Counter*>(entry.metric)->get());
+        pendingLength = formatSample(entry, "", nullptr, value);
+    }
+    else if (entry.type == Metrics::TYPE_GAUGE)
+    {
+        snprintf(value, sizeof(value), "%d", (int)static_cast<const Gauge*>(entry.metric)->get());
+        pendingLength = formatSample(entry, "", nullptr, value);
+    }
+    else
+    {
+        const Histogram* histogram = static_cast<const Histogram*>(entry.metric);
+        uint8_t buckets = histogram->getBucketCount();
+        uint8_t index = line - 1;
+
+        if (index <= buckets)
+        {
+            // Bucket lines are cumulative; the last one is +Inf
+            uint32_t cumulative = 0;
+            for (uint8_t i = 0; i <= index; i++)
+            {
+                cumulative += histogram->getBucket(i);
+            }
+            char le[12];
+            if (index < buckets)
+            {
+                snprintf(le, sizeof(le), "%u", (unsigned)histogram->getBound(index));
+            }
+            else
+            {
+                strcpy(le, "+Inf");
+            }
+            snprintf(value, sizeof(value), "%u", (unsigned)cumulative);
+            pendingLength = formatSample(entry, "_bucket", le, value);
+        }
+        else if (index == buckets + 1)
+        {
+            formatUnsigned64(value, sizeof(value), histogram->getSum());
+            pendingLength = formatSample(entry, "_sum", nullptr, value);
+        }
+        else
+        {
+            snprintf(value, sizeof(value), "%u", (unsigned)histogram->getCount());
+            pendingLength = formatSample(entry, "_count", nullptr, value);
+            entryIndex++;
+            line = 0;
+            return true;
+        }
+        line++;
+        return true;
+    }
+
+    entryIndex++;
+    line = 0;
+    return true;
+}
@@ -11,19 +11,121 @@
 //   - Use setPattern(), setBrightness(), setAllPixels(), update() for control.
 //   - update() should be called periodically (e.g., from a task or loop).
 //
-// Patterns supported: Off, Red, Rainbow, Chase, Fade, Twinkle, Fire, Rain, Color Wipe
+// Patterns supported: Off, Red, Rainbow, Chase, Fade, Twinkle, Fire, Rain, Color Wipe, Weather, Program
+//
+// Chase, Fade, Color Wipe and the weather drops are computed from the animation
+// frame, which comes from the clock shared between nodes (SyncService), so
+// several clouds show the same frame at the same time.
+//
+// update() runs at the output rate (NEOPIXEL_OUTPUT_INTERVAL). Each pattern
+// renders keyframes at its own rate (patternTiming); the expensive smooth
+// ones render at about 15 fps and the frames in between are blended from the
+// last two keyframes, which costs one pass over the bytes instead of the
+// pattern (scripts/keyframe_bench.cpp). When frames overrun, the quality
+// governor trades some of that detail for time (QualityGovernor.h).
+//
+// Chase, Fade and Color Wipe repeat exactly after a fixed number of frames.
+// Each frame of the cycle is rendered once, delta-encoded into the frame
+// cache and replayed from there afterwards (FrameCache.h). The cache is
+// allocated when one of them starts and freed whenever the pattern or
+// scene changes, so the other patterns leave its ~3.8 KB on the heap.
 
 #include "NeoPixel.h"
+#include "Trace.h"
+#include "Log.h"
+#include "SyncService.h"
+#include "OtaService.h"
 #include <Adafruit_NeoPixel.h>
 #include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <coredecls.h> // crc32()
+#include <new>
 
 #define NEOPIXEL_PIN  D5
-#define NUM_PIXELS    60
+#define NUM_PIXELS    NEOPIXEL_COUNT
+#define FRAME_MS      50  // Animation time per frame
+#define PROGRAM_FILE  "/program.pxv"
+#define BLEND_NONE    256 // Output shows the current keyframe as is
+#define FADE_FRAMES   (5120 / NEOPIXEL_OUTPUT_INTERVAL)  // Fade up and back down in 5.12 s
 
 NeoPixel* NeoPixel::instance = nullptr;
 
+namespace {
+
+// ESP8266 RTC user memory; keeps its contents through everything but power loss
+class EspRtcRegion : public RtcRegion {
+public:
+    bool read(uint32_t block, void* data, size_t size) override {
+        return ESP.rtcUserMemoryRead(block, static_cast<uint32_t*>(data), size);
+    }
+    bool write(uint32_t block, const void* data, size_t size) override {
+        return ESP.rtcUserMemoryWrite(block, static_cast<uint32_t*>(const_cast<void*>(data)), size);
+    }
+};
+
+EspRtcRegion rtcRegion;
+
+// How often an animated pattern renders, whether output blends between its keyframes,
+// and after how many of its frames it repeats exactly (0: never, nothing is cached)
+struct PatternTiming {
+    uint16_t keyframeMs;
+    bool interpolate;
+    uint16_t periodFrames;
+};
+
+// Patterns that step a pixel at a time (chase, wipe, rain, weather drops) render every
+// frame they move on; blending those would smear the step. Fade and twinkle are a
+// fill or a decay pass, cheaper than the blend itself, so they render every output
+// frame. Fire and pixel programs compute every pixel and get 4 output frames per keyframe.
+const PatternTiming patternTiming[] = {
+    {FRAME_MS, false, 0},                         // PATTERN_OFF
+    {FRAME_MS, false, 0},                         // PATTERN_RED
+    {FRAME_MS, false, 0},                         // PATTERN_RAINBOW
+    {FRAME_MS, false, NUM_PIXELS},                // PATTERN_CHASE
+    {NEOPIXEL_OUTPUT_INTERVAL, false, FADE_FRAMES},  // PATTERN_FADE
+    {NEOPIXEL_OUTPUT_INTERVAL, false, 0},         // PATTERN_TWINKLE
+    {4 * NEOPIXEL_OUTPUT_INTERVAL, true, 0},      // PATTERN_FIRE
+    {FRAME_MS, false, 0},                         // PATTERN_RAIN
+    {FRAME_MS, false, NUM_PIXELS * 6},            // PATTERN_COLOR_WIPE (6 colours)
+    {FRAME_MS, false, 0},                         // PATTERN_WEATHER
+    {4 * NEOPIXEL_OUTPUT_INTERVAL, true, 0},      // PATTERN_PROGRAM
+};
+
+} // namespace
+
+StripOutput::StripOutput(uint16_t count, int16_t pin, neoPixelType type) : Adafruit_NeoPixel() {
+    // The default constructor allocates nothing; size the strip without letting it malloc a buffer
+    updateType(type);
+    setPin(pin);
+    numLEDs = count;
+    numBytes = count * (wOffset == rOffset ? 3 : 4);
+}
+
+void StripOutput::send(uint8_t* bytes) {
+    pixels = bytes;
+    show();
+    pixels = nullptr;
+}
+
 NeoPixel::NeoPixel()
-    : strip(NUM_PIXELS, NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800), brightness(50), currentPattern(PATTERN_OFF), lastUpdate(0) {
+    : strip(NUM_PIXELS, NEOPIXEL_PIN, PixelBuffer::ORDER_TYPE + NEO_KHZ800), brightness(50), currentPattern(PATTERN_OFF), lastUpdate(0),
+      frame(0), lastTwinkle(0), blend(BLEND_NONE), quality(QUALITY_FRAME_BUDGET), lastOutput(0), frameCache(nullptr), warmState(rtcRegion, RTC_LED_STATE_BLOCK), warmStart(false), lastCheckpoint(0),
+      weatherCondition(WEATHER_UNKNOWN), renderedCondition(0xFF), programFileChecked(false), programCrc(0) {
+    Metrics::add("ledcloud_program_pixels_per_second", "PixelVM interpreter speed in the last frame", programPixelsPerSecond);
+    Metrics::add("ledcloud_program_budget_exhausted_total", "Frames where the pixel program ran out of instruction budget",
+                 programBudgetExhausted);
+    Metrics::add("ledcloud_keyframes_rendered_total", "Animation frames computed by the pattern", keyframesRendered);
+    Metrics::add("ledcloud_frames_blended_total", "Output frames blended between two keyframes", framesBlended);
+    Metrics::add("ledcloud_render_quality_level", "Render quality level (0 full, 4 lowest)", qualityLevel);
+    Metrics::add("ledcloud_render_quality_changes_total", "Render quality level changes", qualityStepsDown, "direction",
+                 "down");
+    Metrics::add("ledcloud_render_quality_changes_total", "Render quality level changes", qualityStepsUp, "direction",
+                 "up");
+    Metrics::add("ledcloud_frame_cache_lookups_total", "Periodic pattern frames by where they came from", frameCacheHits,
+                 "result", "hit");
+    Metrics::add("ledcloud_frame_cache_lookups_total", "Periodic pattern frames by where they came from", frameCacheMisses,
+                 "result", "miss");
+    Metrics::add("ledcloud_frame_cache_bytes", "Encoded size of the cached pattern frames", frameCacheBytes);
 }
 
 NeoPixel* NeoPixel::getInstance() {
@@ -36,221 +138,367 @@ NeoPixel* NeoPixel::getInstance() {
 
 void NeoPixel::begin() {
     strip.begin();
-    strip.setBrightness(brightness);
-    strip.show();
-    for (int i = 0; i < NUM_PIXELS; ++i) {
-        pixelColors[i] = strip.Color(0, 0, 0);
+    
+    // After a soft reset the strip picks up the scene it was showing instead of going dark
+    warmStart = restoreWarmState();
+    if (!warmStart) {
+        pixels.clear();
+        show();
     }
-    Serial.println("NeoPixel initialized with " + String(NUM_PIXELS) + " LEDs on pin " + String(NEOPIXEL_PIN));
+    LOG_INFO("NeoPixel initialized with %d LEDs on pin %d", NUM_PIXELS, NEOPIXEL_PIN);
 }
 
-void NeoPixel::setAllPixels(uint32_t color) {
-    Serial.println("Setting all pixels to color: R=" + String((color >> 16) & 0xFF) + 
-                   ", G=" + String((color >> 8) & 0xFF) + 
-                   ", B=" + String(color & 0xFF));
+bool NeoPixel::restoreWarmState() {
+    WarmStateRecord record;
+    if (!warmState.load(record) || record.pattern > PATTERN_PROGRAM) {
+        return false;
+    }
+    
+    brightness = record.brightness;
+    currentPattern = static_cast<PatternType>(record.pattern);
+    blend = BLEND_NONE;
+    releaseFrameCache();
+    SyncService::getInstance()->setAnimationElapsed(record.phase.elapsedMs);
+    weatherCondition = record.weatherCondition;
+    renderedCondition = 0xFF;  // Base scene is re-rendered on the next update()
+    
+    pixels.load(record.pixels);
+    show();
     
-    // Disable interrupts during pixel updates to prevent crashes
-    noInterrupts();
+    LOG_INFO("NeoPixel scene restored from RTC memory (pattern %d, brightness %d)", (int)currentPattern, brightness);
+    return true;
+}
+
+void NeoPixel::saveWarmState() {
+    // Once an update is complete, RTC memory holds the bootloader's command; leave it alone until the restart
+    if (OtaService::getInstance()->isRestartPending()) {
+        return;
+    }
+    // RTC memory rather than flash, so this is cheap enough for every change
+    WarmStateRecord record;
+    memset(&record, 0, sizeof(record));
+    record.pattern = currentPattern;
+    record.brightness = constrain(brightness, 0, 255);
+    record.weatherCondition = weatherCondition;
+    record.phase.elapsedMs = SyncService::getInstance()->animationTimeMs();
     for (int i = 0; i < NUM_PIXELS; ++i) {
-        pixelColors[i] = color;
-        strip.setPixelColor(i, color);
+        uint32_t color = pixels.get(i);
+        record.pixels[i][0] = (color >> 16) & 0xFF;
+        record.pixels[i][1] = (color >> 8) & 0xFF;
+        record.pixels[i][2] = color & 0xFF;
     }
-    interrupts();
+    warmState.save(record);
+    lastCheckpoint = millis();
+}
+
+void NeoPixel::setAllPixels(uint32_t color) {
+    LOG_DEBUG("Setting all pixels to color: R=%u, G=%u, B=%u",
+              (unsigned)((color >> 16) & 0xFF), (unsigned)((color >> 8) & 0xFF), (unsigned)(color & 0xFF));
     
-    strip.show();
+    pixels.fill(color);
+    if (frameCache) {
+        frameCache->lose();
+    }
+    show();
+    saveWarmState();
 }
 
 void NeoPixel::updatePixelColor(int idx, int r, int g, int b) {
     if (idx < 0 || idx >= NUM_PIXELS) {
-        Serial.println("ERROR: Invalid pixel index: " + String(idx));
+        LOG_ERROR("Invalid pixel index: %d", idx);
         return;
     }
     
-    Serial.println("Setting pixel " + String(idx) + " to R=" + String(r) + ", G=" + String(g) + ", B=" + String(b));
+    LOG_DEBUG("Setting pixel %d to R=%d, G=%d, B=%d", idx, r, g, b);
     
-    // Disable interrupts during pixel updates to prevent crashes
-    noInterrupts();
-    uint32_t color = strip.Color(r, g, b);
-    pixelColors[idx] = color;
-    strip.setPixelColor(idx, color);
-    interrupts();
+    pixels.set(idx, r, g, b);
+    if (frameCache) {
+        frameCache->lose();
+    }
+    show();
+    saveWarmState();
+}
+
+void NeoPixel::setPixels(const uint8_t (*rgb)[3], int count) {
+    if (count > NUM_PIXELS) {
+        count = NUM_PIXELS;
+    }
     
-    strip.show();
+    for (int i = 0; i < count; ++i) {
+        pixels.set(i, rgb[i][0], rgb[i][1], rgb[i][2]);
+    }
+    if (frameCache) {
+        frameCache->lose();
+    }
+    show();
+    saveWarmState();
 }
 
-void NeoPixel::setBrightness(int b) {
-    Serial.println("Setting brightness to " + String(b));
+void NeoPixel::setScene(PatternType pattern, int b, const uint8_t (*rgb)[3]) {
+    LOG_DEBUG("Setting scene: pattern %d, brightness %d", (int)pattern, b);
+    currentPattern = pattern;
     brightness = b;
+    blend = BLEND_NONE;
+    releaseFrameCache();
+    renderedCondition = 0xFF;  // Weather base scene is re-rendered on the next update()
     
-    // Disable interrupts during strip updates
-    noInterrupts();
-    strip.setBrightness(brightness);
-    interrupts();
+    pixels.load(rgb);
+    show();
+    saveWarmState();
+}
+
+void NeoPixel::setBrightness(int b) {
+    LOG_DEBUG("Setting brightness to %d", b);
+    brightness = b;
     
-    strip.show();
+    // Applied while copying to the strip, so the stored colors stay exact
+    show();
+    saveWarmState();
 }
 
 void NeoPixel::setPattern(PatternType pattern) {
-    Serial.println("Setting pattern to " + String(pattern));
+    LOG_INFO("Setting pattern to %d", (int)pattern);
     currentPattern = pattern;
-    
-    // Disable interrupts during pattern setup
-    noInterrupts();
+    blend = BLEND_NONE;  // The last keyframe belongs to the old pattern
+    releaseFrameCache();  // So do the cached frames
     
     // Simple placeholder: pattern 0 = all off, 1 = all red, 2 = rainbow
     if (pattern == PATTERN_OFF) {
         // Turn off all LEDs
-        setAllPixels(strip.Color(0,0,0));
+        pixels.fill(strip.Color(0,0,0));
     } else if (pattern == PATTERN_RED) {
         // All red
-        setAllPixels(strip.Color(255,0,0));
+        pixels.fill(strip.Color(255,0,0));
     } else if (pattern == PATTERN_RAINBOW) {
         // Simple rainbow: each pixel a different color
         for (int i = 0; i < NUM_PIXELS; ++i) {
-            uint32_t color = strip.Color((i*40)%255, (255-(i*40))%255, (i*80)%255);
-            pixelColors[i] = color;
-            strip.setPixelColor(i, color);
+            pixels.set(i, (i*40)%255, (255-(i*40))%255, (i*80)%255);
         }
-        strip.show();
     } else if (pattern == PATTERN_CHASE) {
         // Set up for chase pattern - actual animation happens in update()
         // Just initialize with all pixels off
-        setAllPixels(strip.Color(0,0,0));
+        pixels.fill(strip.Color(0,0,0));
     } else if (pattern == PATTERN_FADE) {
         // Set up for fade pattern - actual animation happens in update()
-        setAllPixels(strip.Color(0,0,0));
+        pixels.fill(strip.Color(0,0,0));
     } else if (pattern == PATTERN_TWINKLE) {
         // Set up for twinkle pattern - actual animation happens in update()
-        setAllPixels(strip.Color(0,0,0));
+        pixels.fill(strip.Color(0,0,0));
     } else if (pattern == PATTERN_FIRE) {
         // Set up for fire pattern - actual animation happens in update()
-        setAllPixels(strip.Color(10,0,0)); // Start with dim red
+        pixels.fill(strip.Color(10,0,0)); // Start with dim red
     } else if (pattern == PATTERN_RAIN) {
         // Set up for rain pattern - actual animation happens in update()
-        setAllPixels(strip.Color(0,0,0)); // Start with all off
+        pixels.fill(strip.Color(0,0,0)); // Start with all off
     } else if (pattern == PATTERN_COLOR_WIPE) {
         // Set up for color wipe pattern - actual animation happens in update()
-        setAllPixels(strip.Color(0,0,0)); // Start with all off
+        pixels.fill(strip.Color(0,0,0)); // Start with all off
+    } else if (pattern == PATTERN_WEATHER) {
+        // Force the base scene to be rendered on the next update()
+        renderedCondition = 0xFF;
     }
     
-    interrupts();
+    // The first frame is sent and saved once; show() masks interrupts itself while it clocks the strip out
+    if (pattern <= PATTERN_COLOR_WIPE) {
+        show();
+    }
+    saveWarmState();
 }
 
 void NeoPixel::show() {
-    // Disable interrupts during strip updates
-    noInterrupts();
-    for (int i = 0; i < NUM_PIXELS; ++i) {
-        strip.setPixelColor(i, pixelColors[i]);
+    TRACE_SCOPE(TRACE_NEOPIXEL_SHOW);
+    
+    // The buffer is already in wire order, so at full brightness it goes out as is
+    uint8_t level = constrain(brightness, 0, 255);
+    if (blend < BLEND_NONE) {
+        // Between two keyframes: blend and dim in one pass into a stack frame
+        uint8_t out[PixelBuffer::BYTES];
+        pixels.writeBlended(out, keyframe, blend, level);
+        strip.send(out);
+        return;
+    }
+    if (level == 255) {
+        strip.send(pixels.data());
+        return;
     }
-    interrupts();
     
-    strip.show();
-    // Serial.println("NeoPixel strip updated"); // Commented out to reduce serial spam
+    // Dimmed: scale into a frame that only lives on the stack while it is sent
+    uint8_t out[PixelBuffer::BYTES];
+    pixels.writeScaled(out, level);
+    strip.send(out);
 }
 
 void NeoPixel::update() {
+    TRACE_SCOPE(TRACE_NEOPIXEL_UPDATE);
+    
     // Return early if no active animated pattern
-    if (currentPattern < PATTERN_CHASE) return;
+    if (currentPattern < PATTERN_CHASE || currentPattern > PATTERN_PROGRAM) return;
     
-    // Throttle updates to not overwhelm the system
+    // The last thing the quality governor gives up is the output rate
+    uint8_t level = quality.getLevel();
     unsigned long currentTime = millis();
-    if (currentTime - lastUpdate < 50) return; // Update at max ~20fps
-    
-    lastUpdate = currentTime;
-    
-    // Handle different animated patterns
-    switch (currentPattern) {
-        case PATTERN_CHASE:
-            updateChasePattern();
-            break;
-        case PATTERN_FADE:
-            updateFadePattern();
-            break;
-        case PATTERN_TWINKLE:
-            updateTwinklePattern();
-            break;
-        case PATTERN_FIRE:
-            updateFirePattern();
-            break;
-        case PATTERN_RAIN:
-            updateRainPattern();
-            break;
-        case PATTERN_COLOR_WIPE:
-            updateColorWipePattern();
-            break;
-        default:
-            // No animation for other patterns
-            break;
+    if (level >= QUALITY_HALF_OUTPUT && currentTime - lastOutput < NEOPIXEL_OUTPUT_INTERVAL * 3 / 2) {
+        return;  // Every second output tick
     }
-}
-
-void NeoPixel::updateChasePattern() {
-    static int chasePosition = 0;
-    // Removed unused variable chaseColor
+    lastOutput = currentTime;
     
-    // Clear previous position
-    for (int i = 0; i < NUM_PIXELS; i++) {
-        strip.setPixelColor(i, 0);
-        pixelColors[i] = 0;
+    // Before that, keyframed patterns render at half their rate and then stop blending
+    const PatternTiming& timing = patternTiming[currentPattern];
+    unsigned long keyframeMs = timing.keyframeMs;
+    if (timing.interpolate && level >= QUALITY_SLOW_KEYFRAMES) {
+        keyframeMs *= 2;
+    }
+    bool blending = timing.interpolate && level < QUALITY_NO_BLEND;
+    
+    // Between keyframes, interpolated patterns only move the blend on; the others have nothing new
+    unsigned long sinceKeyframe = currentTime - lastUpdate;
+    if (sinceKeyframe < keyframeMs) {
+        if (blending) {
+            blend = sinceKeyframe * BLEND_NONE / keyframeMs;
+            framesBlended.inc();
+            show();
+        }
+        return;
     }
     
-    // Set the "chase" pixel and a few neighbors
-    for (int i = 0; i < 3; i++) {
-        int pos = (chasePosition + i) % NUM_PIXELS;
-        uint32_t color = strip.Color(0, 0, 255 - (i * 60)); // Fading blue tail
-        strip.setPixelColor(pos, color);
-        pixelColors[pos] = color;
+    // Keyframes stay on their own grid, so the rate holds even when output ticks don't divide it
+    lastUpdate += keyframeMs;
+    if (currentTime - lastUpdate >= keyframeMs) {
+        lastUpdate = currentTime;  // Fell behind or the pattern just changed
     }
+    frame = SyncService::getInstance()->animationTimeMs() / timing.keyframeMs;
     
-    strip.show();
+    // The new keyframe is blended in over the next interval, starting from the one just reached
+    if (blending) {
+        keyframe = pixels;
+        blend = 0;
+    } else {
+        blend = BLEND_NONE;
+    }
     
-    // Move the chase position
-    chasePosition = (chasePosition + 1) % NUM_PIXELS;
+    // Handle different animated patterns; the periodic ones go through the frame cache
+    if (timing.periodFrames > 0) {
+        updatePeriodicPattern(timing.periodFrames);
+    } else {
+        keyframesRendered.inc();
+        switch (currentPattern) {
+            case PATTERN_TWINKLE:
+                updateTwinklePattern();
+                break;
+            case PATTERN_FIRE:
+                updateFirePattern();
+                break;
+            case PATTERN_RAIN:
+                updateRainPattern();
+                break;
+            case PATTERN_WEATHER:
+                updateWeatherPattern();
+                break;
+            case PATTERN_PROGRAM:
+                updateProgramPattern();
+                break;
+            default:
+                // No animation for other patterns
+                break;
+        }
+    }
+    
+    // Checkpoint the phase so a reset mid-animation resumes close to where it was
+    if (currentTime - lastCheckpoint >= WARM_STATE_INTERVAL) {
+        saveWarmState();
+    }
 }
 
-void NeoPixel::updateFadePattern() {
-    static int fadeDirection = 1;
-    static int fadeValue = 0;
+void NeoPixel::reportFrame(uint32_t costUs, bool late) {
+    if (!quality.observe(costUs, late, millis())) {
+        return;
+    }
     
-    // Create a fading effect
-    uint32_t color = strip.Color(fadeValue, 0, fadeValue);
-    for (int i = 0; i < NUM_PIXELS; i++) {
-        strip.setPixelColor(i, color);
-        pixelColors[i] = color;
+    const QualityTransition& change = quality.getTransition(quality.getTransitionCount() - 1);
+    (change.to > change.from ? qualityStepsDown : qualityStepsUp).inc();
+    qualityLevel.set(change.to);
+    LOG_INFO("Render quality %s -> %s (%u of %u frames over budget, slowest %u us)", qualityLevelName(change.from),
+             qualityLevelName(change.to), (unsigned)change.overruns, (unsigned)QUALITY_WINDOW,
+             (unsigned)change.peakCostUs);
+}
+
+void NeoPixel::updatePeriodicPattern(uint16_t periodFrames) {
+    auto render = [this](uint32_t cycleFrame) {
+        frame = cycleFrame;
+        keyframesRendered.inc();
+        switch (currentPattern) {
+            case PATTERN_CHASE:
+                updateChasePattern();
+                break;
+            case PATTERN_FADE:
+                updateFadePattern();
+                break;
+            case PATTERN_COLOR_WIPE:
+                updateColorWipePattern();
+                break;
+            default:
+                break;
+        }
+    };
+    if (!frameCache) {
+        frameCache = new (std::nothrow) PatternFrameCache();
+    }
+    if (!frameCache) {
+        // Short of heap: render every frame, and try again on the next one
+        render(frame);
+        frameCacheMisses.inc();
+        show();
+        return;
     }
     
-    strip.show();
+    // Cached frames are replayed; the others are rendered for their frame of the cycle and stored
+    bool wasFull = frameCache->isFull();
+    size_t cached = frameCache->getFrames();
+    bool hit = frameCache->seek(frame, periodFrames, pixels, keyframe, render);
+    (hit ? frameCacheHits : frameCacheMisses).inc();
+    frameCacheBytes.set(frameCache->getBytes());
+    
+    if (frameCache->isComplete() && frameCache->getFrames() > cached) {
+        LOG_INFO("Frame cache holds pattern %d: %u frames in %u bytes", (int)currentPattern,
+                 (unsigned)frameCache->getFrames(), (unsigned)frameCache->getBytes());
+    } else if (frameCache->isFull() && !wasFull) {
+        LOG_INFO("Frame cache full: pattern %d replays %u of its %u frames, renders the rest", (int)currentPattern,
+                 (unsigned)frameCache->getFrames(), (unsigned)periodFrames);
+    }
+    show();
+}
+
+void NeoPixel::releaseFrameCache() {
+    delete frameCache;
+    frameCache = nullptr;
+    frameCacheBytes.set(0);
+}
+
+void NeoPixel::updateChasePattern() {
+    // Clear previous position
+    pixels.clear();
     
-    // Update fade value and direction
-    fadeValue += (fadeDirection * 5);
-    if (fadeValue >= 255) {
-        fadeValue = 255;
-        fadeDirection = -1;
-    } else if (fadeValue <= 0) {
-        fadeValue = 0;
-        fadeDirection = 1;
+    // Set the "chase" pixel and a few neighbors
+    int chasePosition = frame % NUM_PIXELS;
+    for (int i = 0; i < 3; i++) {
+        int pos = (chasePosition + i) % NUM_PIXELS;
+        pixels.set(pos, 0, 0, 255 - (i * 60)); // Fading blue tail
     }
 }
 
+void NeoPixel::updateFadePattern() {
+    // Triangle wave: up to full brightness over half the cycle, then back down; a
+    // new level every output frame (the fade's frames are NEOPIXEL_OUTPUT_INTERVAL)
+    int phase = frame % FADE_FRAMES;
+    int fadeValue = (phase <= FADE_FRAMES / 2 ? phase : FADE_FRAMES - phase) * 510 / FADE_FRAMES;
+    pixels.fill(strip.Color(fadeValue, 0, fadeValue));
+}
+
 void NeoPixel::updateTwinklePattern() {
-    // Slowly return all LEDs to black
-    for (int i = 0; i < NUM_PIXELS; i++) {
-        uint32_t color = pixelColors[i];
-        uint8_t r = (color >> 16) & 0xFF;
-        uint8_t g = (color >> 8) & 0xFF;
-        uint8_t b = color & 0xFF;
-        
-        // Fade out pixels with a smooth decay
-        if (r > 0) r = (r * 95) / 100;
-        if (g > 0) g = (g * 95) / 100;
-        if (b > 0) b = (b * 95) / 100;
-        
-        pixelColors[i] = strip.Color(r, g, b);
-        strip.setPixelColor(i, pixelColors[i]);
-    }
+    // Slowly return all LEDs to black: about 98% per 16 ms frame, the rate 95% every 50 ms had
+    pixels.fade(252);
     
     // Randomly light up new pixels
-    static unsigned long lastTwinkle = 0;
     unsigned long now = millis();
     
     // Add new twinkles at a randomized rate
@@ -281,17 +529,17 @@ void NeoPixel::updateTwinklePattern() {
                     break;
             }
             
-            pixelColors[idx] = strip.Color(r, g, b);
-            strip.setPixelColor(idx, pixelColors[idx]); // Fixed: use idx instead of i
+            pixels.set(idx, r, g, b);
         }
     }
     
-    strip.show();
+    show();
 }
 
 void NeoPixel::updateFirePattern() {
-    // Fire effect simulation - red/orange/yellow flicker
-    for (int i = 0; i < NUM_PIXELS; i++) {
+    // Fire effect simulation - red/orange/yellow flicker; at reduced quality each flicker covers two pixels
+    int step = quality.getLevel() >= QUALITY_HALF_PIXELS ? 2 : 1;
+    for (int i = 0; i < NUM_PIXELS; i += step) {
         // Get a random number in the range controlled by heat (higher = more intense fire)
         int flicker = random(80, 150);
         
@@ -307,46 +555,41 @@ void NeoPixel::updateFirePattern() {
             g = min(255, g + (int)random(20, 50));
         }
         
-        pixelColors[i] = strip.Color(r, g, b);
-        strip.setPixelColor(i, pixelColors[i]);
+        pixels.set(i, r, g, b);
+        if (step == 2 && i + 1 < NUM_PIXELS) {
+            pixels.set(i + 1, r, g, b);
+        }
     }
     
-    strip.show();
+    show();
 }
 
 void NeoPixel::updateRainPattern() {
     // Simulate rain falling - blue drops
     // First, move all existing colors down by one pixel
-    for (int i = NUM_PIXELS - 1; i > 0; i--) {
-        pixelColors[i] = pixelColors[i - 1];
-        strip.setPixelColor(i, pixelColors[i]);
-    }
+    pixels.shiftUp();
     
     // New raindrops appear randomly at the top
     if (random(100) < 25) { // 25% chance of a new raindrop
         // Pick a blue color with some variation
         uint8_t b = random(180, 240);
         uint8_t g = b / 3; // Some cyan tint
-        pixelColors[0] = strip.Color(0, g, b);
+        pixels.set(0, 0, g, b);
     } else {
-        pixelColors[0] = strip.Color(0, 0, 0); // No drop, black
+        pixels.set(0, 0, 0, 0); // No drop, black
     }
-    strip.setPixelColor(0, pixelColors[0]);
     
     // Add some random water puddle effects at the bottom
     if (random(100) < 10) {
         int puddleIdx = random(NUM_PIXELS - 5, NUM_PIXELS);
         uint8_t puddleBlue = random(50, 100);
-        pixelColors[puddleIdx] = strip.Color(0, puddleBlue/2, puddleBlue);
-        strip.setPixelColor(puddleIdx, pixelColors[puddleIdx]);
+        pixels.set(puddleIdx, 0, puddleBlue/2, puddleBlue);
     }
     
-    strip.show();
+    show();
 }
 
 void NeoPixel::updateColorWipePattern() {
-    static int wipePosition = 0;
-    static int colorIndex = 0;
     static const uint32_t wipeColors[] = {
         strip.Color(255, 0, 0),     // Red
         strip.Color(0, 255, 0),     // Green
@@ -357,26 +600,155 @@ void NeoPixel::updateColorWipePattern() {
     };
     static const int numColors = 6;
     
-    // Set the current pixel to the current color
-    pixelColors[wipePosition] = wipeColors[colorIndex];
-    strip.setPixelColor(wipePosition, wipeColors[colorIndex]);
+    // One pixel per frame; each pass over the strip starts from black in the next color
+    int wipePosition = frame % NUM_PIXELS;
+    uint32_t color = wipeColors[(frame / NUM_PIXELS) % numColors];
+    for (int i = 0; i < NUM_PIXELS; i++) {
+        pixels.setColor(i, i <= wipePosition ? color : 0);
+    }
+}
+
+void NeoPixel::setWeatherCondition(uint8_t condition) {
+    // The weather pattern picks the change up on its next update()
+    weatherCondition = condition;
+}
+
+void NeoPixel::renderWeatherBase() {
+    // Vertical gradient between two colours per condition
+    uint8_t from[3], to[3];
+    switch (weatherCondition) {
+        case WEATHER_CLEAR:        from[0] = 255; from[1] = 140; from[2] = 20;  to[0] = 255; to[1] = 200; to[2] = 60;  break;
+        case WEATHER_CLOUDS:       from[0] = 90;  from[1] = 90;  from[2] = 110; to[0] = 160; to[1] = 160; to[2] = 180; break;
+        case WEATHER_DRIZZLE:      from[0] = 20;  from[1] = 40;  from[2] = 90;  to[0] = 40;  to[1] = 80;  to[2] = 140; break;
+        case WEATHER_RAIN:         from[0] = 0;   from[1] = 20;  from[2] = 80;  to[0] = 10;  to[1] = 50;  to[2] = 150; break;
+        case WEATHER_THUNDERSTORM: from[0] = 30;  from[1] = 0;   from[2] = 50;  to[0] = 60;  to[1] = 10;  to[2] = 90;  break;
+        case WEATHER_SNOW:         from[0] = 120; from[1] = 140; from[2] = 170; to[0] = 200; to[1] = 210; to[2] = 240; break;
+        case WEATHER_MIST:         from[0] = 50;  from[1] = 50;  from[2] = 55;  to[0] = 90;  to[1] = 90;  to[2] = 95;  break;
+        default:                   from[0] = 40;  from[1] = 40;  from[2] = 40;  to[0] = 60;  to[1] = 60;  to[2] = 60;  break;
+    }
     
-    strip.show();
+    for (int i = 0; i < NUM_PIXELS; i++) {
+        uint8_t r = from[0] + ((to[0] - from[0]) * i) / (NUM_PIXELS - 1);
+        uint8_t g = from[1] + ((to[1] - from[1]) * i) / (NUM_PIXELS - 1);
+        uint8_t b = from[2] + ((to[2] - from[2]) * i) / (NUM_PIXELS - 1);
+        weatherBase.set(i, r, g, b);
+    }
+}
+
+void NeoPixel::updateWeatherPattern() {
+    bool baseChanged = false;
+    if (weatherCondition != renderedCondition) {
+        renderWeatherBase();
+        renderedCondition = weatherCondition;
+        baseChanged = true;
+        LOG_INFO("Weather pattern scene: %s", weatherConditionName(weatherCondition));
+    }
     
-    // Advance to the next position
-    wipePosition++;
+    // Clear, cloudy and misty scenes are static; nothing to do until the condition changes
+    bool animated = weatherCondition == WEATHER_RAIN || weatherCondition == WEATHER_DRIZZLE ||
+                    weatherCondition == WEATHER_THUNDERSTORM || weatherCondition == WEATHER_SNOW;
+    if (!animated && !baseChanged) {
+        return;
+    }
     
-    // If we've filled the entire strip, move to the next color
-    if (wipePosition >= NUM_PIXELS) {
-        wipePosition = 0;
-        colorIndex = (colorIndex + 1) % numColors;
-        
-        // Clear the strip when starting a new color
-        for (int i = 0; i < NUM_PIXELS; i++) {
-            pixelColors[i] = strip.Color(0, 0, 0);
-            strip.setPixelColor(i, 0);
+    pixels = weatherBase;
+    
+    if (weatherCondition == WEATHER_RAIN || weatherCondition == WEATHER_DRIZZLE) {
+        // Evenly spaced drops with a short tail falling one pixel per frame
+        int drops = weatherCondition == WEATHER_RAIN ? 6 : 3;
+        for (int d = 0; d < drops; d++) {
+            int pos = (frame + d * NUM_PIXELS / drops) % NUM_PIXELS;
+            pixels.set(pos, 60, 140, 255);
+            pixels.set((pos + NUM_PIXELS - 1) % NUM_PIXELS, 20, 60, 160);
         }
+    } else if (weatherCondition == WEATHER_THUNDERSTORM) {
+        // Occasional lightning flash over the whole strip
+        if (random(100) < 2) {
+            pixels.fill(strip.Color(220, 220, 255));
+        }
+    } else if (weatherCondition == WEATHER_SNOW) {
+        // A couple of white sparkles per frame
+        for (int s = 0; s < 2; s++) {
+            pixels.set(random(NUM_PIXELS), 255, 255, 255);
+        }
+    }
+    show();
+}
+
+const char* NeoPixel::setProgram(const uint8_t* data, size_t length) {
+    PixelVM candidate;
+    const char* error = candidate.load(data, length);
+    if (error) {
+        return error;
+    }
+    if ((uint32_t)candidate.getInstructionCount() * NUM_PIXELS > VM_FRAME_BUDGET) {
+        return "Program needs more instructions per frame than the budget allows";
+    }
+    
+    vm = candidate;
+    programFileChecked = true;
+    programCrc = crc32(data, length);
+    File file = LittleFS.open(PROGRAM_FILE, "w");
+    if (!file || file.write(data, length) != length) {
+        LOG_WARN("Pixel program not saved; it runs until the next restart");
+    }
+    if (file) {
+        file.close();
     }
+    LOG_INFO("Pixel program loaded (%u bytes, %u instructions per pixel)",
+             (unsigned)vm.getCodeLength(), (unsigned)vm.getInstructionCount());
+    return nullptr;
+}
+
+void NeoPixel::loadProgramFile() {
+    programFileChecked = true;
+    File file = LittleFS.open(PROGRAM_FILE, "r");
+    if (!file) {
+        return;
+    }
+    uint8_t data[4 + VM_MAX_PROGRAM];
+    size_t length = file.read(data, sizeof(data));
+    file.close();
+    const char* error = vm.load(data, length);
+    if (error) {
+        LOG_WARN("Saved pixel program rejected: %s", error);
+        return;
+    }
+    programCrc = crc32(data, length);
+}
+
+uint32_t NeoPixel::getProgramCrc() {
+    if (!programFileChecked) {
+        loadProgramFile();
+    }
+    return programCrc;
+}
+
+void NeoPixel::updateProgramPattern() {
+    if (!programFileChecked) {
+        loadProgramFile();
+    }
+    
+    // At reduced quality the program runs for half as many pixels spread over the
+    // whole strip (pos still spans 0..1), and each result is shown on two pixels
+    int shift = quality.getLevel() >= QUALITY_HALF_PIXELS ? 1 : 0;
+    int count = (NUM_PIXELS + shift) >> shift;
+    uint8_t rgb[NUM_PIXELS][3];
+    uint32_t start = micros();
+    int rendered = vm.render(SyncService::getInstance()->animationTimeMs(), rgb, count, VM_FRAME_BUDGET);
+    uint32_t elapsed = micros() - start;
+    if (rendered == 0) {
+        return;  // No program
+    }
+    if (rendered < count) {
+        programBudgetExhausted.inc();  // The rest keep last frame's colors
+    }
+    programPixelsPerSecond.set(elapsed > 0 ? (int32_t)((uint64_t)rendered * 1000000 / elapsed) : 0);
+    
+    for (int i = 0; i < NUM_PIXELS && (i >> shift) < rendered; i++) {
+        pixels.set(i, rgb[i >> shift][0], rgb[i >> shift][1], rgb[i >> shift][2]);
+    }
+    show();
 }
 
 bool NeoPixel::isAnimationActive() {
@@ -386,24 +758,11 @@ bool NeoPixel::isAnimationActive() {
             currentPattern == PATTERN_TWINKLE ||
             currentPattern == PATTERN_FIRE ||
             currentPattern == PATTERN_RAIN ||
-            currentPattern == PATTERN_COLOR_WIPE);
+            currentPattern == PATTERN_COLOR_WIPE ||
+            currentPattern == PATTERN_WEATHER ||
+            currentPattern == PATTERN_PROGRAM);
 }
 
 uint32_t NeoPixel::rgbToColor(int r, int g, int b) {
     return strip.Color(r, g, b);
 }
-
-String NeoPixel::getStatusJson() {
-    JsonDocument doc;
-    doc["brightness"] = brightness;
-    doc["pattern"] = currentPattern;
-    doc["pixels"] = JsonArray();
-    JsonArray arr = doc["pixels"].to<JsonArray>();
-    for (int i = 0; i < NUM_PIXELS; ++i) {
-        uint32_t c = pixelColors[i];
-        arr.add(c);
-    }
-    String out;
-    serializeJson(doc, out);
-    return out;
-}
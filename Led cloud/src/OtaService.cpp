@@ -0,0 +1,484 @@
+#include "OtaService.h"
+#include "Settings.h"
+#include "Log.h"
+#include "Crc32.h"
+#include <LittleFS.h>
+#include <new>
+#include <coredecls.h> // crc32()
+#include <eboot_command.h>
+
+extern "C" uint32_t _FS_start;
+
+OtaService* OtaService::instance = nullptr;
+
+const char* OtaService::STATE_FILE = "/ota.state";
+
+namespace {
+
+const uint32_t STATE_MAGIC = 0x324F434C;  // "LCO2"
+const uint8_t IMAGE_MAGIC = 0xE9;         // First byte of every ESP8266 application image
+const uint32_t FLASH_BASE = 0x40200000;   // Where flash is mapped in the address space
+
+uint32_t roundToSector(uint32_t size)
+{
+    return (size + OTA_SECTOR_SIZE - 1) & ~(uint32_t)(OTA_SECTOR_SIZE - 1);
+}
+
+/**
+ * @brief The update area in the chip's flash, through the SDK
+ *
+ * The sector data handed to write() is the inflater's 4-byte aligned window
+ * and always a whole sector, as spi_flash_write() requires. Sectors are
+ * erased by OtaService::loop() before the upload is accepted, so the
+ * writer's erase is a no-op here and the web server's callbacks only program.
+ */
+class EspFlashRegion : public FlashRegion {
+public:
+    explicit EspFlashRegion(uint32_t start) : start(start) {}
+
+    bool eraseSector(uint32_t offset) override
+    {
+        return true;
+    }
+
+    bool write(uint32_t offset, const uint8_t* data, size_t size) override
+    {
+        return ESP.flashWrite(start + offset, reinterpret_cast<const uint32_t*>(data), size);
+    }
+
+private:
+    uint32_t start;
+};
+
+EspFlashRegion* region = nullptr;
+
+const char* const PHASE_NAMES[] = {"idle", "erasing", "ready", "receiving", "verifying", "restarting"};
+
+} // namespace
+
+OtaService::OtaService()
+    : recordLoaded(false), phase(PHASE_IDLE), eraseNext(0), eraseEnd(0), verifyOffset(0), verifyCrc(0),
+      writer(nullptr), owner(nullptr), lastDataTime(0), completedTime(0), lastError("")
+{
+    memset(&record, 0, sizeof(record));
+    Metrics::add("ledcloud_ota_received_bytes_total", "Compressed firmware bytes received over /ota", received);
+    Metrics::add("ledcloud_ota_sectors_written_total", "Flash sectors written by firmware updates", sectorsWritten);
+    Metrics::add("ledcloud_ota_resumes_total", "Firmware uploads resumed from a saved commit point", resumes);
+    Metrics::add("ledcloud_ota_failures_total", "Firmware uploads that failed or stalled", failures);
+}
+
+OtaService* OtaService::getInstance()
+{
+    if (instance == nullptr)
+    {
+        instance = new OtaService();
+    }
+    return instance;
+}
+
+const char* OtaService::getStateName() const
+{
+    return PHASE_NAMES[phase];
+}
+
+/**
+ * @brief Flash address an image of this size is received at, or 0 if it does not fit
+ *
+ * The image goes at the top of the free space, right below the filesystem,
+ * so the address only depends on the image size and stays the same across
+ * a resume as long as the running sketch does not grow past it.
+ */
+uint32_t OtaService::updateArea(uint32_t imageSize)
+{
+    uint32_t sketchEnd = roundToSector(ESP.getSketchSize());
+    uint32_t areaEnd = (uint32_t)&_FS_start - FLASH_BASE;
+    uint32_t size = roundToSector(imageSize);
+    if (imageSize == 0 || size > areaEnd || areaEnd - size < sketchEnd)
+    {
+        return 0;
+    }
+    return areaEnd - size;
+}
+
+void OtaService::loadRecord()
+{
+    recordLoaded = true;
+    memset(&record, 0, sizeof(record));
+
+    File file = LittleFS.open(STATE_FILE, "r");
+    if (!file)
+    {
+        return;
+    }
+    bool ok = file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record) &&
+              record.magic == STATE_MAGIC &&
+              record.crc == crc32(&record, offsetof(ResumeRecord, crc));
+    file.close();
+    if (!ok)
+    {
+        LOG_WARN("%s is unreadable, the next update starts from the beginning", STATE_FILE);
+        memset(&record, 0, sizeof(record));
+        LittleFS.remove(STATE_FILE);
+    }
+}
+
+void OtaService::saveRecord()
+{
+    record.magic = STATE_MAGIC;
+    record.crc = crc32(&record, offsetof(ResumeRecord, crc));
+    File file = LittleFS.open(STATE_FILE, "w");
+    bool ok = file && file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record)) == sizeof(record);
+    if (file)
+    {
+        file.close();
+    }
+    if (!ok)
+    {
+        // The upload still goes on; only resuming it would start over
+        LOG_WARN("Failed to save OTA progress to %s", STATE_FILE);
+    }
+}
+
+/**
+ * @brief Compares every character whatever the first difference, so the time taken gives nothing away
+ */
+bool OtaService::isAuthorized(const char* token)
+{
+    size_t length = strlen(OTA_TOKEN);
+    if (length == 0 || token == nullptr || strlen(token) != length)
+    {
+        return false;
+    }
+    uint8_t difference = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        difference |= token[i] ^ OTA_TOKEN[i];
+    }
+    return difference == 0;
+}
+
+uint32_t OtaService::getResumeOffset(uint32_t imageSize, uint32_t packedCrc)
+{
+    if (!recordLoaded)
+    {
+        loadRecord();
+    }
+    if (record.magic != STATE_MAGIC || record.imageSize != imageSize || record.packedCrc != packedCrc ||
+        record.startAddress == 0 || record.startAddress != updateArea(imageSize))
+    {
+        return 0;
+    }
+    return record.committedInput;
+}
+
+const char* OtaService::prepare(uint32_t imageSize, uint32_t packedCrc, uint32_t imageCrc)
+{
+    if (isImageReceived())
+    {
+        return "An update is complete and is being applied";
+    }
+    if (writer != nullptr)
+    {
+        if (millis() - lastDataTime < OTA_STALL_TIMEOUT)
+        {
+            return "Another upload is in progress";
+        }
+        abort("Upload stalled");
+    }
+
+    uint32_t offset = getResumeOffset(imageSize, packedCrc);
+    if (offset > 0 && imageCrc != record.imageCrc)
+    {
+        return "imageCrc differs from the interrupted upload";
+    }
+    if (offset == 0)
+    {
+        uint32_t start = updateArea(imageSize);
+        if (start == 0)
+        {
+            return "Image does not fit in the free flash";
+        }
+        memset(&record, 0, sizeof(record));
+        record.imageSize = imageSize;
+        record.packedCrc = packedCrc;
+        record.imageCrc = imageCrc;
+        record.startAddress = start;
+        LittleFS.remove(STATE_FILE);
+    }
+
+    // Everything past the last commit point may hold a partly written sector from before
+    eraseNext = record.committedOutput;
+    eraseEnd = roundToSector(imageSize);
+    phase = PHASE_ERASING;
+    lastError = "";
+    LOG_INFO("Erasing %u KB of flash at 0x%06X for a firmware upload", (unsigned)((eraseEnd - eraseNext) / 1024),
+             (unsigned)(record.startAddress + eraseNext));
+    return nullptr;
+}
+
+const char* OtaService::begin(const void* uploader, uint32_t offset, uint32_t imageSize, uint32_t packedCrc,
+                              uint32_t imageCrc)
+{
+    if (phase != PHASE_READY || record.imageSize != imageSize || record.packedCrc != packedCrc ||
+        record.imageCrc != imageCrc)
+    {
+        return "Prepare this upload first (POST /ota/prepare) and wait for the ready state";
+    }
+    if (offset != record.committedInput)
+    {
+        return "Upload must start at resumeOffset";
+    }
+
+    delete region;
+    region = new (std::nothrow) EspFlashRegion(record.startAddress);
+    writer = region ? new (std::nothrow) OtaImageWriter(*region) : nullptr;
+    if (writer == nullptr)
+    {
+        failures.inc();
+        return "Not enough memory for the update";
+    }
+    const char* error = writer->begin(imageSize, IMAGE_MAGIC, record.committedInput, record.committedOutput);
+    if (error != nullptr)
+    {
+        abort(error);
+        return error;
+    }
+
+    owner = uploader;
+    lastDataTime = millis();
+    phase = PHASE_RECEIVING;
+    if (offset > 0)
+    {
+        resumes.inc();
+        LOG_INFO("Resuming firmware upload at %u of %u image bytes", (unsigned)record.committedOutput,
+                 (unsigned)imageSize);
+    }
+    else
+    {
+        LOG_INFO("Receiving a %u byte firmware image at 0x%06X", (unsigned)imageSize, (unsigned)record.startAddress);
+    }
+    return nullptr;
+}
+
+const char* OtaService::write(const void* uploader, const uint8_t* data, size_t length)
+{
+    if (writer == nullptr || uploader != owner)
+    {
+        return "No upload in progress";
+    }
+
+    uint32_t sectorsBefore = writer->getSectorsWritten();
+    uint32_t committedBefore = writer->getCommittedInput();
+    const char* error = writer->write(data, length);
+    received.inc(length);
+    sectorsWritten.inc(writer->getSectorsWritten() - sectorsBefore);
+    lastDataTime = millis();
+
+    // Everything up to a commit point is on flash, so it is safe to skip next time
+    if (writer->getCommittedInput() != committedBefore)
+    {
+        record.committedInput = writer->getCommittedInput();
+        record.committedOutput = writer->getCommittedOutput();
+        saveRecord();
+    }
+
+    if (error != nullptr)
+    {
+        abort(error);
+        return error;
+    }
+    if (writer->isComplete())
+    {
+        LOG_INFO("Firmware image received (%u bytes), reading it back", (unsigned)record.imageSize);
+        delete writer;
+        writer = nullptr;
+        owner = nullptr;
+        verifyOffset = 0;
+        verifyCrc = 0;
+        phase = PHASE_VERIFYING;
+    }
+    return nullptr;
+}
+
+void OtaService::release(const void* uploader)
+{
+    if (writer != nullptr && uploader == owner)
+    {
+        abort("Connection closed before the image was complete");
+    }
+}
+
+/**
+ * @brief The bootloader command that copies the received image over the sketch
+ */
+void OtaService::bootCommand(eboot_command& command) const
+{
+    memset(&command, 0, sizeof(command));
+    command.action = ACTION_COPY_RAW;
+    command.args[0] = record.startAddress;
+    command.args[1] = 0;
+    command.args[2] = record.imageSize;
+}
+
+/**
+ * @brief Whether RTC memory holds bootCommand(), intact
+ */
+bool OtaService::isBootCommandStored() const
+{
+    eboot_command expected;
+    eboot_command stored;
+    bootCommand(expected);
+    return eboot_command_read(&stored) == 0 && stored.action == expected.action &&
+           memcmp(stored.args, expected.args, sizeof(stored.args)) == 0;
+}
+
+/**
+ * @brief Write bootCommand() to RTC memory and read it back
+ */
+bool OtaService::storeBootCommand()
+{
+    eboot_command command;
+    bootCommand(command);
+    eboot_command_write(&command);
+    return isBootCommandStored();
+}
+
+/**
+ * @brief Read the next OTA_VERIFY_CHUNK of the image back from flash, checking it as the core's Updater does
+ * @return nullptr, or what is wrong with the image; it is all checked once verifyOffset reaches the image size
+ *
+ * The whole image is read, so a sector that did not program correctly or
+ * an image other than the one announced never reaches the bootloader.
+ */
+const char* OtaService::verifyNext()
+{
+    alignas(4) uint8_t buffer[256];
+    uint32_t end = min(verifyOffset + OTA_VERIFY_CHUNK, record.imageSize);
+    for (; verifyOffset < end; verifyOffset += sizeof(buffer))
+    {
+        // Reads whole buffers; past the end of the image the sector holds erased flash
+        if (!ESP.flashRead(record.startAddress + verifyOffset, reinterpret_cast<uint32_t*>(buffer), sizeof(buffer)))
+        {
+            return "Flash read failed";
+        }
+        // Header: magic, segment count, flash mode, flash size and frequency
+        if (verifyOffset == 0)
+        {
+            if (buffer[0] != IMAGE_MAGIC)
+            {
+                return "Not a firmware image for this device";
+            }
+            if (buffer[2] > FM_DOUT)
+            {
+                return "Image has an unknown flash mode";
+            }
+            uint32_t flashSize = ESP.magicFlashChipSize(buffer[3] >> 4);
+            if (flashSize == 0 || flashSize > ESP.getFlashChipRealSize())
+            {
+                return "Image is built for a larger flash chip";
+            }
+        }
+        verifyCrc = crc32Nibble(buffer, min((uint32_t)sizeof(buffer), record.imageSize - verifyOffset), verifyCrc);
+    }
+    if (verifyOffset >= record.imageSize && verifyCrc != record.imageCrc)
+    {
+        return "Image on flash does not match imageCrc";
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Has the bootloader copy the checked image over the sketch on the next boot
+ */
+void OtaService::finish()
+{
+    // Either way the saved commit points are done with; they would only lead back to this image
+    LittleFS.remove(STATE_FILE);
+    record.magic = 0;
+    if (!storeBootCommand())
+    {
+        abort("The bootloader command did not read back");
+        return;
+    }
+    LOG_INFO("Firmware image checked (%u bytes), restarting", (unsigned)record.imageSize);
+    phase = PHASE_RESTARTING;
+    completedTime = millis();
+}
+
+void OtaService::abort(const char* error)
+{
+    if (writer != nullptr)
+    {
+        LOG_WARN("Firmware upload stopped at %u bytes: %s", (unsigned)writer->getInputOffset(), error);
+    }
+    else
+    {
+        LOG_WARN("Firmware update stopped: %s", error);
+    }
+    failures.inc();
+    lastError = error;
+    delete writer;
+    writer = nullptr;
+    owner = nullptr;
+    phase = PHASE_IDLE;
+}
+
+void OtaService::loop()
+{
+    if (writer != nullptr && millis() - lastDataTime >= OTA_STALL_TIMEOUT)
+    {
+        abort("Upload stalled");
+    }
+
+    if (phase == PHASE_ERASING)
+    {
+        // A sector per run: each erase holds the CPU for tens of milliseconds
+        if (!ESP.flashEraseSector((record.startAddress + eraseNext) / OTA_SECTOR_SIZE))
+        {
+            abort("Flash erase failed");
+            return;
+        }
+        eraseNext += OTA_SECTOR_SIZE;
+        if (eraseNext >= eraseEnd)
+        {
+            phase = PHASE_READY;
+            LOG_INFO("Flash erased, ready for the firmware upload");
+        }
+    }
+
+    if (phase == PHASE_VERIFYING)
+    {
+        const char* error = verifyNext();
+        if (error != nullptr)
+        {
+            LittleFS.remove(STATE_FILE);
+            record.magic = 0;
+            abort(error);
+        }
+        else if (verifyOffset >= record.imageSize)
+        {
+            finish();
+        }
+    }
+
+    if (phase == PHASE_RESTARTING && millis() - completedTime >= OTA_RESTART_DELAY)
+    {
+        // Don't lose a settings change that is still waiting to be written
+        SettingsStore::getInstance()->flush();
+        Log::flush();
+        // Without the command the bootloader would start the old sketch again and the update would be lost silently
+        if (!isBootCommandStored())
+        {
+            LOG_WARN("The bootloader command was overwritten, writing it again");
+            if (!storeBootCommand())
+            {
+                LOG_ERROR("The bootloader command does not read back, not restarting");
+                failures.inc();
+                lastError = "The bootloader command did not read back";
+                phase = PHASE_IDLE;
+                return;
+            }
+        }
+        ESP.restart();
+    }
+}
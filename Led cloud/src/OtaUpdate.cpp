@@ -0,0 +1,722 @@
+#include "OtaUpdate.h"
+#include "Crc32.h"
+#include <string.h>
+
+namespace {
+
+// gzip header flags
+const uint8_t FLAG_HCRC = 0x02;
+const uint8_t FLAG_EXTRA = 0x04;
+const uint8_t FLAG_NAME = 0x08;
+const uint8_t FLAG_COMMENT = 0x10;
+
+// Base values and extra bits of length codes 257..285 and distance codes 0..29 (RFC 1951 3.2.5)
+const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                    8193, 12289, 16385, 24577};
+const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order in which code-length code lengths are sent
+const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+uint32_t readLe32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+} // namespace
+
+GzipInflater::GzipInflater()
+    : windowFill(0), in(nullptr), inEnd(nullptr)
+{
+    reset();
+}
+
+void GzipInflater::reset()
+{
+    bitBuffer = 0;
+    bitCount = 0;
+    state = STATE_HEADER;
+    error = nullptr;
+    headerCount = 0;
+    flags = 0;
+    skip = 0;
+    finalBlock = false;
+    crc = 0xFFFFFFFF;
+    memberOutput = 0;
+}
+
+void GzipInflater::resetWindow()
+{
+    reset();
+    windowFill = 0;
+}
+
+bool GzipInflater::fail(const char* message)
+{
+    error = message;
+    state = STATE_FAILED;
+    return false;
+}
+
+/**
+ * @brief Pull input bytes until count bits are buffered
+ * @return false if the input ran out first (the bits pulled so far stay buffered)
+ */
+bool GzipInflater::needBits(uint8_t count)
+{
+    while (bitCount < count)
+    {
+        if (in == inEnd)
+        {
+            return false;
+        }
+        bitBuffer |= (uint32_t)*in++ << bitCount;
+        bitCount += 8;
+    }
+    return true;
+}
+
+uint32_t GzipInflater::takeBits(uint8_t count)
+{
+    uint32_t value = bitBuffer & ((1UL << count) - 1);
+    bitBuffer >>= count;
+    bitCount -= count;
+    return value;
+}
+
+void GzipInflater::alignToByte()
+{
+    // At most 7 bits are ever left buffered, so this drops the rest of the current byte
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+/**
+ * @brief Decode one Huffman symbol, pulling input a byte at a time
+ * @return The symbol, -1 if the input ran out (nothing consumed), -2 for an invalid code
+ */
+int GzipInflater::decode(const uint16_t* count, const uint16_t* symbol)
+{
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (uint8_t length = 1; length <= 15; length++)
+    {
+        if (bitCount < length)
+        {
+            if (in == inEnd)
+            {
+                return -1;
+            }
+            bitBuffer |= (uint32_t)*in++ << bitCount;
+            bitCount += 8;
+        }
+        code |= (bitBuffer >> (length - 1)) & 1;
+        int codes = count[length];
+        if (code - first < codes)
+        {
+            takeBits(length);
+            return symbol[index + (code - first)];
+        }
+        index += codes;
+        first = (first + codes) << 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+/**
+ * @brief Canonical Huffman table from code lengths
+ * @return Negative if the lengths are over-subscribed
+ */
+int GzipInflater::buildTable(uint16_t* count, uint16_t* symbol, const uint8_t* lengths, int n)
+{
+    memset(count, 0, 16 * sizeof(uint16_t));
+    for (int i = 0; i < n; i++)
+    {
+        count[lengths[i]]++;
+    }
+    if (count[0] == n)
+    {
+        return 0;
+    }
+
+    int left = 1;
+    for (int length = 1; length <= 15; length++)
+    {
+        left = (left << 1) - count[length];
+        if (left < 0)
+        {
+            return left;
+        }
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int length = 1; length < 15; length++)
+    {
+        offsets[length + 1] = offsets[length] + count[length];
+    }
+    for (int i = 0; i < n; i++)
+    {
+        if (lengths[i] != 0)
+        {
+            symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+    return left;
+}
+
+void GzipInflater::buildFixedTables()
+{
+    int i = 0;
+    for (; i < 144; i++) codeLengths[i] = 8;
+    for (; i < 256; i++) codeLengths[i] = 9;
+    for (; i < 280; i++) codeLengths[i] = 7;
+    for (; i < 288; i++) codeLengths[i] = 8;
+    buildTable(lengthCount, lengthSymbol, codeLengths, 288);
+    for (i = 0; i < 30; i++) codeLengths[i] = 5;
+    buildTable(distanceCount, distanceSymbol, codeLengths, 30);
+}
+
+bool GzipInflater::buildDynamicTables()
+{
+    if (codeLengths[256] == 0)
+    {
+        return fail("Block has no end code");
+    }
+    if (buildTable(lengthCount, lengthSymbol, codeLengths, literalCodes) < 0 ||
+        buildTable(distanceCount, distanceSymbol, codeLengths + literalCodes, distanceCodes) < 0)
+    {
+        return fail("Invalid Huffman code lengths");
+    }
+    return true;
+}
+
+inline void GzipInflater::put(uint8_t value)
+{
+    window[windowFill++] = value;
+    crc = crc32NibbleByte(crc, value);
+    memberOutput++;
+}
+
+GzipInflater::Result GzipInflater::inflate(const uint8_t* input, size_t length, size_t& consumed)
+{
+    in = input;
+    inEnd = input + length;
+    Result result = NEED_INPUT;
+
+    while (result == NEED_INPUT)
+    {
+        if (windowFill == OTA_SECTOR_SIZE)
+        {
+            result = WINDOW_FULL;
+            break;
+        }
+
+        switch (state)
+        {
+        case STATE_HEADER:
+            while (headerCount < 10 && in < inEnd)
+            {
+                header[headerCount++] = *in++;
+            }
+            if (headerCount < 10)
+            {
+                goto out;
+            }
+            if (header[0] != 0x1F || header[1] != 0x8B || header[2] != 8)
+            {
+                fail("Not a gzip stream");
+                break;
+            }
+            flags = header[3];
+            headerCount = 0;
+            state = STATE_EXTRA_LENGTH;
+            break;
+
+        case STATE_EXTRA_LENGTH:
+            // Optional fields in the order RFC 1952 lists them; each state falls to the next when absent
+            if (flags & FLAG_EXTRA)
+            {
+                while (headerCount < 2 && in < inEnd)
+                {
+                    header[headerCount++] = *in++;
+                }
+                if (headerCount < 2)
+                {
+                    goto out;
+                }
+                skip = header[0] | (header[1] << 8);
+                flags &= ~FLAG_EXTRA;
+                headerCount = 0;
+                state = STATE_SKIP;
+                break;
+            }
+            state = STATE_NAME;
+            break;
+
+        case STATE_SKIP:
+            while (skip > 0 && in < inEnd)
+            {
+                in++;
+                skip--;
+            }
+            if (skip > 0)
+            {
+                goto out;
+            }
+            state = STATE_NAME;  // Fields already read have had their flags cleared
+            break;
+
+        case STATE_NAME:
+        case STATE_COMMENT:
+        {
+            uint8_t flag = state == STATE_NAME ? FLAG_NAME : FLAG_COMMENT;
+            if (flags & flag)
+            {
+                while (in < inEnd && *in != 0)
+                {
+                    in++;
+                }
+                if (in == inEnd)
+                {
+                    goto out;
+                }
+                in++;
+                flags &= ~flag;
+            }
+            if (state == STATE_NAME)
+            {
+                state = STATE_COMMENT;
+            }
+            else if (flags & FLAG_HCRC)
+            {
+                flags &= ~FLAG_HCRC;
+                skip = 2;
+                state = STATE_SKIP;
+            }
+            else
+            {
+                state = STATE_BLOCK_HEADER;
+            }
+            break;
+        }
+
+        case STATE_BLOCK_HEADER:
+            if (finalBlock)
+            {
+                alignToByte();
+                headerCount = 0;
+                state = STATE_TRAILER;
+                break;
+            }
+            if (!needBits(3))
+            {
+                goto out;
+            }
+            finalBlock = takeBits(1);
+            switch (takeBits(2))
+            {
+            case 0:
+                alignToByte();
+                headerCount = 0;
+                state = STATE_STORED_LENGTH;
+                break;
+            case 1:
+                buildFixedTables();
+                state = STATE_CODES;
+                break;
+            case 2:
+                state = STATE_TABLE_COUNTS;
+                break;
+            default:
+                fail("Invalid block type");
+                break;
+            }
+            break;
+
+        case STATE_STORED_LENGTH:
+            while (headerCount < 4 && in < inEnd)
+            {
+                header[headerCount++] = *in++;
+            }
+            if (headerCount < 4)
+            {
+                goto out;
+            }
+            skip = header[0] | (header[1] << 8);
+            if ((uint16_t)~(header[2] | (header[3] << 8)) != skip)
+            {
+                fail("Stored block length check failed");
+                break;
+            }
+            state = STATE_STORED;
+            break;
+
+        case STATE_STORED:
+            while (skip > 0 && in < inEnd && windowFill < OTA_SECTOR_SIZE)
+            {
+                put(*in++);
+                skip--;
+            }
+            if (skip == 0)
+            {
+                state = STATE_BLOCK_HEADER;
+            }
+            else if (in == inEnd)
+            {
+                goto out;
+            }
+            break;
+
+        case STATE_TABLE_COUNTS:
+            if (!needBits(14))
+            {
+                goto out;
+            }
+            literalCodes = takeBits(5) + 257;
+            distanceCodes = takeBits(5) + 1;
+            codeLengthCodes = takeBits(4) + 4;
+            if (literalCodes > 286 || distanceCodes > 30)
+            {
+                fail("Too many length or distance codes");
+                break;
+            }
+            memset(codeLengths, 0, 19);
+            lengthIndex = 0;
+            state = STATE_CODE_LENGTH_CODES;
+            break;
+
+        case STATE_CODE_LENGTH_CODES:
+            while (lengthIndex < codeLengthCodes)
+            {
+                if (!needBits(3))
+                {
+                    goto out;
+                }
+                codeLengths[CODE_LENGTH_ORDER[lengthIndex++]] = takeBits(3);
+            }
+            // The code-length code borrows the distance table until the real one is built
+            if (buildTable(distanceCount, distanceSymbol, codeLengths, 19) != 0)
+            {
+                fail("Invalid code length code");
+                break;
+            }
+            lengthIndex = 0;
+            state = STATE_CODE_LENGTHS;
+            break;
+
+        case STATE_CODE_LENGTHS:
+            while (lengthIndex < literalCodes + distanceCodes)
+            {
+                int symbol = decode(distanceCount, distanceSymbol);
+                if (symbol == -1)
+                {
+                    goto out;
+                }
+                if (symbol < 0)
+                {
+                    fail("Invalid code length");
+                    break;
+                }
+                if (symbol < 16)
+                {
+                    codeLengths[lengthIndex++] = symbol;
+                    continue;
+                }
+                if (symbol == 16 && lengthIndex == 0)
+                {
+                    fail("Repeat with no previous length");
+                    break;
+                }
+                pendingSymbol = symbol;
+                state = STATE_CODE_LENGTH_REPEAT;
+                break;
+            }
+            if (state == STATE_CODE_LENGTHS && lengthIndex == literalCodes + distanceCodes)
+            {
+                if (buildDynamicTables())
+                {
+                    state = STATE_CODES;
+                }
+            }
+            break;
+
+        case STATE_CODE_LENGTH_REPEAT:
+        {
+            uint8_t extra = pendingSymbol == 16 ? 2 : (pendingSymbol == 17 ? 3 : 7);
+            if (!needBits(extra))
+            {
+                goto out;
+            }
+            uint8_t value = pendingSymbol == 16 ? codeLengths[lengthIndex - 1] : 0;
+            uint16_t repeat = takeBits(extra) + (pendingSymbol == 18 ? 11 : 3);
+            if (lengthIndex + repeat > literalCodes + distanceCodes)
+            {
+                fail("Code lengths overrun");
+                break;
+            }
+            while (repeat--)
+            {
+                codeLengths[lengthIndex++] = value;
+            }
+            state = STATE_CODE_LENGTHS;
+            if (lengthIndex == literalCodes + distanceCodes && buildDynamicTables())
+            {
+                state = STATE_CODES;
+            }
+            break;
+        }
+
+        case STATE_CODES:
+            // Literals are the bulk of the work: stay in this loop until something else comes up
+            while (windowFill < OTA_SECTOR_SIZE)
+            {
+                int symbol = decode(lengthCount, lengthSymbol);
+                if (symbol == -1)
+                {
+                    goto out;
+                }
+                if (symbol < 0)
+                {
+                    fail("Invalid literal/length code");
+                    break;
+                }
+                if (symbol < 256)
+                {
+                    put(symbol);
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    state = STATE_BLOCK_HEADER;
+                    break;
+                }
+                if (symbol > 285)
+                {
+                    fail("Invalid length code");
+                    break;
+                }
+                pendingSymbol = symbol - 257;
+                state = STATE_LENGTH_EXTRA;
+                break;
+            }
+            break;
+
+        case STATE_LENGTH_EXTRA:
+            if (!needBits(LENGTH_EXTRA[pendingSymbol]))
+            {
+                goto out;
+            }
+            copyLength = LENGTH_BASE[pendingSymbol] + takeBits(LENGTH_EXTRA[pendingSymbol]);
+            state = STATE_DISTANCE;
+            break;
+
+        case STATE_DISTANCE:
+        {
+            int symbol = decode(distanceCount, distanceSymbol);
+            if (symbol == -1)
+            {
+                goto out;
+            }
+            if (symbol < 0 || symbol > 29)
+            {
+                fail("Invalid distance code");
+                break;
+            }
+            pendingSymbol = symbol;
+            state = STATE_DISTANCE_EXTRA;
+            break;
+        }
+
+        case STATE_DISTANCE_EXTRA:
+        {
+            if (!needBits(DISTANCE_EXTRA[pendingSymbol]))
+            {
+                goto out;
+            }
+            uint32_t distance = DISTANCE_BASE[pendingSymbol] + takeBits(DISTANCE_EXTRA[pendingSymbol]);
+            if (distance > OTA_SECTOR_SIZE)
+            {
+                fail("Back-reference beyond the 4 KB window; pack the image with scripts/ota_pack.py");
+                break;
+            }
+            if (distance > memberOutput)
+            {
+                fail("Back-reference before the start of the stream");
+                break;
+            }
+            copyDistance = distance;
+            state = STATE_COPY;
+            break;
+        }
+
+        case STATE_COPY:
+        {
+            // The ring is exactly one window long, so the source is always still in it
+            size_t from = (windowFill + OTA_SECTOR_SIZE - copyDistance) % OTA_SECTOR_SIZE;
+            while (copyLength > 0 && windowFill < OTA_SECTOR_SIZE)
+            {
+                put(window[from]);
+                from = from + 1 == OTA_SECTOR_SIZE ? 0 : from + 1;
+                copyLength--;
+            }
+            if (copyLength == 0)
+            {
+                state = STATE_CODES;
+            }
+            break;
+        }
+
+        case STATE_TRAILER:
+            while (headerCount < 8 && in < inEnd)
+            {
+                header[headerCount++] = *in++;
+            }
+            if (headerCount < 8)
+            {
+                goto out;
+            }
+            if (readLe32(header) != (crc ^ 0xFFFFFFFF))
+            {
+                fail("CRC mismatch");
+                break;
+            }
+            if (readLe32(header + 4) != memberOutput)
+            {
+                fail("Length mismatch");
+                break;
+            }
+            reset();
+            result = MEMBER_END;
+            break;
+
+        case STATE_FAILED:
+            result = FAILED;
+            break;
+        }
+    }
+
+out:
+    consumed = in - input;
+    return result;
+}
+
+OtaImageWriter::OtaImageWriter(FlashRegion& region)
+    : region(region), imageSize(0), magic(0), inputOffset(0), sectorOffset(0), committedInput(0),
+      committedOutput(0), sectorsWritten(0), complete(false), error(nullptr)
+{
+}
+
+const char* OtaImageWriter::begin(uint32_t size, uint8_t firstByte, uint32_t input, uint32_t output)
+{
+    if (size == 0 || output % OTA_SECTOR_SIZE != 0 || output > size || (output == 0 && input != 0))
+    {
+        return error = "Invalid image size or resume point";
+    }
+    inflater.resetWindow();
+    imageSize = size;
+    magic = firstByte;
+    inputOffset = input;
+    sectorOffset = output;
+    committedInput = input;
+    committedOutput = output;
+    sectorsWritten = 0;
+    complete = false;
+    error = nullptr;
+    return nullptr;
+}
+
+/**
+ * @brief Erase the window's sector and write the first used bytes of the window to it
+ */
+const char* OtaImageWriter::flushSector(size_t used)
+{
+    uint8_t* data = inflater.getWindow();
+    if (sectorOffset == 0 && data[0] != magic)
+    {
+        return "Not a firmware image for this device";
+    }
+    if (used < OTA_SECTOR_SIZE)
+    {
+        memset(data + used, 0xFF, OTA_SECTOR_SIZE - used);  // Erased-flash value past the end of the image
+    }
+    if (!region.eraseSector(sectorOffset) || !region.write(sectorOffset, data, OTA_SECTOR_SIZE))
+    {
+        return "Flash erase or write failed";
+    }
+    sectorsWritten++;
+    sectorOffset += OTA_SECTOR_SIZE;
+    inflater.windowFlushed();
+    return nullptr;
+}
+
+const char* OtaImageWriter::write(const uint8_t* data, size_t length)
+{
+    if (error)
+    {
+        return error;
+    }
+    while (length > 0)
+    {
+        if (complete)
+        {
+            return error = "Data after the end of the image";
+        }
+
+        size_t consumed = 0;
+        GzipInflater::Result result = inflater.inflate(data, length, consumed);
+        data += consumed;
+        length -= consumed;
+        inputOffset += consumed;
+
+        switch (result)
+        {
+        case GzipInflater::NEED_INPUT:
+            break;
+        case GzipInflater::WINDOW_FULL:
+            if (sectorOffset + OTA_SECTOR_SIZE > imageSize)
+            {
+                return error = "Image is larger than announced";
+            }
+            if ((error = flushSector(OTA_SECTOR_SIZE)) != nullptr)
+            {
+                return error;
+            }
+            break;
+        case GzipInflater::MEMBER_END:
+        {
+            uint32_t output = getOutputOffset();
+            if (output > imageSize)
+            {
+                return error = "Image is larger than announced";
+            }
+            if (output == imageSize)
+            {
+                if (inflater.getWindowFill() > 0 && (error = flushSector(inflater.getWindowFill())) != nullptr)
+                {
+                    return error;
+                }
+                complete = true;
+            }
+            // Everything up to here is on flash: a later upload can start again from this point
+            if (inflater.getWindowFill() == 0)
+            {
+                committedInput = inputOffset;
+                committedOutput = output;
+            }
+            break;
+        }
+        case GzipInflater::FAILED:
+            return error = inflater.getError();
+        }
+    }
+    return nullptr;
+}
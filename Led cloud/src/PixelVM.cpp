@@ -0,0 +1,357 @@
+#include "PixelVM.h"
+#include <string.h>
+
+namespace {
+
+const int32_t ONE = 65536;  // 1.0 in Q16.16
+
+// Stack effect and operand size of each opcode, for load() to verify programs
+struct OpInfo {
+    uint8_t pops;
+    uint8_t pushes;
+    uint8_t operandBytes;
+};
+
+const OpInfo OP_INFO[OP_COUNT_OF_OPS] = {
+    {0, 1, 4},  // PUSH
+    {0, 1, 0},  // INDEX
+    {0, 1, 0},  // POS
+    {0, 1, 0},  // TIME
+    {0, 1, 0},  // COUNT
+    {0, 1, 1},  // LOAD
+    {1, 0, 1},  // STORE
+    {1, 2, 0},  // DUP
+    {2, 2, 0},  // SWAP
+    {1, 0, 0},  // POP
+    {2, 1, 0},  // ADD
+    {2, 1, 0},  // SUB
+    {2, 1, 0},  // MUL
+    {2, 1, 0},  // DIV
+    {2, 1, 0},  // MOD
+    {1, 1, 0},  // NEG
+    {1, 1, 0},  // ABS
+    {2, 1, 0},  // MIN
+    {2, 1, 0},  // MAX
+    {1, 1, 0},  // FRAC
+    {1, 1, 0},  // FLOOR
+    {1, 1, 0},  // CLAMP
+    {2, 1, 0},  // LT
+    {3, 1, 0},  // SELECT
+    {1, 1, 0},  // SIN
+    {1, 1, 0},  // NOISE
+    {1, 3, 1},  // PALETTE
+};
+
+// First quarter of a sine wave in Q16.16 (65535 stands in for 1.0)
+const uint16_t SINE_QUARTER[65] = {
+    0, 1608, 3216, 4821, 6424, 8022, 9616, 11204,
+    12785, 14359, 15924, 17479, 19024, 20557, 22078, 23586,
+    25080, 26558, 28020, 29466, 30893, 32303, 33692, 35062,
+    36410, 37736, 39040, 40320, 41576, 42806, 44011, 45190,
+    46341, 47464, 48559, 49624, 50660, 51665, 52639, 53581,
+    54491, 55368, 56212, 57022, 57798, 58538, 59244, 59914,
+    60547, 61145, 61705, 62228, 62714, 63162, 63572, 63944,
+    64277, 64571, 64827, 65043, 65220, 65358, 65457, 65516,
+    65535,
+};
+
+// Eight colour stops per palette; t = 0..1 runs through them and wraps back to the first
+const uint8_t PALETTES[PixelVM::PALETTE_COUNT][8][3] = {
+    // Rainbow
+    {{255, 0, 0}, {255, 128, 0}, {255, 255, 0}, {0, 255, 0}, {0, 255, 255}, {0, 0, 255}, {128, 0, 255}, {255, 0, 128}},
+    // Fire
+    {{0, 0, 0}, {64, 0, 0}, {160, 16, 0}, {255, 64, 0}, {255, 140, 0}, {255, 220, 40}, {255, 140, 0}, {120, 8, 0}},
+    // Ocean
+    {{0, 0, 40}, {0, 20, 90}, {0, 60, 160}, {0, 120, 200}, {40, 180, 220}, {0, 120, 200}, {0, 60, 160}, {0, 20, 90}},
+    // Forest
+    {{0, 40, 0}, {20, 80, 10}, {60, 120, 20}, {120, 160, 40}, {60, 120, 20}, {20, 90, 40}, {0, 60, 30}, {10, 50, 10}},
+};
+
+int32_t sine(int32_t turns)
+{
+    uint32_t phase = (uint32_t)turns & 0xFFFF;    // Fraction of a turn, 16 bits
+    uint32_t quadrant = phase >> 14;
+    uint32_t within = phase & 0x3FFF;
+    if (quadrant & 1)
+    {
+        within = 0x4000 - within;                 // Falling half of each lobe
+    }
+    uint32_t i = within >> 8;
+    int32_t value = SINE_QUARTER[i];
+    if (i < 64)
+    {
+        value += ((SINE_QUARTER[i + 1] - value) * (int32_t)(within & 0xFF)) >> 8;
+    }
+    return quadrant >= 2 ? -value : value;
+}
+
+int32_t hash(int32_t n)
+{
+    uint32_t x = (uint32_t)n * 0x9E3779B1u;
+    x ^= x >> 15;
+    x *= 0x85EBCA77u;
+    x ^= x >> 13;
+    return (int32_t)(x & 0xFFFF);                 // 0..1 in Q16.16
+}
+
+int32_t noise(int32_t x)
+{
+    int32_t cell = x >> 16;
+    int32_t f = x & 0xFFFF;
+    int32_t smooth = (int32_t)(((int64_t)f * f >> 16) * (3 * ONE - 2 * f) >> 16);
+    int32_t a = hash(cell);
+    int32_t b = hash(cell + 1);
+    return a + (int32_t)(((int64_t)(b - a) * smooth) >> 16);
+}
+
+// Addition, subtraction and negation wrap around like the hardware's, instead of being undefined on overflow
+int32_t wrapAdd(int32_t a, int32_t b)
+{
+    return (int32_t)((uint32_t)a + (uint32_t)b);
+}
+
+int32_t wrapSub(int32_t a, int32_t b)
+{
+    return (int32_t)((uint32_t)a - (uint32_t)b);
+}
+
+int32_t wrapNeg(int32_t a)
+{
+    return (int32_t)(0u - (uint32_t)a);
+}
+
+int32_t multiply(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b) >> 16);
+}
+
+int32_t divide(int32_t a, int32_t b)
+{
+    return b == 0 ? 0 : (int32_t)(uint32_t)((int64_t)a * ONE / b);
+}
+
+uint8_t toByte(int32_t v)
+{
+    v = v < 0 ? 0 : (v > ONE ? ONE : v);
+    return (uint8_t)((v * 255 + ONE / 2) >> 16);
+}
+
+int32_t read32(const uint8_t* p)
+{
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+} // namespace
+
+PixelVM::PixelVM()
+    : codeLength(0), instructionCount(0)
+{
+}
+
+const char* PixelVM::load(const uint8_t* data, size_t length)
+{
+    codeLength = 0;
+    if (length < 4 || (uint32_t)read32(data) != MAGIC)
+    {
+        return "Not a PixelVM program";
+    }
+    data += 4;
+    length -= 4;
+    if (length == 0 || length > VM_MAX_PROGRAM)
+    {
+        return "Program is empty or too long";
+    }
+
+    int depth = 0;
+    uint16_t instructions = 0;
+    for (size_t pc = 0; pc < length; instructions++)
+    {
+        uint8_t op = data[pc];
+        if (op >= OP_COUNT_OF_OPS)
+        {
+            return "Unknown opcode";
+        }
+        const OpInfo& info = OP_INFO[op];
+        if (pc + 1 + info.operandBytes > length)
+        {
+            return "Truncated operand";
+        }
+        if ((op == OP_LOAD || op == OP_STORE) && data[pc + 1] >= VM_REGISTERS)
+        {
+            return "Register out of range";
+        }
+        if (op == OP_PALETTE && data[pc + 1] >= PALETTE_COUNT)
+        {
+            return "Palette out of range";
+        }
+        if (depth < info.pops)
+        {
+            return "Stack underflow";
+        }
+        depth += info.pushes - info.pops;
+        if (depth > VM_STACK_DEPTH)
+        {
+            return "Stack overflow";
+        }
+        pc += 1 + info.operandBytes;
+    }
+    if (depth != 3)
+    {
+        return "Program must leave exactly r, g, b on the stack";
+    }
+
+    memcpy(code, data, length);
+    codeLength = length;
+    instructionCount = instructions;
+    return nullptr;
+}
+
+int PixelVM::render(uint32_t timeMs, uint8_t (*rgb)[3], int count, uint32_t budget)
+{
+    if (!isLoaded())
+    {
+        return 0;
+    }
+
+    int32_t time = (int32_t)((uint64_t)(timeMs % 32768000UL) * ONE / 1000);
+    int32_t span = count > 1 ? count - 1 : 1;
+    int rendered = 0;
+    for (; rendered < count && budget >= instructionCount; rendered++)
+    {
+        run(rendered, divide(rendered, span), time, count, rgb[rendered]);
+        budget -= instructionCount;
+    }
+    return rendered;
+}
+
+/**
+ * @brief Runs the program for one pixel; load() has already ruled out bad operands and stack errors
+ */
+void PixelVM::run(int32_t index, int32_t pos, int32_t time, int32_t count, uint8_t* rgb) const
+{
+    int32_t stack[VM_STACK_DEPTH];
+    int32_t registers[VM_REGISTERS] = {0};
+    int sp = 0;
+
+    for (size_t pc = 0; pc < codeLength;)
+    {
+        uint8_t op = code[pc++];
+        switch (op)
+        {
+        case OP_PUSH:
+            stack[sp++] = read32(&code[pc]);
+            pc += 4;
+            break;
+        case OP_INDEX:
+            stack[sp++] = index << 16;
+            break;
+        case OP_POS:
+            stack[sp++] = pos;
+            break;
+        case OP_TIME:
+            stack[sp++] = time;
+            break;
+        case OP_COUNT:
+            stack[sp++] = count << 16;
+            break;
+        case OP_LOAD:
+            stack[sp++] = registers[code[pc++]];
+            break;
+        case OP_STORE:
+            registers[code[pc++]] = stack[--sp];
+            break;
+        case OP_DUP:
+            stack[sp] = stack[sp - 1];
+            sp++;
+            break;
+        case OP_SWAP:
+        {
+            int32_t top = stack[sp - 1];
+            stack[sp - 1] = stack[sp - 2];
+            stack[sp - 2] = top;
+            break;
+        }
+        case OP_POP:
+            sp--;
+            break;
+        case OP_ADD:
+            sp--;
+            stack[sp - 1] = wrapAdd(stack[sp - 1], stack[sp]);
+            break;
+        case OP_SUB:
+            sp--;
+            stack[sp - 1] = wrapSub(stack[sp - 1], stack[sp]);
+            break;
+        case OP_MUL:
+            sp--;
+            stack[sp - 1] = multiply(stack[sp - 1], stack[sp]);
+            break;
+        case OP_DIV:
+            sp--;
+            stack[sp - 1] = divide(stack[sp - 1], stack[sp]);
+            break;
+        case OP_MOD:
+            sp--;
+            // x % -1 is 0, but INT32_MIN % -1 traps on most CPUs
+            stack[sp - 1] = stack[sp] == 0 || stack[sp] == -1 ? 0 : stack[sp - 1] % stack[sp];
+            break;
+        case OP_NEG:
+            stack[sp - 1] = wrapNeg(stack[sp - 1]);
+            break;
+        case OP_ABS:
+            stack[sp - 1] = stack[sp - 1] < 0 ? wrapNeg(stack[sp - 1]) : stack[sp - 1];
+            break;
+        case OP_MIN:
+            sp--;
+            stack[sp - 1] = stack[sp] < stack[sp - 1] ? stack[sp] : stack[sp - 1];
+            break;
+        case OP_MAX:
+            sp--;
+            stack[sp - 1] = stack[sp] > stack[sp - 1] ? stack[sp] : stack[sp - 1];
+            break;
+        case OP_FRAC:
+            stack[sp - 1] &= 0xFFFF;
+            break;
+        case OP_FLOOR:
+            stack[sp - 1] &= ~0xFFFF;
+            break;
+        case OP_CLAMP:
+            stack[sp - 1] = stack[sp - 1] < 0 ? 0 : (stack[sp - 1] > ONE ? ONE : stack[sp - 1]);
+            break;
+        case OP_LT:
+            sp--;
+            stack[sp - 1] = stack[sp - 1] < stack[sp] ? ONE : 0;
+            break;
+        case OP_SELECT:
+            sp -= 2;
+            stack[sp - 1] = stack[sp - 1] > 0 ? stack[sp] : stack[sp + 1];
+            break;
+        case OP_SIN:
+            stack[sp - 1] = sine(stack[sp - 1]);
+            break;
+        case OP_NOISE:
+            stack[sp - 1] = noise(stack[sp - 1]);
+            break;
+        case OP_PALETTE:
+        {
+            const uint8_t (*palette)[3] = PALETTES[code[pc++]];
+            uint32_t scaled = ((uint32_t)stack[sp - 1] & 0xFFFF) * 8;   // Q16.16 position among the 8 stops
+            uint32_t stop = scaled >> 16;
+            int32_t weight = scaled & 0xFFFF;
+            const uint8_t* from = palette[stop];
+            const uint8_t* to = palette[(stop + 1) & 7];
+            sp--;
+            for (int c = 0; c < 3; c++)
+            {
+                int32_t value = from[c] + (((to[c] - from[c]) * weight) >> 16);
+                stack[sp++] = value * 257;                             // 0..255 to 0..1
+            }
+            break;
+        }
+        }
+    }
+
+    rgb[0] = toByte(stack[0]);
+    rgb[1] = toByte(stack[1]);
+    rgb[2] = toByte(stack[2]);
+}
@@ -0,0 +1,286 @@
+#include "Preset.h"
+#include "NeoPixel.h"
+#include "Log.h"
+#include <LittleFS.h>
+#include <coredecls.h> // crc32()
+
+PresetStore* PresetStore::instance = nullptr;
+
+const char* PresetStore::PRESET_FILE = "/presets.bin";
+
+namespace {
+
+const uint32_t PRESET_MAGIC = 0x3150434C; // "LCP1"
+const uint16_t PRESET_VERSION = 2;       // 2: programCrc
+const uint32_t FRAME_US = 50000;          // One frame of the NeoPixel task
+
+// File layout: header followed by PRESET_SLOTS records
+struct PresetHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t slots;
+    uint8_t reserved;
+    uint16_t recordSize;   // sizeof(PresetRecord); changes with NEOPIXEL_COUNT
+    uint16_t reserved2;
+};
+
+// Recall time buckets (us), up to one frame
+const uint32_t RECALL_TIME_BOUNDS[] = {250, 500, 1000, 2000, 5000, 10000, 20000, FRAME_US};
+
+size_t slotOffset(int slot)
+{
+    return sizeof(PresetHeader) + (size_t)slot * sizeof(PresetRecord);
+}
+
+} // namespace
+
+PresetStore::PresetStore()
+    : indexed(false), lastRecallUs(0),
+      recallTimeUs(RECALL_TIME_BOUNDS, sizeof(RECALL_TIME_BOUNDS) / sizeof(RECALL_TIME_BOUNDS[0]))
+{
+    Metrics::add("ledcloud_preset_saves_total", "LED presets saved", saves);
+    Metrics::add("ledcloud_preset_recalls_total", "LED presets recalled", recalls);
+    Metrics::add("ledcloud_preset_failures_total", "LED preset saves or recalls that failed", failures);
+    Metrics::add("ledcloud_preset_recall_us", "Time to read a preset slot and show it (us)", recallTimeUs);
+}
+
+PresetStore* PresetStore::getInstance()
+{
+    if (instance == nullptr)
+    {
+        instance = new PresetStore();
+    }
+    return instance;
+}
+
+/**
+ * @brief Reads the name of every used slot into RAM
+ *
+ * A missing file, or one written for a different strip length, reads as all
+ * slots empty; the next save recreates it.
+ */
+void PresetStore::loadIndex()
+{
+    indexed = true;
+    memset(names, 0, sizeof(names));
+    memset(used, 0, sizeof(used));
+
+    File file = LittleFS.open(PRESET_FILE, "r");
+    if (!file)
+    {
+        return;
+    }
+
+    PresetHeader header;
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != PRESET_MAGIC || header.version != PRESET_VERSION ||
+        header.slots != PRESET_SLOTS || header.recordSize != sizeof(PresetRecord))
+    {
+        LOG_WARN("%s does not match this firmware, presets start empty", PRESET_FILE);
+        file.close();
+        LittleFS.remove(PRESET_FILE);
+        return;
+    }
+
+    // Only the fixed part of each record; the pixels are read on recall
+    const size_t fixedSize = offsetof(PresetRecord, crc);
+    for (int slot = 0; slot < PRESET_SLOTS; slot++)
+    {
+        PresetRecord record;
+        if (!file.seek(slotOffset(slot)) ||
+            file.read(reinterpret_cast<uint8_t*>(&record), fixedSize) != fixedSize || !record.used)
+        {
+            continue;
+        }
+        used[slot] = true;
+        memcpy(names[slot], record.name, PRESET_NAME_MAX);
+        names[slot][PRESET_NAME_MAX - 1] = '\0';
+    }
+    file.close();
+}
+
+/**
+ * @brief Writes the header and empty slots, so later saves can write in place
+ */
+bool PresetStore::createFile()
+{
+    File file = LittleFS.open(PRESET_FILE, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    PresetHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PRESET_MAGIC;
+    header.version = PRESET_VERSION;
+    header.slots = PRESET_SLOTS;
+    header.recordSize = sizeof(PresetRecord);
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+
+    PresetRecord empty;
+    memset(&empty, 0, sizeof(empty));
+    for (int slot = 0; slot < PRESET_SLOTS && ok; slot++)
+    {
+        ok = file.write(reinterpret_cast<const uint8_t*>(&empty), sizeof(empty)) == sizeof(empty);
+    }
+    file.close();
+    return ok;
+}
+
+int PresetStore::find(const char* name)
+{
+    if (!indexed)
+    {
+        loadIndex();
+    }
+    for (int slot = 0; slot < PRESET_SLOTS; slot++)
+    {
+        if (used[slot] && strncmp(names[slot], name, PRESET_NAME_MAX - 1) == 0)
+        {
+            return slot;
+        }
+    }
+    return INVALID_SLOT;
+}
+
+bool PresetStore::isUsed(int slot)
+{
+    if (!indexed)
+    {
+        loadIndex();
+    }
+    return slot >= 0 && slot < PRESET_SLOTS && used[slot];
+}
+
+const char* PresetStore::getName(int slot)
+{
+    return isUsed(slot) ? names[slot] : "";
+}
+
+int PresetStore::save(const char* name, int slot)
+{
+    if (name == nullptr || name[0] == '\0' || slot < INVALID_SLOT || slot >= PRESET_SLOTS)
+    {
+        failures.inc();
+        return INVALID_SLOT;
+    }
+
+    // Before any write: loading drops a file from another firmware, which
+    // would otherwise take this slot and then be deleted on first read
+    if (!indexed)
+    {
+        loadIndex();
+    }
+
+    // Same name overwrites, otherwise the first free slot
+    if (slot == INVALID_SLOT)
+    {
+        slot = find(name);
+    }
+    for (int i = 0; i < PRESET_SLOTS && slot == INVALID_SLOT; i++)
+    {
+        if (!used[i])
+        {
+            slot = i;
+        }
+    }
+    if (slot == INVALID_SLOT)
+    {
+        LOG_WARN("No free preset slot for '%s'", name);
+        failures.inc();
+        return INVALID_SLOT;
+    }
+
+    NeoPixel* neoPixel = NeoPixel::getInstance();
+    PresetRecord record;
+    memset(&record, 0, sizeof(record));
+    record.used = 1;
+    record.pattern = neoPixel->getPattern();
+    record.brightness = constrain(neoPixel->getBrightness(), 0, 255);
+    if (record.pattern == PATTERN_PROGRAM)
+    {
+        record.programCrc = neoPixel->getProgramCrc();
+    }
+    strncpy(record.name, name, PRESET_NAME_MAX - 1);
+    for (int i = 0; i < NEOPIXEL_COUNT; i++)
+    {
+        uint32_t color = neoPixel->getPixelColor(i);
+        record.pixels[i][0] = (color >> 16) & 0xFF;
+        record.pixels[i][1] = (color >> 8) & 0xFF;
+        record.pixels[i][2] = color & 0xFF;
+    }
+    record.crc = crc32(record.pixels, sizeof(record.pixels));
+
+    if (!LittleFS.exists(PRESET_FILE) && !createFile())
+    {
+        LOG_ERROR("Failed to create %s", PRESET_FILE);
+        failures.inc();
+        return INVALID_SLOT;
+    }
+
+    // LittleFS commits the slot on close, so a power cut keeps the old contents
+    File file = LittleFS.open(PRESET_FILE, "r+");
+    bool ok = file && file.seek(slotOffset(slot)) &&
+              file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record)) == sizeof(record);
+    if (file)
+    {
+        file.close();
+    }
+    if (!ok)
+    {
+        LOG_ERROR("Failed to write preset slot %d", slot);
+        failures.inc();
+        return INVALID_SLOT;
+    }
+
+    used[slot] = true;
+    memcpy(names[slot], record.name, PRESET_NAME_MAX);
+    saves.inc();
+    LOG_INFO("Preset '%s' saved to slot %d", record.name, slot);
+    return slot;
+}
+
+const char* PresetStore::recall(int slot)
+{
+    uint32_t start = micros();
+    if (!isUsed(slot))
+    {
+        failures.inc();
+        return "No such preset";
+    }
+
+    PresetRecord record;
+    File file = LittleFS.open(PRESET_FILE, "r");
+    bool ok = file && file.seek(slotOffset(slot)) &&
+              file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record);
+    if (file)
+    {
+        file.close();
+    }
+    if (!ok || !record.used || record.pattern > PATTERN_PROGRAM ||
+        crc32(record.pixels, sizeof(record.pixels)) != record.crc)
+    {
+        LOG_ERROR("Preset slot %d is unreadable or corrupt", slot);
+        failures.inc();
+        return "Preset is unreadable or corrupt";
+    }
+    // The pixel program is not part of the preset; running another one would not be this look
+    if (record.pattern == PATTERN_PROGRAM && record.programCrc != NeoPixel::getInstance()->getProgramCrc())
+    {
+        LOG_WARN("Preset '%s' was saved with another pixel program", names[slot]);
+        failures.inc();
+        return "Preset was saved with a pixel program that is no longer loaded";
+    }
+
+    NeoPixel::getInstance()->setScene(static_cast<PatternType>(record.pattern), record.brightness, record.pixels);
+
+    lastRecallUs = micros() - start;
+    recallTimeUs.observe(lastRecallUs);
+    recalls.inc();
+    if (lastRecallUs > FRAME_US)
+    {
+        LOG_WARN("Preset recall took %u us, longer than a frame", (unsigned)lastRecallUs);
+    }
+    return nullptr;
+}
@@ -1,17 +1,39 @@
 #include "Protocol.h"
 #include "Config.h"
+#include "Trace.h"
+#include "Log.h"
+#include "Settings.h"
+#include "Boot.h"
+#include "SyncService.h"
+#include "Preset.h"
+#include "OtaService.h"
 #include <LittleFS.h>
+#include <coredecls.h> // settimeofday_cb()
 
 // Initialize static member
 Protocol *Protocol::instance = nullptr;
 
+// Frame render time buckets (us); a 60-pixel show() alone takes ~1.8 ms
+static const uint32_t RENDER_TIME_BOUNDS[] = {500, 1000, 2000, 4000, 8000, 16000, 32000, 50000};
+
 /**
  * @brief Private constructor initializes members with default values
  */
 Protocol::Protocol()
-    : wifiManager(nullptr),
+    : scheduler([]() -> uint32_t { return micros(); }),
+      wifiManager(nullptr),
       weatherService(nullptr),
-      webServer(nullptr)
+      webServer(nullptr),
+      neoPixel(nullptr),
+      heapFreeMin(INT32_MAX),
+      heapMaxBlockMin(INT32_MAX),
+      renderTimeUs(RENDER_TIME_BOUNDS, sizeof(RENDER_TIME_BOUNDS) / sizeof(RENDER_TIME_BOUNDS[0])),
+      windowHeapMin(UINT32_MAX),
+      windowMaxBlockMin(UINT32_MAX),
+      windowFragMax(0),
+      renderSumMark(0),
+      renderCountMark(0),
+      lastFrameStart(0)
 {
 
     // Allocate memory for LED state and brightness
@@ -44,41 +66,91 @@ Protocol *Protocol::getInstance()
  */
 bool Protocol::initializeSystem()
 {
-    Serial.println("Initializing system components...");
+    BootTimeline::start(BOOT_SETUP);
+    LOG_INFO("Initializing system components...");
+
+    // System metrics first, so the registry lists them ahead of the components'
+    registerMetrics();
+    sampleHeap();
+
+    // Bring the strip up first: after a soft reset it resumes its scene from RTC memory
+    BootTimeline::start(BOOT_SCENE);
+    neoPixel = NeoPixel::getInstance();
+    if (neoPixel->isWarmStart())
+    {
+        BootTimeline::finish(BOOT_SCENE);
+    }
 
     // Initialize built-in LED for PWM control
     pinMode(LED_PIN, OUTPUT);
     digitalWrite(LED_PIN, HIGH); // LED off initially
     analogWriteRange(1023); // Set PWM range to 0-1023 (default for ESP8266)
 
-    // Initialize file system
+    // Initialize file system (the only mount; the web server serves from it too)
+    BootTimeline::start(BOOT_FILESYSTEM);
     if (!LittleFS.begin())
     {
-        Serial.println("LittleFS mount failed!");
+        LOG_ERROR("LittleFS mount failed!");
         return false;
     }
-    Serial.println("LittleFS mounted successfully");
+    BootTimeline::finish(BOOT_FILESYSTEM);
+    LOG_INFO("LittleFS mounted successfully");
+
+    // One read of /settings.bin restores everything below
+    BootTimeline::start(BOOT_SETTINGS);
+    const SettingsData& settings = SettingsStore::getInstance()->get();
+    *ledState = settings.ledOn != 0;
+    *brightness = settings.ledBrightness;
+    webServer = new WebServer(WEB_SERVER_PORT, ledState, brightness);
+    webServer->updateLED();
 
-    // Initialize WiFi manager
-    wifiManager = new CustomWiFiManager(DEVICE_HOSTNAME, new AsyncWebServer(WEB_SERVER_PORT));
-    wifiManager->begin();
-    Serial.println("WiFi manager initialized");
+    // A cold boot restores the saved scene; a warm one already shows a newer one
+    if (!neoPixel->isWarmStart())
+    {
+        neoPixel->setBrightness(settings.pixelBrightness);
+        neoPixel->setPattern((PatternType)settings.pattern);
+        if (!neoPixel->isAnimationActive())
+        {
+            neoPixel->setPixels(settings.pixels, NEOPIXEL_COUNT);
+        }
+    }
+    PresetStore::getInstance();  // Registers its metrics; the slot index is read on first use
+    OtaService::getInstance();   // Registers its metrics; /ota.state is read when an upload asks for it
+    BootTimeline::finish(BOOT_SETTINGS);
+    BootTimeline::finish(BOOT_SCENE);
+
+    // The scheduler is not draining the log yet
+    Log::flush();
 
-    // Initialize Weather service
+    // Initialize Weather service from its cache; poll() fetches once WiFi is up
+    BootTimeline::start(BOOT_WEATHER_SERVICE);
     weatherService = Weather::getInstance();
     weatherService->beginWithSavedSettings();
-    Serial.println("Weather service initialized");
+    BootTimeline::finish(BOOT_WEATHER_SERVICE);
+    BootTimeline::start(BOOT_FIRST_WEATHER);
+    LOG_INFO("Weather service initialized");
 
-    // Initialize Web server
-    webServer = new WebServer(WEB_SERVER_PORT, ledState, brightness);
+    // The server listens before WiFi associates and answers as soon as it does
+    BootTimeline::start(BOOT_WEB_SERVER);
     webServer->setWeatherService(weatherService);
+    webServer->setScheduler(&scheduler);
+    webServer->setSystemHistory(&history);
     webServer->begin();
-    Serial.println("Web server initialized");
+    BootTimeline::finish(BOOT_WEB_SERVER);
+    LOG_INFO("Web server initialized");
+
+    // WiFi, SNTP and the first weather reading complete in the background once the scheduler runs.
+    // There is one AsyncWebServer: the WiFi portal borrows it while AP mode is up.
+    wifiManager = new CustomWiFiManager(DEVICE_HOSTNAME, webServer->getServer());
+    wifiManager->setPortalClosedCallback([this]()
+                                         { webServer->restoreRoutes(); });
+    wifiManager->begin();
 
-    // Initialize NeoPixel
-    neoPixel = NeoPixel::getInstance();
-    neoPixel->begin();
-    Serial.println("NeoPixel initialized");
+    // Start SNTP so cached data can be aged by wall-clock time
+    BootTimeline::start(BOOT_CLOCK);
+    settimeofday_cb([]()
+                    { BootTimeline::finish(BOOT_CLOCK); });
+    configTime(0, 0, NTP_SERVER, NTP_SERVER_FALLBACK);
 
     return true;
 }
@@ -93,30 +165,59 @@ void Protocol::setupTasks()
     // Clear any existing tasks
     initializeTasks();
 
-    // Create weather update task - use Config.h value and ensure it's not too frequent
-    unsigned long weatherInterval = WEATHER_UPDATE_INTERVAL;
-    // Ensure minimum 10 minute interval for weather updates to prevent API rate limiting
-    if (weatherInterval < 600000)
-    {
-        Serial.println("WARNING: Weather update interval too short, increasing to 10 minutes minimum");
-        weatherInterval = 600000; // 10 minutes in milliseconds
-    }
-
+    // Create weather update task - it polls frequently and the Weather service decides
+    // whether a fetch or a backoff retry is actually due
     createTask("WeatherUpdate", [this]()
-               { weatherUpdateTask(); }, weatherInterval);
+               { weatherUpdateTask(); }, WEATHER_POLL_INTERVAL, PRIORITY_NORMAL);
 
     // Create system monitor task
     createTask("SystemMonitor", [this]()
-               { systemMonitorTask(); }, HEAP_CHECK_INTERVAL);
-
-    // Create NeoPixel pattern update task (e.g., every 50ms for smooth animation)
-    createTask("NeoPixelUpdate", [this]() { neoPixelTask(); }, 50);
+               { systemMonitorTask(); }, HEAP_CHECK_INTERVAL, PRIORITY_LOW);
+
+    // NeoPixel output task; patterns render their keyframes at their own rate inside update()
+    createTask("NeoPixelUpdate", [this]() { neoPixelTask(); }, NEOPIXEL_OUTPUT_INTERVAL, PRIORITY_REALTIME);
+
+    // Run the WiFi reconnect state machine (and the portal, while it is open)
+    createTask("WiFiCheck", [this]()
+               {
+                   TRACE_SCOPE(TRACE_TASK_WIFI);
+                   if (wifiManager) wifiManager->loop();
+               }, WIFI_CHECK_INTERVAL, PRIORITY_HIGH);
+
+    // Record system health history
+    createTask("History", [this]()
+               { historyTask(); }, HISTORY_FINE_INTERVAL, PRIORITY_LOW);
+
+    // Move buffered log text to the UART as its FIFO frees up
+    createTask("LogDrain", []()
+               { Log::drain(); }, LOG_DRAIN_INTERVAL, PRIORITY_LOW);
+
+    // Write settings changes to flash once they have settled
+    createTask("Settings", []()
+               {
+                   TRACE_SCOPE(TRACE_TASK_SETTINGS);
+                   SettingsStore::getInstance()->loop();
+               }, SETTINGS_CHECK_INTERVAL, PRIORITY_LOW);
+
+    // Exchange clock sync beacons; received ones are timestamped when read, so poll often.
+    // Most polls find nothing, so only the beacons handled are traced
+    createTask("Sync", []()
+               { SyncService::getInstance()->loop(); }, SYNC_POLL_INTERVAL, PRIORITY_NORMAL);
+
+    // Erase flash for a prepared firmware upload, check a received one, drop stalled ones and reboot into the new image
+    createTask("Ota", []()
+               {
+                   TRACE_SCOPE(TRACE_TASK_OTA);
+                   OtaService::getInstance()->loop();
+               }, OTA_CHECK_INTERVAL, PRIORITY_LOW);
 
     // Start all tasks including WiFi monitoring
     startAllTasks();
 
-    Serial.println("All system tasks configured and started");
-    Serial.printf("Weather updates scheduled every %lu minutes\n", weatherInterval / 60000);
+    BootTimeline::finish(BOOT_SETUP);
+    LOG_INFO("All system tasks configured and started");
+    LOG_INFO("Weather updates scheduled every %lu minutes",
+             (unsigned long)(WEATHER_UPDATE_INTERVAL > 600000 ? WEATHER_UPDATE_INTERVAL : 600000) / 60000);
 }
 
 /**
@@ -124,9 +225,17 @@ void Protocol::setupTasks()
  */
 void Protocol::weatherUpdateTask()
 {
+    TRACE_SCOPE(TRACE_TASK_WEATHER);
+
     if (weatherService)
     {
-        weatherService->fetchWeatherData();
+        weatherService->poll();
+
+        // Feed the weather-reactive LED pattern
+        if (neoPixel)
+        {
+            neoPixel->setWeatherCondition(weatherService->getCondition());
+        }
     }
 }
 
@@ -135,39 +244,31 @@ void Protocol::weatherUpdateTask()
  */
 void Protocol::systemMonitorTask()
 {
-    uint32_t freeHeap = ESP.getFreeHeap();
-    uint32_t maxFreeBlockSize = ESP.getMaxFreeBlockSize();
-    uint32_t heapFragmentation = ESP.getHeapFragmentation();
+    TRACE_SCOPE(TRACE_TASK_MONITOR);
+
+    sampleHeap();
     uint8_t cpuFreqMHz = ESP.getCpuFreqMHz();
-    float heapPercent = 100.0 * freeHeap / ESP.getFreeContStack();
 
-    Serial.println("=== System Status ===");
-    Serial.printf("Free heap: %u bytes (%.1f%%)\n", freeHeap, heapPercent);
-    Serial.printf("Max free block: %u bytes\n", maxFreeBlockSize);
-    Serial.printf("Heap fragmentation: %u%%\n", heapFragmentation);
-    Serial.printf("CPU frequency: %u MHz\n", cpuFreqMHz);
-    Serial.printf("LED state: %s\n", *ledState ? "ON" : "OFF");
-    Serial.printf("Brightness: %d\n", *brightness);
+    LOG_INFO("Heap: %d bytes free (min %d), max block %d bytes (min %d), fragmentation %d%%, uptime %d s",
+             (int)heapFree.get(), (int)heapFreeMin.get(), (int)heapMaxBlock.get(), (int)heapMaxBlockMin.get(),
+             (int)heapFragmentation.get(), (int)uptimeSeconds.get());
+    LOG_DEBUG("CPU %u MHz, LED %s, brightness %d", cpuFreqMHz, *ledState ? "ON" : "OFF", *brightness);
 
     // WiFi information
     if (wifiManager && WiFi.status() == WL_CONNECTED)
     {
-        Serial.printf("WiFi SSID: %s (RSSI: %d dBm)\n", WiFi.SSID().c_str(), WiFi.RSSI());
-        Serial.printf("IP: %s\n", WiFi.localIP().toString().c_str());
+        LOG_DEBUG("WiFi SSID: %s (RSSI: %d dBm), IP: %s",
+                  WiFi.SSID().c_str(), WiFi.RSSI(), WiFi.localIP().toString().c_str());
     }
 
     // Weather information
     if (weatherService)
     {
-        Serial.printf("Weather: %.1f°C, %s\n",
-                      weatherService->getTemperature(),
-                      weatherService->getDescription().c_str());
-        Serial.printf("Weather API calls: %lu\n", 
-                      Weather::getApiCallCount());
+        LOG_DEBUG("Weather: %.1f°C, %s, %lu API calls",
+                  weatherService->getTemperature(),
+                  weatherService->getDescription().c_str(),
+                  Weather::getApiCallCount());
     }
-
-    Serial.printf("Uptime: %lu seconds\n", millis() / 1000);
-    Serial.println("====================");
 }
 
 /**
@@ -175,13 +276,13 @@ void Protocol::systemMonitorTask()
  */
 void Protocol::initializeTasks()
 {
-    tasks.clear();
+    scheduler.clear();
 }
 
 /**
  * @brief Starts the WiFi monitoring task and all registered application tasks
  *
- * Each task will run at its specified interval using the Ticker library
+ * Each task will run at its specified interval from loop() via the scheduler
  */
 void Protocol::startAllTasks()
 {
@@ -190,10 +291,7 @@ void Protocol::startAllTasks()
         wifiManager->startTask();
     }
 
-    for (auto &task : tasks)
-    {
-        task.ticker.attach_ms(task.interval_ms, task.callback);
-    }
+    scheduler.start();
 }
 
 /**
@@ -208,11 +306,7 @@ void Protocol::stopAllTasks()
         wifiManager->stopTask();
     }
 
-    for (auto &task : tasks)
-    {
-        task.ticker.detach();
-    }
-    tasks.clear();
+    scheduler.clear();
 }
 
 /**
@@ -223,16 +317,32 @@ void Protocol::stopAllTasks()
  * @param interval_ms Time between task executions in milliseconds
  */
 void Protocol::createTask(const char *name, std::function<void(void)> taskFunction,
-                          uint32_t interval_ms)
+                          uint32_t interval_ms, uint8_t priority)
 {
-    TaskConfig newTask = {
-        .name = name,
-        .ticker = Ticker(),
-        .callback = taskFunction,
-        .interval_ms = interval_ms};
-
-    tasks.push_back(newTask);
-    Serial.printf("Task '%s' created successfully\n", name);
+    if (scheduler.addTask(name, taskFunction, interval_ms, priority) == Scheduler::INVALID_TASK)
+    {
+        LOG_ERROR("Failed to create task '%s'", name);
+        return;
+    }
+    LOG_DEBUG("Task '%s' created successfully", name);
+}
+
+/**
+ * @brief Runs all due tasks, then idles until the next deadline
+ *
+ * The idle time is capped so the network stack and async web server
+ * still get serviced promptly.
+ */
+void Protocol::loop()
+{
+    // Heap low points happen while tasks run, so sample right after them
+    if (scheduler.runPending() > 0)
+    {
+        sampleHeap();
+    }
+
+    uint32_t idle = scheduler.getMsUntilNext();
+    delay(idle < 10 ? idle : 10);
 }
 
 /**
@@ -240,13 +350,96 @@ void Protocol::createTask(const char *name, std::function<void(void)> taskFuncti
  */
 void Protocol::neoPixelTask()
 {
+    TRACE_SCOPE(TRACE_TASK_NEOPIXEL);
+
     if (neoPixel) {
-        // Update the current animation pattern
+        uint32_t start = micros();
+        
+        // A tick that starts after the next one was due has already lost the strip a frame
+        bool late = lastFrameStart != 0 && start - lastFrameStart >= 2 * NEOPIXEL_OUTPUT_INTERVAL * 1000;
+        lastFrameStart = start;
+        
+        // Renders a keyframe or blends an in-between frame, and sends it
         neoPixel->update();
         
-        // Only call show if we're in an active animation mode
+        uint32_t cost = micros() - start;
+        renderTimeUs.observe(cost);
         if (neoPixel->isAnimationActive()) {
-            neoPixel->show();
+            neoPixel->reportFrame(cost, late);
         }
     }
+}
+
+/**
+ * @brief Registers heap, uptime and render time metrics
+ */
+void Protocol::registerMetrics()
+{
+    Metrics::add("ledcloud_heap_free_bytes", "Free heap at the last sample", heapFree);
+    Metrics::add("ledcloud_heap_free_min_bytes", "Lowest free heap since boot", heapFreeMin);
+    Metrics::add("ledcloud_heap_max_block_bytes", "Largest free heap block at the last sample", heapMaxBlock);
+    Metrics::add("ledcloud_heap_max_block_min_bytes", "Smallest largest-free-block since boot", heapMaxBlockMin);
+    Metrics::add("ledcloud_heap_fragmentation_percent", "Heap fragmentation at the last sample", heapFragmentation);
+    Metrics::add("ledcloud_uptime_seconds", "Seconds since boot", uptimeSeconds);
+    Metrics::add("ledcloud_render_time_us", "NeoPixel frame update and show time", renderTimeUs);
+}
+
+/**
+ * @brief Samples the heap and updates the current and minimum gauges
+ */
+void Protocol::sampleHeap()
+{
+    // One heap walk for all three values
+    uint32_t freeHeap = 0;
+    uint16_t maxBlock = 0;
+    uint8_t fragmentation = 0;
+    ESP.getHeapStats(&freeHeap, &maxBlock, &fragmentation);
+
+    heapFree.set(freeHeap);
+    heapFreeMin.setMin(freeHeap);
+    heapMaxBlock.set(maxBlock);
+    heapMaxBlockMin.setMin(maxBlock);
+    heapFragmentation.set(fragmentation);
+    uptimeSeconds.set(millis() / 1000);
+
+    // Worst case over the current history interval
+    if (freeHeap < windowHeapMin)
+    {
+        windowHeapMin = freeHeap;
+    }
+    if (maxBlock < windowMaxBlockMin)
+    {
+        windowMaxBlockMin = maxBlock;
+    }
+    if (fragmentation > windowFragMax)
+    {
+        windowFragMax = fragmentation;
+    }
+}
+
+/**
+ * @brief Records the worst heap figures, signal and mean frame time of the last interval
+ */
+void Protocol::historyTask()
+{
+    TRACE_SCOPE(TRACE_TASK_HISTORY);
+
+    sampleHeap();
+
+    uint32_t frames = renderTimeUs.getCount() - renderCountMark;
+    uint64_t frameTime = renderTimeUs.getSum() - renderSumMark;
+
+    HistorySample sample;
+    sample.freeHeap = SystemHistory::saturate16(windowHeapMin);
+    sample.maxBlock = SystemHistory::saturate16(windowMaxBlockMin);
+    sample.fragmentation = windowFragMax;
+    sample.rssi = WiFi.status() == WL_CONNECTED ? (int8_t)WiFi.RSSI() : 0;
+    sample.frameTimeUs = frames ? SystemHistory::saturate16((uint32_t)(frameTime / frames)) : 0;
+    history.record(sample, millis());
+
+    windowHeapMin = UINT32_MAX;
+    windowMaxBlockMin = UINT32_MAX;
+    windowFragMax = 0;
+    renderSumMark = renderTimeUs.getSum();
+    renderCountMark = renderTimeUs.getCount();
 }
\ No newline at end of file
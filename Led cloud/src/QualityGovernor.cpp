@@ -0,0 +1,101 @@
+#include "QualityGovernor.h"
+
+namespace {
+
+const uint16_t MAX_RECOVER_WINDOWS = QUALITY_RECOVER_WINDOWS * 8;
+
+} // namespace
+
+QualityGovernor::QualityGovernor(uint32_t budget)
+    : budgetUs(budget), level(QUALITY_FULL), windowFrames(0), windowOverruns(0), windowPeakUs(0), cleanWindows(0),
+      recoverWindows(QUALITY_RECOVER_WINDOWS), windowsAtLevel(0), steppedUp(false), stepsDown(0), stepsUp(0),
+      transitionHead(0), transitionCount(0)
+{
+}
+
+bool QualityGovernor::observe(uint32_t costUs, bool late, uint32_t nowMs)
+{
+    if (late || costUs > budgetUs)
+    {
+        windowOverruns++;
+    }
+    if (costUs > windowPeakUs)
+    {
+        windowPeakUs = costUs;
+    }
+    if (++windowFrames < QUALITY_WINDOW)
+    {
+        return false;
+    }
+
+    uint8_t overruns = windowOverruns;
+    uint32_t peakUs = windowPeakUs;
+    windowFrames = 0;
+    windowOverruns = 0;
+    windowPeakUs = 0;
+    if (windowsAtLevel < UINT16_MAX)
+    {
+        windowsAtLevel++;
+    }
+
+    if (overruns >= QUALITY_DOWN_OVERRUNS)
+    {
+        cleanWindows = 0;
+        if (level + 1 >= QUALITY_LEVELS)
+        {
+            return false;  // Nothing left to give up
+        }
+        // A restored level that could not hold: wait longer before trying it again
+        if (steppedUp && windowsAtLevel < recoverWindows && recoverWindows < MAX_RECOVER_WINDOWS)
+        {
+            recoverWindows *= 2;
+        }
+        change(level + 1, nowMs, overruns, peakUs);
+        stepsDown++;
+        steppedUp = false;
+        return true;
+    }
+
+    // A level that held after being restored earns back some of the wait
+    if (steppedUp && windowsAtLevel == recoverWindows && recoverWindows > QUALITY_RECOVER_WINDOWS)
+    {
+        recoverWindows /= 2;
+    }
+
+    bool clean = overruns == 0 && peakUs + QUALITY_RECOVER_MARGIN <= budgetUs;
+    cleanWindows = clean ? cleanWindows + 1 : 0;
+    if (level == QUALITY_FULL || cleanWindows < recoverWindows)
+    {
+        return false;
+    }
+
+    cleanWindows = 0;
+    change(level - 1, nowMs, overruns, peakUs);
+    stepsUp++;
+    steppedUp = true;
+    return true;
+}
+
+const QualityTransition& QualityGovernor::getTransition(size_t index) const
+{
+    size_t oldest = (transitionHead + QUALITY_HISTORY - transitionCount) % QUALITY_HISTORY;
+    return transitions[(oldest + index) % QUALITY_HISTORY];
+}
+
+void QualityGovernor::change(uint8_t to, uint32_t nowMs, uint8_t overruns, uint32_t peakUs)
+{
+    QualityTransition& transition = transitions[transitionHead];
+    transition.timeMs = nowMs;
+    transition.from = level;
+    transition.to = to;
+    transition.overruns = overruns;
+    transition.peakCostUs = peakUs;
+    transitionHead = (transitionHead + 1) % QUALITY_HISTORY;
+    if (transitionCount < QUALITY_HISTORY)
+    {
+        transitionCount++;
+    }
+
+    level = to;
+    windowsAtLevel = 0;
+}
@@ -0,0 +1,208 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler(ClockFunction clockUs)
+    : clock(clockUs), lastClock(0), elapsed(0), taskCount(0), heapSize(0), started(false)
+{
+    lastClock = clock();
+}
+
+/**
+ * @brief Extends the wrapping 32-bit clock to a 64-bit timeline
+ *
+ * Valid as long as the scheduler is polled at least once per wrap (~71 minutes).
+ */
+uint64_t Scheduler::now()
+{
+    uint32_t current = clock();
+    elapsed += (uint32_t)(current - lastClock);
+    lastClock = current;
+    return elapsed;
+}
+
+int Scheduler::addTask(const char *name, std::function<void(void)> callback,
+                       uint32_t intervalMs, uint8_t priority)
+{
+    // Intervals are kept in microseconds, which limits them to ~71 minutes
+    if (taskCount >= MAX_TASKS || intervalMs == 0 || intervalMs > UINT32_MAX / 1000)
+    {
+        return INVALID_TASK;
+    }
+
+    uint8_t index = taskCount++;
+    Task &task = tasks[index];
+    task.name = name;
+    task.callback = callback;
+    task.intervalUs = intervalMs * 1000UL;
+    task.priority = priority;
+    task.deadline = 0;
+    task.runCount = 0;
+    task.totalRuntimeUs = 0;
+    task.maxRuntimeUs = 0;
+    task.lastJitterUs = 0;
+    task.maxJitterUs = 0;
+    task.missedDeadlines = 0;
+    task.overruns = 0;
+
+    // Tasks added after start() are armed immediately
+    if (started)
+    {
+        task.deadline = now() + task.intervalUs;
+        heapPush(index);
+    }
+    return index;
+}
+
+void Scheduler::start()
+{
+    uint64_t t = now();
+    heapSize = 0;
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        tasks[i].deadline = t + tasks[i].intervalUs;
+        heapPush(i);
+    }
+    started = true;
+}
+
+void Scheduler::clear()
+{
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        tasks[i].callback = nullptr;
+    }
+    taskCount = 0;
+    heapSize = 0;
+    started = false;
+}
+
+size_t Scheduler::runPending()
+{
+    uint64_t t = now();
+
+    // Collect everything that is due, then run it highest priority first
+    uint8_t due[MAX_TASKS];
+    uint8_t dueCount = 0;
+    while (heapSize > 0 && tasks[heap[0]].deadline <= t)
+    {
+        uint8_t index = heapPop();
+        uint8_t pos = dueCount++;
+        // Insertion sort: priority descending, deadline order kept for equal priority
+        while (pos > 0 && tasks[due[pos - 1]].priority < tasks[index].priority)
+        {
+            due[pos] = due[pos - 1];
+            pos--;
+        }
+        due[pos] = index;
+    }
+
+    for (uint8_t i = 0; i < dueCount; i++)
+    {
+        run(due[i]);
+    }
+    return dueCount;
+}
+
+void Scheduler::run(uint8_t index)
+{
+    Task &task = tasks[index];
+
+    uint64_t startTime = now();
+    uint32_t jitter = (uint32_t)(startTime - task.deadline);
+    if (task.callback)
+    {
+        task.callback();
+    }
+    uint64_t endTime = now();
+    uint32_t runtime = (uint32_t)(endTime - startTime);
+
+    task.runCount++;
+    task.totalRuntimeUs += runtime;
+    if (runtime > task.maxRuntimeUs)
+    {
+        task.maxRuntimeUs = runtime;
+    }
+    task.lastJitterUs = jitter;
+    if (jitter > task.maxJitterUs)
+    {
+        task.maxJitterUs = jitter;
+    }
+    if (runtime > task.intervalUs)
+    {
+        task.overruns++;
+    }
+
+    // Next slot on the original grid; slots that already passed count as missed
+    uint64_t periodsLate = (endTime - task.deadline) / task.intervalUs;
+    task.missedDeadlines += (uint32_t)periodsLate;
+    task.deadline += (periodsLate + 1) * task.intervalUs;
+
+    heapPush(index);
+}
+
+uint32_t Scheduler::getMsUntilNext()
+{
+    if (heapSize == 0)
+    {
+        return UINT32_MAX;
+    }
+    uint64_t t = now();
+    uint64_t deadline = tasks[heap[0]].deadline;
+    return deadline > t ? (uint32_t)((deadline - t) / 1000) : 0;
+}
+
+bool Scheduler::earlier(uint8_t a, uint8_t b) const
+{
+    if (tasks[a].deadline != tasks[b].deadline)
+    {
+        return tasks[a].deadline < tasks[b].deadline;
+    }
+    return tasks[a].priority > tasks[b].priority;
+}
+
+void Scheduler::heapPush(uint8_t index)
+{
+    uint8_t pos = heapSize++;
+    heap[pos] = index;
+    while (pos > 0)
+    {
+        uint8_t parent = (pos - 1) / 2;
+        if (!earlier(heap[pos], heap[parent]))
+        {
+            break;
+        }
+        uint8_t swap = heap[parent];
+        heap[parent] = heap[pos];
+        heap[pos] = swap;
+        pos = parent;
+    }
+}
+
+uint8_t Scheduler::heapPop()
+{
+    uint8_t top = heap[0];
+    heap[0] = heap[--heapSize];
+    uint8_t pos = 0;
+    while (true)
+    {
+        uint8_t left = 2 * pos + 1;
+        uint8_t right = left + 1;
+        uint8_t smallest = pos;
+        if (left < heapSize && earlier(heap[left], heap[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < heapSize && earlier(heap[right], heap[smallest]))
+        {
+            smallest = right;
+        }
+        if (smallest == pos)
+        {
+            break;
+        }
+        uint8_t swap = heap[smallest];
+        heap[smallest] = heap[pos];
+        heap[pos] = swap;
+        pos = smallest;
+    }
+    return top;
+}
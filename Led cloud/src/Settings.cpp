@@ -0,0 +1,251 @@
+#include "Settings.h"
+#include "Log.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <coredecls.h> // crc32()
+
+SettingsStore* SettingsStore::instance = nullptr;
+
+const char* SettingsStore::SETTINGS_FILE = "/settings.bin";
+const char* SettingsStore::TEMP_FILE = "/settings.tmp";
+const char* SettingsStore::LEGACY_WEATHER_FILE = "/weather_settings.json";
+
+namespace {
+
+const uint32_t SETTINGS_MAGIC = 0x3153434C; // "LCS1"
+const uint16_t SETTINGS_VERSION = 1;
+
+// File layout: header followed by the SettingsData payload
+struct SettingsHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;   // Payload bytes; shorter than sizeof(SettingsData) for older records
+    uint32_t crc;      // crc32 over the payload
+};
+
+} // namespace
+
+SettingsStore::SettingsStore()
+    : loaded(false), dirty(false), firstChangeTime(0), lastChangeTime(0), writtenCrc(0)
+{
+    Metrics::add("ledcloud_settings_writes_total", "Settings records written to flash", writes);
+    Metrics::add("ledcloud_settings_skipped_writes_total", "Settings writes skipped because nothing changed", skippedWrites);
+    Metrics::add("ledcloud_settings_write_failures_total", "Settings writes that failed", writeFailures);
+}
+
+SettingsStore* SettingsStore::getInstance()
+{
+    if (instance == nullptr)
+    {
+        instance = new SettingsStore();
+    }
+    return instance;
+}
+
+const SettingsData& SettingsStore::get()
+{
+    if (!loaded)
+    {
+        load();
+    }
+    return data;
+}
+
+SettingsData& SettingsStore::edit()
+{
+    if (!loaded)
+    {
+        load();
+    }
+    unsigned long now = millis();
+    if (!dirty)
+    {
+        firstChangeTime = now;
+    }
+    lastChangeTime = now;
+    dirty = true;
+    return data;
+}
+
+void SettingsStore::loop()
+{
+    if (!dirty)
+    {
+        return;
+    }
+    unsigned long now = millis();
+    if (now - lastChangeTime >= SETTINGS_WRITE_DELAY || now - firstChangeTime >= SETTINGS_WRITE_MAX_DELAY)
+    {
+        write();
+    }
+}
+
+bool SettingsStore::flush()
+{
+    return dirty ? write() : true;
+}
+
+void SettingsStore::applyDefaults()
+{
+    memset(&data, 0, sizeof(data));
+    strncpy(data.apiKey, WEATHER_API_KEY, sizeof(data.apiKey) - 1);
+    strncpy(data.apiBaseUrl, WEATHER_API_BASE_URL, sizeof(data.apiBaseUrl) - 1);
+    data.latitude = LATITUDE;
+    data.longitude = LONGITUDE;
+    data.ledBrightness = DEFAULT_BRIGHTNESS;
+    data.pixelBrightness = 50;
+}
+
+void SettingsStore::load()
+{
+    loaded = true;
+    applyDefaults();
+
+    if (readFile())
+    {
+        return;
+    }
+
+    // First boot after the upgrade: convert the old JSON file once
+    if (migrateLegacy())
+    {
+        return;
+    }
+
+    LOG_INFO("No saved settings, using defaults");
+}
+
+/**
+ * @brief Reads the binary record in one read and validates it
+ */
+bool SettingsStore::readFile()
+{
+    File file = LittleFS.open(SETTINGS_FILE, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    uint8_t buffer[sizeof(SettingsHeader) + sizeof(SettingsData)];
+    size_t bytesRead = file.read(buffer, sizeof(buffer));
+    file.close();
+
+    SettingsHeader header;
+    if (bytesRead < sizeof(header))
+    {
+        LOG_WARN("Settings file is truncated, using defaults");
+        return false;
+    }
+    memcpy(&header, buffer, sizeof(header));
+
+    const uint8_t* payload = buffer + sizeof(header);
+    if (header.magic != SETTINGS_MAGIC || header.version > SETTINGS_VERSION ||
+        header.length > sizeof(SettingsData) || bytesRead < sizeof(header) + header.length ||
+        crc32(payload, header.length) != header.crc)
+    {
+        LOG_WARN("Settings file is corrupt or from newer firmware, using defaults");
+        return false;
+    }
+
+    // Older, shorter records keep the defaults for fields they do not have
+    memcpy(&data, payload, header.length);
+    data.apiKey[sizeof(data.apiKey) - 1] = '\0';
+    data.apiBaseUrl[sizeof(data.apiBaseUrl) - 1] = '\0';
+    writtenCrc = header.length == sizeof(SettingsData) ? header.crc : 0;
+
+    LOG_INFO("Settings loaded (version %u, %u bytes)", header.version, header.length);
+    return true;
+}
+
+/**
+ * @brief Imports /weather_settings.json, writes the binary record and removes the JSON file
+ */
+bool SettingsStore::migrateLegacy()
+{
+    File file = LittleFS.open(LEGACY_WEATHER_FILE, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+    {
+        LOG_WARN("Legacy weather settings unreadable (%s), not migrated", error.c_str());
+        return false;
+    }
+
+    const char* apiKey = doc["apiKey"] | "";
+    const char* baseUrl = doc["baseUrl"] | "";
+    if (strlen(apiKey) > 0)
+    {
+        strncpy(data.apiKey, apiKey, sizeof(data.apiKey) - 1);
+        data.latitude = doc["latitude"] | (float)LATITUDE;
+        data.longitude = doc["longitude"] | (float)LONGITUDE;
+        if (strlen(baseUrl) > 0)
+        {
+            strncpy(data.apiBaseUrl, baseUrl, sizeof(data.apiBaseUrl) - 1);
+        }
+        data.weatherSaved = 1;
+    }
+
+    dirty = true;
+    if (!write())
+    {
+        return false;
+    }
+    LittleFS.remove(LEGACY_WEATHER_FILE);
+    LOG_INFO("Migrated %s to %s", LEGACY_WEATHER_FILE, SETTINGS_FILE);
+    return true;
+}
+
+/**
+ * @brief Writes the record to a temporary file and renames it over the old one
+ *
+ * LittleFS renames atomically, so a power cut leaves either the old or the new
+ * record, never a partial one.
+ */
+bool SettingsStore::write()
+{
+    SettingsHeader header;
+    header.magic = SETTINGS_MAGIC;
+    header.version = SETTINGS_VERSION;
+    header.length = sizeof(SettingsData);
+    header.crc = crc32(&data, sizeof(data));
+
+    if (header.crc == writtenCrc)
+    {
+        dirty = false;
+        skippedWrites.inc();
+        return true;
+    }
+
+    File file = LittleFS.open(TEMP_FILE, "w");
+    if (!file)
+    {
+        LOG_ERROR("Failed to open %s for writing", TEMP_FILE);
+        writeFailures.inc();
+        firstChangeTime = lastChangeTime = millis();  // Retry after another quiet period
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+              file.write(reinterpret_cast<const uint8_t*>(&data), sizeof(data)) == sizeof(data);
+    file.close();
+
+    if (!ok || !LittleFS.rename(TEMP_FILE, SETTINGS_FILE))
+    {
+        LOG_ERROR("Failed to write settings");
+        LittleFS.remove(TEMP_FILE);
+        writeFailures.inc();
+        firstChangeTime = lastChangeTime = millis();
+        return false;
+    }
+
+    writtenCrc = header.crc;
+    dirty = false;
+    writes.inc();
+    LOG_DEBUG("Settings written (%u bytes)", (unsigned)(sizeof(header) + sizeof(data)));
+    return true;
+}
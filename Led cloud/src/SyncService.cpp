@@ -0,0 +1,141 @@
+#include "SyncService.h"
+#include "Log.h"
+#include "Trace.h"
+
+SyncService* SyncService::instance = nullptr;
+
+SyncService::SyncService()
+    : clock(ESP.getChipId()), joined(false), lastMicros(micros()), elapsedUs(0)
+{
+    group.fromString(SYNC_MULTICAST_GROUP);
+
+    Metrics::add("ledcloud_sync_beacons_sent_total", "Clock sync beacons sent as leader", beaconsSent);
+    Metrics::add("ledcloud_sync_beacons_received_total", "Clock sync beacons received", beaconsReceived);
+    Metrics::add("ledcloud_sync_invalid_packets_total", "Packets on the sync port that were not beacons", invalidPackets);
+    Metrics::add("ledcloud_sync_leader", "1 while this node leads the animation clock", leader);
+    Metrics::add("ledcloud_sync_error_mean_us", "Moving average of the clock sync error (us)", errorMeanUs);
+    Metrics::add("ledcloud_sync_error_max_us", "Largest clock sync error over the last beacons (us)", errorMaxUs);
+}
+
+SyncService* SyncService::getInstance()
+{
+    if (instance == nullptr)
+    {
+        instance = new SyncService();
+    }
+    return instance;
+}
+
+uint64_t SyncService::localUs()
+{
+    uint32_t now = micros();
+    elapsedUs += (uint32_t)(now - lastMicros);
+    lastMicros = now;
+    return elapsedUs;
+}
+
+uint32_t SyncService::animationTimeMs()
+{
+    return clock.animationTimeMs(localUs());
+}
+
+void SyncService::setAnimationElapsed(uint32_t elapsedMs)
+{
+    clock.setAnimationElapsed(elapsedMs, localUs());
+}
+
+/**
+ * @brief Joins the multicast group on the current station address
+ *
+ * A reconnect can bring a new address and drops the membership, so this is
+ * repeated whenever the address changes.
+ */
+void SyncService::join()
+{
+    IPAddress address = WiFi.localIP();
+    if (joined && address == joinedAddress)
+    {
+        return;
+    }
+
+    udp.stop();
+    joined = udp.beginMulticast(address, group, SYNC_PORT);
+    if (joined)
+    {
+        joinedAddress = address;
+        LOG_INFO("Clock sync joined %s:%d as node %08x", SYNC_MULTICAST_GROUP, SYNC_PORT, (unsigned)clock.getNodeId());
+    }
+    else
+    {
+        LOG_WARN("Clock sync could not join %s", SYNC_MULTICAST_GROUP);
+    }
+}
+
+void SyncService::loop()
+{
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        if (joined)
+        {
+            udp.stop();
+            joined = false;
+        }
+    }
+    else
+    {
+        join();
+    }
+
+    if (joined)
+    {
+        receive();
+    }
+
+    SyncBeacon beacon;
+    if (clock.poll(localUs(), beacon) && joined)
+    {
+        TRACE_SCOPE(TRACE_SYNC_BEACON);
+        uint8_t packet[SyncBeacon::SIZE];
+        size_t length = beacon.encode(packet);
+        if (udp.beginPacketMulticast(group, SYNC_PORT, joinedAddress))
+        {
+            udp.write(packet, length);
+            udp.endPacket();
+            beaconsSent.inc();
+        }
+    }
+
+    updateMetrics();
+}
+
+void SyncService::receive()
+{
+    int length;
+    while ((length = udp.parsePacket()) > 0)
+    {
+        // Timestamp before anything else; processing time would read as network delay
+        uint64_t arrivalUs = localUs();
+        TRACE_SCOPE(TRACE_SYNC_BEACON);
+        uint8_t packet[SyncBeacon::SIZE];
+        int bytesRead = udp.read(packet, sizeof(packet));
+
+        SyncBeacon beacon;
+        if (length != (int)SyncBeacon::SIZE || bytesRead != length || !beacon.decode(packet, bytesRead))
+        {
+            invalidPackets.inc();
+            continue;
+        }
+        if (beacon.nodeId != clock.getNodeId())
+        {
+            beaconsReceived.inc();
+        }
+        clock.onBeacon(beacon, arrivalUs);
+    }
+}
+
+void SyncService::updateMetrics()
+{
+    leader.set(clock.isLeader() ? 1 : 0);
+    errorMeanUs.set(clock.getMeanErrorUs());
+    errorMaxUs.set(clock.getMaxErrorUs());
+}
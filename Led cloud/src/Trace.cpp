@@ -0,0 +1,158 @@
+#include "Trace.h"
+
+#if LEDCLOUD_TRACE
+
+TraceRecord Trace::buffer[TRACE_CAPACITY];
+uint32_t Trace::head = 0;
+
+namespace {
+
+// Chrome trace tracks ("tid"), so related regions line up on one row
+enum TraceTrack : uint8_t {
+    TRACK_RENDER = 1,
+    TRACK_HTTP = 2,
+    TRACK_TASKS = 3,
+    TRACK_SERVICES = 4
+};
+
+struct TraceInfo {
+    const char* name;
+    uint8_t track;
+};
+
+const TraceInfo TRACE_INFO[TRACE_ID_COUNT] = {
+    {"NeoPixel::update", TRACK_RENDER},
+    {"NeoPixel::show", TRACK_RENDER},
+    {"GET /", TRACK_HTTP},
+    {"GET /health", TRACK_HTTP},
+    {"GET /led/on", TRACK_HTTP},
+    {"GET /led/off", TRACK_HTTP},
+    {"GET /brightness", TRACK_HTTP},
+    {"GET /system-info", TRACK_HTTP},
+    {"GET /tasks", TRACK_HTTP},
+    {"GET /boot", TRACK_HTTP},
+    {"GET /trace", TRACK_HTTP},
+    {"GET /logs", TRACK_HTTP},
+    {"GET /metrics", TRACK_HTTP},
+    {"GET /system-history", TRACK_HTTP},
+    {"GET /weather", TRACK_HTTP},
+    {"GET /weather/forecast", TRACK_HTTP},
+    {"GET /weather-settings", TRACK_HTTP},
+    {"POST /weather-settings", TRACK_HTTP},
+    {"POST /neopixel/setAll", TRACK_HTTP},
+    {"POST /neopixel/setPixel", TRACK_HTTP},
+    {"POST /neopixel/setPattern", TRACK_HTTP},
+    {"POST /neopixel/setBrightness", TRACK_HTTP},
+    {"GET /neopixel/status", TRACK_HTTP},
+    {"GET /sync", TRACK_HTTP},
+    {"GET /presets", TRACK_HTTP},
+    {"POST /presets/save", TRACK_HTTP},
+    {"POST /presets/recall", TRACK_HTTP},
+    {"GET /neopixel/program", TRACK_HTTP},
+    {"POST /neopixel/program", TRACK_HTTP},
+    {"GET /neopixel/quality", TRACK_HTTP},
+    {"GET /ota", TRACK_HTTP},
+    {"POST /ota", TRACK_HTTP},
+    {"POST /ota/prepare", TRACK_HTTP},
+    {"Task WeatherUpdate", TRACK_TASKS},
+    {"Task SystemMonitor", TRACK_TASKS},
+    {"Task NeoPixelUpdate", TRACK_TASKS},
+    {"Task WiFiCheck", TRACK_TASKS},
+    {"Task History", TRACK_TASKS},
+    {"Task Settings", TRACK_TASKS},
+    {"Task Ota", TRACK_TASKS},
+    {"Weather::fetchWeatherData", TRACK_SERVICES},
+    {"Weather::fetchForecast", TRACK_SERVICES},
+    {"SyncService beacon", TRACK_SERVICES},
+};
+
+} // namespace
+
+const char* Trace::getName(uint8_t id)
+{
+    return id < TRACE_ID_COUNT ? TRACE_INFO[id].name : "unknown";
+}
+
+uint8_t Trace::getTrack(uint8_t id)
+{
+    return id < TRACE_ID_COUNT ? TRACE_INFO[id].track : 0;
+}
+
+size_t Trace::snapshot(TraceRecord* out, size_t maxRecords)
+{
+    uint32_t end = head;
+    uint32_t available = end < TRACE_CAPACITY ? end : TRACE_CAPACITY;
+    size_t count = available < maxRecords ? available : maxRecords;
+    uint32_t first = end - count;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = buffer[(first + i) & (TRACE_CAPACITY - 1)];
+    }
+    return count;
+}
+
+TraceExporter::TraceExporter()
+    : records(new TraceRecord[TRACE_CAPACITY]), count(0), next(0), stage(0),
+      originCycles(0), cyclesPerUs(ESP.getCpuFreqMHz())
+{
+    count = Trace::snapshot(records, TRACE_CAPACITY);
+
+    // Timestamps are emitted relative to the earliest start in the snapshot
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = timeline.place(records[i]);
+        if (i == 0 || start < originCycles) {
+            originCycles = start;
+        }
+    }
+    timeline.reset();
+}
+
+TraceExporter::~TraceExporter()
+{
+    delete[] records;
+}
+
+/**
+ * @brief Formats the next piece of the document into the pending buffer
+ */
+bool TraceExporter::formatNext()
+{
+    if (stage == 0) {
+        setPendingLength(snprintf(pending, sizeof(pending),
+                                  "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"recorded\":%u},\"traceEvents\":[",
+                                  (unsigned)Trace::getTotalRecorded()));
+        stage = 1;
+        return true;
+    }
+
+    if (stage == 1) {
+        if (next >= count) {
+            stage = 2;
+        } else {
+            const TraceRecord& record = records[next];
+            uint8_t id = record.getId();
+            uint32_t durationCycles = record.getDurationCycles();
+            uint32_t startCycles = (uint32_t)(timeline.place(record) - originCycles);
+
+            int length = snprintf(pending, sizeof(pending),
+                                  "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%u.%01u,\"dur\":%u.%01u}",
+                                  next == 0 ? "" : ",",
+                                  Trace::getName(id), Trace::getTrack(id),
+                                  (unsigned)(startCycles / cyclesPerUs),
+                                  (unsigned)((startCycles % cyclesPerUs) * 10 / cyclesPerUs),
+                                  (unsigned)(durationCycles / cyclesPerUs),
+                                  (unsigned)((durationCycles % cyclesPerUs) * 10 / cyclesPerUs));
+            setPendingLength(length);
+            next++;
+            return true;
+        }
+    }
+
+    if (stage == 2) {
+        setPendingLength(snprintf(pending, sizeof(pending), "]}"));
+        stage = 3;
+        return true;
+    }
+    return false;
+}
+
+#endif // LEDCLOUD_TRACE
@@ -0,0 +1,39 @@
+#include "WarmState.h"
+#include "Crc32.h"
+#include <string.h>
+
+namespace {
+
+const uint32_t WARM_STATE_MAGIC = 0x57534C32; // "WSL2"
+
+} // namespace
+
+WarmStateStore::WarmStateStore(RtcRegion& rtc, uint32_t startBlock)
+    : region(rtc), block(startBlock)
+{
+}
+
+/**
+ * @brief Standard CRC-32, without the core's crc32() so it also runs on the host
+ */
+uint32_t WarmStateStore::checksum(const void* data, size_t length)
+{
+    return crc32Nibble(data, length);
+}
+
+bool WarmStateStore::load(WarmStateRecord& record)
+{
+    if (!region.read(block, &record, sizeof(record)))
+    {
+        return false;
+    }
+    return record.magic == WARM_STATE_MAGIC &&
+           record.checksum == checksum(&record, offsetof(WarmStateRecord, checksum));
+}
+
+bool WarmStateStore::save(WarmStateRecord& record)
+{
+    record.magic = WARM_STATE_MAGIC;
+    record.checksum = checksum(&record, offsetof(WarmStateRecord, checksum));
+    return region.write(block, &record, sizeof(record));
+}
@@ -1,26 +1,90 @@
 #include "Weather.h"
 #include "Config.h"
+#include "JsonStream.h"
+#include "Trace.h"
+#include "Log.h"
+#include "Settings.h"
+#include "Boot.h"
+#include "OtaService.h"
+#include "WarmState.h"
+#include <coredecls.h> // crc32()
+#include <time.h>
 
 // Initialize static instance pointer
 Weather* Weather::instance = nullptr;
 
-// Define the settings file path
-const char* Weather::SETTINGS_FILE = "/weather_settings.json";
+// Define the cache file path
+const char* Weather::CACHE_FILE = "/weather_cache.bin";
+
+static_assert(sizeof(ForecastBuffer<FORECAST_CAPACITY>) < 1024, "Forecast ring buffer must stay under 1 KB");
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x57434331; // "WCC1"
+
+// Compact on-disk / RTC form of the last reading (52 bytes)
+struct WeatherCacheRecord {
+    uint32_t magic;
+    uint32_t epoch;            // Wall-clock fetch time, 0 if the clock was not synced yet
+    int16_t temperatureCenti;  // Temperature in 1/100 °C
+    uint8_t humidity;
+    uint8_t condition;         // WeatherCondition code
+    char icon[4];
+    char description[32];
+    uint32_t crc;              // crc32 over all preceding bytes
+};
+static_assert(sizeof(WeatherCacheRecord) % 4 == 0, "RTC user memory is accessed in 4-byte blocks");
+static_assert(RTC_WEATHER_CACHE_BLOCK >= RTC_EBOOT_BLOCKS,
+              "Weather cache would overlap the bootloader command in RTC user memory");
+static_assert(RTC_WEATHER_CACHE_BLOCK * 4 >= RTC_LED_STATE_BLOCK * 4 + sizeof(WarmStateRecord),
+              "Weather cache would overlap the LED warm state in RTC user memory");
+static_assert(RTC_WEATHER_CACHE_BLOCK * 4 + sizeof(WeatherCacheRecord) <= RTC_USER_MEMORY_SIZE,
+              "Weather cache does not fit in RTC user memory");
+
+uint32_t cacheChecksum(const WeatherCacheRecord& record) {
+    return crc32(&record, offsetof(WeatherCacheRecord, crc));
+}
+
+bool isCacheRecordValid(const WeatherCacheRecord& record) {
+    return record.magic == CACHE_MAGIC && record.crc == cacheChecksum(record);
+}
+
+// SNTP has delivered a plausible wall-clock time (after Sep 2020)
+bool isClockSynced() {
+    return time(nullptr) > 1600000000;
+}
+
+} // namespace
 
 // Rate limiting - track the last API call time
 unsigned long Weather::lastApiCallTime = 0;
 const unsigned long Weather::MIN_API_CALL_INTERVAL = 600000; // 10 minutes minimum between API calls
 
 // Initialize API call counter
-unsigned long Weather::apiCallCount = 0;
+Counter Weather::apiCallCount;
 
 Weather::Weather() 
-    : temperature(0),
+    : apiBaseUrl(WEATHER_API_BASE_URL),
+      temperature(0),
       humidity(0),  // Initialize humidity
       weatherDescription("Unknown"), 
       weatherIcon(""),
+      condition(WEATHER_UNKNOWN),
+      lastForecastTime(0),
+      hasForecast(false),
+      updateRequested(false),
       lastUpdateTime(0),
-      shouldRun(false) {
+      lastUpdateEpoch(0),
+      hasData(false),
+      shouldRun(false),
+      breaker(WEATHER_FAILURE_THRESHOLD, WEATHER_BACKOFF_BASE, WEATHER_BACKOFF_MAX, WEATHER_BREAKER_COOLDOWN),
+      lastParsePeakBytes(0),
+      lastResponseBytes(0),
+      lastFetchHeapUsed(0) {
+    Metrics::add("ledcloud_weather_api_calls_total", "OpenWeatherMap requests made (weather and forecast)", apiCallCount);
+    Metrics::add("ledcloud_weather_api_failures_total", "Failed weather requests and endpoint probes", apiFailures);
+    Metrics::add("ledcloud_weather_cache_hits_total", "Weather fetches answered from the cache", cacheHits);
+    Metrics::add("ledcloud_weather_cache_misses_total", "Weather fetches that went to the network", cacheMisses);
 }
 
 Weather* Weather::getInstance() {
@@ -35,9 +99,10 @@ void Weather::begin(const String& apiKey, float latitude, float longitude) {
     this->latitude = latitude;
     this->longitude = longitude;
     
-    Serial.println("Weather service initialized");
+    LOG_INFO("Weather service initialized");
     
-    // Fetch initial weather data
+    // Serve the last reading immediately; only fetch if it is stale
+    restoreCache();
     fetchWeatherData();
 }
 
@@ -47,17 +112,14 @@ void Weather::beginWithDefaults() {
     this->latitude = LATITUDE;
     this->longitude = LONGITUDE;
     
-    Serial.println("Weather service initialized with defaults from Config.h");
-    Serial.print("Location: ");
-    Serial.print(latitude, 6);
-    Serial.print(", ");
-    Serial.println(longitude, 6);
+    LOG_INFO("Weather service initialized with defaults from Config.h");
+    LOG_INFO("Location: %.6f, %.6f", latitude, longitude);
     
-    // Fetch initial weather data if API key is not the placeholder
-    if (apiKey != "YOUR_API_KEY_HERE") {
-        fetchWeatherData();
-    } else {
-        Serial.println("Weather updates disabled: No API key configured");
+    // Serve the last reading immediately; poll() fetches once WiFi is up and the reading is stale
+    restoreCache();
+    
+    if (apiKey == "YOUR_API_KEY_HERE") {
+        LOG_WARN("Weather updates disabled: No API key configured");
     }
 }
 
@@ -65,23 +127,24 @@ bool Weather::beginWithSavedSettings() {
     String savedApiKey;
     float savedLatitude = 0.0;
     float savedLongitude = 0.0;
+    String savedBaseUrl;
     
-    bool settingsLoaded = loadSettings(savedApiKey, savedLatitude, savedLongitude);
+    bool settingsLoaded = loadSettings(savedApiKey, savedLatitude, savedLongitude, savedBaseUrl);
     
     if (settingsLoaded && savedApiKey.length() > 0) {
         // Use saved settings
         this->apiKey = savedApiKey;
         this->latitude = savedLatitude;
         this->longitude = savedLongitude;
+        if (savedBaseUrl.length() > 0) {
+            this->apiBaseUrl = savedBaseUrl;
+        }
         
-        Serial.println("Weather service initialized with saved settings");
-        Serial.print("Location: ");
-        Serial.print(latitude, 6);
-        Serial.print(", ");
-        Serial.println(longitude, 6);
+        LOG_INFO("Weather service initialized with saved settings");
+        LOG_INFO("Location: %.6f, %.6f", latitude, longitude);
         
-        // Fetch initial weather data
-        fetchWeatherData();
+        // Serve the last reading immediately; poll() fetches once WiFi is up and the reading is stale
+        restoreCache();
         return true;
     } else {
         // Fall back to defaults
@@ -90,70 +153,48 @@ bool Weather::beginWithSavedSettings() {
     }
 }
 
-bool Weather::saveSettings(const String& apiKey, float latitude, float longitude) {
-    // Create a JSON document
-    JsonDocument doc;
-    
-    doc["apiKey"] = apiKey;
-    doc["latitude"] = latitude;
-    doc["longitude"] = longitude;
-    
-    // Open file for writing
-    File file = LittleFS.open(SETTINGS_FILE, "w");
-    if (!file) {
-        Serial.println("Failed to open weather settings file for writing");
+bool Weather::saveSettings(const String& apiKey, float latitude, float longitude, const String& baseUrl) {
+    SettingsStore* store = SettingsStore::getInstance();
+    const SettingsData& current = store->get();
+    if (apiKey.length() >= sizeof(current.apiKey) || baseUrl.length() >= sizeof(current.apiBaseUrl)) {
+        LOG_ERROR("Weather settings too long to save");
         return false;
     }
     
-    // Serialize JSON to file
-    if (serializeJson(doc, file) == 0) {
-        Serial.println("Failed to write weather settings to file");
-        file.close();
-        return false;
-    }
+    // Only marks the record dirty; the settings task writes it once changes settle
+    SettingsData& settings = store->edit();
+    strncpy(settings.apiKey, apiKey.c_str(), sizeof(settings.apiKey));
+    strncpy(settings.apiBaseUrl, baseUrl.c_str(), sizeof(settings.apiBaseUrl));
+    settings.latitude = latitude;
+    settings.longitude = longitude;
+    settings.weatherSaved = 1;
     
-    file.close();
-    Serial.println("Weather settings saved successfully");
+    LOG_INFO("Weather settings saved");
     return true;
 }
 
-bool Weather::loadSettings(String& apiKey, float& latitude, float& longitude) {
-    // Check if file exists
-    if (!LittleFS.exists(SETTINGS_FILE)) {
-        Serial.println("Weather settings file not found");
+bool Weather::loadSettings(String& apiKey, float& latitude, float& longitude, String& baseUrl) {
+    const SettingsData& settings = SettingsStore::getInstance()->get();
+    if (!settings.weatherSaved) {
+        LOG_INFO("No saved weather settings");
         return false;
     }
     
-    // Open file for reading
-    File file = LittleFS.open(SETTINGS_FILE, "r");
-    if (!file) {
-        Serial.println("Failed to open weather settings file for reading");
-        return false;
-    }
-    
-    // Parse JSON from file
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
+    apiKey = settings.apiKey;
+    latitude = settings.latitude;
+    longitude = settings.longitude;
+    baseUrl = settings.apiBaseUrl;
     
-    if (error) {
-        Serial.print("Failed to parse weather settings: ");
-        Serial.println(error.c_str());
-        return false;
-    }
-    
-    // Extract values
-    apiKey = doc["apiKey"].as<String>();
-    latitude = doc["latitude"].as<float>();
-    longitude = doc["longitude"].as<float>();
-    
-    Serial.println("Weather settings loaded successfully");
+    LOG_INFO("Weather settings loaded successfully");
     return true;
 }
 
-bool Weather::updateSettings(const String& apiKey, float latitude, float longitude) {
+bool Weather::updateSettings(const String& apiKey, float latitude, float longitude, const String& baseUrl) {
+    // An empty base URL keeps the current endpoint
+    String newBaseUrl = baseUrl.length() > 0 ? baseUrl : apiBaseUrl;
+    
     // Save new settings
-    if (!saveSettings(apiKey, latitude, longitude)) {
+    if (!saveSettings(apiKey, latitude, longitude, newBaseUrl)) {
         return false;
     }
     
@@ -161,6 +202,13 @@ bool Weather::updateSettings(const String& apiKey, float latitude, float longitu
     this->apiKey = apiKey;
     this->latitude = latitude;
     this->longitude = longitude;
+    this->apiBaseUrl = newBaseUrl;
+    
+    // A new endpoint or key deserves a fresh start rather than the old backoff
+    breaker.recordSuccess(millis());
+    
+    // The cached reading belongs to the old location
+    invalidateCache();
     
     // Fetch weather with new settings
     updateNow();
@@ -168,10 +216,7 @@ bool Weather::updateSettings(const String& apiKey, float latitude, float longitu
     return true;
 }
 
-String Weather::getSettingsJson() const {
-    // Create a JSON document
-    JsonDocument doc;
-    
+void Weather::getSettings(JsonDocument& doc) const {
     // Mask API key for security (show only last 4 characters)
     String maskedApiKey = apiKey;
     if (maskedApiKey.length() > 4) {
@@ -183,55 +228,315 @@ String Weather::getSettingsJson() const {
     doc["apiKey"] = maskedApiKey;
     doc["latitude"] = latitude;
     doc["longitude"] = longitude;
-    
-    String jsonString;
-    serializeJson(doc, jsonString);
-    
-    return jsonString;
+    doc["baseUrl"] = apiBaseUrl;
 }
 
 void Weather::startTask() {
     shouldRun = true;
     
-    // Using a ticker to schedule periodic updates
+    // The ticker only flags the update; the HTTP request runs from poll() in loop context
     weatherTicker.attach_ms(UPDATE_INTERVAL, []() {
-        Weather::getInstance()->fetchWeatherData();
+        Weather::getInstance()->updateRequested = true;
     });
     
-    Serial.println("Weather update task started");
+    LOG_INFO("Weather update task started");
 }
 
 void Weather::stopTask() {
     shouldRun = false;
     weatherTicker.detach();
-    Serial.println("Weather update task stopped");
+    LOG_INFO("Weather update task stopped");
+}
+
+void Weather::poll() {
+    // Nothing to do while the reading is current (never more often than the API rate limit)
+    unsigned long interval = UPDATE_INTERVAL > MIN_API_CALL_INTERVAL ? UPDATE_INTERVAL : MIN_API_CALL_INTERVAL;
+    bool weatherDue = updateRequested || !hasData || getDataAgeMs() >= interval;
+    bool forecastDue = !hasForecast || millis() - lastForecastTime >= FORECAST_UPDATE_INTERVAL;
+    if (!weatherDue && !forecastDue) {
+        return;
+    }
+    
+    // Stay quiet while offline, unconfigured or backing off; fetchWeatherData() would only log the skip
+    if (WiFi.status() != WL_CONNECTED || apiKey.length() == 0 || apiKey == "YOUR_API_KEY_HERE") {
+        return;
+    }
+    if (!breaker.allowRequest(millis())) {
+        return;
+    }
+    
+    // At most one blocking request per poll; the forecast follows on the next tick
+    if (weatherDue) {
+        updateRequested = false;
+        fetchWeatherData();
+    } else {
+        fetchForecast();
+    }
+}
+
+void Weather::fetchForecast() {
+    TRACE_SCOPE(TRACE_WEATHER_FORECAST);
+    
+    // After the breaker opened, check the host accepts connections before a full request
+    if (breaker.getState() == CircuitBreaker::HALF_OPEN && !probeEndpoint()) {
+        recordFailure("probe");
+        return;
+    }
+    
+    WiFiClient client;
+    HTTPClient http;
+    
+    // 5-day/3-hour forecast (free tier), 40 entries
+    String url = apiBaseUrl + "/forecast?";
+    url += "lat=" + String(latitude, 6);
+    url += "&lon=" + String(longitude, 6);
+    url += "&appid=" + apiKey;
+    url += "&units=metric";
+    
+    http.useHTTP10(true);
+    http.setTimeout(WEATHER_HTTP_TIMEOUT);
+    http.begin(client, url);
+    
+    apiCallCount.inc();
+    LOG_INFO("Making API call #%lu to OpenWeatherMap (forecast)", getApiCallCount());
+    
+    int httpResponseCode = http.GET();
+    if (httpResponseCode != HTTP_CODE_OK) {
+        LOG_WARN("Forecast error code: %d", httpResponseCode);
+        recordFailure(httpResponseCode > 0 ? "http status" : "connection");
+        http.end();
+        return;
+    }
+    
+    // The response is ~16 KB; walk the "list" array and parse one entry at a time
+    JsonDocument filter;
+    filter["dt"] = true;
+    filter["main"]["temp"] = true;
+    filter["main"]["humidity"] = true;
+    filter["weather"][0]["id"] = true;
+    
+    BoundedAllocator allocator(WEATHER_PARSE_BUFFER_LIMIT);
+    BufferedStreamReader<> reader(http.getStream());
+    JsonDocument entry(&allocator);
+    size_t ingested = 0;
+    
+    if (reader.find("\"list\":[")) {
+        do {
+            DeserializationError error = deserializeJson(entry, reader, DeserializationOption::Filter(filter));
+            if (error) {
+                LOG_WARN("Forecast entry parse failed: %s", error.c_str());
+                break;
+            }
+            
+            ForecastSample sample;
+            sample.epoch = entry["dt"] | 0;
+            sample.temperatureCenti = static_cast<int16_t>(lroundf((entry["main"]["temp"] | 0.0f) * 100.0f));
+            sample.humidity = static_cast<uint8_t>(constrain(entry["main"]["humidity"] | 0, 0, 100));
+            sample.condition = weatherConditionFromId(entry["weather"][0]["id"] | 0);
+            if (sample.epoch != 0 && forecast.upsert(sample)) {
+                ingested++;
+            }
+        } while (reader.readNonSpace() == ',');
+    }
+    http.end();
+    
+    LOG_INFO("Forecast: %u samples ingested (%u held), %u bytes read, parse peak %u bytes",
+             (unsigned)ingested, (unsigned)forecast.size(),
+             (unsigned)reader.getBytesRead(), (unsigned)allocator.getPeak());
+    
+    if (ingested == 0) {
+        recordFailure("forecast parse");
+        return;
+    }
+    
+    lastForecastTime = millis();
+    hasForecast = true;
+    breaker.recordSuccess(millis());
+}
+
+void Weather::getForecast(JsonDocument& doc) const {
+    // Rows of [epoch, temperature in 1/100 °C, humidity %, condition code]
+    doc["fields"] = "epoch,tempCenti,humidity,condition";
+    doc["count"] = forecast.size();
+    JsonArray samples = doc["samples"].to<JsonArray>();
+    for (size_t i = 0; i < forecast.size(); i++) {
+        const ForecastSample& sample = forecast.at(i);
+        JsonArray row = samples.add<JsonArray>();
+        row.add(sample.epoch);
+        row.add(sample.temperatureCenti);
+        row.add(sample.humidity);
+        row.add(sample.condition);
+    }
+}
+
+void Weather::recordFailure(const char* reason) {
+    breaker.recordFailure(millis(), (uint32_t)random(0x7FFFFFFF));
+    apiFailures.inc();
+    LOG_WARN("Weather fetch failed (%s): %u consecutive, breaker %s, retry in %lu s",
+             reason, breaker.getConsecutiveFailures(),
+             CircuitBreaker::stateName(breaker.getState()),
+             (unsigned long)(breaker.getRetryInMs(millis()) / 1000));
+}
+
+bool Weather::probeEndpoint() {
+    // Extract host and port from "http://host[:port]/path"
+    String host = apiBaseUrl;
+    int schemeEnd = host.indexOf("://");
+    if (schemeEnd >= 0) {
+        host = host.substring(schemeEnd + 3);
+    }
+    int pathStart = host.indexOf('/');
+    if (pathStart >= 0) {
+        host = host.substring(0, pathStart);
+    }
+    uint16_t port = 80;
+    int portStart = host.indexOf(':');
+    if (portStart >= 0) {
+        port = host.substring(portStart + 1).toInt();
+        host = host.substring(0, portStart);
+    }
+    
+    WiFiClient probe;
+    probe.setTimeout(WEATHER_PROBE_TIMEOUT);
+    bool reachable = probe.connect(host.c_str(), port);
+    probe.stop();
+    
+    LOG_INFO("Weather endpoint probe %s:%u %s", host.c_str(), port, reachable ? "succeeded" : "failed");
+    return reachable;
 }
 
 void Weather::updateNow() {
     // Force an immediate weather update regardless of the schedule
-    fetchWeatherData();
-    Serial.println("Manual weather update triggered");
+    fetchWeatherData(true);
+    LOG_INFO("Manual weather update triggered");
 }
 
-void Weather::fetchWeatherData() {
+bool Weather::restoreCache() {
+    WeatherCacheRecord record;
+    const char* source = "RTC memory";
+    
+    // RTC memory survives soft resets and avoids a flash read; after power-on it fails the CRC
+    if (!ESP.rtcUserMemoryRead(RTC_WEATHER_CACHE_BLOCK, reinterpret_cast<uint32_t*>(&record), sizeof(record)) ||
+        !isCacheRecordValid(record)) {
+        source = "LittleFS";
+        File file = LittleFS.open(CACHE_FILE, "r");
+        if (!file) {
+            LOG_INFO("No cached weather data");
+            return false;
+        }
+        size_t bytesRead = file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record));
+        file.close();
+        
+        if (bytesRead != sizeof(record) || !isCacheRecordValid(record)) {
+            LOG_WARN("Cached weather data is corrupt, ignoring");
+            return false;
+        }
+    }
+    
+    record.description[sizeof(record.description) - 1] = '\0';
+    record.icon[sizeof(record.icon) - 1] = '\0';
+    
+    temperature = record.temperatureCenti / 100.0f;
+    humidity = record.humidity;
+    weatherDescription = record.description;
+    weatherIcon = record.icon;
+    condition = record.condition;
+    lastUpdateEpoch = record.epoch;
+    // Without a synced clock the age is unknown, so count it from boot (conservative for the API quota)
+    lastUpdateTime = millis();
+    hasData = true;
+    
+    LOG_INFO("Weather restored from %s cache: %.1f°C, %s",
+             source, temperature, weatherDescription.c_str());
+    return true;
+}
+
+void Weather::storeCache() {
+    // Once an update is complete, RTC memory holds the bootloader's command; leave it alone until the restart
+    if (OtaService::getInstance()->isRestartPending()) {
+        return;
+    }
+    WeatherCacheRecord record;
+    memset(&record, 0, sizeof(record));
+    
+    record.magic = CACHE_MAGIC;
+    record.epoch = lastUpdateEpoch;
+    record.temperatureCenti = static_cast<int16_t>(lroundf(temperature * 100.0f));
+    record.humidity = static_cast<uint8_t>(constrain(humidity, 0, 100));
+    record.condition = condition;
+    strncpy(record.icon, weatherIcon.c_str(), sizeof(record.icon) - 1);
+    strncpy(record.description, weatherDescription.c_str(), sizeof(record.description) - 1);
+    record.crc = cacheChecksum(record);
+    
+    ESP.rtcUserMemoryWrite(RTC_WEATHER_CACHE_BLOCK, reinterpret_cast<uint32_t*>(&record), sizeof(record));
+    
+    File file = LittleFS.open(CACHE_FILE, "w");
+    if (!file) {
+        LOG_ERROR("Failed to open weather cache file for writing");
+        return;
+    }
+    if (file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record)) != sizeof(record)) {
+        LOG_ERROR("Failed to write weather cache");
+    }
+    file.close();
+}
+
+void Weather::invalidateCache() {
+    uint32_t zero = 0;
+    ESP.rtcUserMemoryWrite(RTC_WEATHER_CACHE_BLOCK, &zero, sizeof(zero));
+    LittleFS.remove(CACHE_FILE);
+    hasData = false;
+}
+
+unsigned long Weather::getDataAgeMs() const {
+    // Prefer wall-clock age so time spent powered off or rebooting is counted
+    if (lastUpdateEpoch != 0 && isClockSynced()) {
+        time_t now = time(nullptr);
+        return now > (time_t)lastUpdateEpoch ? (unsigned long)(now - lastUpdateEpoch) * 1000UL : 0;
+    }
+    return millis() - lastUpdateTime;
+}
+
+bool Weather::isCacheFresh() const {
+    return hasData && getDataAgeMs() < WEATHER_CACHE_TTL;
+}
+
+void Weather::fetchWeatherData(bool force) {
+    TRACE_SCOPE(TRACE_WEATHER_FETCH);
+    
+    // Serve the cached reading while it is still fresh
+    if (!force && isCacheFresh()) {
+        cacheHits.inc();
+        LOG_DEBUG("Weather cache hit (age %lu s), skipping API call", getDataAgeMs() / 1000);
+        return;
+    }
+    cacheMisses.inc();
+    
     // Only fetch if WiFi is connected
     if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("WiFi not connected. Skipping weather update.");
+        LOG_WARN("WiFi not connected. Skipping weather update.");
         return;
     }
     
     // Check if API key is set
     if (apiKey.length() == 0 || apiKey == "YOUR_API_KEY_HERE") {
-        Serial.println("API key not set. Skipping weather update.");
+        LOG_WARN("API key not set. Skipping weather update.");
         return;
     }
     
-    // Rate limiting - check if enough time has passed since the last API call
+    // Backoff and circuit breaker - don't touch the network while the API is known to be failing
     unsigned long currentTime = millis();
+    if (!breaker.allowRequest(currentTime)) {
+        LOG_DEBUG("Weather breaker %s, next attempt in %lu seconds",
+                  CircuitBreaker::stateName(breaker.getState()),
+                  (unsigned long)(breaker.getRetryInMs(currentTime) / 1000));
+        return;
+    }
+    
+    // Rate limiting - check if enough time has passed since the last API call
     if (lastApiCallTime > 0 && (currentTime - lastApiCallTime < MIN_API_CALL_INTERVAL)) {
-        Serial.println("API call rate limited. Too frequent calls to OpenWeatherMap API.");
-        Serial.printf("Next API call allowed in %lu seconds\n", 
-                     (MIN_API_CALL_INTERVAL - (currentTime - lastApiCallTime)) / 1000);
+        LOG_WARN("API call rate limited, next call allowed in %lu seconds",
+                 (MIN_API_CALL_INTERVAL - (currentTime - lastApiCallTime)) / 1000);
         return;
     }
     
@@ -239,8 +544,14 @@ void Weather::fetchWeatherData() {
     WiFiClient client;
     HTTPClient http;
     
+    // After the breaker opened, check the host accepts connections before a full request
+    if (breaker.getState() == CircuitBreaker::HALF_OPEN && !probeEndpoint()) {
+        recordFailure("probe");
+        return;
+    }
+    
     // Build the URL for OpenWeatherMap Current Weather API (free tier compatible)
-    String url = "http://api.openweathermap.org/data/2.5/weather?";
+    String url = apiBaseUrl + "/weather?";
     
     // Add latitude and longitude
     url += "lat=" + String(latitude, 6); // 6 decimal places for accuracy
@@ -252,35 +563,52 @@ void Weather::fetchWeatherData() {
     // Add units parameter (metric for Celsius)
     url += "&units=metric";
     
-    Serial.println("Fetching weather data from: " + url);
+    LOG_DEBUG("Fetching weather data from: %s", url.c_str());
+    
+    uint32_t heapBefore = ESP.getFreeHeap();
+    
+    // HTTP/1.0 avoids chunked transfer encoding so the body can be parsed straight off the socket
+    http.useHTTP10(true);
+    http.setTimeout(WEATHER_HTTP_TIMEOUT);
     
     // Start the HTTP request
     http.begin(client, url);
     
-    // Update last API call time before making the call
-    lastApiCallTime = currentTime;
-    
     // Increment API call counter
-    apiCallCount++;
-    Serial.printf("Making API call #%lu to OpenWeatherMap\n", apiCallCount);
+    apiCallCount.inc();
+    LOG_INFO("Making API call #%lu to OpenWeatherMap", getApiCallCount());
     
     // Send HTTP GET request
     int httpResponseCode = http.GET();
     
-    if (httpResponseCode > 0) {
-        Serial.print("HTTP Response code: ");
-        Serial.println(httpResponseCode);
+    if (httpResponseCode == HTTP_CODE_OK) {
+        LOG_DEBUG("HTTP Response code: %d", httpResponseCode);
+        
+        // Only the fields we display survive the filter; everything else is skipped while reading
+        JsonDocument filter;
+        filter["main"]["temp"] = true;
+        filter["main"]["humidity"] = true;
+        filter["weather"][0]["description"] = true;
+        filter["weather"][0]["icon"] = true;
+        filter["weather"][0]["id"] = true;
         
-        String payload = http.getString();
-        Serial.println("Response: " + payload);
+        // Parse directly from the socket through a small buffer into a size-capped document
+        BoundedAllocator allocator(WEATHER_PARSE_BUFFER_LIMIT);
+        BufferedStreamReader<> reader(http.getStream());
+        JsonDocument doc(&allocator);
+        DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(filter));
         
-        // Use Arduino JSON to parse response
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, payload);
+        lastParsePeakBytes = allocator.getPeak();
+        lastResponseBytes = reader.getBytesRead();
+        uint32_t heapDuring = ESP.getFreeHeap();
+        lastFetchHeapUsed = heapBefore > heapDuring ? heapBefore - heapDuring : 0;
+        LOG_DEBUG("Weather response: %u bytes read, parse peak %u/%u bytes, heap used %u bytes",
+                  (unsigned)lastResponseBytes, (unsigned)lastParsePeakBytes,
+                  (unsigned)allocator.getLimit(), lastFetchHeapUsed);
         
         if (error) {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.c_str());
+            LOG_ERROR("deserializeJson() failed: %s", error.c_str());
+            recordFailure("parse");
         } else {
             // Extract current weather data from JSON
             temperature = doc["main"]["temp"];
@@ -288,9 +616,6 @@ void Weather::fetchWeatherData() {
             // Extract humidity from the response
             if (!doc["main"]["humidity"].isNull()) {
                 humidity = doc["main"]["humidity"].as<int>();
-                Serial.print("Humidity: ");
-                Serial.print(humidity);
-                Serial.println("%");
             }
             
             // Weather description
@@ -305,29 +630,39 @@ void Weather::fetchWeatherData() {
                 weatherIcon = doc["weather"][0]["icon"].as<String>();
             }
             
-            Serial.println("Weather data updated successfully");
-            Serial.print("Temperature: ");
-            Serial.print(temperature);
-            Serial.println("°C");
-            Serial.print("Description: ");
-            Serial.println(weatherDescription);
+            // Compact condition code for LED patterns and the cache
+            condition = weatherConditionFromId(doc["weather"][0]["id"] | 0);
+            
+            LOG_INFO("Weather data updated: %.1f°C, %d%%, %s",
+                     temperature, humidity, weatherDescription.c_str());
+            
+            // Update timestamp and persist the reading for the next boot
+            lastUpdateTime = millis();
+            lastUpdateEpoch = isClockSynced() ? (uint32_t)time(nullptr) : 0;
+            hasData = true;
+            storeCache();
+            BootTimeline::finish(BOOT_FIRST_WEATHER);
+            
+            // Only successful calls count toward the rate limit; failures are paced by the breaker
+            lastApiCallTime = currentTime;
+            breaker.recordSuccess(millis());
         }
     } else {
-        Serial.print("Error code: ");
-        Serial.println(httpResponseCode);
+        LOG_WARN("Weather HTTP error code: %d", httpResponseCode);
+        recordFailure(httpResponseCode > 0 ? "http status" : "connection");
     }
     
     // Free resources
     http.end();
-    
-    // Update timestamp
-    lastUpdateTime = millis();
 }
 
 String Weather::getLastUpdateTime() const {
+    if (!hasData) {
+        return "never";
+    }
+    
     // Calculate minutes since the last update
-    unsigned long currentTime = millis();
-    unsigned long timeDiff = (currentTime - lastUpdateTime) / 60000; // convert to minutes
+    unsigned long timeDiff = getDataAgeMs() / 60000; // convert to minutes
     
     if (timeDiff < 60) {
         return String(timeDiff) + " min ago";
@@ -338,19 +673,24 @@ String Weather::getLastUpdateTime() const {
     }
 }
 
-String Weather::toJson() const {
-    // Create a JSON document
-    JsonDocument doc;
-    
+void Weather::getWeather(JsonDocument& doc) const {
     doc["temperature"] = temperature;
     doc["humidity"] = humidity;  // Include humidity in the JSON response
     doc["description"] = weatherDescription;
     doc["icon"] = weatherIcon;
+    doc["condition"] = weatherConditionName(condition);
     doc["lastUpdate"] = getLastUpdateTime();
-    doc["apiCallCount"] = apiCallCount;
-    
-    String jsonString;
-    serializeJson(doc, jsonString);
-    
-    return jsonString;
+    doc["apiCallCount"] = apiCallCount.get();
+    doc["parsePeakBytes"] = lastParsePeakBytes;
+    doc["responseBytes"] = lastResponseBytes;
+    doc["fetchHeapUsed"] = lastFetchHeapUsed;
+    doc["cacheHits"] = cacheHits.get();
+    doc["cacheMisses"] = cacheMisses.get();
+    
+    JsonObject breakerJson = doc["breaker"].to<JsonObject>();
+    breakerJson["state"] = CircuitBreaker::stateName(breaker.getState());
+    breakerJson["consecutiveFailures"] = breaker.getConsecutiveFailures();
+    breakerJson["totalFailures"] = breaker.getTotalFailures();
+    breakerJson["openCount"] = breaker.getOpenCount();
+    breakerJson["retryInMs"] = breaker.getRetryInMs(millis());
 }
\ No newline at end of file
@@ -1,10 +1,143 @@
 #include "HttpConstants.h" // Include HTTP constants first
 #include "WebServer.h"
 #include "NeoPixel.h" // Include NeoPixel.h for NeoPixel class references
+#include "Trace.h"
+#include "Log.h"
+#include "Settings.h"
+#include "Boot.h"
+#include "SyncService.h"
+#include "Preset.h"
+#include "OtaService.h"
+#include "HttpApi.h"
+#include "RequestTracker.h"
+#include <memory>
 
 // Define the onboard LED pin for ESP8266
 #define LED_BUILTIN_PIN LED_BUILTIN // Use the predefined LED_BUILTIN
 
+uint16_t RequestTracker::active = 0;
+
+namespace {
+
+// Queue the strip's pattern, brightness and colors for the next settings write
+void saveNeoPixelState()
+{
+    NeoPixel *neoPixel = NeoPixel::getInstance();
+    SettingsData &settings = SettingsStore::getInstance()->edit();
+    settings.pattern = neoPixel->getPattern();
+    settings.pixelBrightness = constrain(neoPixel->getBrightness(), 0, 255);
+    for (int i = 0; i < NEOPIXEL_COUNT; i++)
+    {
+        uint32_t color = neoPixel->getPixelColor(i);
+        settings.pixels[i][0] = (color >> 16) & 0xFF;
+        settings.pixels[i][1] = (color >> 8) & 0xFF;
+        settings.pixels[i][2] = color & 0xFF;
+    }
+}
+
+/**
+ * @brief Keeps the Accept and X-OTA-Token headers, which the server drops before the routes see them otherwise
+ *
+ * Registered ahead of every route. It never claims a request; asking for the
+ * headers from canHandle() is what makes the server keep them.
+ */
+class KeptHeadersHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest *request) override
+    {
+        request->addInterestingHeader("Accept");
+        request->addInterestingHeader("X-OTA-Token");
+        return false;
+    }
+};
+
+/**
+ * @brief An AsyncWebServerRequest, and the body chunk that came with it, as an ApiRequest
+ *
+ * Body routes take the body from their first chunk, as they always have.
+ */
+class AsyncApiRequest : public ApiRequest
+{
+public:
+    explicit AsyncApiRequest(AsyncWebServerRequest *request, const uint8_t *data = nullptr, size_t len = 0)
+        : request(request), data(data), len(len) {}
+
+    const char *getParam(const char *name) const override
+    {
+        AsyncWebParameter *param = request->getParam(name);
+        return param ? param->value().c_str() : nullptr;
+    }
+
+    const char *getHeader(const char *name) const override
+    {
+        AsyncWebHeader *header = request->getHeader(name);
+        return header ? header->value().c_str() : nullptr;
+    }
+
+    const char *getContentType() const override { return request->contentType().c_str(); }
+    const uint8_t *getBody() const override { return data; }
+    size_t getBodyLength() const override { return len; }
+
+private:
+    AsyncWebServerRequest *request;
+    const uint8_t *data;
+    size_t len;
+};
+
+/**
+ * @brief Writes the reply into an AsyncResponseStream and sends it on end()
+ */
+class AsyncApiResponse : public ApiResponse
+{
+public:
+    explicit AsyncApiResponse(AsyncWebServerRequest *request) : request(request), stream(nullptr) {}
+
+    void begin(int code, const char *contentType) override
+    {
+        stream = request->beginResponseStream(contentType);
+        stream->setCode(code);
+    }
+
+    size_t write(const uint8_t *data, size_t length) override { return stream->write(data, length); }
+    void addHeader(const char *name, const char *value) override { stream->addHeader(name, value); }
+    void end() override { request->send(stream); }
+
+private:
+    AsyncWebServerRequest *request;
+    AsyncResponseStream *stream;
+};
+
+// For the routes outside DashboardApi: send doc in the format the client accepts
+void sendDocument(AsyncWebServerRequest *request, int code, const JsonDocument &doc)
+{
+    AsyncApiRequest in(request);
+    AsyncApiResponse out(request);
+    ::sendDocument(in, out, code, doc);
+}
+
+// For the routes outside DashboardApi: a fixed JSON reply, converted if the client wants MessagePack
+void sendReply(AsyncWebServerRequest *request, int code, const String &json)
+{
+    AsyncApiRequest in(request);
+    AsyncApiResponse out(request);
+    ::sendReply(in, out, code, json.c_str());
+}
+
+// For the routes outside DashboardApi: parse a JSON or MessagePack body
+DeserializationError parseBody(AsyncWebServerRequest *request, JsonDocument &doc, const uint8_t *data, size_t len)
+{
+    AsyncApiRequest in(request, data, len);
+    return ::parseBody(in, doc);
+}
+
+} // namespace
+
+uint32_t apiClockUs()
+{
+    return micros();
+}
+
 /**
  * @brief Constructor initializes web server and stores LED state pointers
  * @param port Server port number
@@ -12,7 +145,8 @@
  * @param brightnessPtr Pointer to the brightness variable
  */
 WebServer::WebServer(uint16_t port, bool *ledStatePtr, int *brightnessPtr)
-    : server(port), ledState(ledStatePtr), brightness(brightnessPtr), weatherService(nullptr)
+    : server(port), ledState(ledStatePtr), brightness(brightnessPtr), weatherService(nullptr), scheduler(nullptr),
+      systemHistory(nullptr), dashboard(*this), routeCount(0), routesCounted(false)
 {
 
     // Record start time for uptime calculations
@@ -21,28 +155,6 @@ WebServer::WebServer(uint16_t port, bool *ledStatePtr, int *brightnessPtr)
     // Note: LED pin is already initialized in main.cpp
 }
 
-/**
- * @brief Initialize the file system for serving web files
- * @return true if initialization successful, false otherwise
- */
-
-bool WebServer::initFileSystem()
-{
-    // Try up to 3 times to mount the filesystem
-    for (int i = 0; i < 3; i++)
-    {
-        if (LittleFS.begin())
-        {
-            Serial.println("LittleFS mounted successfully");
-            return true;
-        }
-        delay(100);
-    }
-
-    Serial.println("An error occurred while mounting LittleFS");
-    return false;
-}
-
 /**
  * @brief Handle 404 errors with a simple text response
  */
@@ -56,18 +168,14 @@ void WebServer::notFound(AsyncWebServerRequest *request)
  */
 void WebServer::begin()
 {
-    // Initialize file system first
-    if (!initFileSystem())
-    {
-        Serial.println("Warning: Proceeding without file system");
-    }
+    // LittleFS is already mounted by Protocol::initializeSystem()
 
     // Set up all routes
     setupRoutes();
 
     // Start server
     server.begin();
-    Serial.println("HTTP server started on port 80");
+    LOG_INFO("HTTP server started on port 80");
 }
 
 /**
@@ -78,7 +186,7 @@ void WebServer::updateLED()
 {
     if (!ledState || !brightness)
     {
-        Serial.println("[ERROR] LED state or brightness pointer is null!");
+        LOG_ERROR("LED state or brightness pointer is null!");
         return;
     }
 
@@ -89,13 +197,13 @@ void WebServer::updateLED()
         // LED_BUILTIN is inverted (0 = full brightness, 1023 = off)
         int pwmValue = 1023 - map(*brightness, 0, 255, 0, 1023);
         analogWrite(LED_BUILTIN_PIN, pwmValue);
-        Serial.printf("LED ON with brightness %d (PWM value: %d)\n", *brightness, pwmValue);
+        LOG_DEBUG("LED ON with brightness %d (PWM value: %d)", *brightness, pwmValue);
     }
     else
     {
         // LED is off (HIGH for ESP8266 built-in LED)
         digitalWrite(LED_BUILTIN_PIN, HIGH);
-        Serial.println("LED OFF");
+        LOG_DEBUG("LED OFF");
     }
 }
 
@@ -104,6 +212,10 @@ void WebServer::updateLED()
  */
 void WebServer::setupRoutes()
 {
+    // Ahead of the routes: the tracker sees every request, and kept headers let them negotiate the response format
+    server.addHandler(new RequestTracker());
+    server.addHandler(new KeptHeadersHandler());
+
     // Set up routes for different functionalities
     setupLEDRoutes();
     setupSystemRoutes();
@@ -111,14 +223,36 @@ void WebServer::setupRoutes()
     setupNeoPixelRoutes();
 
     // Route for root / web page
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(LittleFS, "/index.html", "text/html"); });
+    server.on("/", HTTP_GET, [requests = countRoute("GET /")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_ROOT);
+        requests->inc();
+        request->send(LittleFS, "/index.html", "text/html"); });
 
     // Route to serve static files (CSS, JS, images)
     server.serveStatic("/", LittleFS, "/");
 
     // 404 handler
     server.onNotFound(notFound);
+    routesCounted = true;
+}
+
+/**
+ * @brief Register the routes again after the server was lent out
+ *
+ * Only called while no request is active (see RequestTracker), since reset()
+ * frees the handlers in-flight requests point to. The route counters keep
+ * their registrations and their counts.
+ */
+void WebServer::restoreRoutes()
+{
+    uint32_t heapBefore = ESP.getFreeHeap();
+    server.reset();
+    routeCount = 0;
+    setupRoutes();
+    uint32_t heapAfter = ESP.getFreeHeap();
+    LOG_INFO("HTTP routes restored: %u bytes of heap free before, %u after (routes use %d)",
+             (unsigned)heapBefore, (unsigned)heapAfter, (int)heapBefore - (int)heapAfter);
 }
 
 /**
@@ -127,41 +261,52 @@ void WebServer::setupRoutes()
 void WebServer::setupLEDRoutes()
 {
     // Simple health check endpoint that doesn't require filesystem
-    server.on("/health", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(200, "text/plain", "Server is running"); });
+    server.on("/health", HTTP_GET, [requests = countRoute("GET /health")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_HEALTH);
+        requests->inc();
+        request->send(200, "text/plain", "Server is running"); });
 
     // Route to set LED ON
-    server.on("/led/on", HTTP_GET, [this](AsyncWebServerRequest *request)
+    server.on("/led/on", HTTP_GET, [this, requests = countRoute("GET /led/on")](AsyncWebServerRequest *request)
               {
+        TRACE_SCOPE(TRACE_HTTP_LED_ON);
+        requests->inc();
         if (ledState) {
             *ledState = true;
-            Serial.println("LED ON");
+            LOG_INFO("LED ON");
             updateLED();
+            SettingsStore::getInstance()->edit().ledOn = 1;
         } else {
-            Serial.println("[ERROR] ledState pointer is null in /led/on");
+            LOG_ERROR("ledState pointer is null in /led/on");
         }
         request->send(200, "text/plain", "LED turned ON"); });
 
     // Route to set LED OFF
-    server.on("/led/off", HTTP_GET, [this](AsyncWebServerRequest *request)
+    server.on("/led/off", HTTP_GET, [this, requests = countRoute("GET /led/off")](AsyncWebServerRequest *request)
               {
+        TRACE_SCOPE(TRACE_HTTP_LED_OFF);
+        requests->inc();
         if (ledState) {
             *ledState = false;
-            Serial.println("LED OFF");
+            LOG_INFO("LED OFF");
             updateLED();
+            SettingsStore::getInstance()->edit().ledOn = 0;
         } else {
-            Serial.println("[ERROR] ledState pointer is null in /led/off");
+            LOG_ERROR("ledState pointer is null in /led/off");
         }
         request->send(200, "text/plain", "LED turned OFF"); });
 
     // Route to set brightness
-    server.on("/brightness", HTTP_GET, [this](AsyncWebServerRequest *request)
+    server.on("/brightness", HTTP_GET, [this, requests = countRoute("GET /brightness")](AsyncWebServerRequest *request)
               {
+        TRACE_SCOPE(TRACE_HTTP_BRIGHTNESS);
+        requests->inc();
         if (brightness) {
             if (request->hasParam("value")) {
                 *brightness = request->getParam("value")->value().toInt();
-                Serial.print("Brightness set to: ");
-                Serial.println(*brightness);
+                LOG_INFO("Brightness set to: %d", *brightness);
+                SettingsStore::getInstance()->edit().ledBrightness = constrain(*brightness, 0, 255);
                 
                 // Apply the brightness if the LED is on
                 if (ledState && *ledState) {
@@ -169,7 +314,7 @@ void WebServer::setupLEDRoutes()
                 }
             }
         } else {
-            Serial.println("[ERROR] brightness pointer is null in /brightness");
+            LOG_ERROR("brightness pointer is null in /brightness");
         }
         request->send(200, "text/plain", "Brightness updated"); });
 }
@@ -180,18 +325,246 @@ void WebServer::setupLEDRoutes()
 void WebServer::setupSystemRoutes()
 {
     // Improved system info endpoint with heap fragmentation and WiFi signal
-    server.on("/system-info", HTTP_GET, [this](AsyncWebServerRequest *request)
+    server.on("/system-info", HTTP_GET, [this, requests = countRoute("GET /system-info")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_SYSTEM_INFO);
+        requests->inc();
+        AsyncApiRequest in(request);
+        AsyncApiResponse out(request);
+        dashboard.systemInfo(in, out); });
+
+    // Per-task scheduler statistics
+    server.on("/tasks", HTTP_GET, [this, requests = countRoute("GET /tasks")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_TASKS);
+        requests->inc();
+        if (!scheduler) {
+            sendReply(request, 503, "{\"error\":\"Scheduler not available\"}");
+            return;
+        }
+        
+        JsonDocument doc;
+        JsonArray tasks = doc["tasks"].to<JsonArray>();
+        for (size_t i = 0; i < scheduler->getTaskCount(); i++) {
+            const Scheduler::Task& task = scheduler->getTask(i);
+            JsonObject entry = tasks.add<JsonObject>();
+            entry["name"] = task.name;
+            entry["priority"] = task.priority;
+            entry["intervalMs"] = task.intervalUs / 1000;
+            entry["runs"] = task.runCount;
+            entry["avgRuntimeUs"] = Scheduler::getAverageRuntimeUs(task);
+            entry["maxRuntimeUs"] = task.maxRuntimeUs;
+            entry["lastJitterUs"] = task.lastJitterUs;
+            entry["maxJitterUs"] = task.maxJitterUs;
+            entry["missedDeadlines"] = task.missedDeadlines;
+            entry["overruns"] = task.overruns;
+        }
+        
+        sendDocument(request, 200, doc); });
+
+    // When each boot phase started and finished; background phases may still be pending
+    server.on("/boot", HTTP_GET, [requests = countRoute("GET /boot")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_BOOT);
+        requests->inc();
+        
+        JsonDocument doc;
+        doc["resetReason"] = ESP.getResetReason();
+        doc["warmStart"] = NeoPixel::getInstance()->isWarmStart();
+        JsonArray phases = doc["phases"].to<JsonArray>();
+        for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+            const BootTimeline::Phase& phase = BootTimeline::get(i);
+            JsonObject entry = phases.add<JsonObject>();
+            entry["name"] = BootTimeline::getName(i);
+            if (!phase.started) {
+                entry["state"] = "not started";
+                continue;
+            }
+            entry["startMs"] = phase.startUs / 1000.0f;
+            if (phase.finished) {
+                entry["state"] = "done";
+                entry["endMs"] = phase.endUs / 1000.0f;
+                entry["durationMs"] = (phase.endUs - phase.startUs) / 1000.0f;
+                entry["freeHeap"] = phase.freeHeap;
+            } else {
+                entry["state"] = "running";
+            }
+        }
+        
+        sendDocument(request, 200, doc); });
+
+    // Downsampled heap, signal and frame time history, streamed as column arrays
+    server.on("/system-history", HTTP_GET, [this, requests = countRoute("GET /system-history")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_SYSTEM_HISTORY);
+        requests->inc();
+        if (!systemHistory) {
+            sendReply(request, 503, "{\"error\":\"History not available\"}");
+            return;
+        }
+        
+        auto exporter = std::make_shared<HistoryExporter>(*systemHistory, millis());
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [exporter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+            { return exporter->fill(buffer, maxLen); });
+        request->send(response); });
+
+    // Prometheus text exposition of the metrics registry, streamed entry by entry
+    server.on("/metrics", HTTP_GET, [requests = countRoute("GET /metrics")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_METRICS);
+        requests->inc();
+        
+        auto exporter = std::make_shared<MetricsExporter>();
+        AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain; version=0.0.4",
+            [exporter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+            { return exporter->fill(buffer, maxLen); });
+        request->send(response); });
+
+    // Recent log output from the RAM ring buffer, with logging cost counters in the headers
+    server.on("/logs", HTTP_GET, [requests = countRoute("GET /logs")](AsyncWebServerRequest *request)
               {
-        String json = "{";
-        json += "\"freeHeap\":" + String(ESP.getFreeHeap()) + ",";
-        json += "\"heapFragmentation\":" + String(ESP.getHeapFragmentation()) + ",";
-        json += "\"wifiSignal\":" + String(WiFi.RSSI()) + ",";
-        json += "\"ledState\":" + String(ledState ? (*ledState) : 0) + ",";
-        json += "\"brightness\":" + String(brightness ? (*brightness) : 0) + ",";
-        json += "\"uptime\":" + String((millis() - startTime) / 1000);
-        json += "}";
+        TRACE_SCOPE(TRACE_HTTP_LOGS);
+        requests->inc();
         
-        request->send(200, "application/json", json); });
+        // Snapshot now; the ring keeps moving while the response is sent
+        size_t capacity = Log::getBufferedLength();
+        std::shared_ptr<char> snapshot(new char[capacity + 1], std::default_delete<char[]>());
+        size_t length = Log::copyRecent(snapshot.get(), capacity);
+        AsyncWebServerResponse *response = request->beginResponse("text/plain", length,
+            [snapshot, length](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+            {
+                size_t chunk = length - index < maxLen ? length - index : maxLen;
+                memcpy(buffer, snapshot.get() + index, chunk);
+                return chunk;
+            });
+        response->addHeader("X-Log-Lines", String(Log::getLineCount()));
+        response->addHeader("X-Log-Dropped-Bytes", String(Log::getDroppedBytes()));
+        response->addHeader("X-Log-Avg-Cycles", String(Log::getAverageCycles()));
+        request->send(response); });
+
+    // Chrome trace_event dump of recent timed regions (open in chrome://tracing or Perfetto)
+    server.on("/trace", HTTP_GET, [requests = countRoute("GET /trace")](AsyncWebServerRequest *request)
+              {
+        requests->inc();
+#if LEDCLOUD_TRACE
+        TRACE_SCOPE(TRACE_HTTP_TRACE);
+        
+        // The exporter snapshots the ring now and is streamed out as the TCP window allows
+        auto exporter = std::make_shared<TraceExporter>();
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [exporter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+            { return exporter->fill(buffer, maxLen); });
+        request->send(response);
+#else
+        sendReply(request, 501, "{\"error\":\"Tracing disabled (build with -D LEDCLOUD_TRACE=1)\"}");
+#endif
+    });
+
+    // Firmware update progress; with ?size=&crc= also where an upload of that image resumes
+    server.on("/ota", HTTP_GET, [requests = countRoute("GET /ota")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_OTA_GET);
+        requests->inc();
+        OtaService* ota = OtaService::getInstance();
+        
+        JsonDocument doc;
+        doc["state"] = ota->getStateName();
+        doc["imageSize"] = ota->getImageSize();
+        doc["received"] = ota->getReceived();
+        doc["written"] = ota->getWritten();
+        doc["committed"] = ota->getCommittedInput();
+        if (request->hasParam("size") && request->hasParam("crc")) {
+            doc["resumeOffset"] = ota->getResumeOffset(strtoul(request->getParam("size")->value().c_str(), nullptr, 10),
+                                                       strtoul(request->getParam("crc")->value().c_str(), nullptr, 10));
+        }
+        doc["lastError"] = ota->getLastError();
+        
+        sendDocument(request, 200, doc); });
+
+    // Get the flash ready for an upload (POST ?size=&crc=&imageCrc=, X-OTA-Token); GET /ota shows "ready" when it is
+    // (registered before POST /ota, which would otherwise match it as a sub-path)
+    server.on("/ota/prepare", HTTP_POST, [requests = countRoute("POST /ota/prepare")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_OTA_PREPARE);
+        requests->inc();
+        AsyncWebHeader* token = request->getHeader("X-OTA-Token");
+        if (!OtaService::isAuthorized(token ? token->value().c_str() : nullptr)) {
+            sendReply(request, 401, "{\"error\":\"A valid X-OTA-Token is required\"}");
+            return;
+        }
+        if (!request->hasParam("size") || !request->hasParam("crc") || !request->hasParam("imageCrc")) {
+            sendReply(request, 400, "{\"error\":\"size, crc and imageCrc are required\"}");
+            return;
+        }
+        OtaService* ota = OtaService::getInstance();
+        uint32_t imageSize = strtoul(request->getParam("size")->value().c_str(), nullptr, 10);
+        uint32_t packedCrc = strtoul(request->getParam("crc")->value().c_str(), nullptr, 10);
+        uint32_t imageCrc = strtoul(request->getParam("imageCrc")->value().c_str(), nullptr, 10);
+        const char* error = ota->prepare(imageSize, packedCrc, imageCrc);
+        if (error) {
+            sendReply(request, 409, String("{\"error\":\"") + error + "\"}");
+            return;
+        }
+        sendReply(request, 202,
+                  "{\"status\":\"erasing\",\"resumeOffset\":" + String(ota->getResumeOffset(imageSize, packedCrc)) + "}"); });
+
+    // Upload a firmware image packed by scripts/ota_pack.py (POST ?size=&crc=&imageCrc=&offset=, X-OTA-Token, application/octet-stream)
+    server.on("/ota", HTTP_POST, [](AsyncWebServerRequest *request) {
+            // The body handler below is never called without a body
+            if (request->contentLength() == 0) {
+                sendReply(request, 400, "{\"error\":\"Firmware image is empty\"}");
+            }
+        }, NULL,
+        [requests = countRoute("POST /ota")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+        {
+            TRACE_SCOPE(TRACE_HTTP_OTA_POST);
+            OtaService* ota = OtaService::getInstance();
+            if (index == 0) {
+                requests->inc();
+                AsyncWebHeader* token = request->getHeader("X-OTA-Token");
+                if (!OtaService::isAuthorized(token ? token->value().c_str() : nullptr)) {
+                    sendReply(request, 401, "{\"error\":\"A valid X-OTA-Token is required\"}");
+                    return;
+                }
+                if (!request->hasParam("size") || !request->hasParam("crc") || !request->hasParam("imageCrc")) {
+                    sendReply(request, 400, "{\"error\":\"size, crc and imageCrc are required\"}");
+                    return;
+                }
+                uint32_t imageSize = strtoul(request->getParam("size")->value().c_str(), nullptr, 10);
+                uint32_t packedCrc = strtoul(request->getParam("crc")->value().c_str(), nullptr, 10);
+                uint32_t imageCrc = strtoul(request->getParam("imageCrc")->value().c_str(), nullptr, 10);
+                uint32_t offset = request->hasParam("offset") ? strtoul(request->getParam("offset")->value().c_str(), nullptr, 10) : 0;
+                const char* error = ota->begin(request, offset, imageSize, packedCrc, imageCrc);
+                if (error) {
+                    sendReply(request, 409,
+                              String("{\"error\":\"") + error + "\",\"resumeOffset\":" + String(ota->getResumeOffset(imageSize, packedCrc)) + "}");
+                    return;
+                }
+                // A dropped connection ends the upload now rather than after OTA_STALL_TIMEOUT
+                RequestTracker::onDisconnect(request, [request]() { OtaService::getInstance()->release(request); });
+            }
+            if (!ota->isReceivingFrom(request)) {
+                return;  // Refused or failed; the response is already out
+            }
+            
+            const char* error = ota->write(request, data, len);
+            if (error) {
+                sendReply(request, 500, String("{\"error\":\"") + error + "\"}");
+                return;
+            }
+            bool complete = ota->isImageReceived();
+            if (!complete && index + len < total) {
+                return;  // More chunks to come
+            }
+            if (!complete) {
+                ota->release(request);
+            }
+            sendReply(request, 200,
+                      String("{\"status\":\"ok\",\"complete\":") + (complete ? "true" : "false") +
+                      ",\"committed\":" + String(ota->getCommittedInput()) + "}");
+        }
+    );
 }
 
 /**
@@ -199,24 +572,39 @@ void WebServer::setupSystemRoutes()
  */
 void WebServer::setupWeatherRoutes()
 {
-    // Weather data endpoint
-    server.on("/weather", HTTP_GET, [this](AsyncWebServerRequest *request)
+    // Forecast endpoint (registered before /weather, which would otherwise match it as a sub-path)
+    server.on("/weather/forecast", HTTP_GET, [this, requests = countRoute("GET /weather/forecast")](AsyncWebServerRequest *request)
               {
+        TRACE_SCOPE(TRACE_HTTP_WEATHER_FORECAST);
+        requests->inc();
         if (weatherService) {
-            String weatherJson = weatherService->toJson();
-            request->send(200, "application/json", weatherJson);
+            JsonDocument doc;
+            weatherService->getForecast(doc);
+            sendDocument(request, 200, doc);
         } else {
-            request->send(503, "application/json", "{\"error\":\"Weather service not available\"}");
+            sendReply(request, 503, "{\"error\":\"Weather service not available\"}");
         } });
 
+    // Weather data endpoint
+    server.on("/weather", HTTP_GET, [this, requests = countRoute("GET /weather")](AsyncWebServerRequest *request)
+              {
+        TRACE_SCOPE(TRACE_HTTP_WEATHER);
+        requests->inc();
+        AsyncApiRequest in(request);
+        AsyncApiResponse out(request);
+        dashboard.weather(in, out); });
+
     // Get weather settings endpoint
-    server.on("/weather-settings", HTTP_GET, [this](AsyncWebServerRequest *request)
+    server.on("/weather-settings", HTTP_GET, [this, requests = countRoute("GET /weather-settings")](AsyncWebServerRequest *request)
               {
+        TRACE_SCOPE(TRACE_HTTP_WEATHER_SETTINGS_GET);
+        requests->inc();
         if (weatherService) {
-            String settingsJson = weatherService->getSettingsJson();
-            request->send(200, "application/json", settingsJson);
+            JsonDocument doc;
+            weatherService->getSettings(doc);
+            sendDocument(request, 200, doc);
         } else {
-            request->send(503, "application/json", "{\"error\":\"Weather service not available\"}");
+            sendReply(request, 503, "{\"error\":\"Weather service not available\"}");
         } });
 
     // Save weather settings endpoint
@@ -224,19 +612,24 @@ void WebServer::setupWeatherRoutes()
               {
                   // POST request will be handled in the body handler
               },
-              NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              NULL, [this, requests = countRoute("POST /weather-settings")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
               {
+        TRACE_SCOPE(TRACE_HTTP_WEATHER_SETTINGS_POST);
+        if (index == 0) {
+            requests->inc();  // The body handler runs once per received chunk
+        }
+        
         if (!weatherService) {
-            request->send(503, "application/json", "{\"status\":\"error\",\"message\":\"Weather service not available\"}");
+            sendReply(request, 503, "{\"status\":\"error\",\"message\":\"Weather service not available\"}");
             return;
         }
         
         // Parse JSON data
         JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, data, len);
+        DeserializationError error = parseBody(request, doc, data, len);
         
         if (error) {
-            request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid JSON\"}");
+            sendReply(request, 400, "{\"status\":\"error\",\"message\":\"Invalid JSON\"}");
             return;
         }
         
@@ -244,14 +637,15 @@ void WebServer::setupWeatherRoutes()
         String apiKey = doc["apiKey"].as<String>();
         float latitude = doc["latitude"].as<float>();
         float longitude = doc["longitude"].as<float>();
+        String baseUrl = doc["baseUrl"] | "";
         
         // Update settings
-        bool success = weatherService->updateSettings(apiKey, latitude, longitude);
+        bool success = weatherService->updateSettings(apiKey, latitude, longitude, baseUrl);
         
         if (success) {
-            request->send(200, "application/json", "{\"status\":\"success\",\"message\":\"Settings updated\"}");
+            sendReply(request, 200, "{\"status\":\"success\",\"message\":\"Settings updated\"}");
         } else {
-            request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to save settings\"}");
+            sendReply(request, 500, "{\"status\":\"error\",\"message\":\"Failed to save settings\"}");
         } });
 }
 
@@ -261,75 +655,339 @@ void WebServer::setupWeatherRoutes()
 void WebServer::setupNeoPixelRoutes() {
     // Set all LEDs to a color (POST: {"r":int, "g":int, "b":int})
     server.on("/neopixel/setAll", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, data, len);
-            if (error) {
-                request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-                return;
+        [this, requests = countRoute("POST /neopixel/setAll")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_NEOPIXEL_SET_ALL);
+            if (index == 0) {
+                requests->inc();
             }
-            int r = doc["r"] | 0;
-            int g = doc["g"] | 0;
-            int b = doc["b"] | 0;
-            NeoPixel::getInstance()->setAllPixels(NeoPixel::getInstance()->rgbToColor(r, g, b));
-            NeoPixel::getInstance()->show();
-            request->send(200, "application/json", "{\"status\":\"ok\"}");
+            AsyncApiRequest in(request, data, len);
+            AsyncApiResponse out(request);
+            dashboard.setAllPixels(in, out);
         }
     );
 
     // Set a specific LED's color (POST: {"index":int, "r":int, "g":int, "b":int})
     server.on("/neopixel/setPixel", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, data, len);
-            if (error) {
-                request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-                return;
+        [this, requests = countRoute("POST /neopixel/setPixel")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_NEOPIXEL_SET_PIXEL);
+            if (index == 0) {
+                requests->inc();
             }
-            int idx = doc["index"] | 0;
-            int r = doc["r"] | 0;
-            int g = doc["g"] | 0;
-            int b = doc["b"] | 0;
-            NeoPixel::getInstance()->updatePixelColor(idx, r, g, b);
-            request->send(200, "application/json", "{\"status\":\"ok\"}");
+            AsyncApiRequest in(request, data, len);
+            AsyncApiResponse out(request);
+            dashboard.setPixel(in, out);
         }
     );
 
     // Set pattern (POST: {"pattern":int})
     server.on("/neopixel/setPattern", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, data, len);
-            if (error) {
-                request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-                return;
+        [this, requests = countRoute("POST /neopixel/setPattern")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_NEOPIXEL_SET_PATTERN);
+            if (index == 0) {
+                requests->inc();
             }
-            int pattern = doc["pattern"] | 0;
-            NeoPixel::getInstance()->setPattern(static_cast<PatternType>(pattern));
-            request->send(200, "application/json", "{\"status\":\"ok\"}");
+            AsyncApiRequest in(request, data, len);
+            AsyncApiResponse out(request);
+            dashboard.setPattern(in, out);
         }
     );
 
     // Set brightness (POST: {"brightness":int})
     server.on("/neopixel/setBrightness", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, data, len);
+        [this, requests = countRoute("POST /neopixel/setBrightness")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_NEOPIXEL_SET_BRIGHTNESS);
+            if (index == 0) {
+                requests->inc();
+            }
+            AsyncApiRequest in(request, data, len);
+            AsyncApiResponse out(request);
+            dashboard.setPixelBrightness(in, out);
+        }
+    );
+
+    // Pixel program state and interpreter speed
+    server.on("/neopixel/program", HTTP_GET, [requests = countRoute("GET /neopixel/program")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_PROGRAM_GET);
+        requests->inc();
+        NeoPixel* neoPixel = NeoPixel::getInstance();
+        const PixelVM& vm = neoPixel->getProgram();
+        
+        JsonDocument doc;
+        doc["loaded"] = vm.isLoaded();
+        doc["running"] = neoPixel->getPattern() == PATTERN_PROGRAM;
+        doc["bytes"] = vm.getCodeLength();
+        doc["instructionsPerPixel"] = vm.getInstructionCount();
+        doc["instructionsPerFrame"] = (uint32_t)vm.getInstructionCount() * NEOPIXEL_COUNT;
+        doc["frameBudget"] = VM_FRAME_BUDGET;
+        doc["pixelsPerSecond"] = neoPixel->getProgramPixelsPerSecond();
+        doc["budgetExhausted"] = neoPixel->getProgramBudgetExhausted();
+        
+        sendDocument(request, 200, doc);
+    });
+
+    // Upload a compiled pixel program (POST, application/octet-stream; see scripts/pixelvm_compile.py) and run it
+    server.on("/neopixel/program", HTTP_POST, [](AsyncWebServerRequest *request) {
+            // The body handler below is never called without a body
+            if (request->contentLength() == 0) {
+                sendReply(request, 400, "{\"error\":\"Program is empty\"}");
+            }
+        }, NULL,
+        [requests = countRoute("POST /neopixel/program")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_PROGRAM_POST);
+            if (index == 0) {
+                requests->inc();
+                if (total > 4 + VM_MAX_PROGRAM) {
+                    sendReply(request, 413, "{\"error\":\"Program too large\"}");
+                    return;
+                }
+                // Freed by the request when it is destroyed
+                request->_tempObject = malloc(total);
+                if (!request->_tempObject) {
+                    sendReply(request, 413, "{\"error\":\"Not enough free memory for the program\"}");
+                    return;
+                }
+            }
+            uint8_t* program = static_cast<uint8_t*>(request->_tempObject);
+            if (!program || index + len > total) {
+                return;
+            }
+            memcpy(program + index, data, len);
+            if (index + len < total) {
+                return;  // More chunks to come
+            }
+            
+            NeoPixel* neoPixel = NeoPixel::getInstance();
+            const char* error = neoPixel->setProgram(program, total);
             if (error) {
-                request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+                sendReply(request, 400, String("{\"error\":\"") + error + "\"}");
                 return;
             }
-            int brightness = doc["brightness"] | 0;
-            NeoPixel::getInstance()->setBrightness(brightness);
-            request->send(200, "application/json", "{\"status\":\"ok\"}");
+            neoPixel->setPattern(PATTERN_PROGRAM);
+            saveNeoPixelState();
+            sendReply(request, 200,
+                      "{\"status\":\"ok\",\"instructionsPerPixel\":" + String(neoPixel->getProgram().getInstructionCount()) + "}");
         }
     );
 
+    // Render quality governor: current level, budget and the latest level changes
+    server.on("/neopixel/quality", HTTP_GET, [requests = countRoute("GET /neopixel/quality")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_QUALITY);
+        requests->inc();
+        const QualityGovernor& quality = NeoPixel::getInstance()->getQuality();
+        
+        JsonDocument doc;
+        doc["level"] = quality.getLevel();
+        doc["name"] = qualityLevelName(quality.getLevel());
+        doc["budgetUs"] = quality.getBudgetUs();
+        doc["stepsDown"] = quality.getStepsDown();
+        doc["stepsUp"] = quality.getStepsUp();
+        doc["recoverWindows"] = quality.getRecoverWindows();
+        JsonArray changes = doc["changes"].to<JsonArray>();
+        for (size_t i = 0; i < quality.getTransitionCount(); i++) {
+            const QualityTransition& change = quality.getTransition(i);
+            JsonObject entry = changes.add<JsonObject>();
+            entry["timeMs"] = change.timeMs;
+            entry["from"] = qualityLevelName(change.from);
+            entry["to"] = qualityLevelName(change.to);
+            entry["overruns"] = change.overruns;
+            entry["peakUs"] = change.peakCostUs;
+        }
+        
+        sendDocument(request, 200, doc);
+    });
+
     // Get NeoPixel status (GET)
-    server.on("/neopixel/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-        String status = NeoPixel::getInstance()->getStatusJson();
-        request->send(200, "application/json", status);
+    server.on("/neopixel/status", HTTP_GET, [this, requests = countRoute("GET /neopixel/status")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_NEOPIXEL_STATUS);
+        requests->inc();
+        AsyncApiRequest in(request);
+        AsyncApiResponse out(request);
+        dashboard.pixelStatus(in, out);
+    });
+
+    // Animation clock sync between nodes: role, model and achieved error
+    server.on("/sync", HTTP_GET, [requests = countRoute("GET /sync")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_SYNC);
+        requests->inc();
+        SyncService* sync = SyncService::getInstance();
+        const ClockSync& clock = sync->getClock();
+        uint64_t now = sync->localUs();
+        
+        JsonDocument doc;
+        doc["nodeId"] = clock.getNodeId();
+        doc["leaderId"] = clock.getLeaderId();
+        doc["role"] = clock.isLeader() ? "leader" : (clock.isSynced() ? "follower" : "listening");
+        doc["joined"] = sync->isJoined();
+        doc["animationMs"] = clock.animationTimeMs(now);
+        doc["offsetUs"] = clock.getOffsetUs(now);
+        doc["driftPpm"] = clock.getDriftPpm();
+        doc["lastErrorUs"] = clock.getLastErrorUs();
+        doc["meanErrorUs"] = clock.getMeanErrorUs();
+        doc["maxErrorUs"] = clock.getMaxErrorUs();
+        doc["beaconsSent"] = clock.getBeaconsSent();
+        doc["beaconsReceived"] = clock.getBeaconsReceived();
+        
+        sendDocument(request, 200, doc);
     });
+
+    // List saved presets
+    server.on("/presets", HTTP_GET, [requests = countRoute("GET /presets")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_PRESETS);
+        requests->inc();
+        PresetStore* presets = PresetStore::getInstance();
+        
+        JsonDocument doc;
+        doc["slots"] = PRESET_SLOTS;
+        doc["lastRecallUs"] = presets->getLastRecallUs();
+        JsonArray list = doc["presets"].to<JsonArray>();
+        for (int slot = 0; slot < PRESET_SLOTS; slot++) {
+            if (presets->isUsed(slot)) {
+                JsonObject entry = list.add<JsonObject>();
+                entry["slot"] = slot;
+                entry["name"] = presets->getName(slot);
+            }
+        }
+        
+        sendDocument(request, 200, doc);
+    });
+
+    // Save the current scene as a preset (POST: {"name":string, "slot":int (optional)})
+    server.on("/presets/save", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [requests = countRoute("POST /presets/save")](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            TRACE_SCOPE(TRACE_HTTP_PRESETS_SAVE);
+            if (index == 0) {
+                requests->inc();
+            }
+            JsonDocument doc;
+            DeserializationError error = parseBody(request, doc, data, len);
+            if (error) {
+                sendReply(request, 400, "{\"error\":\"Invalid JSON\"}");
+                return;
+            }
+            const char* name = doc["name"] | "";
+            int slot = doc["slot"] | PresetStore::INVALID_SLOT;
+            if (name[0] == '\0') {
+                sendReply(request, 400, "{\"error\":\"Missing name\"}");
+                return;
+            }
+            slot = PresetStore::getInstance()->save(name, slot);
+            if (slot == PresetStore::INVALID_SLOT) {
+                sendReply(request, 507, "{\"error\":\"Preset not saved\"}");
+                return;
+            }
+            sendReply(request, 200, "{\"status\":\"ok\",\"slot\":" + String(slot) + "}");
+        }
+    );
+
+    // Recall a preset by ?slot=n or ?name=x; no JSON is parsed on this path
+    server.on("/presets/recall", HTTP_POST, [requests = countRoute("POST /presets/recall")](AsyncWebServerRequest *request) {
+        TRACE_SCOPE(TRACE_HTTP_PRESETS_RECALL);
+        requests->inc();
+        PresetStore* presets = PresetStore::getInstance();
+        int slot = PresetStore::INVALID_SLOT;
+        if (request->hasParam("slot")) {
+            slot = request->getParam("slot")->value().toInt();
+        } else if (request->hasParam("name")) {
+            slot = presets->find(request->getParam("name")->value().c_str());
+        }
+        
+        if (!presets->isUsed(slot)) {
+            sendReply(request, 404, "{\"error\":\"No such preset\"}");
+            return;
+        }
+        const char* error = presets->recall(slot);
+        if (error) {
+            sendReply(request, 409, String("{\"error\":\"") + error + "\"}");
+            return;
+        }
+        saveNeoPixelState();
+        sendReply(request, 200,
+                  "{\"status\":\"ok\",\"slot\":" + String(slot) + ",\"recallUs\":" + String(presets->getLastRecallUs()) + "}");
+    });
+}
+
+/**
+ * @brief Register a request counter for a route on /metrics
+ * @param handler Label value, e.g. "GET /weather"; must be a string literal
+ * @return Counter to increment from the route's handler
+ */
+Counter *WebServer::countRoute(const char *handler)
+{
+    if (routeCount >= MAX_ROUTES)
+    {
+        LOG_WARN("No metrics slot left for route %s", handler);
+        return &routeRequests[MAX_ROUTES];  // Spare, never exported
+    }
+    Counter *counter = &routeRequests[routeCount++];
+    if (routesCounted)
+    {
+        return counter;  // Routes are registered in the same order every time
+    }
+    Metrics::add("ledcloud_http_requests_total", "HTTP requests handled, by route", *counter, "handler", handler);
+    return counter;
+}
+
+SystemInfo WebServer::getSystemInfo()
+{
+    SystemInfo info;
+    info.freeHeap = ESP.getFreeHeap();
+    info.heapFragmentation = ESP.getHeapFragmentation();
+    info.wifiSignal = WiFi.RSSI();
+    info.ledState = ledState && *ledState;
+    info.brightness = brightness ? *brightness : 0;
+    info.uptime = (millis() - startTime) / 1000;
+    return info;
+}
+
+bool WebServer::getWeather(JsonDocument &doc)
+{
+    if (!weatherService)
+    {
+        return false;
+    }
+    weatherService->getWeather(doc);
+    return true;
+}
+
+int WebServer::getPixelBrightness()
+{
+    return NeoPixel::getInstance()->getBrightness();
+}
+
+int WebServer::getPattern()
+{
+    return NeoPixel::getInstance()->getPattern();
+}
+
+uint32_t WebServer::getPixelColor(int index)
+{
+    return NeoPixel::getInstance()->getPixelColor(index);
+}
+
+void WebServer::setAllPixels(int r, int g, int b)
+{
+    NeoPixel *neoPixel = NeoPixel::getInstance();
+    neoPixel->setAllPixels(neoPixel->rgbToColor(r, g, b));
+    neoPixel->show();
+    saveNeoPixelState();
+}
+
+void WebServer::setPixel(int index, int r, int g, int b)
+{
+    NeoPixel::getInstance()->updatePixelColor(index, r, g, b);
+    saveNeoPixelState();
+}
+
+void WebServer::setPattern(int pattern)
+{
+    NeoPixel::getInstance()->setPattern(static_cast<PatternType>(pattern));
+    saveNeoPixelState();
+}
+
+void WebServer::setPixelBrightness(int value)
+{
+    NeoPixel::getInstance()->setBrightness(value);
+    saveNeoPixelState();
 }
 
 /**
@@ -339,4 +997,22 @@ void WebServer::setupNeoPixelRoutes() {
 void WebServer::setWeatherService(Weather *weather)
 {
     this->weatherService = weather;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Set the scheduler whose task statistics are served on /tasks
+ * @param taskScheduler Pointer to the Scheduler
+ */
+void WebServer::setScheduler(const Scheduler *taskScheduler)
+{
+    this->scheduler = taskScheduler;
+}
+
+/**
+ * @brief Set the system history served on /system-history
+ * @param history Pointer to the SystemHistory
+ */
+void WebServer::setSystemHistory(const SystemHistory *history)
+{
+    this->systemHistory = history;
+}
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "Protocol.h"
+#include "Log.h"
 
 // Single global instance of the Protocol class
 Protocol* protocol = nullptr;
@@ -7,7 +8,7 @@ Protocol* protocol = nullptr;
 void setup() {
     // Initialize serial communication
     Serial.begin(115200);
-    Serial.println("Booting LEDcloud...");
+    LOG_INFO("Booting LEDcloud...");
     
     // Get Protocol instance and initialize the system
     protocol = Protocol::getInstance();
@@ -16,13 +17,22 @@ void setup() {
     if (initSuccess) {
         // Set up and start all system tasks
         protocol->setupTasks();
-        Serial.println("System initialization complete.");
+        LOG_INFO("System initialization complete.");
     } else {
-        Serial.println("System initialization failed!");
+        LOG_ERROR("System initialization failed!");
+        Log::flush();
     }
+
+#if LOG_BENCHMARK
+    Log::runBenchmark();
+#endif
 }
 
 void loop() {
-    // Keep the loop minimal - all functionality is handled by tasks/callbacks
-    delay(10);
+    // All periodic work is run cooperatively by the Protocol scheduler
+    if (protocol) {
+        protocol->loop();
+    } else {
+        delay(10);
+    }
 }
\ No newline at end of file